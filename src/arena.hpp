@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A bump allocator: objects are carved out of large blocks and all released together when the arena goes away, so
+// allocating is a pointer increment and freeing a whole AST costs one deallocation per block. Objects that aren't
+// trivially destructible get their destructor queued and run at that point; AST nodes are meant not to need it.
+class Arena {
+      struct Block {
+            std::unique_ptr<std::byte[]> data;
+            size_t size;
+      };
+
+      struct Finalizer {
+            void (*destroy)(void*);
+            void* object;
+      };
+
+      std::vector<Block> m_blocks;
+      std::vector<Finalizer> m_finalizers;
+      std::byte* m_cur = nullptr;
+      std::byte* m_end = nullptr;
+      size_t m_block_size;
+      size_t m_used = 0;
+
+  public:
+      explicit Arena(const size_t block_size = 64 * 1024) : m_block_size(block_size) {}
+
+      Arena(const Arena&) = delete;
+      Arena& operator=(const Arena&) = delete;
+
+      ~Arena() { run_finalizers(); }
+
+      void* allocate(const size_t size, const size_t align) {
+            auto cur = reinterpret_cast<uintptr_t>(m_cur);
+            auto aligned = (cur + align - 1) & ~(uintptr_t{align} - 1);
+            if (!m_cur || aligned + size > reinterpret_cast<uintptr_t>(m_end)) {
+                  grow(size + align);
+                  cur = reinterpret_cast<uintptr_t>(m_cur);
+                  aligned = (cur + align - 1) & ~(uintptr_t{align} - 1);
+            }
+            m_cur = reinterpret_cast<std::byte*>(aligned + size);
+            m_used += size;
+            return reinterpret_cast<void*>(aligned);
+      }
+
+      template<typename T, typename... Args>
+      T* make(Args&&... args) {
+            T* obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            if constexpr (!std::is_trivially_destructible_v<T>)
+                  m_finalizers.push_back({[](void* p) { static_cast<T*>(p)->~T(); }, obj});
+            return obj;
+      }
+
+      // Copies a list built up elsewhere (usually a reused std::vector) into the arena.
+      template<typename T>
+      std::span<T> copy(const std::span<const T> items) {
+            static_assert(std::is_trivially_copyable_v<T>, "arena lists hold pointers and plain values");
+            if (items.empty())
+                  return {};
+            T* data = static_cast<T*>(allocate(items.size_bytes(), alignof(T)));
+            std::memcpy(data, items.data(), items.size_bytes());
+            return {data, items.size()};
+      }
+
+      template<typename T>
+      std::span<T> copy(const std::vector<T>& items) {
+            return copy(std::span<const T>(items));
+      }
+
+      // Releases every object at once but keeps the first block around for reuse.
+      void reset() {
+            run_finalizers();
+            if (m_blocks.size() > 1)
+                  m_blocks.erase(m_blocks.begin() + 1, m_blocks.end());
+            m_cur = m_blocks.empty() ? nullptr : m_blocks.front().data.get();
+            m_end = m_blocks.empty() ? nullptr : m_cur + m_blocks.front().size;
+            m_used = 0;
+      }
+
+      // bytes handed out, and bytes reserved from the system
+      [[nodiscard]] size_t bytes_used() const { return m_used; }
+
+      [[nodiscard]] size_t bytes_reserved() const {
+            size_t total = 0;
+            for (const Block& b : m_blocks)
+                  total += b.size;
+            return total;
+      }
+
+  private:
+      void grow(const size_t at_least) {
+            const size_t size = at_least > m_block_size ? at_least : m_block_size;
+            m_blocks.push_back({std::make_unique_for_overwrite<std::byte[]>(size), size});
+            m_cur = m_blocks.back().data.get();
+            m_end = m_cur + size;
+      }
+
+      void run_finalizers() {
+            for (auto it = m_finalizers.rbegin(); it != m_finalizers.rend(); ++it)
+                  it->destroy(it->object);
+            m_finalizers.clear();
+      }
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "./parser.hpp"
+
+// The AST as tagged arrays: every node is a 16-byte FlatNode in one contiguous vector, children are 32-bit indices
+// into it, and variable-length child lists are ranges of `extra`. Names and literal text are copied into one character
+// buffer and referenced by index too, so the whole thing is position-independent and holds no pointers. Passes that
+// only read the tree can loop over `nodes` instead of chasing pointers through virtual calls.
+using NodeIndex = uint32_t;
+constexpr NodeIndex no_node = UINT32_MAX;
+
+// What the fields of a FlatNode hold depends on its kind:
+//   null                                       -
+//   number         data: text     aux: negated
+//   boolean                       aux: value
+//   string         data: value
+//   binary                        aux: operator (TypeOfToken)   lhs, rhs: operands
+//   unary                         aux: operator (TypeOfToken)   lhs: operand
+//   variable       data: name                                   lhs: initializer or no_node
+//   variable_call  data: name
+//   prototype      data: name                                   lhs, rhs: parameters, as an extra range (start, count)
+//   function       data: prototype node                         lhs, rhs: body, as an extra range
+//   call           data: callee                                 lhs, rhs: arguments, as an extra range
+//   comptime       data: value node or no_node                  lhs, rhs: body, as an extra range
+//   error          data: source offset                          lhs: length
+// `data` holding a string means an index into FlatAst::strings.
+struct FlatNode {
+      NodeKind kind;
+      uint8_t aux;
+      Type type;
+      uint32_t data;
+      uint32_t lhs;
+      uint32_t rhs;
+};
+
+static_assert(sizeof(FlatNode) == 16);
+
+struct FlatString {
+      uint32_t offset;
+      uint32_t length;
+};
+
+// FlatAst's arrays without owning them, e.g. straight out of a mapped cache file.
+struct FlatAstView {
+      std::span<const FlatNode> nodes;
+      std::span<const NodeIndex> extra;
+      std::span<const NodeIndex> roots;
+      std::span<const FlatString> strings;
+      std::span<const char> chars;
+
+      [[nodiscard]] std::string_view str(const uint32_t i) const {
+            return {chars.data() + strings[i].offset, strings[i].length};
+      }
+
+      // the child list of a prototype, function or call node
+      [[nodiscard]] std::span<const NodeIndex> list(const FlatNode& node) const {
+            return extra.subspan(node.lhs, node.rhs);
+      }
+};
+
+struct FlatAst {
+      std::vector<FlatNode> nodes;
+      std::vector<NodeIndex> extra;
+      std::vector<NodeIndex> roots;
+      std::vector<FlatString> strings;
+      std::vector<char> chars;
+
+      [[nodiscard]] FlatAstView view() const { return {nodes, extra, roots, strings, chars}; }
+      [[nodiscard]] std::string_view str(const uint32_t i) const { return view().str(i); }
+      [[nodiscard]] std::span<const NodeIndex> list(const FlatNode& node) const { return view().list(node); }
+};
+
+// Lowers the pointer-based tree the Parser produces into a FlatAst, in one pass. Nodes are numbered in post-order,
+// so every child's index is lower than its parent's.
+class Flattener {
+      FlatAst m_ast;
+      std::unordered_map<std::string_view, uint32_t> m_string_ids;
+
+  public:
+      FlatAst flatten(const std::span<ASTNode* const> roots) {
+            for (const ASTNode* root : roots) {
+                  if (root)
+                        m_ast.roots.push_back(add(root));
+            }
+            m_string_ids.clear();
+            return std::move(m_ast);
+      }
+
+  private:
+      uint32_t intern(const std::string_view s) {
+            const auto [it, inserted] = m_string_ids.try_emplace(s, static_cast<uint32_t>(m_ast.strings.size()));
+            if (inserted) {
+                  m_ast.strings.push_back({static_cast<uint32_t>(m_ast.chars.size()), static_cast<uint32_t>(s.size())});
+                  m_ast.chars.insert(m_ast.chars.end(), s.begin(), s.end());
+            }
+            return it->second;
+      }
+
+      NodeIndex push(const FlatNode node) {
+            m_ast.nodes.push_back(node);
+            return static_cast<NodeIndex>(m_ast.nodes.size() - 1);
+      }
+
+      // Flattens every item first (they may append lists of their own), then appends the item indices as one range.
+      template<typename T>
+      std::pair<uint32_t, uint32_t> add_list(const std::span<T* const> items) {
+            std::vector<NodeIndex> indices;
+            indices.reserve(items.size());
+            for (const T* item : items)
+                  indices.push_back(add(item));
+            const auto start = static_cast<uint32_t>(m_ast.extra.size());
+            m_ast.extra.insert(m_ast.extra.end(), indices.begin(), indices.end());
+            return {start, static_cast<uint32_t>(indices.size())};
+      }
+
+      // a missing node becomes no_node
+      NodeIndex add(const ASTNode* node) {
+            if (!node)
+                  return no_node;
+            FlatNode flat{node->kind, 0, node->type, 0, no_node, no_node};
+            switch (node->kind) {
+                  case NodeKind::null:
+                        break;
+                  case NodeKind::number: {
+                        const auto* n = static_cast<const NumberNode*>(node);
+                        flat.data = intern(n->val);
+                        flat.aux = n->isNeg;
+                        break;
+                  }
+                  case NodeKind::boolean:
+                        flat.aux = static_cast<const BoolNode*>(node)->val;
+                        break;
+                  case NodeKind::string:
+                        flat.data = intern(static_cast<const StringNode*>(node)->val);
+                        break;
+                  case NodeKind::binary: {
+                        const auto* n = static_cast<const BinaryOperation*>(node);
+                        flat.aux = static_cast<uint8_t>(n->op.type);
+                        flat.lhs = add(n->left);
+                        flat.rhs = add(n->right);
+                        break;
+                  }
+                  case NodeKind::unary: {
+                        const auto* n = static_cast<const UnaryOperation*>(node);
+                        flat.aux = static_cast<uint8_t>(n->op.type);
+                        flat.lhs = add(n->node);
+                        break;
+                  }
+                  case NodeKind::variable: {
+                        const auto* n = static_cast<const VariableNode*>(node);
+                        flat.type = n->type;
+                        flat.data = intern(n->name);
+                        flat.lhs = add(n->val);
+                        break;
+                  }
+                  case NodeKind::variable_call:
+                        flat.data = intern(static_cast<const VariableCallNode*>(node)->name);
+                        break;
+                  case NodeKind::prototype: {
+                        const auto* n = static_cast<const PrototypeNode*>(node);
+                        flat.type = n->type;
+                        flat.data = intern(n->name);
+                        std::tie(flat.lhs, flat.rhs) = add_list<VariableNode>(n->args);
+                        break;
+                  }
+                  case NodeKind::function: {
+                        const auto* n = static_cast<const FunctionNode*>(node);
+                        flat.type = n->type;
+                        flat.data = add(n->Proto);
+                        std::tie(flat.lhs, flat.rhs) = add_list<ASTNode>(n->body());
+                        break;
+                  }
+                  case NodeKind::call: {
+                        const auto* n = static_cast<const CallNode*>(node);
+                        flat.data = intern(n->callee);
+                        std::tie(flat.lhs, flat.rhs) = add_list<ASTNode>(n->args);
+                        break;
+                  }
+                  case NodeKind::comptime: {
+                        const auto* n = static_cast<const ComptimeNode*>(node);
+                        flat.data = add(n->value);
+                        std::tie(flat.lhs, flat.rhs) = add_list<ASTNode>(n->body);
+                        break;
+                  }
+                  case NodeKind::error: {
+                        const auto* n = static_cast<const ErrorNode*>(node);
+                        flat.data = n->token.offset;
+                        flat.lhs = n->token.length;
+                        break;
+                  }
+            }
+            return push(flat);
+      }
+};
@@ -0,0 +1,346 @@
+#pragma once
+#include <cstdio>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include "./parser.hpp"
+
+enum class PrintStyle {
+      // readable infix notation, one top-level node per line
+      text,
+      // one JSON object per node, without any whitespace
+      json,
+};
+
+// Writes an AST to a sink in one linear pass. Nothing is buffered on the nodes or built up in temporaries, the sink
+// receives every piece of output exactly once, in order. A sink is anything callable with a std::string_view, see
+// StringSink and StreamSink below. Types are printed by name, which takes the TypeTable of the Context the tree was
+// parsed in for anything but the built-ins.
+template<typename Sink>
+class AstPrinter {
+      Sink& m_sink;
+      const PrintStyle m_style;
+      const TypeTable* m_types;
+
+  public:
+      explicit AstPrinter(Sink& sink, const PrintStyle style = PrintStyle::text, const TypeTable* types = nullptr) :
+          m_sink(sink), m_style(style), m_types(types) {}
+
+      void print(const ASTNode* node) {
+            if (m_style == PrintStyle::json)
+                  json(node);
+            else
+                  text(node, 0);
+      }
+
+      // A parse() result: one node per line, or a JSON array.
+      void print(const std::span<ASTNode* const> nodes) {
+            if (m_style == PrintStyle::json) {
+                  json_list(nodes);
+                  return;
+            }
+            for (const ASTNode* node : nodes) {
+                  text(node, 0);
+                  put("\n");
+            }
+      }
+
+  private:
+      void put(const std::string_view s) { m_sink(s); }
+
+      [[nodiscard]] std::string type_name(const Type t) const {
+            return m_types ? m_types->str(t) : std::string(type_to_str(t));
+      }
+
+      // any span of node pointers
+      template<typename List>
+      void text_list(const List& nodes) {
+            for (size_t i = 0; i < nodes.size(); i++) {
+                  if (i > 0)
+                        put(", ");
+                  text(nodes[i], 0);
+            }
+      }
+
+      void text(const ASTNode* node, const int indent) {
+            if (!node) {
+                  put("<null>");
+                  return;
+            }
+            switch (node->kind) {
+                  case NodeKind::null:
+                        put("null");
+                        break;
+                  case NodeKind::number: {
+                        const auto* n = static_cast<const NumberNode*>(node);
+                        if (n->isNeg)
+                              put("-");
+                        put(n->val);
+                        break;
+                  }
+                  case NodeKind::boolean:
+                        put(static_cast<const BoolNode*>(node)->val ? "true" : "false");
+                        break;
+                  case NodeKind::string:
+                        put(static_cast<const StringNode*>(node)->val);
+                        break;
+                  case NodeKind::binary: {
+                        const auto* n = static_cast<const BinaryOperation*>(node);
+                        put("(");
+                        text(n->left, indent);
+                        put(" ");
+                        put(n->op.val);
+                        put(" ");
+                        text(n->right, indent);
+                        put(")");
+                        break;
+                  }
+                  case NodeKind::unary: {
+                        const auto* n = static_cast<const UnaryOperation*>(node);
+                        put(n->op.val);
+                        text(n->node, indent);
+                        break;
+                  }
+                  case NodeKind::variable: {
+                        const auto* n = static_cast<const VariableNode*>(node);
+                        put(type_name(n->type));
+                        put(" ");
+                        put(n->name);
+                        if (n->val) {
+                              put(" = ");
+                              text(n->val, indent);
+                        }
+                        break;
+                  }
+                  case NodeKind::variable_call:
+                        put(static_cast<const VariableCallNode*>(node)->name);
+                        break;
+                  case NodeKind::prototype: {
+                        const auto* n = static_cast<const PrototypeNode*>(node);
+                        put(type_name(n->type));
+                        put(" function ");
+                        put(n->name);
+                        put("(");
+                        text_list(n->args);
+                        put(")");
+                        break;
+                  }
+                  case NodeKind::function: {
+                        const auto* n = static_cast<const FunctionNode*>(node);
+                        text(n->Proto, indent);
+                        put(" :");
+                        for (const ASTNode* stmt : n->body()) {
+                              put("\n");
+                              for (int i = 0; i <= indent; i++)
+                                    put("\t");
+                              text(stmt, indent + 1);
+                        }
+                        break;
+                  }
+                  case NodeKind::call: {
+                        const auto* n = static_cast<const CallNode*>(node);
+                        put(n->callee);
+                        put("(");
+                        text_list(n->args);
+                        put(")");
+                        break;
+                  }
+                  case NodeKind::comptime: {
+                        const auto* n = static_cast<const ComptimeNode*>(node);
+                        if (n->value) {
+                              text(n->value, indent);
+                              break;
+                        }
+                        put("comptime ");
+                        if (n->body.size() == 1) {
+                              text(n->body[0], indent);
+                              break;
+                        }
+                        put("{");
+                        for (size_t i = 0; i < n->body.size(); i++) {
+                              put(i == 0 ? " " : "; ");
+                              text(n->body[i], indent);
+                        }
+                        put(" }");
+                        break;
+                  }
+                  case NodeKind::error:
+                        put("<error>");
+                        break;
+            }
+      }
+
+      void json_string(const std::string_view s) {
+            put("\"");
+            size_t plain = 0;
+            for (size_t i = 0; i < s.size(); i++) {
+                  const auto c = static_cast<unsigned char>(s[i]);
+                  if (c >= 0x20 && c != '"' && c != '\\')
+                        continue;
+                  put(s.substr(plain, i - plain));
+                  if (c == '"' || c == '\\') {
+                        const char escaped[2] = {'\\', static_cast<char>(c)};
+                        put({escaped, 2});
+                  } else {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        put({escaped, 6});
+                  }
+                  plain = i + 1;
+            }
+            put(s.substr(plain));
+            put("\"");
+      }
+
+      // any span of node pointers
+      template<typename List>
+      void json_list(const List& nodes) {
+            put("[");
+            for (size_t i = 0; i < nodes.size(); i++) {
+                  if (i > 0)
+                        put(",");
+                  json(nodes[i]);
+            }
+            put("]");
+      }
+
+      // `"key":`
+      void json_key(const std::string_view key) {
+            put(",\"");
+            put(key);
+            put("\":");
+      }
+
+      void json(const ASTNode* node) {
+            if (!node) {
+                  put("null");
+                  return;
+            }
+            put("{\"kind\":\"");
+            put(node_kind_to_str(node->kind));
+            put("\"");
+            switch (node->kind) {
+                  case NodeKind::null:
+                        break;
+                  case NodeKind::number: {
+                        const auto* n = static_cast<const NumberNode*>(node);
+                        json_key("type");
+                        json_string(type_name(n->type));
+                        // kept as written, the lexer doesn't guarantee JSON's number syntax
+                        json_key("value");
+                        put(n->isNeg ? "\"-" : "\"");
+                        put(n->val);
+                        put("\"");
+                        break;
+                  }
+                  case NodeKind::boolean:
+                        json_key("value");
+                        put(static_cast<const BoolNode*>(node)->val ? "true" : "false");
+                        break;
+                  case NodeKind::string:
+                        json_key("value");
+                        json_string(static_cast<const StringNode*>(node)->val);
+                        break;
+                  case NodeKind::binary: {
+                        const auto* n = static_cast<const BinaryOperation*>(node);
+                        json_key("op");
+                        json_string(n->op.val);
+                        json_key("lhs");
+                        json(n->left);
+                        json_key("rhs");
+                        json(n->right);
+                        break;
+                  }
+                  case NodeKind::unary: {
+                        const auto* n = static_cast<const UnaryOperation*>(node);
+                        json_key("op");
+                        json_string(n->op.val);
+                        json_key("operand");
+                        json(n->node);
+                        break;
+                  }
+                  case NodeKind::variable: {
+                        const auto* n = static_cast<const VariableNode*>(node);
+                        json_key("name");
+                        json_string(n->name);
+                        json_key("type");
+                        json_string(type_name(n->type));
+                        if (n->val) {
+                              json_key("value");
+                              json(n->val);
+                        }
+                        break;
+                  }
+                  case NodeKind::variable_call:
+                        json_key("name");
+                        json_string(static_cast<const VariableCallNode*>(node)->name);
+                        break;
+                  case NodeKind::prototype: {
+                        const auto* n = static_cast<const PrototypeNode*>(node);
+                        json_key("name");
+                        json_string(n->name);
+                        json_key("type");
+                        json_string(type_name(n->type));
+                        json_key("params");
+                        json_list(n->args);
+                        break;
+                  }
+                  case NodeKind::function: {
+                        const auto* n = static_cast<const FunctionNode*>(node);
+                        json_key("prototype");
+                        json(n->Proto);
+                        json_key("body");
+                        json_list(n->body());
+                        break;
+                  }
+                  case NodeKind::call: {
+                        const auto* n = static_cast<const CallNode*>(node);
+                        json_key("callee");
+                        json_string(n->callee);
+                        json_key("args");
+                        json_list(n->args);
+                        break;
+                  }
+                  case NodeKind::comptime: {
+                        const auto* n = static_cast<const ComptimeNode*>(node);
+                        json_key("type");
+                        json_string(type_name(n->type));
+                        json_key("body");
+                        json_list(n->body);
+                        json_key("value");
+                        json(n->value);
+                        break;
+                  }
+                  case NodeKind::error: {
+                        char offset[16];
+                        std::snprintf(offset, sizeof(offset), "%u", static_cast<const ErrorNode*>(node)->token.offset);
+                        json_key("offset");
+                        put(offset);
+                        break;
+                  }
+            }
+            put("}");
+      }
+};
+
+// Appends to a caller-owned string, which can be reused across dumps to keep its capacity.
+struct StringSink {
+      std::string& out;
+
+      void operator()(const std::string_view s) const { out.append(s); }
+};
+
+struct StreamSink {
+      std::ostream& out;
+
+      void operator()(const std::string_view s) const { out.write(s.data(), static_cast<std::streamsize>(s.size())); }
+};
+
+inline std::string to_string(const ASTNode* node, const PrintStyle style = PrintStyle::text,
+                             const TypeTable* types = nullptr) {
+      std::string out;
+      StringSink sink{out};
+      AstPrinter(sink, style, types).print(node);
+      return out;
+}
@@ -0,0 +1,730 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "./parser.hpp"
+
+// Every opcode, in one list so the enum, the names and the VM's dispatch table can't drift apart. Suffixes say what
+// the operands are: _i INT (and BOOL and null, which are 0 and 1 in the same slot), _f FLOAT, _s STRING.
+#define NANO_OPCODES(X)                                                                                                \
+      X(load)                                                                                                          \
+      X(mov)                                                                                                           \
+      X(get_global)                                                                                                    \
+      X(set_global)                                                                                                    \
+      X(add_i)                                                                                                         \
+      X(sub_i)                                                                                                         \
+      X(mul_i)                                                                                                         \
+      X(div_i)                                                                                                         \
+      X(and_i)                                                                                                         \
+      X(or_i)                                                                                                          \
+      X(neg_i)                                                                                                         \
+      X(inc_i)                                                                                                         \
+      X(dec_i)                                                                                                         \
+      X(lt_i)                                                                                                          \
+      X(le_i)                                                                                                          \
+      X(gt_i)                                                                                                          \
+      X(ge_i)                                                                                                          \
+      X(eq_i)                                                                                                          \
+      X(ne_i)                                                                                                          \
+      X(add_f)                                                                                                         \
+      X(sub_f)                                                                                                         \
+      X(mul_f)                                                                                                         \
+      X(div_f)                                                                                                         \
+      X(neg_f)                                                                                                         \
+      X(inc_f)                                                                                                         \
+      X(dec_f)                                                                                                         \
+      X(lt_f)                                                                                                          \
+      X(le_f)                                                                                                          \
+      X(gt_f)                                                                                                          \
+      X(ge_f)                                                                                                          \
+      X(eq_f)                                                                                                          \
+      X(ne_f)                                                                                                          \
+      X(not_b)                                                                                                         \
+      X(eq_s)                                                                                                          \
+      X(ne_s)                                                                                                          \
+      X(jump)                                                                                                          \
+      X(jump_if)                                                                                                       \
+      X(jump_unless)                                                                                                   \
+      X(call)                                                                                                          \
+      X(ret)
+
+enum class Op : uint8_t {
+#define NANO_OPCODE_ENUM(name) name,
+      NANO_OPCODES(NANO_OPCODE_ENUM)
+#undef NANO_OPCODE_ENUM
+};
+
+constexpr std::string_view op_to_str(const Op op) {
+      constexpr std::string_view names[] = {
+#define NANO_OPCODE_NAME(name) #name,
+              NANO_OPCODES(NANO_OPCODE_NAME)
+#undef NANO_OPCODE_NAME
+      };
+      return names[static_cast<size_t>(op)];
+}
+
+// A register is one untyped 8-byte slot, the instruction reading it knows what it holds. Strings are indices into
+// Program::strings.
+union Reg {
+      int64_t i;
+      double f;
+};
+
+static_assert(sizeof(Reg) == 8);
+
+// Three-address code over the current frame's registers: `op a, b, c` is mostly `r[a] = r[b] op r[c]`. Operands that
+// don't name a register:
+//   load a, k                   r[a] = constants[k]
+//   get_global a, g             r[a] = globals[g]
+//   set_global a, g             globals[g] = r[a]
+//   jump k / jump_if a, k       to instruction k (jump_if and jump_unless test r[a])
+//   call a, f, c                r[a] = functions[f](r[c], r[c + 1], ...)
+// `k` is 32 bits, spread over b (high half) and c.
+struct Instr {
+      Op op;
+      uint16_t a = 0;
+      uint16_t b = 0;
+      uint16_t c = 0;
+
+      [[nodiscard]] uint32_t k() const { return uint32_t{b} << 16 | c; }
+};
+
+static_assert(sizeof(Instr) == 8);
+
+struct Function {
+      std::string_view name;
+      std::vector<Instr> code;
+      // parameters arrive in registers 0 to params - 1
+      std::vector<Type> params;
+      Type result = Type::NULL_T;
+      uint16_t registers = 0;
+};
+
+// A compiled module: the top-level statements are functions[entry], run once to initialize the globals, and its
+// result is the value of the last one.
+struct Program {
+      std::vector<Function> functions;
+      std::vector<Reg> constants;
+      std::vector<std::string_view> strings;
+      std::vector<Type> globals;
+      uint32_t entry = 0;
+      std::unordered_map<std::string_view, uint32_t> by_name;
+};
+
+enum class CompileError {
+      unknown_name,
+      unknown_function,
+      unknown_type,
+      argument_count,
+      type_mismatch,
+      not_assignable,
+      unsupported,
+      too_many_registers,
+};
+
+constexpr std::string_view compile_error_to_str(CompileError e) {
+      switch (e) {
+            case CompileError::unknown_name:
+                  return "unknown name";
+            case CompileError::unknown_function:
+                  return "call to an undefined function";
+            case CompileError::unknown_type:
+                  return "a parameter or return type is missing or unknown";
+            case CompileError::argument_count:
+                  return "wrong number of arguments";
+            case CompileError::type_mismatch:
+                  return "operand types don't match";
+            case CompileError::not_assignable:
+                  return "only variables can be assigned to";
+            case CompileError::unsupported:
+                  return "not supported by the bytecode compiler";
+            case CompileError::too_many_registers:
+                  return "function needs too many registers";
+      }
+      return "unknown compile error";
+}
+
+// Lowers a parse() result to bytecode. Types are checked as it goes, each operation is emitted as the instruction for
+// its operand type, so the VM never looks at a type. Locals live in fixed registers and temporaries are stacked
+// above them, freed again as soon as the expression that needed them is done.
+class BytecodeCompiler {
+      struct Local {
+            std::string_view name;
+            uint16_t reg;
+            Type type;
+      };
+
+      Program& m_program;
+      std::unordered_map<std::string_view, uint32_t> m_globals;
+      std::unordered_map<int64_t, uint32_t> m_int_constants;
+
+      Function* m_fn = nullptr;
+      std::vector<Local> m_locals;
+      uint32_t m_top = 0;
+
+  public:
+      // the function the last error was in
+      std::string_view error_function;
+
+      explicit BytecodeCompiler(Program& program) : m_program(program) {}
+
+      std::optional<CompileError> compile(const std::span<ASTNode* const> items) {
+            std::vector<const FunctionNode*> bodies;
+            for (const ASTNode* item : items) {
+                  if (!item || item->kind != NodeKind::function)
+                        continue;
+                  const auto* fn = static_cast<const FunctionNode*>(item);
+                  Function f{fn->Proto->name, {}, {}, fn->Proto->type, 0};
+                  error_function = f.name;
+                  if (f.result == Type::UNKNOWN)
+                        return CompileError::unknown_type;
+                  for (const VariableNode* param : fn->Proto->args) {
+                        if (param->type == Type::UNKNOWN)
+                              return CompileError::unknown_type;
+                        f.params.push_back(param->type);
+                  }
+                  m_program.by_name[f.name] = static_cast<uint32_t>(m_program.functions.size());
+                  m_program.functions.push_back(std::move(f));
+                  bodies.push_back(fn);
+            }
+
+            // the entry first, it decides what type each global has
+            m_program.entry = static_cast<uint32_t>(m_program.functions.size());
+            m_program.functions.push_back({"<entry>", {}, {}, Type::NULL_T, 0});
+            error_function = "<entry>";
+            if (const std::optional<CompileError> err = entry(items))
+                  return err;
+
+            for (size_t i = 0; i < bodies.size(); i++) {
+                  error_function = bodies[i]->Proto->name;
+                  if (const std::optional<CompileError> err = function(i, *bodies[i]))
+                        return err;
+            }
+            return std::nullopt;
+      }
+
+  private:
+      std::optional<CompileError> entry(const std::span<ASTNode* const> items) {
+            begin(m_program.entry, 0);
+            const uint16_t result = alloc();
+            emit_load(result, 0);
+            Type type = Type::NULL_T;
+            for (const ASTNode* item : items) {
+                  if (!item || item->kind == NodeKind::function || item->kind == NodeKind::prototype)
+                        continue;
+                  if (item->kind == NodeKind::variable) {
+                        const auto* var = static_cast<const VariableNode*>(item);
+                        if (const std::optional<CompileError> err = initializer(var, result, type))
+                              return err;
+                        const auto [it, inserted] =
+                                m_globals.try_emplace(var->name, static_cast<uint32_t>(m_program.globals.size()));
+                        if (inserted)
+                              m_program.globals.push_back(type);
+                        else if (m_program.globals[it->second] != type)
+                              return CompileError::type_mismatch;
+                        emit(Op::set_global, result, it->second);
+                        continue;
+                  }
+                  if (const std::optional<CompileError> err = emit_to(item, result, type))
+                        return err;
+            }
+            m_fn->result = type;
+            emit(Op::ret, result);
+            return std::nullopt;
+      }
+
+      std::optional<CompileError> function(const size_t index, const FunctionNode& node) {
+            begin(static_cast<uint32_t>(index), 0);
+            for (const VariableNode* param : node.Proto->args)
+                  declare(param->name, alloc(), param->type);
+            const uint16_t result = alloc();
+            Type type;
+            if (const std::optional<CompileError> err = block(node.body(), result, type))
+                  return err;
+            if (type != m_fn->result)
+                  return CompileError::type_mismatch;
+            emit(Op::ret, result);
+            return std::nullopt;
+      }
+
+      void begin(const uint32_t index, const uint32_t top) {
+            m_fn = &m_program.functions[index];
+            m_locals.clear();
+            m_top = top;
+      }
+
+      uint16_t alloc() {
+            const auto reg = static_cast<uint16_t>(m_top < UINT16_MAX ? m_top : UINT16_MAX);
+            m_top++;
+            if (m_top > m_fn->registers)
+                  m_fn->registers = static_cast<uint16_t>(m_top < UINT16_MAX ? m_top : UINT16_MAX);
+            return reg;
+      }
+
+      void declare(const std::string_view name, const uint16_t reg, const Type type) {
+            m_locals.push_back({name, reg, type});
+      }
+
+      const Local* local(const std::string_view name) const {
+            for (size_t i = m_locals.size(); i > 0; i--) {
+                  if (m_locals[i - 1].name == name)
+                        return &m_locals[i - 1];
+            }
+            return nullptr;
+      }
+
+      void emit(const Op op, const uint16_t a = 0, const uint32_t k = 0) {
+            m_fn->code.push_back({op, a, static_cast<uint16_t>(k >> 16), static_cast<uint16_t>(k)});
+      }
+
+      void emit3(const Op op, const uint16_t a, const uint16_t b, const uint16_t c) {
+            m_fn->code.push_back({op, a, b, c});
+      }
+
+      [[nodiscard]] uint32_t here() const { return static_cast<uint32_t>(m_fn->code.size()); }
+
+      void patch(const uint32_t at, const uint32_t target) {
+            m_fn->code[at].b = static_cast<uint16_t>(target >> 16);
+            m_fn->code[at].c = static_cast<uint16_t>(target);
+      }
+
+      void emit_load(const uint16_t dst, const int64_t value) {
+            // integers, and the bools, nulls and string indices stored like them, are shared
+            Reg r;
+            r.i = value;
+            const auto [it, inserted] =
+                    m_int_constants.try_emplace(value, static_cast<uint32_t>(m_program.constants.size()));
+            if (inserted)
+                  m_program.constants.push_back(r);
+            emit(Op::load, dst, it->second);
+      }
+
+      void emit_load_float(const uint16_t dst, const double value) {
+            m_program.constants.push_back(Reg{.f = value});
+            emit(Op::load, dst, static_cast<uint32_t>(m_program.constants.size() - 1));
+      }
+
+      // The statements of a body in their own scope, the value of the last one into `dst`.
+      std::optional<CompileError> block(const std::span<ASTNode* const> stmts, const uint16_t dst, Type& type) {
+            const size_t locals = m_locals.size();
+            const uint32_t top = m_top;
+            type = Type::NULL_T;
+            if (stmts.empty())
+                  emit_load(dst, 0);
+            for (const ASTNode* stmt : stmts) {
+                  if (stmt && stmt->kind == NodeKind::variable) {
+                        const auto* var = static_cast<const VariableNode*>(stmt);
+                        const uint16_t reg = alloc();
+                        if (const std::optional<CompileError> err = initializer(var, reg, type))
+                              return err;
+                        declare(var->name, reg, type);
+                        emit3(Op::mov, dst, reg, 0);
+                        continue;
+                  }
+                  if (const std::optional<CompileError> err = emit_to(stmt, dst, type))
+                        return err;
+            }
+            m_locals.resize(locals);
+            m_top = top;
+            return std::nullopt;
+      }
+
+      std::optional<CompileError> initializer(const VariableNode* var, const uint16_t dst, Type& type) {
+            if (!var->val) {
+                  emit_load(dst, 0);
+                  type = Type::NULL_T;
+                  return std::nullopt;
+            }
+            return emit_to(var->val, dst, type);
+      }
+
+      // Whether evaluating `node` may assign to a local of the current function.
+      static bool writes_locals(const ASTNode* node) {
+            if (!node)
+                  return false;
+            switch (node->kind) {
+                  case NodeKind::binary: {
+                        const auto* n = static_cast<const BinaryOperation*>(node);
+                        switch (n->op.type) {
+                              case TypeOfToken::OP_EQUALS:
+                              case TypeOfToken::OP_PLUSEQUALS:
+                              case TypeOfToken::OP_MINUSEQUALS:
+                              case TypeOfToken::OP_TIMESEQUALS:
+                              case TypeOfToken::OP_DIVEQUALS:
+                                    return true;
+                              default:
+                                    return writes_locals(n->left) || writes_locals(n->right);
+                        }
+                  }
+                  case NodeKind::unary: {
+                        const auto* n = static_cast<const UnaryOperation*>(node);
+                        return n->op.type == TypeOfToken::OP_INC || n->op.type == TypeOfToken::OP_DEC ||
+                               writes_locals(n->node);
+                  }
+                  case NodeKind::call:
+                        return std::ranges::any_of(static_cast<const CallNode*>(node)->args, writes_locals);
+                  case NodeKind::comptime: {
+                        const auto* n = static_cast<const ComptimeNode*>(node);
+                        return !n->value && std::ranges::any_of(n->body, [](const ASTNode* stmt) {
+                               return stmt && (stmt->kind == NodeKind::variable || writes_locals(stmt));
+                        });
+                  }
+                  default:
+                        return false;
+            }
+      }
+
+      // The register `node` is in: a local's own, or a new temporary it is evaluated into. A local is only read in
+      // place when `later`, evaluated after it, can't assign to it first.
+      std::optional<CompileError> operand(const ASTNode* node, uint16_t& reg, Type& type,
+                                          const ASTNode* later = nullptr) {
+            if (node && node->kind == NodeKind::variable_call && !writes_locals(later)) {
+                  if (const Local* l = local(static_cast<const VariableCallNode*>(node)->name)) {
+                        reg = l->reg;
+                        type = l->type;
+                        return std::nullopt;
+                  }
+            }
+            reg = alloc();
+            return emit_to(node, reg, type);
+      }
+
+      std::optional<CompileError> emit_to(const ASTNode* node, const uint16_t dst, Type& type) {
+            if (m_top >= UINT16_MAX)
+                  return CompileError::too_many_registers;
+            if (!node)
+                  return CompileError::unsupported;
+
+            switch (node->kind) {
+                  case NodeKind::null:
+                        type = Type::NULL_T;
+                        emit_load(dst, 0);
+                        return std::nullopt;
+                  case NodeKind::number: {
+                        const auto* n = static_cast<const NumberNode*>(node);
+                        type = n->type;
+                        if (type == Type::INT)
+                              emit_load(dst, n->integer);
+                        else if (type == Type::FLOAT)
+                              emit_load_float(dst, n->real);
+                        else
+                              return CompileError::unsupported;
+                        return std::nullopt;
+                  }
+                  case NodeKind::boolean:
+                        type = Type::BOOL;
+                        emit_load(dst, static_cast<const BoolNode*>(node)->val);
+                        return std::nullopt;
+                  case NodeKind::string:
+                        type = Type::STRING;
+                        m_program.strings.push_back(static_cast<const StringNode*>(node)->val);
+                        emit_load(dst, static_cast<int64_t>(m_program.strings.size() - 1));
+                        return std::nullopt;
+                  case NodeKind::variable_call: {
+                        const std::string_view name = static_cast<const VariableCallNode*>(node)->name;
+                        if (const Local* l = local(name)) {
+                              type = l->type;
+                              if (l->reg != dst)
+                                    emit3(Op::mov, dst, l->reg, 0);
+                              return std::nullopt;
+                        }
+                        const auto g = m_globals.find(name);
+                        if (g == m_globals.end())
+                              return CompileError::unknown_name;
+                        type = m_program.globals[g->second];
+                        emit(Op::get_global, dst, g->second);
+                        return std::nullopt;
+                  }
+                  case NodeKind::binary:
+                        return binary(*static_cast<const BinaryOperation*>(node), dst, type);
+                  case NodeKind::unary:
+                        return unary(*static_cast<const UnaryOperation*>(node), dst, type);
+                  case NodeKind::call:
+                        return call(*static_cast<const CallNode*>(node), dst, type);
+                  case NodeKind::comptime: {
+                        const auto* n = static_cast<const ComptimeNode*>(node);
+                        if (n->value)
+                              return emit_to(n->value, dst, type);
+                        // not evaluated (yet), it computes the same thing at run time
+                        return block(n->body, dst, type);
+                  }
+                  case NodeKind::variable:
+                  case NodeKind::prototype:
+                  case NodeKind::function:
+                  case NodeKind::error:
+                        break;
+            }
+            return CompileError::unsupported;
+      }
+
+      std::optional<CompileError> call(const CallNode& node, const uint16_t dst, Type& type) {
+            const auto it = m_program.by_name.find(node.callee);
+            if (it == m_program.by_name.end())
+                  return CompileError::unknown_function;
+            // call names its callee in 16 bits
+            if (it->second > UINT16_MAX)
+                  return CompileError::unsupported;
+            const Function& callee = m_program.functions[it->second];
+            if (callee.params.size() != node.args.size())
+                  return CompileError::argument_count;
+
+            // arguments go to consecutive registers, which become the callee's first ones
+            const uint32_t top = m_top;
+            const auto base = static_cast<uint16_t>(m_top);
+            for (size_t i = 0; i < node.args.size(); i++)
+                  alloc();
+            for (size_t i = 0; i < node.args.size(); i++) {
+                  Type arg;
+                  const auto reg = static_cast<uint16_t>(base + i);
+                  if (const std::optional<CompileError> err = emit_to(node.args[i], reg, arg))
+                        return err;
+                  if (arg != callee.params[i])
+                        return CompileError::type_mismatch;
+            }
+            emit3(Op::call, dst, static_cast<uint16_t>(it->second), base);
+            m_top = top;
+            type = callee.result;
+            return std::nullopt;
+      }
+
+      std::optional<CompileError> unary(const UnaryOperation& node, const uint16_t dst, Type& type) {
+            const TypeOfToken op = node.op.type;
+            if (op == TypeOfToken::OP_INC || op == TypeOfToken::OP_DEC) {
+                  if (node.node->kind != NodeKind::variable_call)
+                        return CompileError::not_assignable;
+                  const Local* l = local(static_cast<const VariableCallNode*>(node.node)->name);
+                  if (!l)
+                        return CompileError::not_assignable;
+                  type = l->type;
+                  const bool inc = op == TypeOfToken::OP_INC;
+                  if (type == Type::INT)
+                        emit3(inc ? Op::inc_i : Op::dec_i, l->reg, 0, 0);
+                  else if (type == Type::FLOAT)
+                        emit3(inc ? Op::inc_f : Op::dec_f, l->reg, 0, 0);
+                  else
+                        return CompileError::type_mismatch;
+                  if (l->reg != dst)
+                        emit3(Op::mov, dst, l->reg, 0);
+                  return std::nullopt;
+            }
+
+            const uint32_t top = m_top;
+            uint16_t src;
+            if (const std::optional<CompileError> err = operand(node.node, src, type))
+                  return err;
+            m_top = top;
+            if (op == TypeOfToken::OP_MINUS && type == Type::INT)
+                  emit3(Op::neg_i, dst, src, 0);
+            else if (op == TypeOfToken::OP_MINUS && type == Type::FLOAT)
+                  emit3(Op::neg_f, dst, src, 0);
+            else if (op == TypeOfToken::OP_EXCL_MARK && type == Type::BOOL)
+                  emit3(Op::not_b, dst, src, 0);
+            else
+                  return CompileError::type_mismatch;
+            return std::nullopt;
+      }
+
+      // the instruction for `op` on two `type` operands, and the type of its result
+      static std::optional<std::pair<Op, Type>> select(const TypeOfToken op, const Type type) {
+            using enum TypeOfToken;
+            const bool integral = type == Type::INT;
+            if (type == Type::INT || type == Type::FLOAT) {
+                  switch (op) {
+                        case OP_PLUS:
+                              return std::pair{integral ? Op::add_i : Op::add_f, type};
+                        case OP_MINUS:
+                              return std::pair{integral ? Op::sub_i : Op::sub_f, type};
+                        case OP_TIMES:
+                              return std::pair{integral ? Op::mul_i : Op::mul_f, type};
+                        case OP_DIV:
+                              return std::pair{integral ? Op::div_i : Op::div_f, type};
+                        case LTHAN:
+                              return std::pair{integral ? Op::lt_i : Op::lt_f, Type::BOOL};
+                        case LTHAN_EQUALS:
+                              return std::pair{integral ? Op::le_i : Op::le_f, Type::BOOL};
+                        case GTHAN:
+                              return std::pair{integral ? Op::gt_i : Op::gt_f, Type::BOOL};
+                        case GTHAN_EQUALS:
+                              return std::pair{integral ? Op::ge_i : Op::ge_f, Type::BOOL};
+                        case OP_EQUALSEQUALS:
+                              return std::pair{integral ? Op::eq_i : Op::eq_f, Type::BOOL};
+                        case OP_EXCL_EQUALS:
+                              return std::pair{integral ? Op::ne_i : Op::ne_f, Type::BOOL};
+                        case OP_AMPERSAND:
+                              if (integral)
+                                    return std::pair{Op::and_i, type};
+                              break;
+                        case OP_PIPE:
+                              if (integral)
+                                    return std::pair{Op::or_i, type};
+                              break;
+                        default:
+                              break;
+                  }
+                  return std::nullopt;
+            }
+            if (op == OP_EQUALSEQUALS || op == OP_EXCL_EQUALS) {
+                  const bool eq = op == OP_EQUALSEQUALS;
+                  if (type == Type::STRING)
+                        return std::pair{eq ? Op::eq_s : Op::ne_s, Type::BOOL};
+                  if (type == Type::BOOL || type == Type::NULL_T)
+                        return std::pair{eq ? Op::eq_i : Op::ne_i, Type::BOOL};
+            }
+            return std::nullopt;
+      }
+
+      std::optional<CompileError> binary(const BinaryOperation& node, const uint16_t dst, Type& type) {
+            using enum TypeOfToken;
+            const TypeOfToken op = node.op.type;
+            switch (op) {
+                  case OP_EQUALS:
+                  case OP_PLUSEQUALS:
+                  case OP_MINUSEQUALS:
+                  case OP_TIMESEQUALS:
+                  case OP_DIVEQUALS:
+                        return assign(node, dst, type);
+                  case OP_DOUBLEAMPERSAND:
+                  case OP_DOUBLEPIPE: {
+                        if (const std::optional<CompileError> err = emit_to(node.left, dst, type))
+                              return err;
+                        if (type != Type::BOOL)
+                              return CompileError::type_mismatch;
+                        const uint32_t skip = here();
+                        emit(op == OP_DOUBLEAMPERSAND ? Op::jump_unless : Op::jump_if, dst);
+                        if (const std::optional<CompileError> err = emit_to(node.right, dst, type))
+                              return err;
+                        if (type != Type::BOOL)
+                              return CompileError::type_mismatch;
+                        patch(skip, here());
+                        return std::nullopt;
+                  }
+                  default:
+                        break;
+            }
+
+            const uint32_t top = m_top;
+            uint16_t lhs, rhs;
+            Type left, right;
+            if (const std::optional<CompileError> err = operand(node.left, lhs, left, node.right))
+                  return err;
+            if (const std::optional<CompileError> err = operand(node.right, rhs, right))
+                  return err;
+            m_top = top;
+            if (left != right)
+                  return CompileError::type_mismatch;
+            const std::optional<std::pair<Op, Type>> instr = select(op, left);
+            if (!instr)
+                  return CompileError::type_mismatch;
+            emit3(instr->first, dst, lhs, rhs);
+            type = instr->second;
+            return std::nullopt;
+      }
+
+      std::optional<CompileError> assign(const BinaryOperation& node, const uint16_t dst, Type& type) {
+            if (!node.left || node.left->kind != NodeKind::variable_call)
+                  return CompileError::not_assignable;
+            const std::string_view name = static_cast<const VariableCallNode*>(node.left)->name;
+            const Local* l = local(name);
+            const auto g = l ? m_globals.end() : m_globals.find(name);
+            if (!l && g == m_globals.end())
+                  return CompileError::unknown_name;
+            const Type target = l ? l->type : m_program.globals[g->second];
+
+            TypeOfToken op;
+            switch (node.op.type) {
+                  case TypeOfToken::OP_PLUSEQUALS:
+                        op = TypeOfToken::OP_PLUS;
+                        break;
+                  case TypeOfToken::OP_MINUSEQUALS:
+                        op = TypeOfToken::OP_MINUS;
+                        break;
+                  case TypeOfToken::OP_TIMESEQUALS:
+                        op = TypeOfToken::OP_TIMES;
+                        break;
+                  case TypeOfToken::OP_DIVEQUALS:
+                        op = TypeOfToken::OP_DIV;
+                        break;
+                  default:
+                        op = TypeOfToken::OP_EQUALS;
+                        break;
+            }
+
+            const uint32_t top = m_top;
+            const uint16_t reg = l ? l->reg : dst;
+            if (op == TypeOfToken::OP_EQUALS) {
+                  // not straight into a local's register, the right side may still read the old value after a write
+                  const uint16_t value = l ? alloc() : reg;
+                  if (const std::optional<CompileError> err = emit_to(node.right, value, type))
+                        return err;
+                  if (value != reg)
+                        emit3(Op::mov, reg, value, 0);
+            } else {
+                  uint16_t rhs;
+                  if (const std::optional<CompileError> err = operand(node.right, rhs, type))
+                        return err;
+                  if (!l)
+                        emit(Op::get_global, reg, g->second);
+                  const std::optional<std::pair<Op, Type>> instr = select(op, type);
+                  if (!instr || instr->second != type)
+                        return CompileError::type_mismatch;
+                  emit3(instr->first, reg, reg, rhs);
+            }
+            m_top = top;
+            if (type != target)
+                  return CompileError::type_mismatch;
+            if (l && reg != dst)
+                  emit3(Op::mov, dst, reg, 0);
+            if (!l)
+                  emit(Op::set_global, reg, g->second);
+            return std::nullopt;
+      }
+};
+
+// One line per instruction, for tests and for looking at what the compiler made of something.
+inline std::string disassemble(const Function& fn) {
+      std::string out;
+      const auto r = [](const uint16_t reg) { return " r" + std::to_string(reg); };
+      for (size_t i = 0; i < fn.code.size(); i++) {
+            const Instr& in = fn.code[i];
+            out += std::to_string(i) + ": " + std::string(op_to_str(in.op));
+            switch (in.op) {
+                  case Op::load:
+                  case Op::get_global:
+                  case Op::set_global:
+                  case Op::jump_if:
+                  case Op::jump_unless:
+                        out += r(in.a) + ", " + std::to_string(in.k());
+                        break;
+                  case Op::jump:
+                        out += " " + std::to_string(in.k());
+                        break;
+                  case Op::call:
+                        out += r(in.a) + ", f" + std::to_string(in.b) + "," + r(in.c);
+                        break;
+                  case Op::ret:
+                  case Op::inc_i:
+                  case Op::dec_i:
+                  case Op::inc_f:
+                  case Op::dec_f:
+                        out += r(in.a);
+                        break;
+                  case Op::mov:
+                  case Op::neg_i:
+                  case Op::neg_f:
+                  case Op::not_b:
+                        out += r(in.a) + "," + r(in.b);
+                        break;
+                  default:
+                        out += r(in.a) + "," + r(in.b) + "," + r(in.c);
+                        break;
+            }
+            out += '\n';
+      }
+      return out;
+}
@@ -0,0 +1,456 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "./ast_flat.hpp"
+#include "./hash.hpp"
+#include "./interface.hpp"
+#include "./lexer.hpp"
+#include "./source.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define NANO_HAS_GETPID 1
+#else
+#define NANO_HAS_GETPID 0
+#endif
+
+// Entries written by another compiler version never match: the version is part of every key.
+constexpr std::string_view compiler_version = "nano 0.1.0";
+constexpr uint32_t cache_format = 6;
+
+enum class CacheError {
+      cannot_create_directory,
+      cannot_write,
+};
+
+constexpr std::string_view cache_error_to_str(CacheError e) {
+      switch (e) {
+            case CacheError::cannot_create_directory:
+                  return "cannot create cache directory";
+            case CacheError::cannot_write:
+                  return "cannot write cache entry";
+      }
+      return "unknown cache error";
+}
+
+// What a cache entry holds, one array each, in file order.
+enum class CacheSection : uint32_t {
+      kinds,
+      keywords,
+      offsets,
+      lengths,
+      symbols,
+      line_starts,
+      // (token index, value) pairs, uint32_t each, values in `chars`
+      decoded,
+      decoded_values,
+      names,
+      imports,
+      // bytes of names, decoded values and imports
+      chars,
+      ast_nodes,
+      ast_extra,
+      ast_roots,
+      ast_strings,
+      ast_chars,
+      // what the types of the nodes that aren't built-ins are, see StoredType
+      types,
+      type_members,
+      type_names,
+      count,
+};
+
+// An entry is this header followed by the sections, each at an 8-byte aligned offset. Everything is stored the way
+// it sits in memory, so reading an entry is mapping the file and pointing spans into it.
+struct CacheHeader {
+      char magic[8];
+      uint32_t format;
+      uint32_t sections;
+      uint64_t key;
+      uint64_t source_size;
+      // of everything after the header, so a damaged file fails to open
+      uint64_t hash;
+
+      struct Section {
+            uint64_t offset;
+            uint64_t count;
+      } section[static_cast<size_t>(CacheSection::count)];
+};
+
+constexpr char cache_magic[8] = {'N', 'A', 'N', 'O', 'C', 'A', 'C', 'H'};
+
+// A mapped cache entry: a file's token stream, its flattened AST and its imports. Token values aren't stored, they
+// are recovered from the source text like a TokenStream's are. The types of the nodes are stored ones, which types()
+// translates. Every index in an entry that opened is in bounds, so nothing read from one needs checking again.
+class CacheEntry {
+      SourceBuffer m_file;
+      const CacheHeader* m_header = nullptr;
+
+  public:
+      // nullopt for a missing, truncated, damaged or foreign file
+      static std::optional<CacheEntry> open(const std::filesystem::path& path, const uint64_t key,
+                                            const uint64_t source_size) {
+            CacheEntry entry;
+            if (entry.m_file.load(path.string()) || entry.m_file.size() < sizeof(CacheHeader))
+                  return std::nullopt;
+            const std::string_view bytes = entry.m_file.view();
+            const auto* header = reinterpret_cast<const CacheHeader*>(bytes.data());
+            if (std::memcmp(header->magic, cache_magic, sizeof(cache_magic)) != 0 || header->format != cache_format ||
+                header->sections != static_cast<uint32_t>(CacheSection::count) || header->key != key ||
+                header->source_size != source_size ||
+                header->hash != xxh64::hash(bytes.data() + sizeof(CacheHeader), bytes.size() - sizeof(CacheHeader)))
+                  return std::nullopt;
+            entry.m_header = header;
+            if (!entry.bounded() || !entry.tokens_valid() || !entry.ast_valid())
+                  return std::nullopt;
+            return entry;
+      }
+
+      [[nodiscard]] size_t token_count() const { return section<TypeOfToken>(CacheSection::kinds).size(); }
+      [[nodiscard]] std::span<const TypeOfToken> kinds() const { return section<TypeOfToken>(CacheSection::kinds); }
+      [[nodiscard]] std::span<const Keyword> keywords() const { return section<Keyword>(CacheSection::keywords); }
+      [[nodiscard]] std::span<const uint32_t> offsets() const { return section<uint32_t>(CacheSection::offsets); }
+      [[nodiscard]] std::span<const uint32_t> lengths() const { return section<uint32_t>(CacheSection::lengths); }
+      [[nodiscard]] std::span<const SymbolId> symbols() const { return section<SymbolId>(CacheSection::symbols); }
+      [[nodiscard]] std::span<const uint32_t> line_starts() const {
+            return section<uint32_t>(CacheSection::line_starts);
+      }
+
+      // (token index, value) of every literal whose value isn't its text, in token order
+      [[nodiscard]] std::vector<std::pair<uint32_t, std::string_view>> decoded() const {
+            std::vector<std::pair<uint32_t, std::string_view>> decoded;
+            const std::span<const uint32_t> indices = section<uint32_t>(CacheSection::decoded);
+            for (size_t i = 0; i < indices.size() && i < section<FlatString>(CacheSection::decoded_values).size(); i++)
+                  decoded.emplace_back(indices[i], str(CacheSection::decoded_values, i));
+            return decoded;
+      }
+
+      [[nodiscard]] size_t name_count() const { return section<FlatString>(CacheSection::names).size(); }
+      [[nodiscard]] std::string_view name(const SymbolId id) const { return str(CacheSection::names, id); }
+
+      [[nodiscard]] std::vector<std::string_view> imports() const {
+            std::vector<std::string_view> imports;
+            for (size_t i = 0; i < section<FlatString>(CacheSection::imports).size(); i++)
+                  imports.push_back(str(CacheSection::imports, i));
+            return imports;
+      }
+
+      [[nodiscard]] FlatAstView ast() const {
+            return {section<FlatNode>(CacheSection::ast_nodes), section<NodeIndex>(CacheSection::ast_extra),
+                    section<NodeIndex>(CacheSection::ast_roots), section<FlatString>(CacheSection::ast_strings),
+                    section<char>(CacheSection::ast_chars)};
+      }
+
+      // What the type of a node in ast() is in `table`, indexed by the node's type.
+      [[nodiscard]] std::vector<Type> types(TypeTable& table) const {
+            // open() made sure they're valid
+            return *table.import(section<StoredType>(CacheSection::types), section<Type>(CacheSection::type_members),
+                                 type_names());
+      }
+
+  private:
+      template<typename T>
+      [[nodiscard]] std::span<const T> section(const CacheSection s) const {
+            const CacheHeader::Section& sec = m_header->section[static_cast<size_t>(s)];
+            return {reinterpret_cast<const T*>(m_file.view().data() + sec.offset), static_cast<size_t>(sec.count)};
+      }
+
+      [[nodiscard]] std::string_view type_names() const {
+            const std::span<const char> names = section<char>(CacheSection::type_names);
+            return {names.data(), names.size()};
+      }
+
+      [[nodiscard]] std::string_view str(const CacheSection s, const size_t i) const {
+            const FlatString ref = section<FlatString>(s)[i];
+            return {section<char>(CacheSection::chars).data() + ref.offset, ref.length};
+      }
+
+      // whether every one of `refs` lies within `chars`
+      [[nodiscard]] static bool within(const std::span<const FlatString> refs, const std::span<const char> chars) {
+            return std::ranges::all_of(refs, [&chars](const FlatString ref) {
+                  return ref.offset <= chars.size() && ref.length <= chars.size() - ref.offset;
+            });
+      }
+
+      [[nodiscard]] bool bounded() const {
+            static constexpr size_t sizes[] = {sizeof(TypeOfToken), sizeof(Keyword),    sizeof(uint32_t),
+                                               sizeof(uint32_t),    sizeof(SymbolId),   sizeof(uint32_t),
+                                               sizeof(uint32_t),    sizeof(FlatString), sizeof(FlatString),
+                                               sizeof(FlatString),  sizeof(char),       sizeof(FlatNode),
+                                               sizeof(NodeIndex),   sizeof(NodeIndex),  sizeof(FlatString),
+                                               sizeof(char),        sizeof(StoredType), sizeof(Type),
+                                               sizeof(char)};
+            static_assert(std::size(sizes) == static_cast<size_t>(CacheSection::count));
+            for (size_t i = 0; i < std::size(sizes); i++) {
+                  const CacheHeader::Section& sec = m_header->section[i];
+                  if (sec.offset % 8 != 0 || sec.offset > m_file.size() ||
+                      sec.count > (m_file.size() - sec.offset) / sizes[i])
+                        return false;
+            }
+            return true;
+      }
+
+      // one of every per-token array each, every token and line inside the source, every symbol a name
+      [[nodiscard]] bool tokens_valid() const {
+            const size_t n = token_count();
+            const uint64_t source_size = m_header->source_size;
+            const std::span<const uint32_t> offsets = this->offsets(), lengths = this->lengths();
+            const std::span<const FlatString> values = section<FlatString>(CacheSection::decoded_values);
+            const std::span<const char> chars = section<char>(CacheSection::chars);
+            if (keywords().size() != n || offsets.size() != n || lengths.size() != n || symbols().size() != n ||
+                line_starts().empty() || section<uint32_t>(CacheSection::decoded).size() != values.size() ||
+                !within(values, chars) || !within(section<FlatString>(CacheSection::names), chars) ||
+                !within(section<FlatString>(CacheSection::imports), chars))
+                  return false;
+            for (size_t i = 0; i < n; i++) {
+                  const SymbolId symbol = symbols()[i];
+                  if (kinds()[i] > TypeOfToken::T_EOF || keywords()[i] > Keyword::none || offsets[i] > source_size ||
+                      lengths[i] > source_size - offsets[i] || (symbol != no_symbol && symbol >= name_count()))
+                        return false;
+            }
+            const auto in_source = [source_size](const uint32_t start) { return start <= source_size; };
+            const auto a_token = [n](const uint32_t i) { return i < n; };
+            return std::ranges::all_of(line_starts(), in_source) &&
+                   std::ranges::all_of(section<uint32_t>(CacheSection::decoded), a_token);
+      }
+
+      // Every child of a node comes before it, as the Flattener numbers them, which also rules out cycles; lists are
+      // ranges of `extra`, strings are within the AST's characters.
+      [[nodiscard]] bool ast_valid() const {
+            const FlatAstView ast = this->ast();
+            const std::span<const StoredType> types = section<StoredType>(CacheSection::types);
+            if (!within(ast.strings, ast.chars) ||
+                !TypeTable::valid(types, section<Type>(CacheSection::type_members), type_names()))
+                  return false;
+            const auto child = [](const uint32_t c, const size_t parent) { return c == no_node || c < parent; };
+            const auto list = [&](const FlatNode& node, const size_t parent) {
+                  return node.lhs <= ast.extra.size() && node.rhs <= ast.extra.size() - node.lhs &&
+                         std::ranges::all_of(ast.list(node), [&](const NodeIndex c) { return child(c, parent); });
+            };
+            for (size_t i = 0; i < ast.nodes.size(); i++) {
+                  const FlatNode& node = ast.nodes[i];
+                  if (static_cast<size_t>(node.type) >= builtin_types + types.size())
+                        return false;
+                  bool ok;
+                  switch (node.kind) {
+                        case NodeKind::null:
+                        case NodeKind::boolean:
+                              ok = true;
+                              break;
+                        case NodeKind::number:
+                        case NodeKind::string:
+                        case NodeKind::variable_call:
+                              ok = node.data < ast.strings.size();
+                              break;
+                        case NodeKind::binary:
+                              ok = child(node.lhs, i) && child(node.rhs, i);
+                              break;
+                        case NodeKind::unary:
+                              ok = child(node.lhs, i);
+                              break;
+                        case NodeKind::variable:
+                              ok = node.data < ast.strings.size() && child(node.lhs, i);
+                              break;
+                        case NodeKind::prototype:
+                        case NodeKind::call:
+                              ok = node.data < ast.strings.size() && list(node, i);
+                              break;
+                        case NodeKind::function:
+                        case NodeKind::comptime:
+                              ok = child(node.data, i) && list(node, i);
+                              break;
+                        case NodeKind::error:
+                              ok = node.data <= m_header->source_size && node.lhs <= m_header->source_size - node.data;
+                              break;
+                        default:
+                              ok = false;
+                  }
+                  if (!ok)
+                        return false;
+            }
+            return std::ranges::all_of(ast.roots, [&ast](const NodeIndex r) { return r < ast.nodes.size(); });
+      }
+};
+
+// A directory of cache entries, one per distinct source text, named after the hash of that text and the compiler
+// version, each with the module's interface beside it. Nothing is ever invalidated: a changed file hashes to a
+// different entry.
+class CompilationCache {
+      std::filesystem::path m_dir;
+
+  public:
+      explicit CompilationCache(std::filesystem::path dir) : m_dir(std::move(dir)) {}
+
+      static uint64_t key(const std::string_view source) {
+            return xxh64::hash(source, xxh64::hash(compiler_version, cache_format));
+      }
+
+      [[nodiscard]] std::filesystem::path path_of(const uint64_t key) const {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%016llx.nanoc", static_cast<unsigned long long>(key));
+            return m_dir / name;
+      }
+
+      [[nodiscard]] std::optional<CacheEntry> load(const std::string_view source) const {
+            const uint64_t k = key(source);
+            return CacheEntry::open(path_of(k), k, source.size());
+      }
+
+      // the interface of the module with `source`, next to its entry
+      [[nodiscard]] std::filesystem::path interface_path(const uint64_t key) const {
+            std::filesystem::path path = path_of(key);
+            path.replace_extension(".nanoi");
+            return path;
+      }
+
+      // with its types made ids of `types`
+      [[nodiscard]] std::optional<ModuleInterface> load_interface(const std::string_view source,
+                                                                  TypeTable& types) const {
+            const uint64_t k = key(source);
+            return ModuleInterface::open(interface_path(k), k, types);
+      }
+
+      // what ModuleInterface::build() made for `source`
+      std::optional<CacheError> store_interface(const std::string_view source, const std::string_view bytes) const {
+            std::error_code ec;
+            std::filesystem::create_directories(m_dir, ec);
+            if (ec)
+                  return CacheError::cannot_create_directory;
+            return write(interface_path(key(source)), bytes);
+      }
+
+      // `ast` has types of `types`
+      std::optional<CacheError> store(const std::string_view source, const TokenStream& tokens, const FlatAst& ast,
+                                      const TypeTable& types, const std::span<const std::string_view> imports) const {
+            return store_entry(source, entry(source, tokens, ast, types, imports));
+      }
+
+      // The bytes store() writes for `source`, and writing ones made elsewhere: what a remote cache shares.
+      static std::string entry(const std::string_view source, const TokenStream& tokens, const FlatAst& ast,
+                               const TypeTable& types, const std::span<const std::string_view> imports) {
+            return serialize(key(source), source.size(), tokens, ast, types, imports);
+      }
+
+      std::optional<CacheError> store_entry(const std::string_view source, const std::string_view bytes) const {
+            std::error_code ec;
+            std::filesystem::create_directories(m_dir, ec);
+            if (ec)
+                  return CacheError::cannot_create_directory;
+            return write(path_of(key(source)), bytes);
+      }
+
+  private:
+      // Entries are written to a temporary file and renamed into place, so a reader never sees half of one. The
+      // temporary is named after the process and the thread, as every build sharing the directory may be writing
+      // the same entry at once, and thread ids alone repeat from one process to the next.
+      static std::optional<CacheError> write(const std::filesystem::path& target, const std::string_view bytes) {
+            std::error_code ec;
+            std::filesystem::path temp = target;
+#if NANO_HAS_GETPID
+            temp += "." + std::to_string(::getpid());
+#endif
+            temp += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+
+            std::FILE* file = std::fopen(temp.string().c_str(), "wb");
+            if (!file)
+                  return CacheError::cannot_write;
+            const bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+            if (std::fclose(file) != 0 || !written) {
+                  std::filesystem::remove(temp, ec);
+                  return CacheError::cannot_write;
+            }
+            std::filesystem::rename(temp, target, ec);
+            if (ec) {
+                  std::filesystem::remove(temp, ec);
+                  return CacheError::cannot_write;
+            }
+            return std::nullopt;
+      }
+
+      static std::string serialize(const uint64_t key, const size_t source_size, const TokenStream& tokens,
+                                   const FlatAst& ast, const TypeTable& types,
+                                   const std::span<const std::string_view> imports) {
+            CacheHeader header{};
+            std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+            header.format = cache_format;
+            header.sections = static_cast<uint32_t>(CacheSection::count);
+            header.key = key;
+            header.source_size = source_size;
+
+            std::string out(sizeof(CacheHeader), '\0');
+            const auto put = [&]<typename T>(const CacheSection s, const std::span<const T> items) {
+                  out.resize((out.size() + 7) & ~size_t{7}, '\0');
+                  header.section[static_cast<size_t>(s)] = {out.size(), items.size()};
+                  out.append(reinterpret_cast<const char*>(items.data()), items.size_bytes());
+            };
+
+            const size_t n = tokens.size();
+            std::vector<Keyword> keywords(n);
+            std::vector<uint32_t> offsets(n), lengths(n);
+            std::vector<SymbolId> symbols(n);
+            for (size_t i = 0; i < n; i++) {
+                  keywords[i] = tokens.keyword(i);
+                  offsets[i] = tokens.offset(i);
+                  lengths[i] = tokens.length(i);
+                  symbols[i] = tokens.symbol(i);
+            }
+
+            std::string chars;
+            const auto intern = [&chars](const std::string_view s) {
+                  const FlatString ref{static_cast<uint32_t>(chars.size()), static_cast<uint32_t>(s.size())};
+                  chars += s;
+                  return ref;
+            };
+            std::vector<uint32_t> decoded;
+            std::vector<FlatString> decoded_values, names, import_names;
+            for (const auto& [index, val] : tokens.decoded()) {
+                  decoded.push_back(index);
+                  decoded_values.push_back(intern(val));
+            }
+            for (SymbolId id = 0; id < tokens.names.size(); id++)
+                  names.push_back(intern(tokens.names.str(id)));
+            for (const std::string_view name : imports)
+                  import_names.push_back(intern(name));
+
+            put(CacheSection::kinds, std::span<const TypeOfToken>(tokens.kinds()));
+            put(CacheSection::keywords, std::span<const Keyword>(keywords));
+            put(CacheSection::offsets, std::span<const uint32_t>(offsets));
+            put(CacheSection::lengths, std::span<const uint32_t>(lengths));
+            put(CacheSection::symbols, std::span<const SymbolId>(symbols));
+            put(CacheSection::line_starts, std::span<const uint32_t>(tokens.line_starts));
+            put(CacheSection::decoded, std::span<const uint32_t>(decoded));
+            put(CacheSection::decoded_values, std::span<const FlatString>(decoded_values));
+            put(CacheSection::names, std::span<const FlatString>(names));
+            put(CacheSection::imports, std::span<const FlatString>(import_names));
+            put(CacheSection::chars, std::span<const char>(chars));
+            TypeTable::Export stored(types);
+            std::vector<FlatNode> nodes(ast.nodes);
+            for (FlatNode& node : nodes)
+                  node.type = stored.export_type(node.type);
+            put(CacheSection::ast_nodes, std::span<const FlatNode>(nodes));
+            put(CacheSection::ast_extra, std::span<const NodeIndex>(ast.extra));
+            put(CacheSection::ast_roots, std::span<const NodeIndex>(ast.roots));
+            put(CacheSection::ast_strings, std::span<const FlatString>(ast.strings));
+            put(CacheSection::ast_chars, std::span<const char>(ast.chars));
+            put(CacheSection::types, std::span<const StoredType>(stored.types));
+            put(CacheSection::type_members, std::span<const Type>(stored.members));
+            put(CacheSection::type_names, std::span<const char>(stored.names));
+
+            header.hash = xxh64::hash(out.data() + sizeof(CacheHeader), out.size() - sizeof(CacheHeader));
+            std::memcpy(out.data(), &header, sizeof(header));
+            return out;
+      }
+};
@@ -0,0 +1,543 @@
+#pragma once
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "./context.hpp"
+#include "./diagnostics.hpp"
+#include "./hash.hpp"
+#include "./parser.hpp"
+#include "./value.hpp"
+
+// Limits for evaluating one comptime expression, so a runaway one fails instead of stalling the build.
+struct EvalBudget {
+      // nodes evaluated
+      size_t steps = 10'000'000;
+      // calls nested in each other
+      size_t depth = 512;
+      // bytes of locals, and of the results memoized while evaluating it; what earlier expressions memoized is still
+      // reused, but no longer counts
+      size_t memory = 64 << 20;
+};
+
+// Evaluates comptime expressions by walking the AST. Functions have no side effects beyond their own locals (globals
+// are read-only at compile time), so a call's result only depends on the function and its arguments and is memoized
+// on exactly that: a table built by calling the same helpers over and over only computes each distinct call once, for
+// the whole file.
+class Interpreter {
+      struct Local {
+            std::string_view name;
+            Value value;
+      };
+
+      struct Global {
+            const VariableNode* node;
+            std::optional<Value> value;
+            bool evaluating = false;
+      };
+
+      struct Call {
+            const FunctionNode* function;
+            std::vector<Value> args;
+
+            bool operator==(const Call&) const = default;
+      };
+
+      struct CallHash {
+            size_t operator()(const Call& c) const {
+                  uint64_t h = std::hash<const void*>{}(c.function);
+                  for (const Value& v : c.args) {
+                        const uint64_t bits = v.type == Type::FLOAT    ? std::bit_cast<uint64_t>(v.real)
+                                              : v.type == Type::STRING ? xxh64::hash(v.string)
+                                                                       : static_cast<uint64_t>(v.integer) ^ v.boolean;
+                        h = (h ^ (bits + static_cast<uint64_t>(v.type))) * 0x9E3779B97F4A7C15ull;
+                  }
+                  return static_cast<size_t>(h ^ (h >> 32));
+            }
+      };
+
+      Context& m_ctx;
+      Diagnostics* m_diagnostics;
+      EvalBudget m_budget;
+
+      std::unordered_map<std::string_view, const FunctionNode*> m_functions;
+      std::unordered_map<std::string_view, Global> m_globals;
+      std::unordered_map<Call, Value, CallHash> m_memo;
+      // every frame's locals, innermost last; the current frame's start at m_frame
+      std::vector<Local> m_locals;
+      size_t m_frame = 0;
+
+      size_t m_steps = 0;
+      size_t m_depth = 0;
+      size_t m_memory = 0;
+      size_t m_memo_hits = 0;
+
+  public:
+      // Literal nodes for the results are allocated from `ctx`, the arena the AST is in.
+      explicit Interpreter(Context& ctx, Diagnostics* diagnostics = nullptr, const EvalBudget budget = {}) :
+          m_ctx(ctx), m_diagnostics(diagnostics), m_budget(budget) {}
+
+      // Goes through a parse() result in order: every function is callable, globals are visible from their
+      // declaration on, and every comptime node met gets its value (or a diagnostic).
+      void run(const std::span<ASTNode* const> items) {
+            for (const ASTNode* item : items) {
+                  if (item && item->kind == NodeKind::function) {
+                        const auto* fn = static_cast<const FunctionNode*>(item);
+                        m_functions[fn->Proto->name] = fn;
+                  }
+            }
+            for (ASTNode* item : items) {
+                  visit(item);
+                  if (item && item->kind == NodeKind::variable) {
+                        const auto* var = static_cast<const VariableNode*>(item);
+                        m_globals.insert_or_assign(var->name, Global{var, std::nullopt});
+                  }
+            }
+      }
+
+      // Evaluates one expression at global scope, within a fresh budget.
+      std::optional<EvalError> evaluate(const ASTNode* node, Value& out) {
+            m_steps = 0;
+            m_depth = 0;
+            m_memory = 0;
+            const size_t frame = enter();
+            const std::optional<EvalError> err = eval(node, out);
+            leave(frame);
+            return err;
+      }
+
+      // calls answered from the memo table
+      [[nodiscard]] size_t memo_hits() const { return m_memo_hits; }
+
+      // The literal node for `v`; nullptr for a FLOAT that isn't finite.
+      static ASTNode* literal(Arena& arena, const Token& at, const Value& v) {
+            switch (v.type) {
+                  case Type::INT:
+                        return fold::integer(arena, at, v.integer);
+                  case Type::FLOAT:
+                        return fold::real(arena, at, v.real);
+                  case Type::BOOL:
+                        return fold::boolean(arena, at, v.boolean);
+                  case Type::STRING: {
+                        auto* node = arena.make<StringNode>(at);
+                        node->val = v.string;
+                        return node;
+                  }
+                  case Type::NULL_T:
+                  case Type::UNKNOWN:
+                        break;
+            }
+            return arena.make<NullNode>(at);
+      }
+
+  private:
+      // Looks for comptime nodes that aren't inside another one and evaluates them.
+      void visit(ASTNode* node) {
+            if (!node)
+                  return;
+            switch (node->kind) {
+                  case NodeKind::binary: {
+                        auto* n = static_cast<BinaryOperation*>(node);
+                        visit(n->left);
+                        visit(n->right);
+                        break;
+                  }
+                  case NodeKind::unary:
+                        visit(static_cast<UnaryOperation*>(node)->node);
+                        break;
+                  case NodeKind::variable:
+                        visit(static_cast<VariableNode*>(node)->val);
+                        break;
+                  case NodeKind::function:
+                        for (ASTNode* stmt : static_cast<FunctionNode*>(node)->body())
+                              visit(stmt);
+                        break;
+                  case NodeKind::call:
+                        for (ASTNode* arg : static_cast<CallNode*>(node)->args)
+                              visit(arg);
+                        break;
+                  case NodeKind::comptime: {
+                        auto* n = static_cast<ComptimeNode*>(node);
+                        if (n->value)
+                              break;
+                        Value v;
+                        if (const std::optional<EvalError> err = evaluate(n, v)) {
+                              if (m_diagnostics)
+                                    m_diagnostics->report(*err, n->token.offset, n->token.length);
+                        }
+                        break;
+                  }
+                  default:
+                        break;
+            }
+      }
+
+      size_t enter() { return std::exchange(m_frame, m_locals.size()); }
+
+      void leave(const size_t frame) {
+            m_memory -= (m_locals.size() - m_frame) * sizeof(Local);
+            m_locals.resize(m_frame);
+            m_frame = frame;
+      }
+
+      std::optional<EvalError> charge(const size_t bytes) {
+            m_memory += bytes;
+            if (m_memory > m_budget.memory)
+                  return EvalError::memory_limit;
+            return std::nullopt;
+      }
+
+      Value* local(const std::string_view name) {
+            for (size_t i = m_locals.size(); i > m_frame; i--) {
+                  if (m_locals[i - 1].name == name)
+                        return &m_locals[i - 1].value;
+            }
+            return nullptr;
+      }
+
+      std::optional<EvalError> eval(const ASTNode* node, Value& out) {
+            if (!node)
+                  return EvalError::not_constant;
+            if (++m_steps > m_budget.steps)
+                  return EvalError::step_limit;
+
+            switch (node->kind) {
+                  case NodeKind::null:
+                        out = Value{};
+                        return std::nullopt;
+                  case NodeKind::number: {
+                        const auto* n = static_cast<const NumberNode*>(node);
+                        if (n->type == Type::INT)
+                              out = Value::of(n->integer);
+                        else if (n->type == Type::FLOAT)
+                              out = Value::of(n->real);
+                        else
+                              return EvalError::not_constant;
+                        return std::nullopt;
+                  }
+                  case NodeKind::boolean:
+                        out = Value::of(static_cast<const BoolNode*>(node)->val);
+                        return std::nullopt;
+                  case NodeKind::string:
+                        out = Value::of(static_cast<const StringNode*>(node)->val);
+                        return std::nullopt;
+                  case NodeKind::binary:
+                        return binary(*static_cast<const BinaryOperation*>(node), out);
+                  case NodeKind::unary:
+                        return unary(*static_cast<const UnaryOperation*>(node), out);
+                  case NodeKind::variable: {
+                        const auto* n = static_cast<const VariableNode*>(node);
+                        out = Value{};
+                        if (n->val) {
+                              if (const std::optional<EvalError> err = eval(n->val, out))
+                                    return err;
+                        }
+                        if (const std::optional<EvalError> err = charge(sizeof(Local)))
+                              return err;
+                        m_locals.push_back({n->name, out});
+                        return std::nullopt;
+                  }
+                  case NodeKind::variable_call:
+                        return name(static_cast<const VariableCallNode*>(node)->name, out);
+                  case NodeKind::call:
+                        return call(*static_cast<const CallNode*>(node), out);
+                  case NodeKind::comptime: {
+                        auto* n = const_cast<ComptimeNode*>(static_cast<const ComptimeNode*>(node));
+                        if (n->value)
+                              return eval(n->value, out);
+                        // a nested comptime only sees globals, so its value is the same wherever it's reached
+                        const size_t frame = enter();
+                        std::optional<EvalError> err = body(n->body, out);
+                        leave(frame);
+                        if (err)
+                              return err;
+                        if (!(n->value = literal(m_ctx.arena, n->token, out)))
+                              return EvalError::not_finite;
+                        n->type = out.type;
+                        return std::nullopt;
+                  }
+                  case NodeKind::prototype:
+                  case NodeKind::function:
+                  case NodeKind::error:
+                        break;
+            }
+            return EvalError::not_constant;
+      }
+
+      // the value of the last expression, null for none
+      std::optional<EvalError> body(const std::span<ASTNode* const> exprs, Value& out) {
+            out = Value{};
+            for (const ASTNode* expr : exprs) {
+                  if (const std::optional<EvalError> err = eval(expr, out))
+                        return err;
+            }
+            return std::nullopt;
+      }
+
+      std::optional<EvalError> name(const std::string_view n, Value& out) {
+            if (const Value* v = local(n)) {
+                  out = *v;
+                  return std::nullopt;
+            }
+            const auto it = m_globals.find(n);
+            if (it == m_globals.end())
+                  return EvalError::unknown_name;
+            Global& g = it->second;
+            if (!g.value) {
+                  // declared in terms of itself
+                  if (g.evaluating)
+                        return EvalError::not_constant;
+                  g.evaluating = true;
+                  const size_t frame = enter();
+                  Value v;
+                  const std::optional<EvalError> err = g.node->val ? eval(g.node->val, v) : std::nullopt;
+                  leave(frame);
+                  g.evaluating = false;
+                  if (err)
+                        return err;
+                  g.value = v;
+            }
+            out = *g.value;
+            return std::nullopt;
+      }
+
+      std::optional<EvalError> call(const CallNode& node, Value& out) {
+            const auto fn = m_functions.find(node.callee);
+            if (fn == m_functions.end())
+                  return EvalError::unknown_function;
+            const FunctionNode* function = fn->second;
+            if (node.args.size() != function->Proto->args.size())
+                  return EvalError::argument_count;
+
+            Call key{function, std::vector<Value>(node.args.size())};
+            for (size_t i = 0; i < node.args.size(); i++) {
+                  if (const std::optional<EvalError> err = eval(node.args[i], key.args[i]))
+                        return err;
+            }
+            if (const auto hit = m_memo.find(key); hit != m_memo.end()) {
+                  m_memo_hits++;
+                  out = hit->second;
+                  return std::nullopt;
+            }
+
+            if (m_depth >= m_budget.depth)
+                  return EvalError::depth_limit;
+            m_depth++;
+            const size_t frame = enter();
+            std::optional<EvalError> err;
+            for (size_t i = 0; i < key.args.size() && !err; i++) {
+                  err = charge(sizeof(Local));
+                  m_locals.push_back({function->Proto->args[i]->name, key.args[i]});
+            }
+            if (!err)
+                  err = body(function->body(), out);
+            leave(frame);
+            m_depth--;
+            if (err)
+                  return err;
+
+            if (const std::optional<EvalError> full =
+                        charge(sizeof(Call) + sizeof(Value) * (key.args.size() + 1) + 2 * sizeof(void*)))
+                  return full;
+            m_memo.emplace(std::move(key), out);
+            return std::nullopt;
+      }
+
+      std::optional<EvalError> unary(const UnaryOperation& node, Value& out) {
+            const TypeOfToken op = node.op.type;
+            if (op == TypeOfToken::OP_INC || op == TypeOfToken::OP_DEC) {
+                  if (node.node->kind != NodeKind::variable_call)
+                        return EvalError::not_constant;
+                  Value* v = local(static_cast<const VariableCallNode*>(node.node)->name);
+                  if (!v)
+                        return EvalError::not_constant;
+                  const uint64_t step = op == TypeOfToken::OP_INC ? 1 : UINT64_MAX;
+                  if (v->type == Type::INT)
+                        v->integer = static_cast<int64_t>(static_cast<uint64_t>(v->integer) + step);
+                  else if (v->type == Type::FLOAT)
+                        v->real += op == TypeOfToken::OP_INC ? 1.0 : -1.0;
+                  else
+                        return EvalError::type_mismatch;
+                  out = *v;
+                  return std::nullopt;
+            }
+
+            if (const std::optional<EvalError> err = eval(node.node, out))
+                  return err;
+            if (op == TypeOfToken::OP_MINUS && out.type == Type::INT) {
+                  out.integer = static_cast<int64_t>(0 - static_cast<uint64_t>(out.integer));
+                  return std::nullopt;
+            }
+            if (op == TypeOfToken::OP_MINUS && out.type == Type::FLOAT) {
+                  out.real = -out.real;
+                  return std::nullopt;
+            }
+            if (op == TypeOfToken::OP_EXCL_MARK && out.type == Type::BOOL) {
+                  out.boolean = !out.boolean;
+                  return std::nullopt;
+            }
+            return EvalError::type_mismatch;
+      }
+
+      std::optional<EvalError> binary(const BinaryOperation& node, Value& out) {
+            const TypeOfToken op = node.op.type;
+            switch (op) {
+                  case TypeOfToken::OP_EQUALS:
+                  case TypeOfToken::OP_PLUSEQUALS:
+                  case TypeOfToken::OP_MINUSEQUALS:
+                  case TypeOfToken::OP_TIMESEQUALS:
+                  case TypeOfToken::OP_DIVEQUALS:
+                        return assign(node, out);
+                  case TypeOfToken::OP_DOUBLEAMPERSAND:
+                  case TypeOfToken::OP_DOUBLEPIPE: {
+                        if (const std::optional<EvalError> err = eval(node.left, out))
+                              return err;
+                        if (out.type != Type::BOOL)
+                              return EvalError::type_mismatch;
+                        // short-circuits, which is what comptime code has for a conditional
+                        if (out.boolean == (op == TypeOfToken::OP_DOUBLEPIPE))
+                              return std::nullopt;
+                        if (const std::optional<EvalError> err = eval(node.right, out))
+                              return err;
+                        return out.type == Type::BOOL ? std::nullopt : std::optional(EvalError::type_mismatch);
+                  }
+                  default:
+                        break;
+            }
+
+            Value rhs;
+            if (const std::optional<EvalError> err = eval(node.left, out))
+                  return err;
+            if (const std::optional<EvalError> err = eval(node.right, rhs))
+                  return err;
+            return apply(op, out, rhs);
+      }
+
+      std::optional<EvalError> assign(const BinaryOperation& node, Value& out) {
+            if (!node.left || node.left->kind != NodeKind::variable_call)
+                  return EvalError::not_constant;
+            // globals are constants at compile time, only locals can change
+            const std::string_view name = static_cast<const VariableCallNode*>(node.left)->name;
+            if (!local(name))
+                  return EvalError::not_constant;
+            if (const std::optional<EvalError> err = eval(node.right, out))
+                  return err;
+            // looked up again, evaluating the right side may have grown m_locals
+            Value* target = local(name);
+
+            TypeOfToken op;
+            switch (node.op.type) {
+                  case TypeOfToken::OP_PLUSEQUALS:
+                        op = TypeOfToken::OP_PLUS;
+                        break;
+                  case TypeOfToken::OP_MINUSEQUALS:
+                        op = TypeOfToken::OP_MINUS;
+                        break;
+                  case TypeOfToken::OP_TIMESEQUALS:
+                        op = TypeOfToken::OP_TIMES;
+                        break;
+                  case TypeOfToken::OP_DIVEQUALS:
+                        op = TypeOfToken::OP_DIV;
+                        break;
+                  default:
+                        *target = out;
+                        return std::nullopt;
+            }
+            Value result = *target;
+            if (const std::optional<EvalError> err = apply(op, result, out))
+                  return err;
+            *target = out = result;
+            return std::nullopt;
+      }
+
+      // `a = a op b`, with the same rules as fold::binary(), except that what has no value is an error
+      static std::optional<EvalError> apply(const TypeOfToken op, Value& a, const Value& b) {
+            if (a.type != b.type)
+                  return EvalError::type_mismatch;
+
+            const auto compare = [&](const auto x, const auto y) -> std::optional<EvalError> {
+                  if (const std::optional<bool> r = fold::compare(op, x, y)) {
+                        a = Value::of(*r);
+                        return std::nullopt;
+                  }
+                  return EvalError::type_mismatch;
+            };
+
+            switch (a.type) {
+                  case Type::INT: {
+                        const auto x = static_cast<uint64_t>(a.integer);
+                        const auto y = static_cast<uint64_t>(b.integer);
+                        switch (op) {
+                              case TypeOfToken::OP_PLUS:
+                                    a.integer = static_cast<int64_t>(x + y);
+                                    return std::nullopt;
+                              case TypeOfToken::OP_MINUS:
+                                    a.integer = static_cast<int64_t>(x - y);
+                                    return std::nullopt;
+                              case TypeOfToken::OP_TIMES:
+                                    a.integer = static_cast<int64_t>(x * y);
+                                    return std::nullopt;
+                              case TypeOfToken::OP_DIV:
+                                    if (b.integer == 0)
+                                          return EvalError::division_by_zero;
+                                    // INT64_MIN / -1 overflows, and wraps like the VM's does
+                                    a.integer = b.integer == -1 ? static_cast<int64_t>(0 - x) : a.integer / b.integer;
+                                    return std::nullopt;
+                              case TypeOfToken::OP_AMPERSAND:
+                                    a.integer &= b.integer;
+                                    return std::nullopt;
+                              case TypeOfToken::OP_PIPE:
+                                    a.integer |= b.integer;
+                                    return std::nullopt;
+                              default:
+                                    return compare(a.integer, b.integer);
+                        }
+                  }
+                  case Type::FLOAT: {
+                        switch (op) {
+                              case TypeOfToken::OP_PLUS:
+                                    a.real += b.real;
+                                    break;
+                              case TypeOfToken::OP_MINUS:
+                                    a.real -= b.real;
+                                    break;
+                              case TypeOfToken::OP_TIMES:
+                                    a.real *= b.real;
+                                    break;
+                              case TypeOfToken::OP_DIV:
+                                    if (b.real == 0)
+                                          return EvalError::division_by_zero;
+                                    a.real /= b.real;
+                                    break;
+                              default:
+                                    return compare(a.real, b.real);
+                        }
+                        return std::isfinite(a.real) ? std::nullopt : std::optional(EvalError::not_finite);
+                  }
+                  case Type::BOOL:
+                        return compare(a.boolean, b.boolean);
+                  case Type::STRING:
+                        if (op == TypeOfToken::OP_EQUALSEQUALS || op == TypeOfToken::OP_EXCL_EQUALS) {
+                              a = Value::of((a.string == b.string) == (op == TypeOfToken::OP_EQUALSEQUALS));
+                              return std::nullopt;
+                        }
+                        return EvalError::type_mismatch;
+                  case Type::NULL_T:
+                        if (op == TypeOfToken::OP_EQUALSEQUALS || op == TypeOfToken::OP_EXCL_EQUALS) {
+                              a = Value::of(op == TypeOfToken::OP_EQUALSEQUALS);
+                              return std::nullopt;
+                        }
+                        return EvalError::type_mismatch;
+                  case Type::UNKNOWN:
+                        break;
+            }
+            return EvalError::not_constant;
+      }
+};
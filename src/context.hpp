@@ -0,0 +1,20 @@
+#pragma once
+#include <memory>
+#include "./arena.hpp"
+#include "./types.hpp"
+
+// State that lives exactly as long as one compilation: the parser allocates AST nodes and their child lists from
+// `arena`, so they're all released in one go together with the context, and looks type names up in `types`. Contexts
+// that take part in the same compilation, like a Driver's per worker, share its TypeTable; one made on its own has
+// its own.
+struct Context {
+  private:
+      std::unique_ptr<TypeTable> m_own_types;
+
+  public:
+      Arena arena;
+      TypeTable& types;
+
+      Context() : m_own_types(std::make_unique<TypeTable>()), types(*m_own_types) {}
+      explicit Context(TypeTable& shared) : types(shared) {}
+};
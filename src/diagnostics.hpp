@@ -0,0 +1,207 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+#include "./lexer.hpp"
+
+enum class ParseError {
+      expected_expression,
+      expected_variable_name,
+      expected_equals,
+      expected_function_name,
+      expected_lparen,
+      expected_parameter_name,
+      expected_colon,
+      expected_type,
+      expected_rparen,
+      expected_body,
+      expected_rbrace,
+      expected_module,
+      nested_too_deeply,
+};
+
+constexpr std::string_view parse_error_to_str(ParseError e) {
+      switch (e) {
+            case ParseError::expected_expression:
+                  return "expected an expression";
+            case ParseError::expected_variable_name:
+                  return "expected a variable name";
+            case ParseError::expected_equals:
+                  return "expected '='";
+            case ParseError::expected_function_name:
+                  return "expected a function name";
+            case ParseError::expected_lparen:
+                  return "expected '('";
+            case ParseError::expected_parameter_name:
+                  return "expected a parameter name";
+            case ParseError::expected_colon:
+                  return "expected ':'";
+            case ParseError::expected_type:
+                  return "expected a type";
+            case ParseError::expected_rparen:
+                  return "expected ')'";
+            case ParseError::expected_body:
+                  return "expected '{' or ';'";
+            case ParseError::expected_rbrace:
+                  return "expected '}'";
+            case ParseError::expected_module:
+                  return "expected a module after import";
+            case ParseError::nested_too_deeply:
+                  return "nested too deeply";
+      }
+      return "unknown parse error";
+}
+
+enum class EvalError {
+      step_limit,
+      depth_limit,
+      memory_limit,
+      unknown_name,
+      unknown_function,
+      argument_count,
+      type_mismatch,
+      division_by_zero,
+      not_finite,
+      not_constant,
+};
+
+constexpr std::string_view eval_error_to_str(EvalError e) {
+      switch (e) {
+            case EvalError::step_limit:
+                  return "comptime evaluation took too many steps";
+            case EvalError::depth_limit:
+                  return "comptime calls nested too deeply";
+            case EvalError::memory_limit:
+                  return "comptime evaluation used too much memory";
+            case EvalError::unknown_name:
+                  return "unknown name in comptime expression";
+            case EvalError::unknown_function:
+                  return "call to a function without a body in comptime expression";
+            case EvalError::argument_count:
+                  return "wrong number of arguments";
+            case EvalError::type_mismatch:
+                  return "operand types don't match";
+            case EvalError::division_by_zero:
+                  return "division by zero";
+            case EvalError::not_finite:
+                  return "float result is not finite";
+            case EvalError::not_constant:
+                  return "not a compile-time constant";
+      }
+      return "unknown evaluation error";
+}
+
+enum class SemaError {
+      unknown_variable,
+      unknown_function,
+      redefined_function,
+      unknown_type,
+      argument_count,
+      argument_type,
+      operand_types,
+      invalid_operand,
+      not_assignable,
+      assignment_type,
+      return_type,
+      global_type,
+      nested_function,
+      number_out_of_range,
+};
+
+constexpr std::string_view sema_error_to_str(SemaError e) {
+      switch (e) {
+            case SemaError::unknown_variable:
+                  return "unknown variable";
+            case SemaError::unknown_function:
+                  return "unknown function";
+            case SemaError::redefined_function:
+                  return "function already defined differently";
+            case SemaError::unknown_type:
+                  return "unknown type";
+            case SemaError::argument_count:
+                  return "wrong number of arguments";
+            case SemaError::argument_type:
+                  return "argument of the wrong type";
+            case SemaError::operand_types:
+                  return "operand types don't match";
+            case SemaError::invalid_operand:
+                  return "operator not defined for this type";
+            case SemaError::not_assignable:
+                  return "only a variable can be assigned to";
+            case SemaError::assignment_type:
+                  return "assigned value has the wrong type";
+            case SemaError::return_type:
+                  return "body doesn't have the function's return type";
+            case SemaError::global_type:
+                  return "global declared again with another type";
+            case SemaError::nested_function:
+                  return "functions can only be declared at the top level";
+            case SemaError::number_out_of_range:
+                  return "integer literal out of range";
+      }
+      return "unknown semantic error";
+}
+
+// One problem and the source bytes it is about, as offsets like a token's.
+struct Diagnostic {
+      std::variant<LexerError, ParseError, EvalError, SemaError> error;
+      uint32_t offset;
+      uint32_t length;
+
+      bool operator==(const Diagnostic&) const = default;
+
+      [[nodiscard]] std::string_view message() const {
+            if (const LexerError* e = std::get_if<LexerError>(&error))
+                  return lexer_error_to_str(*e);
+            if (const ParseError* e = std::get_if<ParseError>(&error))
+                  return parse_error_to_str(*e);
+            if (const SemaError* e = std::get_if<SemaError>(&error))
+                  return sema_error_to_str(*e);
+            return eval_error_to_str(std::get<EvalError>(error));
+      }
+};
+
+// Collects every error of a file instead of stopping at the first one: Lexer::tokenize(diagnostics) and a Parser
+// given one report here and recover, and so do the TypeChecker and the comptime Interpreter.
+class Diagnostics {
+      std::vector<Diagnostic> m_list;
+
+  public:
+      void report(const LexerError e, const size_t offset, const size_t length) {
+            m_list.push_back({e, static_cast<uint32_t>(offset), static_cast<uint32_t>(length)});
+      }
+
+      void report(const ParseError e, const size_t offset, const size_t length) {
+            m_list.push_back({e, static_cast<uint32_t>(offset), static_cast<uint32_t>(length)});
+      }
+
+      void report(const EvalError e, const size_t offset, const size_t length) {
+            m_list.push_back({e, static_cast<uint32_t>(offset), static_cast<uint32_t>(length)});
+      }
+
+      void report(const SemaError e, const size_t offset, const size_t length) {
+            m_list.push_back({e, static_cast<uint32_t>(offset), static_cast<uint32_t>(length)});
+      }
+
+      // another's diagnostics after these, e.g. from a part of the file checked on another thread
+      void append(const Diagnostics& other) { m_list.insert(m_list.end(), other.m_list.begin(), other.m_list.end()); }
+
+      [[nodiscard]] size_t size() const { return m_list.size(); }
+      [[nodiscard]] bool empty() const { return m_list.empty(); }
+      [[nodiscard]] const std::vector<Diagnostic>& list() const { return m_list; }
+
+      // Into source order: the lexer's errors are all reported before the parser's.
+      void sort() { std::ranges::stable_sort(m_list, {}, &Diagnostic::offset); }
+};
+
+// "path:line:column: message"
+inline std::string format_diagnostic(const std::string_view path, const Diagnostic& d, const TokenStream& tokens) {
+      const SourceLocation loc = tokens.location_of(d.offset);
+      std::string out(path);
+      out += ':' + std::to_string(loc.line) + ':' + std::to_string(loc.column) + ": ";
+      out += d.message();
+      return out;
+}
@@ -0,0 +1,390 @@
+#pragma once
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "./ast_flat.hpp"
+#include "./cache.hpp"
+#include "./comptime.hpp"
+#include "./context.hpp"
+#include "./diagnostics.hpp"
+#include "./interface.hpp"
+#include "./lexer.hpp"
+#include "./parser.hpp"
+#include "./remote_cache.hpp"
+#include "./sema.hpp"
+#include "./source.hpp"
+#include "./stats.hpp"
+#include "./thread_pool.hpp"
+
+// file extension used when expanding directories and resolving `import name`
+constexpr std::string_view source_extension = ".nano";
+// how the front-end is run, which is part of what remote cache entries are keyed by
+constexpr std::string_view frontend_options = "fold_constants";
+
+// One source file and everything the front-end made of it. The AST lives in the arena of whichever worker parsed it,
+// tokens and the AST view `source`, so all of it stays valid as long as the Driver does. A file found in the cache
+// has `cached` instead of a lexer and an AST, and a file only imported whose interface was there has nothing but it,
+// unless the interface of one of its imports changed since: then it's compiled after all once that one is checked.
+struct Module {
+      std::string path;
+      SourceBuffer source;
+      std::unique_ptr<Lexer> lexer;
+      std::vector<ASTNode*> ast;
+      std::optional<CacheEntry> cached;
+      // what importers are checked against: loaded, or made once this was checked
+      std::optional<ModuleInterface> interface;
+      // given to add(), rather than only imported
+      bool root = false;
+      // lexed, but only parsed if the remote cache doesn't have it
+      bool deferred = false;
+      // checked, or found in the cache still matching the interfaces of its imports
+      bool checked = false;
+      Stats::File* stats = nullptr;
+      // resolved paths of the modules this one imports
+      std::vector<std::string> imports;
+      std::optional<SourceError> source_error;
+      // the first of `diagnostics` that came from the lexer
+      std::optional<LexerError> lexer_error;
+      // every lexer and parser error, in source order; the AST is built around them
+      Diagnostics diagnostics;
+
+      [[nodiscard]] bool failed() const { return source_error || !diagnostics.empty(); }
+
+      [[nodiscard]] size_t token_count() const {
+            return cached ? cached->token_count() : lexer ? lexer->tokens.size() : 0;
+      }
+      // top-level items that produced a node, the flat AST keeps only those
+      [[nodiscard]] size_t item_count() const {
+            if (cached)
+                  return cached->ast().roots.size();
+            return ast.size() - static_cast<size_t>(std::ranges::count(ast, nullptr));
+      }
+};
+
+// The operand of every `import "path"` or `import name` statement, in order. An `import` without one is reported to
+// `diagnostics`, if given, and left out.
+inline std::vector<std::string_view> find_imports(const TokenStream& tokens, Diagnostics* diagnostics = nullptr) {
+      std::vector<std::string_view> imports;
+      for (size_t i = 0; i + 1 < tokens.size(); i++) {
+            if (tokens.kind(i) != TypeOfToken::KEYWORD || tokens.keyword(i) != Keyword::kw_import)
+                  continue;
+            if (tokens.kind(i + 1) == TypeOfToken::STRING || tokens.kind(i + 1) == TypeOfToken::IDENTIFIER)
+                  imports.push_back(tokens.value(i + 1));
+            else if (diagnostics)
+                  diagnostics->report(ParseError::expected_module, tokens.offset(i + 1), tokens.length(i + 1));
+      }
+      return imports;
+}
+
+// Runs the front-end over a whole project: every file is lexed and parsed as its own task on a work-stealing pool,
+// and the files it imports are scheduled the moment its tokens are in. Each worker allocates from its own arena, so
+// parsing never contends on memory; the only shared state is the module table, touched once per file. Type checking
+// follows once everything is parsed, a file after the files it imports so it's checked against their interfaces.
+// With a cache, a file that's only imported and whose interface is in it isn't compiled at all: importers only need
+// the interfaces of what they import directly. With a remote cache as well, a file missing from the local one is
+// lexed for its imports, and parsed only if the remote one doesn't have it either once those are checked.
+class Driver {
+      // every worker's Context looks types up in this one, so types mean the same in every file
+      TypeTable m_types;
+      std::vector<std::unique_ptr<Context>> m_contexts;
+      std::optional<CompilationCache> m_cache;
+      std::optional<RemoteCache> m_remote;
+      Stats* m_stats = nullptr;
+
+      std::mutex m_mutex;
+      // keyed by the normalized path, so a file imported from many places is only compiled once
+      std::unordered_map<std::string, std::unique_ptr<Module>> m_modules;
+      // last, so it's destroyed first: its workers are joined before any of the state their tasks use goes away
+      ThreadPool m_pool;
+
+  public:
+      explicit Driver(const size_t threads = std::thread::hardware_concurrency()) : m_pool(threads) {
+            for (size_t i = 0; i < m_pool.size(); i++)
+                  m_contexts.push_back(std::make_unique<Context>(m_types));
+      }
+
+      // Reuses and records the tokens and AST of every file in `dir`. Call before add().
+      void use_cache(std::filesystem::path dir) { m_cache.emplace(std::move(dir)); }
+
+      // Shares files missing from the cache through `remote` too, keyed by their source, the interfaces of what they
+      // import and the compiler. What comes from it is kept in the use_cache() directory, which it needs.
+      void use_remote_cache(RemoteCache remote) { m_remote.emplace(std::move(remote)); }
+
+      // Times every phase of every file and counts what it made into `stats`. Call before add().
+      void collect_stats(Stats& stats) { m_stats = &stats; }
+
+      // Schedules a file, or every source file under a directory. One that something already imported is compiled
+      // the way it was scheduled for that.
+      void add(const std::filesystem::path& path) {
+            std::error_code ec;
+            if (std::filesystem::is_directory(path, ec)) {
+                  for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+                        if (entry.is_regular_file(ec) && entry.path().extension() == source_extension)
+                              schedule(entry.path(), true);
+                  }
+                  return;
+            }
+            schedule(path, true);
+      }
+
+      // Waits for every scheduled file and everything they import, and checks them.
+      void wait() {
+            m_pool.wait();
+            check_all();
+            if (stats_enabled && m_stats) {
+                  for (size_t i = 0; i < m_contexts.size(); i++)
+                        m_stats->arena(i, m_contexts[i]->arena.bytes_used(), m_contexts[i]->arena.bytes_reserved());
+            }
+      }
+
+      // Only safe to walk once wait() has returned.
+      [[nodiscard]] const std::unordered_map<std::string, std::unique_ptr<Module>>& modules() const {
+            return m_modules;
+      }
+
+      // the key of `path` in modules()
+      static std::string normalize(const std::filesystem::path& path) {
+            std::error_code ec;
+            const std::filesystem::path canonical = std::filesystem::weakly_canonical(path, ec);
+            return (ec ? path.lexically_normal() : canonical).string();
+      }
+
+      // the file `import name` in `importer` stands for
+      static std::filesystem::path resolve_import(const std::string_view importer, const std::string_view name) {
+            std::filesystem::path target(name);
+            if (!target.has_extension())
+                  target += source_extension;
+            if (target.is_relative())
+                  target = std::filesystem::path(importer).parent_path() / target;
+            return target;
+      }
+
+  private:
+      void schedule(const std::filesystem::path& path, const bool root) {
+            std::string key = normalize(path);
+            Module* module;
+            {
+                  std::lock_guard lock(m_mutex);
+                  auto [it, inserted] = m_modules.try_emplace(key, nullptr);
+                  if (!inserted)
+                        return;
+                  it->second = std::make_unique<Module>();
+                  module = it->second.get();
+            }
+            module->path = std::move(key);
+            module->root = root;
+            m_pool.submit([this, module](const size_t worker) { compile(*module, *m_contexts[worker]); });
+      }
+
+      void compile(Module& module, Context& ctx) {
+            Stats::File* const file = stats_enabled && m_stats ? m_stats->file(module.path) : nullptr;
+            module.stats = file;
+            {
+                  const PhaseTimer timer(m_stats, Phase::read, file);
+                  if ((module.source_error = module.source.load(module.path)))
+                        return;
+            }
+
+            // what's taken from the cache is only as good as the interfaces of the imports it was checked against,
+            // which check() compares once those are known
+            const std::string_view source = module.source.view();
+            if (m_cache && !module.root && (module.interface = m_cache->load_interface(source, m_types))) {
+                  schedule_imports(module, module.interface->imports());
+                  return;
+            }
+            if (m_cache && (module.cached = m_cache->load(source))) {
+                  if (file)
+                        file->tokens = module.cached->token_count();
+                  module.interface = m_cache->load_interface(source, m_types);
+                  schedule_imports(module, module.cached->imports());
+                  return;
+            }
+
+            lex(module);
+            const std::vector<std::string_view> imports = find_imports(module.lexer->tokens, &module.diagnostics);
+            schedule_imports(module, imports);
+
+            // what's remotely cached is keyed by the interfaces of the imports, which are only known once those are
+            // checked; only clean files are cached
+            if (m_cache && m_remote && module.diagnostics.empty()) {
+                  module.deferred = true;
+                  return;
+            }
+            parse(module, ctx);
+      }
+
+      void lex(Module& module) {
+            module.lexer = std::make_unique<Lexer>(module.source.view());
+            const PhaseTimer timer(m_stats, Phase::lex, module.stats);
+            module.lexer_error = module.lexer->tokenize(module.diagnostics);
+      }
+
+      void parse(Module& module, Context& ctx) {
+            const PhaseTimer timer(m_stats, Phase::parse, module.stats);
+            Parser parser(module.lexer->tokens, ctx, module.diagnostics);
+            parser.fold_constants = true;
+            module.ast = parser.parse();
+      }
+
+      // Checks every file in rounds: each round, on the pool, the files whose imports are all checked. In an import
+      // cycle the first file left by path goes without the interfaces it's still waiting for, so which one that is
+      // doesn't change from run to run.
+      void check_all() {
+            std::vector<Module*> pending;
+            for (const auto& [path, module] : m_modules) {
+                  if (!module->source_error && !module->checked)
+                        pending.push_back(module.get());
+            }
+            std::ranges::sort(pending, {}, &Module::path);
+            while (!pending.empty()) {
+                  std::vector<Module*> ready;
+                  for (Module* module : pending) {
+                        if (std::ranges::all_of(module->imports, [this](const std::string& path) {
+                                  const Module& import = *m_modules.at(path);
+                                  return import.source_error || import.checked;
+                            }))
+                              ready.push_back(module);
+                  }
+                  if (ready.empty())
+                        ready.push_back(pending.front());
+                  for (Module* module : ready)
+                        m_pool.submit([this, module](const size_t worker) { check(*module, *m_contexts[worker]); });
+                  m_pool.wait();
+                  for (Module* module : ready)
+                        module->checked = true;
+                  std::erase_if(pending, [](const Module* module) { return module->checked; });
+            }
+      }
+
+      void check(Module& module, Context& ctx) {
+            Stats::File* const file = module.stats;
+            Imports imports;
+            for (const std::string& path : module.imports) {
+                  if (const Module& import = *m_modules.at(path); import.interface)
+                        imports.add(*import.interface);
+            }
+            const uint64_t imported = imports_hash(module);
+            if (!module.lexer) {
+                  // from the cache: still good unless what it was checked against changed since
+                  if (module.interface && module.interface->imports_hash() == imported)
+                        return;
+                  module.cached.reset();
+                  module.interface.reset();
+                  lex(module);
+                  parse(module, ctx);
+            }
+            std::string action;
+            if (module.deferred) {
+                  action = remote_key(module);
+                  if (fetch(module, action))
+                        return;
+                  parse(module, ctx);
+            }
+
+            // files are already checked in parallel, one body after the other within each is enough
+            const size_t before = module.diagnostics.size();
+            const uint64_t key = CompilationCache::key(module.source.view());
+            const std::vector<std::string_view> import_names = find_imports(module.lexer->tokens);
+            std::string interface;
+            {
+                  const PhaseTimer timer(m_stats, Phase::sema, file);
+                  TypeChecker checker(module.lexer->tokens, module.diagnostics, nullptr, &imports);
+                  checker.check(module.ast);
+                  interface = ModuleInterface::build(key, m_types, checker.functions(), checker.globals(),
+                                                     import_names, imported);
+            }
+            module.interface = ModuleInterface::from(interface, key, m_types);
+            // evaluating what doesn't type check would only report the same errors again
+            if (module.diagnostics.size() == before) {
+                  const PhaseTimer timer(m_stats, Phase::comptime, file);
+                  Interpreter(ctx, &module.diagnostics).run(module.ast);
+            }
+            module.diagnostics.sort();
+
+            // only clean files are cached, a hit has nothing to report; a failed store costs the next run a re-parse
+            const bool cacheable = m_cache && module.diagnostics.empty();
+            // flattened once, for the entry and the node count alike, so stats don't add work of their own
+            std::optional<FlatAst> flat;
+            if (file || cacheable)
+                  flat = Flattener().flatten(module.ast);
+            if (file) {
+                  file->tokens = module.lexer->tokens.size();
+                  file->nodes = flat->nodes.size();
+                  file->names = module.lexer->tokens.names.size();
+                  file->name_slots = module.lexer->tokens.names.slots();
+            }
+
+            if (cacheable) {
+                  const std::string entry = CompilationCache::entry(module.source.view(), module.lexer->tokens, *flat,
+                                                                    m_types, import_names);
+                  m_cache->store_entry(module.source.view(), entry);
+                  m_cache->store_interface(module.source.view(), interface);
+                  if (!action.empty())
+                        m_remote->put_action(action, {{"entry", entry}, {"interface", interface}});
+            }
+      }
+
+      // What `module` is checked against: the interfaces of its imports, in order, one missing counted as 0.
+      uint64_t imports_hash(const Module& module) const {
+            uint64_t h = 0;
+            for (const std::string& path : module.imports) {
+                  const Module& import = *m_modules.at(path);
+                  h = xxh64::hash(&h, sizeof(h), import.interface ? import.interface->hash() : 0);
+            }
+            return h;
+      }
+
+      // SHA-256 of everything the entry and interface of `module` depend on: the compiler, its source and the
+      // interfaces it was checked against. Import names are part of the source, so an import that isn't there is
+      // keyed apart from one with an empty interface by its missing hash.
+      std::string remote_key(const Module& module) const {
+            Sha256 h;
+            h.field(compiler_version).field(std::to_string(cache_format)).field(std::to_string(interface_format));
+            h.field(frontend_options).field(module.source.view());
+            for (const std::string& path : module.imports) {
+                  const Module& import = *m_modules.at(path);
+                  h.field(import.interface ? std::to_string(import.interface->hash()) : "");
+            }
+            return Sha256::hex(h.finish());
+      }
+
+      // Takes the entry and interface of `module` from the remote cache into the local one, instead of parsing it.
+      bool fetch(Module& module, const std::string& action) {
+            const std::optional<ActionOutputs> outputs = m_remote->get_action(action);
+            const BlobDigest* entry_digest = outputs ? outputs->find("entry") : nullptr;
+            const BlobDigest* interface_digest = outputs ? outputs->find("interface") : nullptr;
+            if (!entry_digest || !interface_digest)
+                  return false;
+            const std::optional<std::string> entry = m_remote->get_blob(*entry_digest);
+            const std::optional<std::string> interface = entry ? m_remote->get_blob(*interface_digest) : std::nullopt;
+            const std::string_view source = module.source.view();
+            if (!interface || m_cache->store_entry(source, *entry) || m_cache->store_interface(source, *interface))
+                  return false;
+            // what's written is checked like anything else in the cache
+            module.cached = m_cache->load(source);
+            module.interface = m_cache->load_interface(source, m_types);
+            if (!module.cached || !module.interface) {
+                  module.cached.reset();
+                  module.interface.reset();
+                  return false;
+            }
+            if (module.stats)
+                  module.stats->tokens = module.cached->token_count();
+            module.lexer.reset();
+            return true;
+      }
+
+      void schedule_imports(Module& module, const std::vector<std::string_view>& names) {
+            for (const std::string_view name : names) {
+                  const std::filesystem::path target = resolve_import(module.path, name);
+                  module.imports.push_back(normalize(target));
+                  schedule(target, false);
+            }
+      }
+};
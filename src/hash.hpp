@@ -0,0 +1,201 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// XXH64, for content hashes: several GB/s, and the same value on every platform and in every build.
+namespace xxh64 {
+      namespace detail {
+            constexpr uint64_t p1 = 11400714785074694791ull;
+            constexpr uint64_t p2 = 14029467366897019727ull;
+            constexpr uint64_t p3 = 1609587929392839161ull;
+            constexpr uint64_t p4 = 9650029242287828579ull;
+            constexpr uint64_t p5 = 2870177450012600261ull;
+
+            // little-endian reads whatever the host is, compilers turn these into a single load where they can
+            constexpr uint32_t read32(const unsigned char* p) {
+                  return uint32_t{p[0]} | uint32_t{p[1]} << 8 | uint32_t{p[2]} << 16 | uint32_t{p[3]} << 24;
+            }
+
+            constexpr uint64_t read64(const unsigned char* p) { return read32(p) | uint64_t{read32(p + 4)} << 32; }
+
+            constexpr uint64_t round(uint64_t acc, const uint64_t input) {
+                  acc += input * p2;
+                  return std::rotl(acc, 31) * p1;
+            }
+
+            constexpr uint64_t merge(const uint64_t acc, const uint64_t val) { return (acc ^ round(0, val)) * p1 + p4; }
+      }
+
+      inline uint64_t hash(const void* data, const size_t size, const uint64_t seed = 0) {
+            using namespace detail;
+            const auto* p = static_cast<const unsigned char*>(data);
+            const unsigned char* const end = p + size;
+            uint64_t h;
+
+            if (size >= 32) {
+                  uint64_t v1 = seed + p1 + p2;
+                  uint64_t v2 = seed + p2;
+                  uint64_t v3 = seed;
+                  uint64_t v4 = seed - p1;
+                  for (; end - p >= 32; p += 32) {
+                        v1 = round(v1, read64(p));
+                        v2 = round(v2, read64(p + 8));
+                        v3 = round(v3, read64(p + 16));
+                        v4 = round(v4, read64(p + 24));
+                  }
+                  h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+                  h = merge(h, v1);
+                  h = merge(h, v2);
+                  h = merge(h, v3);
+                  h = merge(h, v4);
+            } else {
+                  h = seed + p5;
+            }
+            h += size;
+
+            for (; end - p >= 8; p += 8)
+                  h = std::rotl(h ^ round(0, read64(p)), 27) * p1 + p4;
+            if (end - p >= 4) {
+                  h = std::rotl(h ^ (read32(p) * p1), 23) * p2 + p3;
+                  p += 4;
+            }
+            for (; p < end; ++p)
+                  h = std::rotl(h ^ (*p * p5), 11) * p1;
+
+            h ^= h >> 33;
+            h *= p2;
+            h ^= h >> 29;
+            h *= p3;
+            h ^= h >> 32;
+            return h;
+      }
+
+      inline uint64_t hash(const std::string_view s, const uint64_t seed = 0) { return hash(s.data(), s.size(), seed); }
+}
+
+// SHA-256, for talking to caches that address everything by it (the Bazel remote cache). Far slower than XXH64,
+// so it's only for what leaves the machine. Fed in pieces with update(), in one go with hash().
+class Sha256 {
+      static constexpr uint32_t k[64] = {
+              0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+              0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+              0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+              0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+              0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+              0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+              0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+              0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+      };
+
+      uint32_t m_state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                             0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+      unsigned char m_block[64];
+      size_t m_used = 0;
+      uint64_t m_length = 0;
+
+  public:
+      using Digest = std::array<unsigned char, 32>;
+
+      Sha256& update(const void* data, size_t size) {
+            const auto* p = static_cast<const unsigned char*>(data);
+            m_length += size;
+            if (m_used) {
+                  const size_t n = std::min(size, sizeof(m_block) - m_used);
+                  std::memcpy(m_block + m_used, p, n);
+                  m_used += n;
+                  p += n;
+                  size -= n;
+                  if (m_used < sizeof(m_block))
+                        return *this;
+                  compress(m_block);
+                  m_used = 0;
+            }
+            for (; size >= sizeof(m_block); p += sizeof(m_block), size -= sizeof(m_block))
+                  compress(p);
+            std::memcpy(m_block, p, size);
+            m_used = size;
+            return *this;
+      }
+
+      Sha256& update(const std::string_view s) { return update(s.data(), s.size()); }
+
+      // a field of a composite key: its length first, so ("ab", "c") and ("a", "bc") differ
+      Sha256& field(const std::string_view s) {
+            const uint64_t size = s.size();
+            return update(&size, sizeof(size)).update(s);
+      }
+
+      Digest finish() {
+            const uint64_t bits = m_length * 8;
+            const unsigned char pad = 0x80;
+            update(&pad, 1);
+            const unsigned char zero = 0;
+            while (m_used != 56)
+                  update(&zero, 1);
+            unsigned char length[8];
+            for (int i = 0; i < 8; i++)
+                  length[i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+            update(length, sizeof(length));
+            Digest out;
+            for (int i = 0; i < 8; i++) {
+                  for (int j = 0; j < 4; j++)
+                        out[i * 4 + j] = static_cast<unsigned char>(m_state[i] >> (24 - 8 * j));
+            }
+            return out;
+      }
+
+      static Digest hash(const std::string_view s) { return Sha256().update(s).finish(); }
+
+      static std::string hex(const Digest& d) {
+            static constexpr char digits[] = "0123456789abcdef";
+            std::string out;
+            for (const unsigned char b : d) {
+                  out += digits[b >> 4];
+                  out += digits[b & 15];
+            }
+            return out;
+      }
+
+  private:
+      void compress(const unsigned char* block) {
+            uint32_t w[64];
+            for (int i = 0; i < 16; i++)
+                  w[i] = uint32_t{block[i * 4]} << 24 | uint32_t{block[i * 4 + 1]} << 16 |
+                         uint32_t{block[i * 4 + 2]} << 8 | uint32_t{block[i * 4 + 3]};
+            for (int i = 16; i < 64; i++) {
+                  const uint32_t s0 = std::rotr(w[i - 15], 7) ^ std::rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                  const uint32_t s1 = std::rotr(w[i - 2], 17) ^ std::rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                  w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+            uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+            uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+            for (int i = 0; i < 64; i++) {
+                  const uint32_t s1 = std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+                  const uint32_t t1 = h + s1 + ((e & f) ^ (~e & g)) + k[i] + w[i];
+                  const uint32_t s0 = std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+                  const uint32_t t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+                  h = g;
+                  g = f;
+                  f = e;
+                  e = d + t1;
+                  d = c;
+                  c = b;
+                  b = a;
+                  a = t1 + t2;
+            }
+            m_state[0] += a;
+            m_state[1] += b;
+            m_state[2] += c;
+            m_state[3] += d;
+            m_state[4] += e;
+            m_state[5] += f;
+            m_state[6] += g;
+            m_state[7] += h;
+      }
+};
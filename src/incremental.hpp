@@ -0,0 +1,213 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "./context.hpp"
+#include "./lexer.hpp"
+#include "./parser.hpp"
+
+// An edit as an editor reports it: `length` bytes at `offset` replaced by `text`.
+struct TextEdit {
+      size_t offset;
+      size_t length;
+      std::string_view text;
+};
+
+// A source file that is edited in place, for running the front-end behind an editor. An edit re-lexes from the token
+// before it only until the lexer lands on the start of a token it had already produced (shifted by the edit), and the
+// rest of the old stream is kept. Top-level functions and prototypes whose tokens the edit didn't touch are reused
+// rather than re-parsed, the other top-level items are cheap single expressions and are parsed again. Types a reused
+// body got from global declarations are the ones it was parsed with.
+class Document {
+      // One version of the text and the arena for the nodes parsed from it. Nodes view their version's text, so a
+      // version lives until the last item parsed from it is replaced.
+      struct Revision {
+            // kept alive by every revision parsed with it
+            std::shared_ptr<TypeTable> types;
+            std::string text;
+            Context ctx;
+
+            explicit Revision(std::shared_ptr<TypeTable> table) : types(std::move(table)), ctx(*types) {}
+      };
+
+  public:
+      // A top-level item and the version it was parsed from, whose text its nodes view. The offsets in its nodes
+      // are from then too: they're `parsed_at` where its first token was, and it's at the first token's offset now.
+      struct Item {
+            ASTNode* node;
+            // token range in the current stream
+            size_t first;
+            size_t last;
+            std::shared_ptr<Revision> revision;
+            // which parse made it, different for every item parsed, the same as long as one is reused
+            uint64_t serial;
+            uint32_t parsed_at;
+      };
+
+  private:
+      std::shared_ptr<Revision> m_revision;
+      TokenStream m_tokens;
+      // decoded literals of every token in m_tokens (and a few that no longer are)
+      std::unordered_set<std::string> m_decoded;
+      std::optional<LexerError> m_error;
+      std::vector<Item> m_items;
+      std::vector<ASTNode*> m_ast;
+      size_t m_reused = 0;
+      uint64_t m_parsed = 0;
+
+  public:
+      // `types` is the TypeTable of the compilation it's part of, a Workspace's; every revision parses with it
+      explicit Document(std::string text, std::shared_ptr<TypeTable> types = std::make_shared<TypeTable>()) :
+          m_revision(std::make_shared<Revision>(std::move(types))) {
+            m_revision->text = std::move(text);
+            update(0, m_revision->text.size(), 0);
+      }
+
+      Document(const Document&) = delete;
+      Document& operator=(const Document&) = delete;
+
+      std::optional<LexerError> edit(const TextEdit& e) {
+            const std::string& old = m_revision->text;
+            const size_t offset = e.offset < old.size() ? e.offset : old.size();
+            const size_t length = e.length < old.size() - offset ? e.length : old.size() - offset;
+
+            auto next = std::make_shared<Revision>(m_revision->types);
+            next->text.reserve(old.size() - length + e.text.size());
+            next->text.append(old, 0, offset).append(e.text).append(old, offset + length);
+            m_revision = std::move(next);
+
+            const int64_t delta = static_cast<int64_t>(e.text.size()) - static_cast<int64_t>(length);
+            update(offset, offset + e.text.size(), delta);
+            return m_error;
+      }
+
+      [[nodiscard]] std::string_view text() const { return m_revision->text; }
+      [[nodiscard]] const TokenStream& tokens() const { return m_tokens; }
+      [[nodiscard]] const std::vector<ASTNode*>& ast() const { return m_ast; }
+      [[nodiscard]] const std::vector<Item>& items() const { return m_items; }
+      // the text an item's nodes view
+      [[nodiscard]] static std::string_view text_of(const Item& item) { return item.revision->text; }
+      [[nodiscard]] std::optional<LexerError> error() const { return m_error; }
+      // how many top-level items the last edit kept from before it
+      [[nodiscard]] size_t reused() const { return m_reused; }
+
+  private:
+      // first token index >= lo whose offset is at least `offset`
+      [[nodiscard]] size_t token_at(size_t lo, const uint32_t offset) const {
+            size_t hi = m_tokens.size();
+            while (lo < hi) {
+                  const size_t mid = lo + (hi - lo) / 2;
+                  if (m_tokens.offset(mid) < offset)
+                        lo = mid + 1;
+                  else
+                        hi = mid;
+            }
+            return lo;
+      }
+
+      // The text in [start, new_end) is new, everything behind it moved by `delta`.
+      void update(const size_t start, const size_t new_end, const int64_t delta) {
+            const std::string_view text = m_revision->text;
+
+            // the first token that ends at or after the edit could change, the one before can't: lexing it never
+            // looked past its last character
+            size_t first = 0;
+            for (size_t hi = m_tokens.size(); first < hi;) {
+                  const size_t mid = first + (hi - first) / 2;
+                  if (m_tokens.offset(mid) + m_tokens.length(mid) < start)
+                        first = mid + 1;
+                  else
+                        hi = mid;
+            }
+            const uint32_t from = first > 0 ? m_tokens.offset(first - 1) + m_tokens.length(first - 1) : 0;
+
+            Lexer lexer{text};
+            lexer.m_index = from;
+            size_t last = m_tokens.size();
+            std::optional<LexerError> err;
+            while (true) {
+                  // past the edit, the old tokens are valid again from wherever one of them started
+                  if (!m_error && lexer.m_index >= new_end) {
+                        const auto old = static_cast<uint32_t>(static_cast<int64_t>(lexer.m_index) - delta);
+                        if (const size_t i = token_at(first, old); i < m_tokens.size() && m_tokens.offset(i) == old) {
+                              last = i;
+                              break;
+                        }
+                  }
+                  if (lexer.m_index >= text.size()) {
+                        lexer.push(TypeOfToken::T_EOF, lexer.m_index);
+                        break;
+                  }
+                  if ((err = lexer.lex_token()))
+                        break;
+            }
+
+            const uint32_t to = last < m_tokens.size() ? m_tokens.offset(last) : UINT32_MAX;
+            m_tokens.splice(first, last, lexer.tokens, delta, from, to, [this](const std::string_view val) {
+                  return std::string_view(*m_decoded.emplace(val).first);
+            });
+            m_tokens.source = text;
+            m_error = err;
+
+            reparse(first, last, lexer.tokens.size());
+      }
+
+      // Tokens [first, last) of the old stream were replaced by `count` new ones.
+      void reparse(const size_t first, const size_t last, const size_t count) {
+            const auto shift = static_cast<int64_t>(count) - static_cast<int64_t>(last - first);
+            std::vector<Item> reusable;
+            for (Item& item : m_items) {
+                  const NodeKind kind = item.node ? item.node->kind : NodeKind::null;
+                  if (kind != NodeKind::function && kind != NodeKind::prototype)
+                        continue;
+                  // an item's extent depends on the token after it too, parse_expr() peeks at it
+                  if (item.last < first) {
+                        reusable.push_back(std::move(item));
+                  } else if (item.first >= last) {
+                        item.first = static_cast<size_t>(static_cast<int64_t>(item.first) + shift);
+                        item.last = static_cast<size_t>(static_cast<int64_t>(item.last) + shift);
+                        reusable.push_back(std::move(item));
+                  }
+            }
+
+            std::vector<Item> items;
+            Parser parser(m_tokens, m_revision->ctx);
+            m_reused = 0;
+            size_t next = 0;
+            while (parser.index < m_tokens.size() && m_tokens.kind(parser.index) != TypeOfToken::T_EOF) {
+                  while (next < reusable.size() && reusable[next].first < parser.index)
+                        next++;
+                  if (next < reusable.size() && reusable[next].first == parser.index &&
+                      m_tokens.keyword(parser.index) == Keyword::kw_fn) {
+                        Item& item = reusable[next++];
+                        // what parsing it would have declared
+                        const PrototypeNode* proto = item.node->kind == NodeKind::function
+                                                             ? static_cast<const FunctionNode*>(item.node)->Proto
+                                                             : static_cast<const PrototypeNode*>(item.node);
+                        // the name is the first token after `fn` that isn't a comment, as the parser's cursor sees it
+                        size_t name = item.first + 1;
+                        while (m_tokens.kind(name) == TypeOfToken::COMMENT)
+                              name++;
+                        parser.symbols.declare_function(m_tokens.symbol(name), Symbol(proto->type, nullptr));
+                        parser.index = item.last;
+                        items.push_back(std::move(item));
+                        m_reused++;
+                        continue;
+                  }
+
+                  const size_t start = parser.index;
+                  if (const std::optional<ASTNode*> node = parser.parse_item())
+                        items.push_back({*node, start, parser.index, m_revision, m_parsed++, m_tokens.offset(start)});
+            }
+
+            m_items = std::move(items);
+            m_ast.clear();
+            for (const Item& item : m_items)
+                  m_ast.push_back(item.node);
+      }
+};
@@ -0,0 +1,285 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "./ast_flat.hpp"
+#include "./hash.hpp"
+#include "./sema.hpp"
+#include "./source.hpp"
+
+// What importing a module needs of it, instead of its source: the signature of every top-level function and
+// prototype, and the type of every global. The language has no type declarations or constants yet; globals are the
+// nearest thing. It also names the modules it imports, so an importer can find them without the source, and records
+// the interfaces of theirs it was checked against. Like a cache entry it's stored the way it sits in memory, so
+// opening one is mapping it; its types are stored ones, made the compilation's when it's opened.
+constexpr uint32_t interface_format = 4;
+constexpr char interface_magic[8] = {'N', 'A', 'N', 'O', 'I', 'F', 'A', 'C'};
+
+enum class InterfaceSection : uint32_t {
+      functions,
+      // the parameter types of every function, each function's in a row
+      params,
+      globals,
+      // every `import` operand, FlatString each, in source order
+      imports,
+      // bytes of the names
+      chars,
+      // what the types that aren't built-ins are, see StoredType
+      types,
+      type_members,
+      type_names,
+      count,
+};
+
+struct InterfaceFunction {
+      FlatString name;
+      uint32_t first_param;
+      uint32_t params;
+      Type result;
+      // whether the module defines it, rather than only declaring a prototype
+      uint8_t defined;
+      uint8_t padding[1];
+};
+
+struct InterfaceGlobal {
+      FlatString name;
+      Type type;
+      uint8_t padding[2];
+};
+
+struct InterfaceHeader {
+      char magic[8];
+      uint32_t format;
+      uint32_t sections;
+      // CompilationCache::key() of the source it was made from
+      uint64_t key;
+      // of everything after the header: the same for every version of the source with the same interface, and what
+      // makes a damaged file fail to open
+      uint64_t hash;
+      // what the Driver made of the interfaces of the imports when it was checked, see Driver::imports_hash(); not
+      // part of `hash`, so it only changes what this module is checked against, not what importers are
+      uint64_t imports_hash;
+
+      struct Section {
+            uint64_t offset;
+            uint64_t count;
+      } section[static_cast<size_t>(InterfaceSection::count)];
+};
+
+// A module's interface, mapped from disk or built in memory. Names are looked up in tables made when it's opened,
+// which view the mapped names, and hold its types as ids of the TypeTable it was opened with.
+class ModuleInterface final : public Declarations {
+      SourceBuffer m_file;
+      const InterfaceHeader* m_header = nullptr;
+      std::unordered_map<std::string_view, FunctionType> m_functions;
+      std::unordered_map<std::string_view, Type> m_globals;
+
+  public:
+      // nullopt for a missing, truncated, damaged or foreign file, or one made from another source than `key`'s
+      static std::optional<ModuleInterface> open(const std::filesystem::path& path, const uint64_t key,
+                                                 TypeTable& types) {
+            ModuleInterface m;
+            if (m.m_file.load(path.string()))
+                  return std::nullopt;
+            return m.validate(key, types) ? std::optional(std::move(m)) : std::nullopt;
+      }
+
+      // from what build() returned
+      static std::optional<ModuleInterface> from(const std::string_view bytes, const uint64_t key, TypeTable& types) {
+            ModuleInterface m;
+            m.m_file.assign("", bytes);
+            return m.validate(key, types) ? std::optional(std::move(m)) : std::nullopt;
+      }
+
+      // The interface of a checked module whose types are ids of `types`, functions and globals sorted by name so
+      // equal interfaces hash the same.
+      static std::string build(const uint64_t key, const TypeTable& types, const FunctionTable& functions,
+                               const std::unordered_map<std::string_view, Type>& globals,
+                               const std::span<const std::string_view> imports = {}, const uint64_t imports_hash = 0) {
+            std::vector<std::pair<std::string_view, const FunctionTable::Entry*>> fns;
+            for (const auto& [name, entry] : functions.entries())
+                  fns.emplace_back(name, &entry);
+            std::ranges::sort(fns, {}, &std::pair<std::string_view, const FunctionTable::Entry*>::first);
+            std::vector<std::pair<std::string_view, Type>> vars(globals.begin(), globals.end());
+            std::ranges::sort(vars, {}, &std::pair<std::string_view, Type>::first);
+
+            std::string chars;
+            const auto intern = [&chars](const std::string_view s) {
+                  const FlatString ref{static_cast<uint32_t>(chars.size()), static_cast<uint32_t>(s.size())};
+                  chars += s;
+                  return ref;
+            };
+            TypeTable::Export stored(types);
+            std::vector<InterfaceFunction> function_records;
+            std::vector<Type> params;
+            for (const auto& [name, entry] : fns) {
+                  function_records.push_back({intern(name), static_cast<uint32_t>(params.size()),
+                                              static_cast<uint32_t>(entry->type.params.size()),
+                                              stored.export_type(entry->type.result),
+                                              static_cast<uint8_t>(entry->defined), {}});
+                  for (const Type param : entry->type.params)
+                        params.push_back(stored.export_type(param));
+            }
+            std::vector<InterfaceGlobal> global_records;
+            for (const auto& [name, type] : vars)
+                  global_records.push_back({intern(name), stored.export_type(type), {}});
+            std::vector<FlatString> import_records;
+            for (const std::string_view name : imports)
+                  import_records.push_back(intern(name));
+
+            InterfaceHeader header{};
+            std::memcpy(header.magic, interface_magic, sizeof(interface_magic));
+            header.format = interface_format;
+            header.sections = static_cast<uint32_t>(InterfaceSection::count);
+            header.key = key;
+            header.imports_hash = imports_hash;
+
+            std::string out(sizeof(InterfaceHeader), '\0');
+            const auto put = [&]<typename T>(const InterfaceSection s, const std::span<const T> items) {
+                  out.resize((out.size() + 7) & ~size_t{7}, '\0');
+                  header.section[static_cast<size_t>(s)] = {out.size(), items.size()};
+                  out.append(reinterpret_cast<const char*>(items.data()), items.size_bytes());
+            };
+            put(InterfaceSection::functions, std::span<const InterfaceFunction>(function_records));
+            put(InterfaceSection::params, std::span<const Type>(params));
+            put(InterfaceSection::globals, std::span<const InterfaceGlobal>(global_records));
+            put(InterfaceSection::imports, std::span<const FlatString>(import_records));
+            put(InterfaceSection::chars, std::span<const char>(chars));
+            put(InterfaceSection::types, std::span<const StoredType>(stored.types));
+            put(InterfaceSection::type_members, std::span<const Type>(stored.members));
+            put(InterfaceSection::type_names, std::span<const char>(stored.names));
+
+            header.hash = xxh64::hash(out.data() + sizeof(InterfaceHeader), out.size() - sizeof(InterfaceHeader));
+            std::memcpy(out.data(), &header, sizeof(header));
+            return out;
+      }
+
+      [[nodiscard]] uint64_t hash() const { return m_header->hash; }
+      [[nodiscard]] uint64_t imports_hash() const { return m_header->imports_hash; }
+      [[nodiscard]] std::vector<std::string_view> imports() const {
+            std::vector<std::string_view> imports;
+            const std::span<const char> chars = section<char>(InterfaceSection::chars);
+            for (const FlatString ref : section<FlatString>(InterfaceSection::imports))
+                  imports.emplace_back(chars.data() + ref.offset, ref.length);
+            return imports;
+      }
+      [[nodiscard]] size_t function_count() const { return m_functions.size(); }
+      [[nodiscard]] size_t global_count() const { return m_globals.size(); }
+
+      [[nodiscard]] const FunctionType* function(const std::string_view name) const override {
+            const auto it = m_functions.find(name);
+            return it == m_functions.end() ? nullptr : &it->second;
+      }
+
+      [[nodiscard]] std::optional<Type> global(const std::string_view name) const override {
+            const auto it = m_globals.find(name);
+            return it == m_globals.end() ? std::nullopt : std::optional(it->second);
+      }
+
+  private:
+      ModuleInterface() = default;
+
+      template<typename T>
+      [[nodiscard]] std::span<const T> section(const InterfaceSection s) const {
+            const InterfaceHeader::Section& sec = m_header->section[static_cast<size_t>(s)];
+            return {reinterpret_cast<const T*>(m_file.view().data() + sec.offset), static_cast<size_t>(sec.count)};
+      }
+
+      [[nodiscard]] bool validate(const uint64_t key, TypeTable& types) {
+            const std::string_view bytes = m_file.view();
+            if (bytes.size() < sizeof(InterfaceHeader))
+                  return false;
+            const auto* header = reinterpret_cast<const InterfaceHeader*>(bytes.data());
+            if (std::memcmp(header->magic, interface_magic, sizeof(interface_magic)) != 0 ||
+                header->format != interface_format ||
+                header->sections != static_cast<uint32_t>(InterfaceSection::count) || header->key != key ||
+                header->hash != xxh64::hash(bytes.data() + sizeof(InterfaceHeader),
+                                            bytes.size() - sizeof(InterfaceHeader)))
+                  return false;
+
+            static constexpr size_t sizes[] = {sizeof(InterfaceFunction), sizeof(Type), sizeof(InterfaceGlobal),
+                                               sizeof(FlatString),        sizeof(char), sizeof(StoredType),
+                                               sizeof(Type),              sizeof(char)};
+            static_assert(std::size(sizes) == static_cast<size_t>(InterfaceSection::count));
+            for (size_t i = 0; i < std::size(sizes); i++) {
+                  const InterfaceHeader::Section& sec = header->section[i];
+                  if (sec.offset % 8 != 0 || sec.offset > bytes.size() ||
+                      sec.count > (bytes.size() - sec.offset) / sizes[i])
+                        return false;
+            }
+            m_header = header;
+
+            const std::span<const char> names = section<char>(InterfaceSection::type_names);
+            const std::optional<std::vector<Type>> ids = types.import(section<StoredType>(InterfaceSection::types),
+                                                                      section<Type>(InterfaceSection::type_members),
+                                                                      std::string_view(names.data(), names.size()));
+            if (!ids)
+                  return false;
+            bool mapped = true;
+            const auto type_of = [&](const Type stored) {
+                  if (static_cast<size_t>(stored) < ids->size())
+                        return (*ids)[static_cast<size_t>(stored)];
+                  mapped = false;
+                  return Type::UNKNOWN;
+            };
+
+            const std::span<const char> chars = section<char>(InterfaceSection::chars);
+            const auto str = [&](const FlatString ref) -> std::optional<std::string_view> {
+                  if (ref.offset > chars.size() || ref.length > chars.size() - ref.offset)
+                        return std::nullopt;
+                  return std::string_view(chars.data() + ref.offset, ref.length);
+            };
+            const std::span<const Type> params = section<Type>(InterfaceSection::params);
+            for (const InterfaceFunction& fn : section<InterfaceFunction>(InterfaceSection::functions)) {
+                  const std::optional<std::string_view> name = str(fn.name);
+                  if (!name || fn.first_param > params.size() || fn.params > params.size() - fn.first_param)
+                        return false;
+                  FunctionType type{{}, type_of(fn.result)};
+                  for (const Type param : params.subspan(fn.first_param, fn.params))
+                        type.params.push_back(type_of(param));
+                  m_functions.emplace(*name, std::move(type));
+            }
+            for (const InterfaceGlobal& var : section<InterfaceGlobal>(InterfaceSection::globals)) {
+                  const std::optional<std::string_view> name = str(var.name);
+                  if (!name)
+                        return false;
+                  m_globals.emplace(*name, type_of(var.type));
+            }
+            return mapped && std::ranges::all_of(section<FlatString>(InterfaceSection::imports),
+                                                 [&str](const FlatString ref) { return str(ref).has_value(); });
+      }
+};
+
+// The declarations of every module a file imports, looked up in import order.
+class Imports final : public Declarations {
+      std::vector<const Declarations*> m_modules;
+
+  public:
+      void add(const Declarations& module) { m_modules.push_back(&module); }
+
+      [[nodiscard]] bool empty() const { return m_modules.empty(); }
+
+      [[nodiscard]] const FunctionType* function(const std::string_view name) const override {
+            for (const Declarations* m : m_modules) {
+                  if (const FunctionType* fn = m->function(name))
+                        return fn;
+            }
+            return nullptr;
+      }
+
+      [[nodiscard]] std::optional<Type> global(const std::string_view name) const override {
+            for (const Declarations* m : m_modules) {
+                  if (const std::optional<Type> type = m->global(name))
+                        return type;
+            }
+            return std::nullopt;
+      }
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Dense ids for names, handed out in order of first appearance, so per-name data can live in plain vectors
+// indexed by id.
+using SymbolId = uint32_t;
+constexpr SymbolId no_symbol = UINT32_MAX;
+
+// Maps each distinct string to a SymbolId and back. The bytes are copied into blocks the interner owns, so interned
+// views stay valid when the text they came from goes away (StreamLexer reuses its chunk buffer) and when more strings
+// are added. Lookups hash the string once and probe an open-addressed table of ids.
+class StringInterner {
+      static constexpr size_t block_size = 16 * 1024;
+
+      std::vector<std::unique_ptr<char[]>> m_blocks;
+      char* m_cur = nullptr;
+      size_t m_left = 0;
+
+      std::vector<std::string_view> m_strings;
+      std::vector<uint32_t> m_hashes;
+      // id + 1 per slot, 0 marks an empty one; the size is a power of two kept at most half full
+      std::vector<uint32_t> m_slots;
+
+  public:
+      SymbolId intern(const std::string_view s) {
+            const uint32_t h = hash(s);
+            if ((m_strings.size() + 1) * 2 > m_slots.size())
+                  rehash(m_slots.empty() ? 64 : m_slots.size() * 2);
+
+            size_t slot = h & (m_slots.size() - 1);
+            for (; m_slots[slot] != 0; slot = (slot + 1) & (m_slots.size() - 1)) {
+                  const uint32_t id = m_slots[slot] - 1;
+                  if (m_hashes[id] == h && m_strings[id] == s)
+                        return id;
+            }
+
+            const auto id = static_cast<SymbolId>(m_strings.size());
+            m_strings.push_back(store(s));
+            m_hashes.push_back(h);
+            m_slots[slot] = id + 1;
+            return id;
+      }
+
+      // no_symbol if `s` was never interned
+      [[nodiscard]] SymbolId find(const std::string_view s) const { return find(s, hash(s)); }
+
+      // the same, for a string whose hash_of() another interner already knows
+      [[nodiscard]] SymbolId find(const std::string_view s, const uint32_t h) const {
+            if (m_slots.empty())
+                  return no_symbol;
+            for (size_t slot = h & (m_slots.size() - 1); m_slots[slot] != 0; slot = (slot + 1) & (m_slots.size() - 1)) {
+                  const uint32_t id = m_slots[slot] - 1;
+                  if (m_hashes[id] == h && m_strings[id] == s)
+                        return id;
+            }
+            return no_symbol;
+      }
+
+      [[nodiscard]] std::string_view str(const SymbolId id) const { return m_strings[id]; }
+      [[nodiscard]] uint32_t hash_of(const SymbolId id) const { return m_hashes[id]; }
+      [[nodiscard]] size_t size() const { return m_strings.size(); }
+      // slots in the table, size() / slots() is its load factor
+      [[nodiscard]] size_t slots() const { return m_slots.size(); }
+
+  private:
+      // FNV-1a; identifiers are short, so this beats anything that needs a setup step
+      static uint32_t hash(const std::string_view s) {
+            uint32_t h = 2166136261u;
+            for (const char c : s) {
+                  h ^= static_cast<unsigned char>(c);
+                  h *= 16777619u;
+            }
+            return h;
+      }
+
+      std::string_view store(const std::string_view s) {
+            if (s.empty())
+                  return {};
+            if (s.size() > m_left) {
+                  const size_t size = s.size() > block_size ? s.size() : block_size;
+                  m_blocks.push_back(std::make_unique_for_overwrite<char[]>(size));
+                  m_cur = m_blocks.back().get();
+                  m_left = size;
+            }
+            std::memcpy(m_cur, s.data(), s.size());
+            const std::string_view stored(m_cur, s.size());
+            m_cur += s.size();
+            m_left -= s.size();
+            return stored;
+      }
+
+      void rehash(const size_t slots) {
+            m_slots.assign(slots, 0);
+            for (uint32_t id = 0; id < m_strings.size(); id++) {
+                  size_t slot = m_hashes[id] & (slots - 1);
+                  while (m_slots[slot] != 0)
+                        slot = (slot + 1) & (slots - 1);
+                  m_slots[slot] = id + 1;
+            }
+      }
+};
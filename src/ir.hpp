@@ -0,0 +1,768 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "./bytecode.hpp"
+#include "./parser.hpp"
+
+// An SSA form of a module for the optimizer and the native backends: every value is defined once, by one instruction,
+// and a variable assigned on only some paths gets a phi where the paths meet. The only control flow Nano has is
+// && and ||, so the blocks of a function form nested diamonds.
+namespace ir {
+      using ValueId = uint32_t;
+      using BlockId = uint32_t;
+
+#define NANO_IR_OPCODES(X)                                                                                             \
+      X(param)                                                                                                         \
+      X(constant)                                                                                                      \
+      X(copy)                                                                                                          \
+      X(phi)                                                                                                           \
+      X(add)                                                                                                           \
+      X(sub)                                                                                                           \
+      X(mul)                                                                                                           \
+      X(div)                                                                                                           \
+      X(bit_and)                                                                                                       \
+      X(bit_or)                                                                                                        \
+      X(neg)                                                                                                           \
+      X(logical_not)                                                                                                   \
+      X(lt)                                                                                                            \
+      X(le)                                                                                                            \
+      X(gt)                                                                                                            \
+      X(ge)                                                                                                            \
+      X(eq)                                                                                                            \
+      X(ne)                                                                                                            \
+      X(call)                                                                                                          \
+      X(get_global)                                                                                                    \
+      X(set_global)                                                                                                    \
+      X(jump)                                                                                                          \
+      X(branch)                                                                                                        \
+      X(ret)
+
+      enum class Opcode : uint8_t {
+#define NANO_IR_OPCODE_ENUM(name) name,
+            NANO_IR_OPCODES(NANO_IR_OPCODE_ENUM)
+#undef NANO_IR_OPCODE_ENUM
+      };
+
+      constexpr std::string_view opcode_to_str(const Opcode op) {
+            constexpr std::string_view names[] = {
+#define NANO_IR_OPCODE_NAME(name) #name,
+                    NANO_IR_OPCODES(NANO_IR_OPCODE_NAME)
+#undef NANO_IR_OPCODE_NAME
+            };
+            return names[static_cast<size_t>(op)];
+      }
+
+      // Operations whose result only depends on their operands: the optimizer may merge, move or drop them.
+      constexpr bool is_pure(const Opcode op) {
+            switch (op) {
+                  case Opcode::param:
+                  case Opcode::call:
+                  case Opcode::get_global:
+                  case Opcode::set_global:
+                  case Opcode::phi:
+                  case Opcode::jump:
+                  case Opcode::branch:
+                  case Opcode::ret:
+                        return false;
+                  default:
+                        return true;
+            }
+      }
+
+      constexpr bool is_terminator(const Opcode op) {
+            return op == Opcode::jump || op == Opcode::branch || op == Opcode::ret;
+      }
+
+      struct Inst {
+            Opcode op;
+            // of the result; comparisons are BOOL, the type they compare is their operands'
+            Type type = Type::NULL_T;
+            BlockId block = 0;
+            // a phi's are in the order of its block's predecessors
+            std::vector<ValueId> operands;
+            // constant: the value (INT, BOOL, NULL and string indices in `integer`, FLOAT in `real`); param: its
+            // index; call: the callee; get_global and set_global: the global
+            int64_t integer = 0;
+            double real = 0;
+            // jump: target[0]; branch: target[0] if operands[0] is true, target[1] otherwise
+            BlockId target[2] = {0, 0};
+      };
+
+      struct Block {
+            // phis first, a terminator last
+            std::vector<ValueId> insts;
+            std::vector<BlockId> preds;
+      };
+
+      struct Function {
+            std::string_view name;
+            std::vector<Type> params;
+            Type result = Type::NULL_T;
+            std::vector<Block> blocks;
+            // every instruction ever made, indexed by ValueId; one no block lists anymore was removed
+            std::vector<Inst> values;
+
+            BlockId add_block() {
+                  blocks.emplace_back();
+                  return static_cast<BlockId>(blocks.size() - 1);
+            }
+
+            ValueId append(const BlockId block, Inst inst) {
+                  inst.block = block;
+                  values.push_back(std::move(inst));
+                  const auto id = static_cast<ValueId>(values.size() - 1);
+                  blocks[block].insts.push_back(id);
+                  return id;
+            }
+
+            // the successors of a block, from its terminator
+            [[nodiscard]] std::span<const BlockId> succs(const BlockId block) const {
+                  if (blocks[block].insts.empty())
+                        return {};
+                  const Inst& last = values[blocks[block].insts.back()];
+                  if (last.op == Opcode::jump)
+                        return {last.target, 1};
+                  if (last.op == Opcode::branch)
+                        return {last.target, 2};
+                  return {};
+            }
+      };
+
+      // Like a bytecode Program: the top-level statements are functions[entry].
+      struct Module {
+            std::vector<Function> functions;
+            std::vector<std::string_view> strings;
+            std::vector<Type> globals;
+            uint32_t entry = 0;
+            std::unordered_map<std::string_view, uint32_t> by_name;
+      };
+
+      // Blocks in reverse postorder from the entry: every block after its dominators.
+      inline std::vector<BlockId> reverse_postorder(const Function& fn) {
+            std::vector<BlockId> order;
+            std::vector<uint8_t> state(fn.blocks.size(), 0);
+            std::vector<std::pair<BlockId, size_t>> stack{{0, 0}};
+            state[0] = 1;
+            while (!stack.empty()) {
+                  auto& [block, next] = stack.back();
+                  const std::span<const BlockId> succs = fn.succs(block);
+                  if (next < succs.size()) {
+                        const BlockId s = succs[next++];
+                        if (!state[s]) {
+                              state[s] = 1;
+                              stack.emplace_back(s, 0);
+                        }
+                        continue;
+                  }
+                  order.push_back(block);
+                  stack.pop_back();
+            }
+            std::ranges::reverse(order);
+            return order;
+      }
+
+      // Each block's immediate dominator (the entry's is itself, an unreachable block's is UINT32_MAX), by Cooper,
+      // Harvey and Kennedy's iteration over the reverse postorder.
+      inline std::vector<BlockId> dominators(const Function& fn) {
+            const std::vector<BlockId> order = reverse_postorder(fn);
+            std::vector<uint32_t> position(fn.blocks.size(), UINT32_MAX);
+            for (size_t i = 0; i < order.size(); i++)
+                  position[order[i]] = static_cast<uint32_t>(i);
+
+            std::vector<BlockId> idom(fn.blocks.size(), UINT32_MAX);
+            idom[0] = 0;
+            const auto intersect = [&](BlockId a, BlockId b) {
+                  while (a != b) {
+                        while (position[a] > position[b])
+                              a = idom[a];
+                        while (position[b] > position[a])
+                              b = idom[b];
+                  }
+                  return a;
+            };
+            for (bool changed = true; changed;) {
+                  changed = false;
+                  for (const BlockId block : order) {
+                        if (block == 0)
+                              continue;
+                        BlockId dom = UINT32_MAX;
+                        for (const BlockId pred : fn.blocks[block].preds) {
+                              if (idom[pred] == UINT32_MAX)
+                                    continue;
+                              dom = dom == UINT32_MAX ? pred : intersect(pred, dom);
+                        }
+                        if (dom != idom[block]) {
+                              idom[block] = dom;
+                              changed = true;
+                        }
+                  }
+            }
+            return idom;
+      }
+
+      enum class VerifyError {
+            missing_terminator,
+            misplaced_phi,
+            phi_arity,
+            undefined_operand,
+            not_dominated,
+            bad_target,
+      };
+
+      constexpr std::string_view verify_error_to_str(VerifyError e) {
+            switch (e) {
+                  case VerifyError::missing_terminator:
+                        return "block doesn't end in exactly one terminator";
+                  case VerifyError::misplaced_phi:
+                        return "phi after a non-phi instruction";
+                  case VerifyError::phi_arity:
+                        return "phi operands don't match the block's predecessors";
+                  case VerifyError::undefined_operand:
+                        return "operand isn't defined in any block";
+                  case VerifyError::not_dominated:
+                        return "operand doesn't dominate its use";
+                  case VerifyError::bad_target:
+                        return "branch target out of range or predecessor list wrong";
+            }
+            return "unknown verify error";
+      }
+
+      // Checks what the passes rely on: SSA (each use dominated by its definition), phis matching predecessors and
+      // blocks closed by a terminator. For tests and for debugging a pass.
+      inline std::optional<VerifyError> verify(const Function& fn) {
+            std::vector<uint32_t> position(fn.values.size(), UINT32_MAX);
+            for (const Block& block : fn.blocks) {
+                  for (size_t i = 0; i < block.insts.size(); i++)
+                        position[block.insts[i]] = static_cast<uint32_t>(i);
+            }
+            const std::vector<BlockId> idom = dominators(fn);
+            const auto dominates = [&](BlockId a, BlockId b) {
+                  while (b != a && b != 0 && idom[b] != UINT32_MAX)
+                        b = idom[b];
+                  return a == b;
+            };
+
+            for (BlockId b = 0; b < fn.blocks.size(); b++) {
+                  const Block& block = fn.blocks[b];
+                  if (block.insts.empty() || !is_terminator(fn.values[block.insts.back()].op))
+                        return VerifyError::missing_terminator;
+                  for (const BlockId s : fn.succs(b)) {
+                        if (s >= fn.blocks.size() || std::ranges::count(fn.blocks[s].preds, b) != 1)
+                              return VerifyError::bad_target;
+                  }
+                  bool phis = true;
+                  for (size_t i = 0; i < block.insts.size(); i++) {
+                        const Inst& inst = fn.values[block.insts[i]];
+                        if (inst.block != b)
+                              return VerifyError::undefined_operand;
+                        if (is_terminator(inst.op) != (i + 1 == block.insts.size()))
+                              return VerifyError::missing_terminator;
+                        if (inst.op != Opcode::phi)
+                              phis = false;
+                        else if (!phis)
+                              return VerifyError::misplaced_phi;
+                        if (inst.op == Opcode::phi && inst.operands.size() != block.preds.size())
+                              return VerifyError::phi_arity;
+                        for (size_t k = 0; k < inst.operands.size(); k++) {
+                              const ValueId v = inst.operands[k];
+                              if (v >= fn.values.size() || position[v] == UINT32_MAX)
+                                    return VerifyError::undefined_operand;
+                              const BlockId def = fn.values[v].block;
+                              // a phi's operand only has to be available at the end of its predecessor
+                              const BlockId use = inst.op == Opcode::phi ? block.preds[k] : b;
+                              if (def == use ? inst.op != Opcode::phi && position[v] >= i : !dominates(def, use))
+                                    return VerifyError::not_dominated;
+                        }
+                  }
+            }
+            return std::nullopt;
+      }
+
+      // "%n = op %a, %b : type", one block after another, for tests and for looking at what the passes did.
+      inline std::string to_string(const Function& fn) {
+            std::string out = "fn " + std::string(fn.name) + "(";
+            for (size_t i = 0; i < fn.params.size(); i++)
+                  out += (i ? ", " : "") + std::string(type_to_str(fn.params[i]));
+            out += ") : " + std::string(type_to_str(fn.result)) + "\n";
+            for (BlockId b = 0; b < fn.blocks.size(); b++) {
+                  out += "b" + std::to_string(b) + ":";
+                  for (size_t i = 0; i < fn.blocks[b].preds.size(); i++)
+                        out += (i ? ", b" : " ; preds b") + std::to_string(fn.blocks[b].preds[i]);
+                  out += '\n';
+                  for (const ValueId id : fn.blocks[b].insts) {
+                        const Inst& inst = fn.values[id];
+                        out += "  ";
+                        if (!is_terminator(inst.op) && inst.op != Opcode::set_global)
+                              out += "%" + std::to_string(id) + " = ";
+                        out += opcode_to_str(inst.op);
+                        switch (inst.op) {
+                              case Opcode::constant:
+                                    out += ' ';
+                                    out += inst.type == Type::FLOAT ? std::to_string(inst.real)
+                                                                    : std::to_string(inst.integer);
+                                    break;
+                              case Opcode::param:
+                              case Opcode::call:
+                              case Opcode::get_global:
+                              case Opcode::set_global:
+                                    out += ' ' + std::to_string(inst.integer);
+                                    break;
+                              default:
+                                    break;
+                        }
+                        for (size_t k = 0; k < inst.operands.size(); k++) {
+                              out += k || inst.op == Opcode::call || inst.op == Opcode::set_global ? ", %" : " %";
+                              out += std::to_string(inst.operands[k]);
+                        }
+                        if (inst.op == Opcode::jump)
+                              out += " b" + std::to_string(inst.target[0]);
+                        if (inst.op == Opcode::branch)
+                              out += ", b" + std::to_string(inst.target[0]) + ", b" + std::to_string(inst.target[1]);
+                        if (!is_terminator(inst.op) && inst.op != Opcode::set_global)
+                              out += " : " + std::string(type_to_str(inst.type));
+                        out += '\n';
+                  }
+            }
+            return out;
+      }
+
+      // Builds a Module from a parse() result, with the same rules (and the same errors) as the BytecodeCompiler.
+      // Locals are renamed as they're assigned, so each one is a ValueId at every point of the function; globals
+      // stay in memory, read and written with get_global and set_global.
+      class Builder {
+            struct Local {
+                  std::string_view name;
+                  ValueId value;
+                  Type type;
+            };
+
+            Module& m_module;
+            std::unordered_map<std::string_view, uint32_t> m_globals;
+            Function* m_fn = nullptr;
+            BlockId m_block = 0;
+            std::vector<Local> m_locals;
+
+        public:
+            // the function the last error was in
+            std::string_view error_function;
+
+            explicit Builder(Module& module) : m_module(module) {}
+
+            std::optional<CompileError> build(const std::span<ASTNode* const> items) {
+                  std::vector<const FunctionNode*> bodies;
+                  for (const ASTNode* item : items) {
+                        if (!item || item->kind != NodeKind::function)
+                              continue;
+                        const auto* node = static_cast<const FunctionNode*>(item);
+                        Function fn{node->Proto->name, {}, node->Proto->type, {}, {}};
+                        error_function = fn.name;
+                        if (fn.result == Type::UNKNOWN)
+                              return CompileError::unknown_type;
+                        for (const VariableNode* param : node->Proto->args) {
+                              if (param->type == Type::UNKNOWN)
+                                    return CompileError::unknown_type;
+                              fn.params.push_back(param->type);
+                        }
+                        m_module.by_name[fn.name] = static_cast<uint32_t>(m_module.functions.size());
+                        m_module.functions.push_back(std::move(fn));
+                        bodies.push_back(node);
+                  }
+
+                  m_module.entry = static_cast<uint32_t>(m_module.functions.size());
+                  m_module.functions.push_back({"<entry>", {}, Type::NULL_T, {}, {}});
+                  error_function = "<entry>";
+                  if (const std::optional<CompileError> err = entry(items))
+                        return err;
+                  for (size_t i = 0; i < bodies.size(); i++) {
+                        error_function = bodies[i]->Proto->name;
+                        if (const std::optional<CompileError> err = function(i, *bodies[i]))
+                              return err;
+                  }
+                  return std::nullopt;
+            }
+
+        private:
+            void begin(const uint32_t index) {
+                  m_fn = &m_module.functions[index];
+                  m_block = m_fn->add_block();
+                  m_locals.clear();
+            }
+
+            ValueId emit(const Opcode op, const Type type, std::vector<ValueId> operands = {}, const int64_t n = 0) {
+                  Inst inst{op, type, 0, std::move(operands)};
+                  inst.integer = n;
+                  return m_fn->append(m_block, std::move(inst));
+            }
+
+            ValueId constant(const Type type, const int64_t integer, const double real = 0) {
+                  Inst inst{Opcode::constant, type, 0, {}};
+                  // only the field that holds the value is set, so equal constants look equal to the optimizer
+                  if (type == Type::FLOAT)
+                        inst.real = real;
+                  else
+                        inst.integer = integer;
+                  return m_fn->append(m_block, std::move(inst));
+            }
+
+            Local* local(const std::string_view name) {
+                  for (size_t i = m_locals.size(); i > 0; i--) {
+                        if (m_locals[i - 1].name == name)
+                              return &m_locals[i - 1];
+                  }
+                  return nullptr;
+            }
+
+            std::optional<CompileError> entry(const std::span<ASTNode* const> items) {
+                  begin(m_module.entry);
+                  ValueId result = no_result();
+                  Type type = Type::NULL_T;
+                  for (const ASTNode* item : items) {
+                        if (!item || item->kind == NodeKind::function || item->kind == NodeKind::prototype)
+                              continue;
+                        if (item->kind == NodeKind::variable) {
+                              const auto* var = static_cast<const VariableNode*>(item);
+                              if (const std::optional<CompileError> err = initializer(var, result, type))
+                                    return err;
+                              const auto [it, inserted] =
+                                      m_globals.try_emplace(var->name, static_cast<uint32_t>(m_module.globals.size()));
+                              if (inserted)
+                                    m_module.globals.push_back(type);
+                              else if (m_module.globals[it->second] != type)
+                                    return CompileError::type_mismatch;
+                              emit(Opcode::set_global, Type::NULL_T, {result}, it->second);
+                              continue;
+                        }
+                        if (const std::optional<CompileError> err = value(item, result, type))
+                              return err;
+                  }
+                  m_fn->result = type;
+                  emit(Opcode::ret, type, {result});
+                  return std::nullopt;
+            }
+
+            std::optional<CompileError> function(const size_t index, const FunctionNode& node) {
+                  begin(static_cast<uint32_t>(index));
+                  for (size_t i = 0; i < node.Proto->args.size(); i++) {
+                        const VariableNode* param = node.Proto->args[i];
+                        const ValueId value = emit(Opcode::param, param->type, {}, static_cast<int64_t>(i));
+                        m_locals.push_back({param->name, value, param->type});
+                  }
+                  ValueId result;
+                  Type type;
+                  if (const std::optional<CompileError> err = block(node.body(), result, type))
+                        return err;
+                  if (type != m_fn->result)
+                        return CompileError::type_mismatch;
+                  emit(Opcode::ret, type, {result});
+                  return std::nullopt;
+            }
+
+            ValueId no_result() { return constant(Type::NULL_T, 0); }
+
+            std::optional<CompileError> block(const std::span<ASTNode* const> stmts, ValueId& result, Type& type) {
+                  const size_t locals = m_locals.size();
+                  type = Type::NULL_T;
+                  if (stmts.empty())
+                        result = no_result();
+                  for (const ASTNode* stmt : stmts) {
+                        if (stmt && stmt->kind == NodeKind::variable) {
+                              const auto* var = static_cast<const VariableNode*>(stmt);
+                              if (const std::optional<CompileError> err = initializer(var, result, type))
+                                    return err;
+                              m_locals.push_back({var->name, result, type});
+                              continue;
+                        }
+                        if (const std::optional<CompileError> err = value(stmt, result, type))
+                              return err;
+                  }
+                  m_locals.resize(locals);
+                  return std::nullopt;
+            }
+
+            std::optional<CompileError> initializer(const VariableNode* var, ValueId& result, Type& type) {
+                  if (!var->val) {
+                        type = Type::NULL_T;
+                        result = no_result();
+                        return std::nullopt;
+                  }
+                  return value(var->val, result, type);
+            }
+
+            std::optional<CompileError> value(const ASTNode* node, ValueId& result, Type& type) {
+                  if (!node)
+                        return CompileError::unsupported;
+                  switch (node->kind) {
+                        case NodeKind::null:
+                              type = Type::NULL_T;
+                              result = no_result();
+                              return std::nullopt;
+                        case NodeKind::number: {
+                              const auto* n = static_cast<const NumberNode*>(node);
+                              type = n->type;
+                              if (type != Type::INT && type != Type::FLOAT)
+                                    return CompileError::unsupported;
+                              result = constant(type, n->integer, n->real);
+                              return std::nullopt;
+                        }
+                        case NodeKind::boolean:
+                              type = Type::BOOL;
+                              result = constant(type, static_cast<const BoolNode*>(node)->val);
+                              return std::nullopt;
+                        case NodeKind::string:
+                              type = Type::STRING;
+                              m_module.strings.push_back(static_cast<const StringNode*>(node)->val);
+                              result = constant(type, static_cast<int64_t>(m_module.strings.size() - 1));
+                              return std::nullopt;
+                        case NodeKind::variable_call: {
+                              const std::string_view name = static_cast<const VariableCallNode*>(node)->name;
+                              if (const Local* l = local(name)) {
+                                    type = l->type;
+                                    result = l->value;
+                                    return std::nullopt;
+                              }
+                              const auto g = m_globals.find(name);
+                              if (g == m_globals.end())
+                                    return CompileError::unknown_name;
+                              type = m_module.globals[g->second];
+                              result = emit(Opcode::get_global, type, {}, g->second);
+                              return std::nullopt;
+                        }
+                        case NodeKind::binary:
+                              return binary(*static_cast<const BinaryOperation*>(node), result, type);
+                        case NodeKind::unary:
+                              return unary(*static_cast<const UnaryOperation*>(node), result, type);
+                        case NodeKind::call:
+                              return call(*static_cast<const CallNode*>(node), result, type);
+                        case NodeKind::comptime: {
+                              const auto* n = static_cast<const ComptimeNode*>(node);
+                              if (n->value)
+                                    return value(n->value, result, type);
+                              return block(n->body, result, type);
+                        }
+                        case NodeKind::variable:
+                        case NodeKind::prototype:
+                        case NodeKind::function:
+                        case NodeKind::error:
+                              break;
+                  }
+                  return CompileError::unsupported;
+            }
+
+            std::optional<CompileError> call(const CallNode& node, ValueId& result, Type& type) {
+                  const auto it = m_module.by_name.find(node.callee);
+                  if (it == m_module.by_name.end())
+                        return CompileError::unknown_function;
+                  const Function& callee = m_module.functions[it->second];
+                  if (callee.params.size() != node.args.size())
+                        return CompileError::argument_count;
+                  std::vector<ValueId> args;
+                  for (size_t i = 0; i < node.args.size(); i++) {
+                        ValueId arg;
+                        Type arg_type;
+                        if (const std::optional<CompileError> err = value(node.args[i], arg, arg_type))
+                              return err;
+                        if (arg_type != callee.params[i])
+                              return CompileError::type_mismatch;
+                        args.push_back(arg);
+                  }
+                  type = callee.result;
+                  result = emit(Opcode::call, type, std::move(args), it->second);
+                  return std::nullopt;
+            }
+
+            std::optional<CompileError> unary(const UnaryOperation& node, ValueId& result, Type& type) {
+                  const TypeOfToken op = node.op.type;
+                  if (op == TypeOfToken::OP_INC || op == TypeOfToken::OP_DEC) {
+                        if (node.node->kind != NodeKind::variable_call)
+                              return CompileError::not_assignable;
+                        Local* l = local(static_cast<const VariableCallNode*>(node.node)->name);
+                        if (!l)
+                              return CompileError::not_assignable;
+                        type = l->type;
+                        if (type != Type::INT && type != Type::FLOAT)
+                              return CompileError::type_mismatch;
+                        const ValueId one = constant(type, 1, 1.0);
+                        l->value = emit(op == TypeOfToken::OP_INC ? Opcode::add : Opcode::sub, type, {l->value, one});
+                        result = l->value;
+                        return std::nullopt;
+                  }
+
+                  ValueId operand;
+                  if (const std::optional<CompileError> err = value(node.node, operand, type))
+                        return err;
+                  if (op == TypeOfToken::OP_MINUS && (type == Type::INT || type == Type::FLOAT))
+                        result = emit(Opcode::neg, type, {operand});
+                  else if (op == TypeOfToken::OP_EXCL_MARK && type == Type::BOOL)
+                        result = emit(Opcode::logical_not, type, {operand});
+                  else
+                        return CompileError::type_mismatch;
+                  return std::nullopt;
+            }
+
+            // the opcode for `op` on two `type` operands, and the type of its result
+            static std::optional<std::pair<Opcode, Type>> select(const TypeOfToken op, const Type type) {
+                  using enum TypeOfToken;
+                  const bool number = type == Type::INT || type == Type::FLOAT;
+                  switch (op) {
+                        case OP_PLUS:
+                              return number ? std::optional{std::pair{Opcode::add, type}} : std::nullopt;
+                        case OP_MINUS:
+                              return number ? std::optional{std::pair{Opcode::sub, type}} : std::nullopt;
+                        case OP_TIMES:
+                              return number ? std::optional{std::pair{Opcode::mul, type}} : std::nullopt;
+                        case OP_DIV:
+                              return number ? std::optional{std::pair{Opcode::div, type}} : std::nullopt;
+                        case OP_AMPERSAND:
+                              return type == Type::INT ? std::optional{std::pair{Opcode::bit_and, type}} : std::nullopt;
+                        case OP_PIPE:
+                              return type == Type::INT ? std::optional{std::pair{Opcode::bit_or, type}} : std::nullopt;
+                        case LTHAN:
+                              return number ? std::optional{std::pair{Opcode::lt, Type::BOOL}} : std::nullopt;
+                        case LTHAN_EQUALS:
+                              return number ? std::optional{std::pair{Opcode::le, Type::BOOL}} : std::nullopt;
+                        case GTHAN:
+                              return number ? std::optional{std::pair{Opcode::gt, Type::BOOL}} : std::nullopt;
+                        case GTHAN_EQUALS:
+                              return number ? std::optional{std::pair{Opcode::ge, Type::BOOL}} : std::nullopt;
+                        case OP_EQUALSEQUALS:
+                              return type != Type::UNKNOWN ? std::optional{std::pair{Opcode::eq, Type::BOOL}}
+                                                           : std::nullopt;
+                        case OP_EXCL_EQUALS:
+                              return type != Type::UNKNOWN ? std::optional{std::pair{Opcode::ne, Type::BOOL}}
+                                                           : std::nullopt;
+                        default:
+                              return std::nullopt;
+                  }
+            }
+
+            std::optional<CompileError> binary(const BinaryOperation& node, ValueId& result, Type& type) {
+                  using enum TypeOfToken;
+                  const TypeOfToken op = node.op.type;
+                  switch (op) {
+                        case OP_EQUALS:
+                        case OP_PLUSEQUALS:
+                        case OP_MINUSEQUALS:
+                        case OP_TIMESEQUALS:
+                        case OP_DIVEQUALS:
+                              return assign(node, result, type);
+                        case OP_DOUBLEAMPERSAND:
+                        case OP_DOUBLEPIPE:
+                              return short_circuit(node, op == OP_DOUBLEAMPERSAND, result, type);
+                        default:
+                              break;
+                  }
+                  ValueId lhs, rhs;
+                  Type left, right;
+                  if (const std::optional<CompileError> err = value(node.left, lhs, left))
+                        return err;
+                  if (const std::optional<CompileError> err = value(node.right, rhs, right))
+                        return err;
+                  if (left != right)
+                        return CompileError::type_mismatch;
+                  const std::optional<std::pair<Opcode, Type>> instr = select(op, left);
+                  if (!instr)
+                        return CompileError::type_mismatch;
+                  type = instr->second;
+                  result = emit(instr->first, type, {lhs, rhs});
+                  return std::nullopt;
+            }
+
+            // `a && b` branches around b when a is false, and the result is a phi of the two; so is every local b
+            // assigns to.
+            std::optional<CompileError> short_circuit(const BinaryOperation& node, const bool all, ValueId& result,
+                                                      Type& type) {
+                  ValueId lhs, rhs;
+                  if (const std::optional<CompileError> err = value(node.left, lhs, type))
+                        return err;
+                  if (type != Type::BOOL)
+                        return CompileError::type_mismatch;
+
+                  const BlockId from = m_block;
+                  const BlockId right = m_fn->add_block();
+                  const BlockId join = m_fn->add_block();
+                  const ValueId branch = emit(Opcode::branch, Type::NULL_T, {lhs});
+                  m_fn->values[branch].target[0] = all ? right : join;
+                  m_fn->values[branch].target[1] = all ? join : right;
+                  m_fn->blocks[right].preds.push_back(from);
+
+                  std::vector<ValueId> before;
+                  for (const Local& l : m_locals)
+                        before.push_back(l.value);
+                  m_block = right;
+                  if (const std::optional<CompileError> err = value(node.right, rhs, type))
+                        return err;
+                  if (type != Type::BOOL)
+                        return CompileError::type_mismatch;
+                  const BlockId to = m_block;
+                  m_fn->values[emit(Opcode::jump, Type::NULL_T)].target[0] = join;
+                  m_fn->blocks[join].preds = {from, to};
+
+                  // the left side's value is what the result is when b is skipped
+                  m_block = join;
+                  result = emit(Opcode::phi, Type::BOOL, {lhs, rhs});
+                  for (size_t i = 0; i < before.size(); i++) {
+                        if (m_locals[i].value != before[i])
+                              m_locals[i].value = emit(Opcode::phi, m_locals[i].type, {before[i], m_locals[i].value});
+                  }
+                  return std::nullopt;
+            }
+
+            std::optional<CompileError> assign(const BinaryOperation& node, ValueId& result, Type& type) {
+                  if (!node.left || node.left->kind != NodeKind::variable_call)
+                        return CompileError::not_assignable;
+                  const std::string_view name = static_cast<const VariableCallNode*>(node.left)->name;
+                  const auto g = m_globals.find(name);
+                  if (!local(name) && g == m_globals.end())
+                        return CompileError::unknown_name;
+
+                  TypeOfToken op;
+                  switch (node.op.type) {
+                        case TypeOfToken::OP_PLUSEQUALS:
+                              op = TypeOfToken::OP_PLUS;
+                              break;
+                        case TypeOfToken::OP_MINUSEQUALS:
+                              op = TypeOfToken::OP_MINUS;
+                              break;
+                        case TypeOfToken::OP_TIMESEQUALS:
+                              op = TypeOfToken::OP_TIMES;
+                              break;
+                        case TypeOfToken::OP_DIVEQUALS:
+                              op = TypeOfToken::OP_DIV;
+                              break;
+                        default:
+                              op = TypeOfToken::OP_EQUALS;
+                              break;
+                  }
+
+                  ValueId rhs;
+                  if (const std::optional<CompileError> err = value(node.right, rhs, type))
+                        return err;
+                  // looked up again: the right side may have declared locals (in a comptime block) and moved them
+                  Local* l = local(name);
+                  const Type target = l ? l->type : m_module.globals[g->second];
+                  result = rhs;
+                  if (op != TypeOfToken::OP_EQUALS) {
+                        const ValueId old = l ? l->value : emit(Opcode::get_global, target, {}, g->second);
+                        const std::optional<std::pair<Opcode, Type>> instr = select(op, type);
+                        if (!instr || instr->second != type)
+                              return CompileError::type_mismatch;
+                        result = emit(instr->first, type, {old, rhs});
+                  }
+                  if (type != target)
+                        return CompileError::type_mismatch;
+                  if (l)
+                        l->value = result;
+                  else
+                        emit(Opcode::set_global, Type::NULL_T, {result}, g->second);
+                  return std::nullopt;
+            }
+      };
+} // namespace ir
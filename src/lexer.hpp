@@ -1,14 +1,19 @@
 #pragma once
 #include <algorithm>
 #include <array>
-#include <cctype>
+#include <cstdint>
 #include <optional>
+#include <stdexcept>
 #include <string_view>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 // for some weird reason, including string before a few other headers causes the clion lsp (and maybe the compiler)
 // to think std::string doesn't exist
 #include <string>
+#include "./interner.hpp"
+#include "./scan.hpp"
+#include "./source.hpp"
 
 constexpr std::array<std::string_view, 24> keywords = {
         "fn",       "return", "var",   "const",   "enum", "struct", "class", "dyn",
@@ -16,16 +21,122 @@ constexpr std::array<std::string_view, 24> keywords = {
         "continue", "switch", "case",  "default", "null", "import", "asm",   "comptime",
 };
 
+// Same order as `keywords`, so a Keyword indexes its spelling.
+enum class Keyword : uint8_t {
+      kw_fn,
+      kw_return,
+      kw_var,
+      kw_const,
+      kw_enum,
+      kw_struct,
+      kw_class,
+      kw_dyn,
+      kw_while,
+      kw_true,
+      kw_false,
+      kw_for,
+      kw_if,
+      kw_elseif,
+      kw_else,
+      kw_break,
+      kw_continue,
+      kw_switch,
+      kw_case,
+      kw_default,
+      kw_null,
+      kw_import,
+      kw_asm,
+      kw_comptime,
+      none,
+};
+
+constexpr std::string_view keyword_to_str(const Keyword kw) {
+      return kw == Keyword::none ? "" : keywords[static_cast<size_t>(kw)];
+}
+
+// Keywords are recognized with a perfect hash over their length and first two and last two characters, whose
+// multiplier is searched for at compile time, so an identifier costs one table load and at most one string compare.
+namespace keyword_hash {
+      constexpr size_t bits = 6;
+      constexpr size_t size = size_t{1} << bits;
+
+      // only called with at least two characters, every keyword has them
+      constexpr uint32_t key(const std::string_view s) {
+            const auto at = [&](const size_t i) { return static_cast<uint32_t>(static_cast<unsigned char>(s[i])); };
+            const size_t n = s.size();
+            return (at(0) | at(1) << 8 | at(n - 2) << 16 | at(n - 1) << 24) ^ static_cast<uint32_t>(n);
+      }
+
+      constexpr size_t slot(const std::string_view s, const uint32_t multiplier) {
+            return (key(s) * multiplier) >> (32 - bits);
+      }
+
+      constexpr uint32_t find_multiplier() {
+            for (uint32_t m = 0x9E3779B1u;; m += 2) {
+                  std::array<bool, size> used{};
+                  bool collides = false;
+                  for (const std::string_view kw : keywords) {
+                        const size_t i = slot(kw, m);
+                        collides |= used[i];
+                        used[i] = true;
+                  }
+                  if (!collides)
+                        return m;
+            }
+      }
+
+      constexpr uint32_t multiplier = find_multiplier();
+
+      constexpr size_t longest = std::ranges::max(keywords, {}, &std::string_view::size).size();
+
+      constexpr std::array<Keyword, size> table = [] {
+            std::array<Keyword, size> t{};
+            t.fill(Keyword::none);
+            for (size_t i = 0; i < keywords.size(); i++)
+                  t[slot(keywords[i], multiplier)] = static_cast<Keyword>(i);
+            return t;
+      }();
+}
+
+constexpr Keyword lookup_keyword(const std::string_view ident) {
+      if (ident.size() < 2 || ident.size() > keyword_hash::longest)
+            return Keyword::none;
+      const Keyword kw = keyword_hash::table[keyword_hash::slot(ident, keyword_hash::multiplier)];
+      return kw != Keyword::none && keywords[static_cast<size_t>(kw)] == ident ? kw : Keyword::none;
+}
+
+static_assert(lookup_keyword("comptime") == Keyword::kw_comptime && lookup_keyword("elseif") == Keyword::kw_elseif &&
+              lookup_keyword("els") == Keyword::none && lookup_keyword("fnord") == Keyword::none);
+
 enum class LexerError {
       unterminated_string,
       unterminated_character,
       unknown_character,
       unclosed_comment,
       unknown_escape_sequence,
+      source_too_large,
 };
 
+constexpr std::string_view lexer_error_to_str(LexerError e) {
+      switch (e) {
+            case LexerError::unterminated_string:
+                  return "unterminated string";
+            case LexerError::unterminated_character:
+                  return "unterminated character";
+            case LexerError::unknown_character:
+                  return "unknown character";
+            case LexerError::unclosed_comment:
+                  return "unclosed comment";
+            case LexerError::unknown_escape_sequence:
+                  return "unknown escape sequence";
+            case LexerError::source_too_large:
+                  return "source too large";
+      }
+      return "unknown lexer error";
+}
+
 // TODO: make all variants lower-cased, enum classes don't require them to be upper-cased.
-enum class TypeOfToken {
+enum class TypeOfToken : uint8_t {
       IDENTIFIER,
       KEYWORD,
       NUMBER,
@@ -66,40 +177,365 @@ enum class TypeOfToken {
       RBRACE,
       LBRACE,
       COMMENT,
+      // text the lexer couldn't make a token of, only produced by tokenize(diagnostics)
+      ERROR,
       T_EOF
 };
 
+// What the first character of a token says about the rest of it; lex_token() dispatches on this.
+enum class CharClass : uint8_t { invalid, space, ident, digit, quote, apostrophe, slash, op };
+
+constexpr std::array<CharClass, 256> char_classes = [] {
+      std::array<CharClass, 256> t{};
+      for (size_t c = 0; c < t.size(); c++) {
+            const char ch = static_cast<char>(c);
+            if (scan::is_space(ch))
+                  t[c] = CharClass::space;
+            else if (scan::is_alpha(ch) || ch == '_')
+                  t[c] = CharClass::ident;
+            else if (scan::is_digit(ch))
+                  t[c] = CharClass::digit;
+      }
+      t['"'] = CharClass::quote;
+      t['\''] = CharClass::apostrophe;
+      t['/'] = CharClass::slash;
+      for (const char c : std::string_view("+-*=!&|<>:;,.()[]{}"))
+            t[static_cast<unsigned char>(c)] = CharClass::op;
+      return t;
+}();
+
+// Operators are at most two characters, so the DFA matching them is two tables: the token a character starts on its
+// own, and the token a (first, second) pair makes together. Both are built from this list.
+namespace op_table {
+      struct Operator {
+            std::string_view text;
+            TypeOfToken type;
+      };
+
+      constexpr std::array operators = {
+              Operator{"+", TypeOfToken::OP_PLUS},
+              Operator{"+=", TypeOfToken::OP_PLUSEQUALS},
+              Operator{"++", TypeOfToken::OP_INC},
+              Operator{"-", TypeOfToken::OP_MINUS},
+              Operator{"-=", TypeOfToken::OP_MINUSEQUALS},
+              Operator{"--", TypeOfToken::OP_DEC},
+              Operator{"*", TypeOfToken::OP_TIMES},
+              Operator{"*=", TypeOfToken::OP_TIMESEQUALS},
+              Operator{"/", TypeOfToken::OP_DIV},
+              Operator{"/=", TypeOfToken::OP_DIVEQUALS},
+              Operator{"=", TypeOfToken::OP_EQUALS},
+              Operator{"==", TypeOfToken::OP_EQUALSEQUALS},
+              Operator{"&", TypeOfToken::OP_AMPERSAND},
+              Operator{"&&", TypeOfToken::OP_DOUBLEAMPERSAND},
+              Operator{"!", TypeOfToken::OP_EXCL_MARK},
+              Operator{"!=", TypeOfToken::OP_EXCL_EQUALS},
+              Operator{"|", TypeOfToken::OP_PIPE},
+              Operator{"||", TypeOfToken::OP_DOUBLEPIPE},
+              Operator{",", TypeOfToken::COMMA},
+              Operator{".", TypeOfToken::PERIOD},
+              Operator{":", TypeOfToken::COLON},
+              Operator{"::", TypeOfToken::DOUBLECOLON},
+              Operator{";", TypeOfToken::SEMICOLON},
+              Operator{">", TypeOfToken::GTHAN},
+              Operator{">=", TypeOfToken::GTHAN_EQUALS},
+              Operator{"<", TypeOfToken::LTHAN},
+              Operator{"<=", TypeOfToken::LTHAN_EQUALS},
+              Operator{")", TypeOfToken::RPAREN},
+              Operator{"(", TypeOfToken::LPAREN},
+              Operator{"]", TypeOfToken::RBRACKET},
+              Operator{"[", TypeOfToken::LBRACKET},
+              Operator{"}", TypeOfToken::RBRACE},
+              Operator{"{", TypeOfToken::LBRACE},
+      };
+
+      // dense numbering of the characters operators are made of, so the pair table stays small
+      constexpr uint8_t none = 0xFF;
+      constexpr std::string_view chars = "+-*/=!&|,.:;<>()[]{}";
+
+      constexpr std::array<uint8_t, 256> index = [] {
+            std::array<uint8_t, 256> t{};
+            t.fill(none);
+            for (size_t i = 0; i < chars.size(); i++)
+                  t[static_cast<unsigned char>(chars[i])] = static_cast<uint8_t>(i);
+            return t;
+      }();
+
+      constexpr uint8_t idx(const char c) { return index[static_cast<unsigned char>(c)]; }
+
+      constexpr std::array<TypeOfToken, chars.size()> single = [] {
+            std::array<TypeOfToken, chars.size()> t{};
+            t.fill(TypeOfToken::T_EOF);
+            for (const Operator& op : operators)
+                  if (op.text.size() == 1)
+                        t[idx(op.text[0])] = op.type;
+            return t;
+      }();
+
+      // T_EOF where the two characters don't form an operator
+      constexpr std::array<std::array<TypeOfToken, chars.size()>, chars.size()> pair = [] {
+            std::array<std::array<TypeOfToken, chars.size()>, chars.size()> t{};
+            for (auto& row : t)
+                  row.fill(TypeOfToken::T_EOF);
+            for (const Operator& op : operators)
+                  if (op.text.size() == 2)
+                        t[idx(op.text[0])][idx(op.text[1])] = op.type;
+            return t;
+      }();
+}
+
+// A token as handed out by TokenStream. It isn't stored anywhere, the stream materializes it from its arrays.
 struct Token {
-      const TypeOfToken type;
-      const std::string_view val;
-      const size_t line;
-      const size_t column;
+      TypeOfToken type = TypeOfToken::T_EOF;
+      // which keyword a KEYWORD token is, so the parser never compares its text again
+      Keyword keyword = Keyword::none;
+      // where the token's text starts in the source and how long it is, quotes and comment markers included
+      uint32_t offset = 0;
+      uint32_t length = 0;
+      // the interned name of an IDENTIFIER token, no_symbol for everything else
+      SymbolId symbol = no_symbol;
+      // what the token stands for: the text without quotes or comment markers, escapes decoded
+      std::string_view val;
+};
 
-      explicit constexpr Token(const TypeOfToken t = TypeOfToken::IDENTIFIER, const std::string_view v = "",
-                               const size_t l = 0, const size_t c = 0) : type(t), val(v), line(l), column(c) {}
+struct SourceLocation {
+      size_t line;
+      size_t column;
 };
 
+// Tokens stored as parallel arrays, 14 bytes each: a kind, a keyword id, the offset and length of the token's text in
+// the source (which limits sources to max_source_size), and the symbol of an identifier. Values are derived from the
+// source on demand, except for literals with escape sequences, which keep their decoded value in a side table. Lines
+// and columns aren't stored either, location() recomputes them from the offsets at which lines start.
+class TokenStream {
+      // set in `lengths` for tokens whose value is in m_decoded
+      static constexpr uint32_t decoded_bit = 1u << 31;
+
+      std::vector<TypeOfToken> m_kinds;
+      std::vector<Keyword> m_keywords;
+      std::vector<uint32_t> m_offsets;
+      std::vector<uint32_t> m_lengths;
+      std::vector<SymbolId> m_symbols;
+      // (token index, value), in token order
+      std::vector<std::pair<uint32_t, std::string_view>> m_decoded;
+
+  public:
+      // the text offsets point into, and the offset its first byte has (non-zero for StreamLexer's later chunks)
+      std::string_view source;
+      uint32_t base = 0;
+      // offset of the first byte of every line; line_starts[0] is always 0
+      std::vector<uint32_t> line_starts{0};
+      // every identifier's name; ids stay the same across StreamLexer chunks
+      StringInterner names;
+
+      [[nodiscard]] size_t size() const { return m_kinds.size(); }
+      [[nodiscard]] bool empty() const { return m_kinds.empty(); }
+
+      [[nodiscard]] TypeOfToken kind(const size_t i) const { return m_kinds[i]; }
+      [[nodiscard]] Keyword keyword(const size_t i) const { return m_keywords[i]; }
+      [[nodiscard]] uint32_t offset(const size_t i) const { return m_offsets[i]; }
+      [[nodiscard]] uint32_t length(const size_t i) const { return m_lengths[i] & ~decoded_bit; }
+      [[nodiscard]] SymbolId symbol(const size_t i) const { return m_symbols[i]; }
+      [[nodiscard]] const std::vector<TypeOfToken>& kinds() const { return m_kinds; }
+      // (token index, value) for every literal whose value isn't its text, in token order
+      [[nodiscard]] const std::vector<std::pair<uint32_t, std::string_view>>& decoded() const { return m_decoded; }
+
+      // the token's text as written
+      [[nodiscard]] std::string_view text(const size_t i) const {
+            return source.substr(m_offsets[i] - base, length(i));
+      }
+
+      [[nodiscard]] std::string_view value(const size_t i) const {
+            const std::string_view t = text(i);
+            switch (m_kinds[i]) {
+                  case TypeOfToken::STRING:
+                  case TypeOfToken::CHAR:
+                        if (m_lengths[i] & decoded_bit) {
+                              return std::ranges::lower_bound(m_decoded, static_cast<uint32_t>(i), {},
+                                                              &std::pair<uint32_t, std::string_view>::first)
+                                      ->second;
+                        }
+                        return t.substr(1, t.size() - 2);
+                  case TypeOfToken::COMMENT:
+                        if (t[1] == '*')
+                              return t.substr(2, t.size() >= 4 && t.ends_with("*/") ? t.size() - 4 : t.size() - 2);
+                        return t.substr(2);
+                  default:
+                        return t;
+            }
+      }
+
+      [[nodiscard]] Token at(const size_t i) const {
+            if (i >= size())
+                  throw std::out_of_range("token index out of range");
+            return (*this)[i];
+      }
+
+      [[nodiscard]] Token operator[](const size_t i) const {
+            return Token{m_kinds[i], m_keywords[i], m_offsets[i], length(i), m_symbols[i], value(i)};
+      }
+
+      [[nodiscard]] SourceLocation location_of(const uint32_t offset) const {
+            const auto line = std::ranges::upper_bound(line_starts, offset) - 1;
+            return {static_cast<size_t>(line - line_starts.begin()) + 1, offset - *line + 1};
+      }
+
+      [[nodiscard]] SourceLocation location(const size_t i) const { return location_of(m_offsets[i]); }
+
+      void reserve(const size_t n) {
+            m_kinds.reserve(n);
+            m_keywords.reserve(n);
+            m_offsets.reserve(n);
+            m_lengths.reserve(n);
+            m_symbols.reserve(n);
+      }
+
+      void push(const TypeOfToken kind, const size_t offset, const size_t length, const Keyword kw = Keyword::none) {
+            m_kinds.push_back(kind);
+            m_keywords.push_back(kw);
+            m_offsets.push_back(static_cast<uint32_t>(offset));
+            m_lengths.push_back(static_cast<uint32_t>(length));
+            m_symbols.push_back(no_symbol);
+      }
+
+      void push_identifier(const size_t offset, const std::string_view name) {
+            push(TypeOfToken::IDENTIFIER, offset, name.size());
+            m_symbols.back() = names.intern(name);
+      }
+
+      // `val` has to outlive the stream
+      void push_decoded(const TypeOfToken kind, const size_t offset, const size_t length, const std::string_view val) {
+            m_decoded.emplace_back(static_cast<uint32_t>(size()), val);
+            push(kind, offset, length);
+            m_lengths.back() |= decoded_bit;
+      }
+
+      // Drops every token from `count` on.
+      void truncate(const size_t count) {
+            m_kinds.resize(count);
+            m_keywords.resize(count);
+            m_offsets.resize(count);
+            m_lengths.resize(count);
+            m_symbols.resize(count);
+            while (!m_decoded.empty() && m_decoded.back().first >= count)
+                  m_decoded.pop_back();
+      }
+
+      void clear() { truncate(0); }
+
+      // Moves another stream's tokens (a later stretch of the same source, lexed on its own) onto the end of this one.
+      // Its names are re-interned here, and its decoded values are passed through `rehome`, which returns a view of the
+      // same text that outlives this stream.
+      template<typename Rehome>
+      void append(const TokenStream& other, Rehome&& rehome) {
+            std::vector<SymbolId> ids(other.names.size());
+            for (SymbolId id = 0; id < ids.size(); id++)
+                  ids[id] = names.intern(other.names.str(id));
+
+            const auto first = static_cast<uint32_t>(size());
+            m_kinds.insert(m_kinds.end(), other.m_kinds.begin(), other.m_kinds.end());
+            m_keywords.insert(m_keywords.end(), other.m_keywords.begin(), other.m_keywords.end());
+            m_offsets.insert(m_offsets.end(), other.m_offsets.begin(), other.m_offsets.end());
+            m_lengths.insert(m_lengths.end(), other.m_lengths.begin(), other.m_lengths.end());
+            for (const SymbolId id : other.m_symbols)
+                  m_symbols.push_back(id == no_symbol ? no_symbol : ids[id]);
+            for (const auto& [index, val] : other.m_decoded)
+                  m_decoded.emplace_back(first + index, rehome(val));
+            // its line table starts with the line its first byte is on, which this one already has
+            line_starts.insert(line_starts.end(), other.line_starts.begin() + 1, other.line_starts.end());
+      }
+
+      // Replaces tokens [first, last) with every token of `fresh`, which re-lexed the text from `from` on after an edit
+      // that moved the text behind it by `delta` bytes. Later tokens and line starts are shifted by `delta`; line
+      // starts in (from, to], where `to` is the old offset of token `last`, are replaced with fresh's. Rehome as for
+      // append().
+      template<typename Rehome>
+      void splice(const size_t first, const size_t last, const TokenStream& fresh, const int64_t delta,
+                  const uint32_t from, const uint32_t to, Rehome&& rehome) {
+            std::vector<SymbolId> ids(fresh.names.size());
+            for (SymbolId id = 0; id < ids.size(); id++)
+                  ids[id] = names.intern(fresh.names.str(id));
+
+            const auto at = [first](auto& v) { return v.begin() + static_cast<std::ptrdiff_t>(first); };
+            const auto replace = [&](auto& v, const auto& with) {
+                  v.erase(at(v), at(v) + static_cast<std::ptrdiff_t>(last - first));
+                  v.insert(at(v), with.begin(), with.end());
+            };
+            replace(m_kinds, fresh.m_kinds);
+            replace(m_keywords, fresh.m_keywords);
+            replace(m_offsets, fresh.m_offsets);
+            replace(m_lengths, fresh.m_lengths);
+            std::vector<SymbolId> symbols;
+            symbols.reserve(fresh.size());
+            for (const SymbolId id : fresh.m_symbols)
+                  symbols.push_back(id == no_symbol ? no_symbol : ids[id]);
+            replace(m_symbols, symbols);
+
+            const size_t shifted = first + fresh.size();
+            for (size_t i = shifted; i < size(); i++)
+                  m_offsets[i] = static_cast<uint32_t>(m_offsets[i] + delta);
+
+            std::vector<std::pair<uint32_t, std::string_view>> decoded;
+            decoded.reserve(m_decoded.size() + fresh.m_decoded.size());
+            for (const auto& [index, val] : m_decoded) {
+                  if (index < first)
+                        decoded.emplace_back(index, val);
+            }
+            for (const auto& [index, val] : fresh.m_decoded)
+                  decoded.emplace_back(static_cast<uint32_t>(first + index), rehome(val));
+            for (const auto& [index, val] : m_decoded) {
+                  if (index >= last)
+                        decoded.emplace_back(static_cast<uint32_t>(index - last + shifted), val);
+            }
+            m_decoded = std::move(decoded);
+
+            const auto lo = std::ranges::upper_bound(line_starts, from);
+            const auto hi = std::ranges::upper_bound(line_starts, to);
+            std::vector<uint32_t> after(hi, line_starts.end());
+            line_starts.erase(lo, line_starts.end());
+            line_starts.insert(line_starts.end(), fresh.line_starts.begin() + 1, fresh.line_starts.end());
+            for (const uint32_t start : after)
+                  line_starts.push_back(static_cast<uint32_t>(start + delta));
+      }
+};
+
+// Token values are views into the source the lexer reads from, so the only allocations made while lexing are the
+// token arrays themselves. Literals containing escape sequences are the exception: their decoded form doesn't exist
+// anywhere in the source, so it is interned once in m_decoded and the token views that copy instead.
 class Lexer {
-      const std::string m_source;
+      friend class StreamLexer;
+      friend class ParallelLexer;
+      friend class Document;
+
+      // only used when the lexer was handed a std::string, m_source views whichever buffer is being lexed
+      const std::string m_owned;
+      std::string_view m_source;
+      // node-based, so views into it stay valid while it grows
+      std::unordered_set<std::string> m_decoded;
       size_t m_index = 0;
-      size_t m_line = 1;
-      size_t m_column = 1;
+      // offset of m_source[0] in the whole input, for StreamLexer
+      size_t m_base = 0;
+      bool m_final = true;
 
   public:
-      std::vector<Token> tokens;
+      TokenStream tokens;
 
-      explicit Lexer(std::string src) : m_source(std::move(src)) {}
+      explicit Lexer(std::string src) : m_owned(std::move(src)), m_source(m_owned) { tokens.source = m_source; }
+
+      explicit Lexer(const char* src) : Lexer(std::string(src)) {}
+
+      // Borrows src, e.g. a memory-mapped SourceBuffer; it has to outlive the lexer and its tokens.
+      explicit Lexer(const std::string_view src) : m_source(src) { tokens.source = m_source; }
+
+      // tokens point into m_source, moving the lexer would leave them dangling (small strings live inline)
+      Lexer(const Lexer&) = delete;
+      Lexer& operator=(const Lexer&) = delete;
 
       constexpr char next_char() {
             if (m_index >= m_source.size())
                   return '\0';
-            char c = m_source[m_index++];
-            if (c == '\n') {
-                  m_line++;
-                  m_column = 1;
-            } else {
-                  m_column++;
-            }
+            const char c = m_source[m_index++];
+            if (c == '\n')
+                  tokens.line_starts.push_back(static_cast<uint32_t>(m_base + m_index));
             return c;
       }
 
@@ -109,274 +545,334 @@ class Lexer {
             return m_source[m_index];
       }
 
-      std::optional<LexerError> tokenize() {
-            while (m_index < m_source.size()) {
-                  const char c = peek_next();
-                  if (std::isspace(static_cast<unsigned char>(c))) {
-                        next_char();
-                        continue;
-                  }
-                  if (c == '\n') {
-                        next_char();
-                        tokens.emplace_back(TypeOfToken::NEWLINE, "[newline]", m_line, m_column);
-                        continue;
-                  }
+  private:
+      // Moves m_index forward to `to`, recording the lines that start in between.
+      void advance_to(const size_t to) {
+            const char* const data = m_source.data();
+            for (const char* p = data + m_index; (p = scan::find_newline(p, data + to)) != data + to;) {
+                  ++p;
+                  tokens.line_starts.push_back(static_cast<uint32_t>(m_base + offset_of(p)));
+            }
+            m_index = to;
+      }
 
-                  next_char();
+      // advance_to() for spans known not to contain a newline
+      void advance_within_line(const size_t to) { m_index = to; }
 
-                  if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
-                        std::string identifier(1, c);
+      // Where a scan:: helper stopped, as an index into m_source.
+      [[nodiscard]] size_t offset_of(const char* p) const { return static_cast<size_t>(p - m_source.data()); }
 
-                        while (std::isalnum(static_cast<unsigned char>(peek_next())) || peek_next() == '_') {
-                              identifier.push_back(next_char());
-                        }
+      void push(const TypeOfToken kind, const size_t start, const Keyword kw = Keyword::none) {
+            tokens.push(kind, m_base + start, m_index - start, kw);
+      }
+
+      void push_decoded(const TypeOfToken kind, const size_t start, std::string&& decoded) {
+            tokens.push_decoded(kind, m_base + start, m_index - start, *m_decoded.insert(std::move(decoded)).first);
+      }
+
+      static constexpr std::optional<char> decode_escape(const char esc) {
+            switch (esc) {
+                  case 'n':
+                        return '\n';
+                  case 't':
+                        return '\t';
+                  case 'r':
+                        return '\r';
+                  case '0':
+                        return '\0';
+                  case '\\':
+                        return '\\';
+                  case '\'':
+                        return '\'';
+                  case '"':
+                        return '"';
+                  default:
+                        return std::nullopt;
+            }
+      }
+
+      // Lexes the token (or run of whitespace) starting at m_index.
+      std::optional<LexerError> lex_token() {
+            const char* const data = m_source.data();
+            const char* const end = data + m_source.size();
+            const char c = peek_next();
+            const CharClass cls = char_classes[static_cast<unsigned char>(c)];
+
+            if (cls == CharClass::space) {
+                  advance_to(offset_of(scan::skip_whitespace(data + m_index + 1, end)));
+                  return std::nullopt;
+            }
+
+            const size_t start = m_index;
+            next_char();
+
+            switch (cls) {
+                  case CharClass::ident: {
+                        advance_within_line(offset_of(scan::skip_ident(data + m_index, end)));
 
-                        if (std::ranges::find(keywords, std::string_view(identifier)) != keywords.end()) {
-                              tokens.emplace_back(TypeOfToken::KEYWORD, identifier, m_line, m_column);
+                        const std::string_view identifier = m_source.substr(start, m_index - start);
+                        if (const Keyword kw = lookup_keyword(identifier); kw != Keyword::none) {
+                              push(TypeOfToken::KEYWORD, start, kw);
                         } else {
-                              tokens.emplace_back(TypeOfToken::IDENTIFIER, identifier, m_line, m_column);
+                              tokens.push_identifier(m_base + start, identifier);
                         }
-                  } else if (std::isdigit(static_cast<unsigned char>(c))) {
-                        std::string num(1, c);
-                        bool has_dot = false;
-
-                        while (true) {
-                              const char next = peek_next();
-
-                              if (std::isdigit(static_cast<unsigned char>(next))) {
-                                    num.push_back(next_char());
-                              } else if (next == '.' && !has_dot) {
-                                    has_dot = true;
-                                    num.push_back(next_char());
-                              } else {
-                                    break;
-                              }
+                        return std::nullopt;
+                  }
+                  case CharClass::digit:
+                        advance_within_line(offset_of(scan::skip_digits(data + m_index, end)));
+                        if (peek_next() == '.') {
+                              next_char();
+                              advance_within_line(offset_of(scan::skip_digits(data + m_index, end)));
                         }
 
-                        tokens.emplace_back(TypeOfToken::NUMBER, num, m_line, m_column);
-                  } else if (c == '"') {
-                        std::string str;
+                        push(TypeOfToken::NUMBER, start);
+                        return std::nullopt;
+                  case CharClass::quote: {
+                        const size_t body = m_index;
+                        bool escaped = false;
 
-                        while (peek_next() != '"' && peek_next() != '\0') {
-                              str.push_back(next_char());
+                        const char* p = data + m_index;
+                        while ((p = scan::find_quote_or_escape(p, end)) != end && *p == '\\') {
+                              escaped = true;
+                              p = end - p > 2 ? p + 2 : end;
                         }
+                        advance_to(offset_of(p));
 
-                        if (peek_next() == '"') {
+                        if (peek_next() != '"')
+                              return LexerError::unterminated_string;
+
+                        const std::string_view str = m_source.substr(body, m_index - body);
+                        next_char();
+
+                        if (escaped) {
+                              std::string decoded;
+                              decoded.reserve(str.size());
+                              for (size_t i = 0; i < str.size(); i++) {
+                                    if (str[i] != '\\') {
+                                          decoded.push_back(str[i]);
+                                          continue;
+                                    }
+                                    const std::optional<char> ch = decode_escape(str[++i]);
+                                    if (!ch)
+                                          return LexerError::unknown_escape_sequence;
+                                    decoded.push_back(*ch);
+                              }
+                              push_decoded(TypeOfToken::STRING, start, std::move(decoded));
+                        } else {
+                              push(TypeOfToken::STRING, start);
+                        }
+                        return std::nullopt;
+                  }
+                  case CharClass::apostrophe: {
+                        std::optional<char> esc;
+                        if (peek_next() == '\\') {
                               next_char();
-                              tokens.emplace_back(TypeOfToken::STRING, str, m_line, m_column);
+                              esc = decode_escape(next_char());
+                              if (!esc)
+                                    return LexerError::unknown_escape_sequence;
                         } else {
-                              return LexerError::unterminated_string;
+                              if (m_index >= m_source.size())
+                                    return LexerError::unterminated_character;
+                              next_char();
                         }
-                  } else if (c == '/') {
-                        const char next = peek_next();
 
-                        if (next == '/') {
+                        if (peek_next() != '\'')
+                              return LexerError::unterminated_character;
+                        next_char();
+                        if (esc) {
+                              push_decoded(TypeOfToken::CHAR, start, std::string(1, *esc));
+                        } else {
+                              push(TypeOfToken::CHAR, start);
+                        }
+                        return std::nullopt;
+                  }
+                  case CharClass::slash:
+                        if (peek_next() == '/') {
                               next_char();
-                              std::string comment;
-
-                              while (peek_next() != '\n' && peek_next() != '\0') {
-                                    comment.push_back(next_char());
-                              }
+                              advance_within_line(offset_of(scan::find_newline(data + m_index, end)));
 
-                              tokens.emplace_back(TypeOfToken::COMMENT, comment, m_line, m_column);
-                        } else if (next == '*') {
+                              push(TypeOfToken::COMMENT, start);
+                              return std::nullopt;
+                        }
+                        if (peek_next() == '*') {
                               next_char();
-                              std::string comment;
-                              bool closed = false;
-
-                              while (true) {
-                                    char ch = next_char();
-                                    if (ch == '\0')
-                                          break;
-                                    if (ch == '*' && peek_next() == '/') {
-                                          next_char();
-                                          closed = true;
-                                          break;
-                                    }
-                                    comment.push_back(ch);
-                              }
+                              const size_t body_end = offset_of(scan::find_comment_close(data + m_index, end));
+                              const bool closed = body_end < m_source.size();
+                              advance_to(closed ? body_end + 2 : body_end);
 
-                              tokens.emplace_back(TypeOfToken::COMMENT, comment, m_line, m_column);
+                              push(TypeOfToken::COMMENT, start);
 
                               if (!closed) {
                                     return LexerError::unclosed_comment;
                               }
-                        } else {
-                              tokens.emplace_back(TypeOfToken::OP_DIV, "/", m_line, m_column);
+                              return std::nullopt;
                         }
-                  } else if (c == '\'') {
-                        char ch;
-                        if (peek_next() == '\\') {
-                              next_char();
-                              switch (const char esc = next_char()) {
-                                    case 'n':
-                                          ch = '\n';
-                                          break;
-                                    case 't':
-                                          ch = '\t';
-                                          break;
-                                    case '\\':
-                                          ch = '\\';
-                                          break;
-                                    case '\'':
-                                          ch = '\'';
-                                          break;
-                                    case '"':
-                                          ch = '"';
-                                          break;
-                                    default:
-                                          return LexerError::unknown_escape_sequence;
+                        [[fallthrough]];
+                  case CharClass::op: {
+                        const uint8_t first = op_table::idx(c);
+                        TypeOfToken type = op_table::single[first];
+                        if (const uint8_t second = op_table::idx(peek_next()); second != op_table::none) {
+                              if (const TypeOfToken pair = op_table::pair[first][second]; pair != TypeOfToken::T_EOF) {
+                                    next_char();
+                                    type = pair;
                               }
-                        } else {
-                              ch = next_char();
                         }
 
-                        if (peek_next() == '\'') {
-                              next_char();
-                              tokens.emplace_back(TypeOfToken::CHAR, std::string(1, ch), m_line, m_column);
-                        } else {
-                              return LexerError::unterminated_character;
-                        }
-                  } else {
-                        TypeOfToken type;
-                        std::string op(1, c);
-                        const char next = peek_next();
-
-                        switch (c) {
-                              case '+':
-                                    if (next == '+') {
-                                          next_char();
-                                          type = TypeOfToken::OP_INC;
-                                          op = "++";
-                                    } else if (next == '=') {
-                                          next_char();
-                                          type = TypeOfToken::OP_PLUSEQUALS;
-                                          op = "+=";
-                                    } else {
-                                          type = TypeOfToken::OP_PLUS;
-                                    }
-                                    break;
-                              case '-':
-                                    if (next == '-') {
-                                          next_char();
-                                          type = TypeOfToken::OP_DEC;
-                                          op = "--";
-                                    } else if (next == '=') {
-                                          next_char();
-                                          type = TypeOfToken::OP_MINUSEQUALS;
-                                          op = "-=";
-                                    } else {
-                                          type = TypeOfToken::OP_MINUS;
-                                    }
-                                    break;
-                              case '*':
-                                    if (next == '=') {
-                                          next_char();
-                                          type = TypeOfToken::OP_TIMESEQUALS;
-                                          op = "*=";
-                                    } else {
-                                          type = TypeOfToken::OP_TIMES;
-                                    }
-                                    break;
-                              case '=':
-                                    if (next == '=') {
-                                          next_char();
-                                          type = TypeOfToken::OP_EQUALSEQUALS;
-                                          op = "==";
-                                    } else {
-                                          type = TypeOfToken::OP_EQUALS;
-                                    }
-                                    break;
-                              case '!':
-                                    if (next == '=') {
-                                          next_char();
-                                          type = TypeOfToken::OP_EXCL_EQUALS;
-                                          op = "!=";
-                                    } else {
-                                          type = TypeOfToken::OP_EXCL_MARK;
-                                    }
-                                    break;
-                              case '&':
-                                    if (next == '&') {
-                                          next_char();
-                                          type = TypeOfToken::OP_DOUBLEAMPERSAND;
-                                          op = "&&";
-                                    } else {
-                                          type = TypeOfToken::OP_AMPERSAND;
-                                    }
-                                    break;
-                              case '|':
-                                    if (next == '|') {
-                                          next_char();
-                                          type = TypeOfToken::OP_DOUBLEPIPE;
-                                          op = "||";
-                                    } else {
-                                          type = TypeOfToken::OP_PIPE;
-                                    }
-                                    break;
-                              case '>':
-                                    if (next == '=') {
-                                          next_char();
-                                          type = TypeOfToken::GTHAN_EQUALS;
-                                          op = ">=";
-                                    } else {
-                                          type = TypeOfToken::GTHAN;
-                                    }
-                                    break;
-                              case '<':
-                                    if (next == '=') {
-                                          next_char();
-                                          type = TypeOfToken::LTHAN_EQUALS;
-                                          op = "<=";
-                                    } else {
-                                          type = TypeOfToken::LTHAN;
-                                    }
-                                    break;
-                              case ':':
-                                    if (next == ':') {
-                                          next_char();
-                                          type = TypeOfToken::DOUBLECOLON;
-                                          op = "::";
-                                    } else {
-                                          type = TypeOfToken::COLON;
-                                    }
-                                    break;
-                              case ';':
-                                    type = TypeOfToken::SEMICOLON;
-                                    break;
-                              case ',':
-                                    type = TypeOfToken::COMMA;
-                                    break;
-                              case '.':
-                                    type = TypeOfToken::PERIOD;
-                                    break;
-                              case '(':
-                                    type = TypeOfToken::LPAREN;
-                                    break;
-                              case ')':
-                                    type = TypeOfToken::RPAREN;
-                                    break;
-                              case '[':
-                                    type = TypeOfToken::LBRACKET;
-                                    break;
-                              case ']':
-                                    type = TypeOfToken::RBRACKET;
-                                    break;
-                              case '{':
-                                    type = TypeOfToken::LBRACE;
-                                    break;
-                              case '}':
-                                    type = TypeOfToken::RBRACE;
-                                    break;
-                              default:
-                                    return LexerError::unknown_character;
-                        }
+                        push(type, start);
+                        return std::nullopt;
+                  }
+                  case CharClass::space:
+                  case CharClass::invalid:
+                        break;
+            }
+            return LexerError::unknown_character;
+      }
+
+      // Lexes until the end of m_source. When m_final is false m_source is only a window over a longer input, and a
+      // token that runs into the end of it may continue past it, so that token is rolled back and lexing stops at its
+      // start instead; the caller then slides the window forward and calls this again.
+      std::optional<LexerError> lex_window() {
+            while (m_index < m_source.size()) {
+                  const size_t index = m_index;
+                  const size_t count = tokens.size();
+                  const size_t lines = tokens.line_starts.size();
 
-                        tokens.emplace_back(type, op, m_line, m_column);
+                  const std::optional<LexerError> err = lex_token();
+                  if (!m_final && m_index >= m_source.size()) {
+                        m_index = index;
+                        tokens.truncate(count);
+                        tokens.line_starts.resize(lines);
+                        return std::nullopt;
                   }
+                  if (err)
+                        return err;
             }
+            return std::nullopt;
+      }
+
+      // Skips the token lex_token() failed on with `err`, which started at `start` and left `count` tokens and `lines`
+      // line starts behind, and returns where it ends. It becomes an ERROR token: a bad character on its own, a bad
+      // escape the whole literal, and an unterminated literal the rest of its line. An unclosed comment already is a
+      // COMMENT token running to the end.
+      size_t skip_error(const LexerError err, const size_t start, const size_t count, const size_t lines) {
+            if (err == LexerError::unclosed_comment)
+                  return m_index;
+
+            size_t stop;
+            if (err == LexerError::unknown_character) {
+                  // the rest of a UTF-8 sequence too, so one character is one error
+                  stop = start + 1;
+                  while (stop < m_source.size() && (static_cast<unsigned char>(m_source[stop]) & 0xC0) == 0x80)
+                        stop++;
+            } else if (err == LexerError::unknown_escape_sequence) {
+                  stop = m_index;
+                  if (m_source[start] == '\'' && peek_next() == '\'')
+                        stop++;
+            } else {
+                  stop = offset_of(scan::find_newline(m_source.data() + start, m_source.data() + m_source.size()));
+            }
+
+            m_index = start;
+            tokens.truncate(count);
+            tokens.line_starts.resize(lines);
+            advance_to(stop);
+            push(TypeOfToken::ERROR, start);
+            return stop;
+      }
+
+  public:
+      std::optional<LexerError> tokenize() {
+            if (m_source.size() > max_source_size)
+                  return LexerError::source_too_large;
+            if (const std::optional<LexerError> err = lex_window())
+                  return err;
 
-            tokens.emplace_back(TypeOfToken::T_EOF, "[eof]", m_line, m_column);
+            push(TypeOfToken::T_EOF, m_index);
             return std::nullopt;
       }
+
+      // tokenize() that doesn't stop at an error: each one is reported to `diagnostics` (.report(LexerError, offset,
+      // length)), its text becomes an ERROR token and lexing goes on, so the stream always ends in T_EOF. Returns the
+      // first error.
+      template<typename Diagnostics>
+      std::optional<LexerError> tokenize(Diagnostics& diagnostics) {
+            if (m_source.size() > max_source_size) {
+                  diagnostics.report(LexerError::source_too_large, 0, 0);
+                  push(TypeOfToken::T_EOF, 0);
+                  return LexerError::source_too_large;
+            }
+            std::optional<LexerError> first;
+            while (m_index < m_source.size()) {
+                  const size_t start = m_index;
+                  const size_t count = tokens.size();
+                  const size_t lines = tokens.line_starts.size();
+                  if (const std::optional<LexerError> err = lex_token()) {
+                        const size_t stop = skip_error(*err, start, count, lines);
+                        diagnostics.report(*err, m_base + start, stop - start);
+                        if (!first)
+                              first = err;
+                  }
+            }
+
+            push(TypeOfToken::T_EOF, m_index);
+            return first;
+      }
+};
+
+// Lexes an input that is read piece by piece (a pipe, or a file too large to want in memory twice) in fixed-size
+// chunks. Tokens are handed to the sink once per chunk and view the chunk buffer, so their values are only valid during
+// that call; offsets and locations are those in the whole input. A token crossing a chunk boundary is carried over to
+// the next chunk whole, so it is never split.
+class StreamLexer {
+      size_t m_chunk_size;
+      size_t m_max_size;
+      std::vector<char> m_window;
+
+  public:
+      // Inputs longer than `max_size` end in source_too_large once that much has been read.
+      explicit StreamLexer(const size_t chunk_size = 64 * 1024, const size_t max_size = max_source_size)
+          : m_chunk_size(chunk_size == 0 ? 1 : chunk_size), m_max_size(std::min(max_size, max_source_size)) {}
+
+      // read: size_t(char* buf, size_t capacity), returning 0 at the end of the input.
+      // sink: void(const TokenStream&), the final call ends with the T_EOF token.
+      template<typename Read, typename Sink>
+      std::optional<LexerError> tokenize(Read&& read, Sink&& sink) {
+            Lexer lexer{std::string_view{}};
+            size_t filled = 0;
+            bool eof = false;
+
+            while (true) {
+                  if (m_window.size() < filled + m_chunk_size)
+                        m_window.resize(filled + m_chunk_size);
+                  const size_t n = read(m_window.data() + filled, m_chunk_size);
+                  eof = n == 0;
+                  filled += n;
+                  if (lexer.m_base + filled > m_max_size)
+                        return LexerError::source_too_large;
+
+                  lexer.m_source = std::string_view(m_window.data(), filled);
+                  lexer.m_index = 0;
+                  lexer.m_final = eof;
+                  lexer.tokens.source = lexer.m_source;
+                  lexer.tokens.base = static_cast<uint32_t>(lexer.m_base);
+                  lexer.tokens.clear();
+
+                  if (const std::optional<LexerError> err = lexer.lex_window())
+                        return err;
+                  if (eof)
+                        lexer.push(TypeOfToken::T_EOF, lexer.m_index);
+                  if (!lexer.tokens.empty())
+                        sink(std::as_const(lexer.tokens));
+                  if (eof)
+                        return std::nullopt;
+
+                  // keep the unfinished token, the next chunk gets appended to it
+                  std::copy(m_window.begin() + static_cast<std::ptrdiff_t>(lexer.m_index),
+                            m_window.begin() + static_cast<std::ptrdiff_t>(filled), m_window.begin());
+                  filled -= lexer.m_index;
+                  lexer.m_base += lexer.m_index;
+                  // its interned literals were only referenced by tokens the sink has already seen
+                  lexer.m_decoded.clear();
+            }
+      }
 };
@@ -0,0 +1,544 @@
+#pragma once
+#if !NANO_ENABLE_LLVM
+#error "llvm_backend.hpp needs LLVM: configure with -DNANO_ENABLE_LLVM=ON"
+#endif
+
+#include <csetjmp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+#include "./ir.hpp"
+#include "./thread_pool.hpp"
+#include "./value.hpp"
+
+enum class LlvmError {
+      no_target,
+      invalid_module,
+      cannot_write,
+      cannot_emit,
+      jit_failed,
+      division_by_zero,
+};
+
+constexpr std::string_view llvm_error_to_str(LlvmError e) {
+      switch (e) {
+            case LlvmError::no_target:
+                  return "LLVM has no target for this machine";
+            case LlvmError::invalid_module:
+                  return "generated LLVM IR doesn't verify";
+            case LlvmError::cannot_write:
+                  return "cannot write object file";
+            case LlvmError::cannot_emit:
+                  return "LLVM cannot emit an object file for this target";
+            case LlvmError::jit_failed:
+                  return "JIT compilation failed";
+            case LlvmError::division_by_zero:
+                  return "division by zero";
+      }
+      return "unknown LLVM error";
+}
+
+// Lowers an ir::Module to LLVM IR, all of it or some of its functions, so a module can be split over several LLVM
+// modules and compiled in parallel. Functions are `nano.<name>`, the top-level statements `nano.main`; every
+// symbol is external so the pieces link against each other. INT is i64, FLOAT double, BOOL i1; a STRING is the
+// index of its text in the module's table (literals are the only strings, and equal ones share one index) and NULL
+// is an i64 0.
+class LlvmLowering {
+      const ir::Module& m_ir;
+      llvm::LLVMContext& m_ctx;
+      llvm::Module& m_module;
+      llvm::IRBuilder<> m_builder;
+      std::vector<llvm::Function*> m_functions;
+      std::vector<llvm::GlobalVariable*> m_globals;
+      // each string index's first index with the same text
+      std::vector<int64_t> m_strings;
+      llvm::Function* m_trap = nullptr;
+
+  public:
+      static constexpr std::string_view trap_name = "nano.division_by_zero";
+
+      // `owns_globals`: this piece defines the globals, the others only declare them
+      LlvmLowering(const ir::Module& ir, llvm::Module& module, const bool owns_globals) :
+          m_ir(ir), m_ctx(module.getContext()), m_module(module), m_builder(m_ctx) {
+            for (size_t i = 0; i < ir.strings.size(); i++) {
+                  size_t first = i;
+                  for (size_t j = 0; j < i; j++) {
+                        if (ir.strings[j] == ir.strings[i]) {
+                              first = j;
+                              break;
+                        }
+                  }
+                  m_strings.push_back(static_cast<int64_t>(first));
+            }
+
+            for (const ir::Function& fn : ir.functions) {
+                  std::vector<llvm::Type*> params;
+                  for (const Type t : fn.params)
+                        params.push_back(type(t));
+                  const bool entry = &fn == &ir.functions[ir.entry];
+                  const std::string name = entry ? "nano.main" : "nano." + std::string(fn.name);
+                  m_functions.push_back(llvm::Function::Create(llvm::FunctionType::get(type(fn.result), params, false),
+                                                               llvm::Function::ExternalLinkage, name, m_module));
+            }
+            for (size_t i = 0; i < ir.globals.size(); i++) {
+                  llvm::Type* t = type(ir.globals[i]);
+                  llvm::Constant* init = owns_globals ? llvm::Constant::getNullValue(t) : nullptr;
+                  m_globals.push_back(new llvm::GlobalVariable(m_module, t, false, llvm::GlobalValue::ExternalLinkage,
+                                                               init, "nano.global." + std::to_string(i)));
+            }
+            m_trap = llvm::Function::Create(llvm::FunctionType::get(m_builder.getVoidTy(), false),
+                                            llvm::Function::ExternalLinkage, std::string(trap_name), m_module);
+            m_trap->setDoesNotReturn();
+      }
+
+      llvm::Type* type(const Type t) {
+            switch (t) {
+                  case Type::FLOAT:
+                        return m_builder.getDoubleTy();
+                  case Type::BOOL:
+                        return m_builder.getInt1Ty();
+                  default:
+                        return m_builder.getInt64Ty();
+            }
+      }
+
+      void define(const uint32_t index) {
+            const ir::Function& fn = m_ir.functions[index];
+            llvm::Function* f = m_functions[index];
+            std::vector<llvm::BasicBlock*> blocks, ends(fn.blocks.size(), nullptr);
+            for (ir::BlockId b = 0; b < fn.blocks.size(); b++)
+                  blocks.push_back(llvm::BasicBlock::Create(m_ctx, "b" + std::to_string(b), f));
+            llvm::BasicBlock* trap = nullptr;
+
+            std::vector<llvm::Value*> values(fn.values.size(), nullptr);
+            std::vector<ir::ValueId> phis;
+            // dominators first, so every operand but a phi's is lowered before its use
+            for (const ir::BlockId b : ir::reverse_postorder(fn)) {
+                  m_builder.SetInsertPoint(blocks[b]);
+                  for (const ir::ValueId id : fn.blocks[b].insts) {
+                        const ir::Inst& inst = fn.values[id];
+                        const auto at = [&](const size_t k) { return values[inst.operands[k]]; };
+                        const Type operand_type =
+                                inst.operands.empty() ? Type::NULL_T : fn.values[inst.operands[0]].type;
+                        const bool real = operand_type == Type::FLOAT;
+                        llvm::Value* v = nullptr;
+                        switch (inst.op) {
+                              case ir::Opcode::param:
+                                    v = f->getArg(static_cast<unsigned>(inst.integer));
+                                    break;
+                              case ir::Opcode::constant:
+                                    if (inst.type == Type::FLOAT)
+                                          v = llvm::ConstantFP::get(m_builder.getDoubleTy(), inst.real);
+                                    else if (inst.type == Type::STRING)
+                                          v = m_builder.getInt64(
+                                                  static_cast<uint64_t>(m_strings[static_cast<size_t>(inst.integer)]));
+                                    else
+                                          v = llvm::ConstantInt::get(type(inst.type),
+                                                                     static_cast<uint64_t>(inst.integer));
+                                    break;
+                              case ir::Opcode::copy:
+                                    v = at(0);
+                                    break;
+                              case ir::Opcode::phi:
+                                    v = m_builder.CreatePHI(type(inst.type),
+                                                            static_cast<unsigned>(inst.operands.size()));
+                                    phis.push_back(id);
+                                    break;
+                              case ir::Opcode::add:
+                                    v = real ? m_builder.CreateFAdd(at(0), at(1)) : m_builder.CreateAdd(at(0), at(1));
+                                    break;
+                              case ir::Opcode::sub:
+                                    v = real ? m_builder.CreateFSub(at(0), at(1)) : m_builder.CreateSub(at(0), at(1));
+                                    break;
+                              case ir::Opcode::mul:
+                                    v = real ? m_builder.CreateFMul(at(0), at(1)) : m_builder.CreateMul(at(0), at(1));
+                                    break;
+                              case ir::Opcode::div:
+                                    if (real) {
+                                          v = m_builder.CreateFDiv(at(0), at(1));
+                                          break;
+                                    }
+                                    if (!trap) {
+                                          const llvm::IRBuilderBase::InsertPointGuard guard(m_builder);
+                                          trap = llvm::BasicBlock::Create(m_ctx, "division_by_zero", f);
+                                          m_builder.SetInsertPoint(trap);
+                                          m_builder.CreateCall(m_trap);
+                                          m_builder.CreateUnreachable();
+                                    }
+                                    v = divide(at(0), at(1), trap, f);
+                                    break;
+                              case ir::Opcode::bit_and:
+                                    v = m_builder.CreateAnd(at(0), at(1));
+                                    break;
+                              case ir::Opcode::bit_or:
+                                    v = m_builder.CreateOr(at(0), at(1));
+                                    break;
+                              case ir::Opcode::neg:
+                                    v = real ? m_builder.CreateFNeg(at(0)) : m_builder.CreateNeg(at(0));
+                                    break;
+                              case ir::Opcode::logical_not:
+                                    v = m_builder.CreateNot(at(0));
+                                    break;
+                              case ir::Opcode::lt:
+                              case ir::Opcode::le:
+                              case ir::Opcode::gt:
+                              case ir::Opcode::ge:
+                              case ir::Opcode::eq:
+                              case ir::Opcode::ne:
+                                    v = m_builder.CreateCmp(predicate(inst.op, real), at(0), at(1));
+                                    break;
+                              case ir::Opcode::call: {
+                                    std::vector<llvm::Value*> args;
+                                    for (const ir::ValueId arg : inst.operands)
+                                          args.push_back(values[arg]);
+                                    v = m_builder.CreateCall(m_functions[static_cast<size_t>(inst.integer)], args);
+                                    break;
+                              }
+                              case ir::Opcode::get_global: {
+                                    llvm::GlobalVariable* g = m_globals[static_cast<size_t>(inst.integer)];
+                                    v = m_builder.CreateLoad(g->getValueType(), g);
+                                    break;
+                              }
+                              case ir::Opcode::set_global:
+                                    m_builder.CreateStore(at(0), m_globals[static_cast<size_t>(inst.integer)]);
+                                    break;
+                              case ir::Opcode::jump:
+                                    m_builder.CreateBr(blocks[inst.target[0]]);
+                                    break;
+                              case ir::Opcode::branch:
+                                    m_builder.CreateCondBr(at(0), blocks[inst.target[0]], blocks[inst.target[1]]);
+                                    break;
+                              case ir::Opcode::ret:
+                                    m_builder.CreateRet(at(0));
+                                    break;
+                        }
+                        values[id] = v;
+                  }
+                  // a division splits the block, the phis of its successors come from the last piece
+                  ends[b] = m_builder.GetInsertBlock();
+            }
+
+            for (const ir::ValueId id : phis) {
+                  const ir::Inst& inst = fn.values[id];
+                  auto* phi = llvm::cast<llvm::PHINode>(values[id]);
+                  for (size_t k = 0; k < inst.operands.size(); k++)
+                        phi->addIncoming(values[inst.operands[k]], ends[fn.blocks[inst.block].preds[k]]);
+            }
+      }
+
+      // A C `main` that runs the top-level statements and prints their value like `Nano --run` does, and the handler
+      // for a division by zero, so an object file with every piece links into a program on its own.
+      void define_main() {
+            llvm::Type* i32 = m_builder.getInt32Ty();
+            llvm::Type* ptr = m_builder.getInt8PtrTy();
+            const llvm::FunctionCallee printf =
+                    m_module.getOrInsertFunction("printf", llvm::FunctionType::get(i32, {ptr}, true));
+            const llvm::FunctionCallee puts =
+                    m_module.getOrInsertFunction("puts", llvm::FunctionType::get(i32, {ptr}, false));
+            const llvm::FunctionCallee exit =
+                    m_module.getOrInsertFunction("exit", llvm::FunctionType::get(m_builder.getVoidTy(), {i32}, false));
+
+            m_builder.SetInsertPoint(llvm::BasicBlock::Create(m_ctx, "", m_trap));
+            m_builder.CreateCall(puts, {m_builder.CreateGlobalStringPtr("division by zero")});
+            m_builder.CreateCall(exit, {m_builder.getInt32(1)});
+            m_builder.CreateUnreachable();
+
+            llvm::Function* main = llvm::Function::Create(llvm::FunctionType::get(i32, false),
+                                                          llvm::Function::ExternalLinkage, "main", m_module);
+            m_builder.SetInsertPoint(llvm::BasicBlock::Create(m_ctx, "", main));
+            llvm::Value* result = m_builder.CreateCall(m_functions[m_ir.entry]);
+            switch (m_ir.functions[m_ir.entry].result) {
+                  case Type::INT:
+                        m_builder.CreateCall(printf, {m_builder.CreateGlobalStringPtr("%lld\n"), result});
+                        break;
+                  case Type::FLOAT:
+                        m_builder.CreateCall(printf, {m_builder.CreateGlobalStringPtr("%g\n"), result});
+                        break;
+                  case Type::BOOL:
+                        m_builder.CreateCall(puts, {m_builder.CreateSelect(result,
+                                                                           m_builder.CreateGlobalStringPtr("true"),
+                                                                           m_builder.CreateGlobalStringPtr("false"))});
+                        break;
+                  case Type::STRING: {
+                        std::vector<llvm::Constant*> texts;
+                        for (const std::string_view s : m_ir.strings)
+                              texts.push_back(m_builder.CreateGlobalStringPtr(llvm::StringRef(s.data(), s.size())));
+                        auto* table_type = llvm::ArrayType::get(ptr, texts.size());
+                        auto* table = new llvm::GlobalVariable(m_module, table_type, true,
+                                                               llvm::GlobalValue::PrivateLinkage,
+                                                               llvm::ConstantArray::get(table_type, texts));
+                        llvm::Value* text = m_builder.CreateLoad(
+                                ptr, m_builder.CreateInBoundsGEP(table_type, table, {m_builder.getInt64(0), result}));
+                        m_builder.CreateCall(puts, {text});
+                        break;
+                  }
+                  default:
+                        m_builder.CreateCall(puts, {m_builder.CreateGlobalStringPtr("null")});
+                        break;
+            }
+            m_builder.CreateRet(m_builder.getInt32(0));
+      }
+
+  private:
+      static llvm::CmpInst::Predicate predicate(const ir::Opcode op, const bool real) {
+            using P = llvm::CmpInst::Predicate;
+            switch (op) {
+                  case ir::Opcode::lt:
+                        return real ? P::FCMP_OLT : P::ICMP_SLT;
+                  case ir::Opcode::le:
+                        return real ? P::FCMP_OLE : P::ICMP_SLE;
+                  case ir::Opcode::gt:
+                        return real ? P::FCMP_OGT : P::ICMP_SGT;
+                  case ir::Opcode::ge:
+                        return real ? P::FCMP_OGE : P::ICMP_SGE;
+                  case ir::Opcode::eq:
+                        return real ? P::FCMP_OEQ : P::ICMP_EQ;
+                  default:
+                        // unordered, so NaN != NaN like everywhere else
+                        return real ? P::FCMP_UNE : P::ICMP_NE;
+            }
+      }
+
+      // x / y the way the VM does it: a zero y traps, and INT64_MIN / -1 wraps instead of being undefined.
+      llvm::Value* divide(llvm::Value* x, llvm::Value* y, llvm::BasicBlock* trap, llvm::Function* f) {
+            llvm::BasicBlock* ok = llvm::BasicBlock::Create(m_ctx, "", f);
+            m_builder.CreateCondBr(m_builder.CreateICmpEQ(y, m_builder.getInt64(0)), trap, ok);
+            m_builder.SetInsertPoint(ok);
+            llvm::Value* minus_one = m_builder.CreateICmpEQ(y, m_builder.getInt64(static_cast<uint64_t>(-1)));
+            llvm::Value* q = m_builder.CreateSDiv(x, m_builder.CreateSelect(minus_one, m_builder.getInt64(1), y));
+            return m_builder.CreateSelect(minus_one, m_builder.CreateNeg(x), q);
+      }
+};
+
+// Native code for an ir::Module: object files, or running it in process with ORC's LLJIT. `opt_level` is 0 to 3,
+// like -O0 to -O3.
+class LlvmBackend {
+      // where a JIT-compiled division by zero jumps back to, for the thread running it
+      static inline thread_local std::jmp_buf* t_trap = nullptr;
+
+  public:
+      LlvmBackend() {
+            static std::once_flag once;
+            std::call_once(once, [] {
+                  llvm::InitializeNativeTarget();
+                  llvm::InitializeNativeTargetAsmPrinter();
+                  llvm::InitializeNativeTargetAsmParser();
+            });
+      }
+
+      // The module as LLVM IR text, after optimizing it.
+      std::optional<LlvmError> ir_text(const ir::Module& module, const unsigned opt_level, std::string& out) const {
+            llvm::LLVMContext ctx;
+            llvm::Module m("nano", ctx);
+            lower(module, m, 0, 1);
+            std::unique_ptr<llvm::TargetMachine> tm = target_machine(opt_level);
+            if (!tm)
+                  return LlvmError::no_target;
+            if (const std::optional<LlvmError> err = optimize(m, *tm, opt_level))
+                  return err;
+            llvm::raw_string_ostream os(out);
+            m.print(os, nullptr);
+            return std::nullopt;
+      }
+
+      // Writes `path` and, with jobs > 1, `path`.1 to `path`.(jobs - 1): the functions are dealt out over that many
+      // LLVM modules, each lowered, optimized and compiled on its own thread. Cross-module inlining is lost, but the
+      // IR passes already inlined the small functions. Linking all of them (with libc) gives a program.
+      std::optional<LlvmError> emit_objects(const ir::Module& module, const std::string& path, const unsigned opt_level,
+                                            size_t jobs, std::vector<std::string>& written) const {
+            jobs = std::max<size_t>(1, std::min(jobs, module.functions.size()));
+            written.clear();
+            for (size_t k = 0; k < jobs; k++)
+                  written.push_back(k == 0 ? path : path + "." + std::to_string(k));
+
+            std::vector<std::optional<LlvmError>> errors(jobs);
+            const auto piece = [&](const size_t k) {
+                  llvm::LLVMContext ctx;
+                  llvm::Module m("nano." + std::to_string(k), ctx);
+                  std::unique_ptr<llvm::TargetMachine> tm = target_machine(opt_level);
+                  if (!tm) {
+                        errors[k] = LlvmError::no_target;
+                        return;
+                  }
+                  lower(module, m, k, jobs);
+                  if (!(errors[k] = optimize(m, *tm, opt_level)))
+                        errors[k] = emit(m, *tm, written[k]);
+            };
+            if (jobs == 1) {
+                  piece(0);
+            } else {
+                  ThreadPool pool(jobs);
+                  for (size_t k = 0; k < jobs; k++)
+                        pool.submit([&piece, k](size_t) { piece(k); });
+                  pool.wait();
+            }
+            for (const std::optional<LlvmError>& err : errors) {
+                  if (err)
+                        return err;
+            }
+            return std::nullopt;
+      }
+
+      // Compiles the module in process and runs its top-level statements.
+      std::optional<LlvmError> run(const ir::Module& module, const unsigned opt_level, Value& out) const {
+            auto ctx = std::make_unique<llvm::LLVMContext>();
+            auto m = std::make_unique<llvm::Module>("nano", *ctx);
+            lower(module, *m, 0, 1, false);
+
+            llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit = llvm::orc::LLJITBuilder().create();
+            if (!jit) {
+                  llvm::consumeError(jit.takeError());
+                  return LlvmError::jit_failed;
+            }
+            m->setDataLayout((*jit)->getDataLayout());
+            std::unique_ptr<llvm::TargetMachine> tm = target_machine(opt_level);
+            if (!tm)
+                  return LlvmError::no_target;
+            if (const std::optional<LlvmError> err = optimize(*m, *tm, opt_level))
+                  return err;
+
+            llvm::orc::JITDylib& lib = (*jit)->getMainJITDylib();
+            llvm::orc::SymbolMap handler;
+            handler[(*jit)->mangleAndIntern(LlvmLowering::trap_name)] =
+                    llvm::JITEvaluatedSymbol::fromPointer(&division_by_zero);
+            if (llvm::Error err = lib.define(llvm::orc::absoluteSymbols(std::move(handler)))) {
+                  llvm::consumeError(std::move(err));
+                  return LlvmError::jit_failed;
+            }
+            if (llvm::Error err = (*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(m), std::move(ctx)))) {
+                  llvm::consumeError(std::move(err));
+                  return LlvmError::jit_failed;
+            }
+            llvm::Expected<llvm::JITEvaluatedSymbol> entry = (*jit)->lookup("nano.main");
+            if (!entry) {
+                  llvm::consumeError(entry.takeError());
+                  return LlvmError::jit_failed;
+            }
+
+            const Type result = module.functions[module.entry].result;
+            const uint64_t address = entry->getAddress();
+            std::jmp_buf trap;
+            std::jmp_buf* const outer = t_trap;
+            t_trap = &trap;
+            // nothing between here and the JIT-compiled code has a destructor for the longjmp to skip
+            if (setjmp(trap) != 0) {
+                  t_trap = outer;
+                  return LlvmError::division_by_zero;
+            }
+            switch (result) {
+                  case Type::FLOAT:
+                        out = Value::of(reinterpret_cast<double (*)()>(address)());
+                        break;
+                  case Type::BOOL:
+                        // only the low bit of an i1 return is defined
+                        out = Value::of((reinterpret_cast<uint8_t (*)()>(address)() & 1) != 0);
+                        break;
+                  case Type::STRING: {
+                        const auto index = static_cast<size_t>(reinterpret_cast<int64_t (*)()>(address)());
+                        out = Value::of(module.strings[index]);
+                        break;
+                  }
+                  case Type::INT:
+                        out = Value::of(reinterpret_cast<int64_t (*)()>(address)());
+                        break;
+                  default:
+                        reinterpret_cast<int64_t (*)()>(address)();
+                        out = {};
+                        break;
+            }
+            t_trap = outer;
+            return std::nullopt;
+      }
+
+  private:
+      [[noreturn]] static void division_by_zero() { std::longjmp(*t_trap, 1); }
+
+      // Piece `k` of `pieces`: the functions whose index is k modulo pieces, and with them all the declarations.
+      // Piece 0 also defines the globals and, for an object file, main.
+      static void lower(const ir::Module& module, llvm::Module& m, const size_t k, const size_t pieces,
+                        const bool with_main = true) {
+            LlvmLowering lowering(module, m, k == 0);
+            for (uint32_t f = 0; f < module.functions.size(); f++) {
+                  if (f % pieces == k)
+                        lowering.define(f);
+            }
+            if (k == 0 && with_main)
+                  lowering.define_main();
+      }
+
+      static std::unique_ptr<llvm::TargetMachine> target_machine(const unsigned opt_level) {
+            const std::string triple = llvm::sys::getProcessTriple();
+            std::string error;
+            const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+            if (!target)
+                  return nullptr;
+            const llvm::CodeGenOpt::Level level = opt_level == 0   ? llvm::CodeGenOpt::None
+                                                  : opt_level == 1 ? llvm::CodeGenOpt::Less
+                                                  : opt_level == 2 ? llvm::CodeGenOpt::Default
+                                                                   : llvm::CodeGenOpt::Aggressive;
+            return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+                    triple, llvm::sys::getHostCPUName(), "", llvm::TargetOptions(), llvm::Reloc::PIC_, llvm::None,
+                    level));
+      }
+
+      static std::optional<LlvmError> optimize(llvm::Module& m, llvm::TargetMachine& tm, const unsigned opt_level) {
+            m.setTargetTriple(tm.getTargetTriple().str());
+            m.setDataLayout(tm.createDataLayout());
+            if (llvm::verifyModule(m, &llvm::errs()))
+                  return LlvmError::invalid_module;
+
+            llvm::LoopAnalysisManager lam;
+            llvm::FunctionAnalysisManager fam;
+            llvm::CGSCCAnalysisManager cgam;
+            llvm::ModuleAnalysisManager mam;
+            llvm::PassBuilder builder(&tm);
+            builder.registerModuleAnalyses(mam);
+            builder.registerCGSCCAnalyses(cgam);
+            builder.registerFunctionAnalyses(fam);
+            builder.registerLoopAnalyses(lam);
+            builder.crossRegisterProxies(lam, fam, cgam, mam);
+            const llvm::OptimizationLevel level = opt_level == 0   ? llvm::OptimizationLevel::O0
+                                                  : opt_level == 1 ? llvm::OptimizationLevel::O1
+                                                  : opt_level == 2 ? llvm::OptimizationLevel::O2
+                                                                   : llvm::OptimizationLevel::O3;
+            llvm::ModulePassManager passes = opt_level == 0 ? builder.buildO0DefaultPipeline(level)
+                                                            : builder.buildPerModuleDefaultPipeline(level);
+            passes.run(m, mam);
+            return std::nullopt;
+      }
+
+      static std::optional<LlvmError> emit(llvm::Module& m, llvm::TargetMachine& tm, const std::string& path) {
+            std::error_code ec;
+            llvm::raw_fd_ostream out(path, ec, llvm::sys::fs::OF_None);
+            if (ec)
+                  return LlvmError::cannot_write;
+            llvm::legacy::PassManager passes;
+            if (tm.addPassesToEmitFile(passes, out, nullptr, llvm::CGFT_ObjectFile))
+                  return LlvmError::cannot_emit;
+            passes.run(m);
+            out.flush();
+            return out.has_error() ? std::optional{LlvmError::cannot_write} : std::nullopt;
+      }
+};
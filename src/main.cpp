@@ -1,7 +1,395 @@
-#include <stdio.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "bytecode.hpp"
+#include "comptime.hpp"
+#include "diagnostics.hpp"
+#include "driver.hpp"
 #include "lexer.hpp"
+#include "parallel_lexer.hpp"
+#include "remote_cache.hpp"
+#include "sema.hpp"
+#include "server.hpp"
+#include "source.hpp"
+#include "stats.hpp"
+#include "vm.hpp"
+#if NANO_ENABLE_LLVM
+#include "ir.hpp"
+#include "llvm_backend.hpp"
+#include "passes.hpp"
+#endif
 
-int main() {
-      puts("Hello, world!");
+static int lex_stream(const char* path) {
+      FileReader reader(path);
+      if (!reader.is_open()) {
+            std::fprintf(stderr, "%s: %s\n", path, source_error_to_str(SourceError::cannot_open).data());
+            return 1;
+      }
+
+      size_t count = 0;
+      if (const std::optional<LexerError> err =
+              StreamLexer().tokenize(reader, [&](const TokenStream& tokens) { count += tokens.size(); })) {
+            std::fprintf(stderr, "%s: %s\n", path, lexer_error_to_str(*err).data());
+            return 1;
+      }
+      std::printf("%s: %zu tokens\n", path, count);
+      return 0;
+}
+
+// One large file, lexed in pieces on every core.
+static int lex_split(const char* path, ThreadPool& pool) {
+      SourceBuffer source;
+      if (const std::optional<SourceError> err = source.load(path)) {
+            std::fprintf(stderr, "%s: %s\n", path, source_error_to_str(*err).data());
+            return 1;
+      }
+
+      Lexer lexer(source.view());
+      if (const std::optional<LexerError> err = ParallelLexer::tokenize(lexer, pool)) {
+            std::fprintf(stderr, "%s: %s\n", path, lexer_error_to_str(*err).data());
+            return 1;
+      }
+      std::printf("%s: %zu tokens\n", path, lexer.tokens.size());
+      return 0;
+}
+
+static void print_value(const Value& value) {
+      switch (value.type) {
+            case Type::INT:
+                  std::printf("%" PRId64 "\n", value.integer);
+                  break;
+            case Type::FLOAT:
+                  std::printf("%g\n", value.real);
+                  break;
+            case Type::BOOL:
+                  std::puts(value.boolean ? "true" : "false");
+                  break;
+            case Type::STRING:
+                  std::printf("%.*s\n", static_cast<int>(value.string.size()), value.string.data());
+                  break;
+            default:
+                  std::puts("null");
+                  break;
+      }
+}
+
+struct RunOptions {
+      // compile to native code and run that instead of bytecode
+      bool jit = false;
+      // write object files instead of running
+      const char* object = nullptr;
+      unsigned opt_level = 2;
+      size_t jobs = 1;
+      Stats* stats = nullptr;
+};
+
+#if NANO_ENABLE_LLVM
+static int run_native(const char* path, const std::vector<ASTNode*>& ast, const RunOptions& options,
+                      const Stats::File* file) {
+      ir::Module module;
+      {
+            const PhaseTimer timer(options.stats, Phase::ir, file);
+            ir::Builder builder(module);
+            if (const std::optional<CompileError> err = builder.build(ast)) {
+                  std::fprintf(stderr, "%s: in %.*s: %s\n", path, static_cast<int>(builder.error_function.size()),
+                               builder.error_function.data(), compile_error_to_str(*err).data());
+                  return 1;
+            }
+            ThreadPool pool(options.jobs);
+            if (options.opt_level > 0)
+                  ir::PassManager::standard(&pool).run(module);
+      }
+
+      // the JIT runs the program right after compiling it, so for --jit this is both
+      const PhaseTimer timer(options.stats, Phase::codegen, file);
+      const LlvmBackend backend;
+      if (options.object) {
+            std::vector<std::string> written;
+            if (const std::optional<LlvmError> err =
+                        backend.emit_objects(module, options.object, options.opt_level, options.jobs, written)) {
+                  std::fprintf(stderr, "%s: %s\n", path, llvm_error_to_str(*err).data());
+                  return 1;
+            }
+            for (const std::string& object : written)
+                  std::printf("%s\n", object.c_str());
+            return 0;
+      }
+      Value result;
+      if (const std::optional<LlvmError> err = backend.run(module, options.opt_level, result)) {
+            std::fprintf(stderr, "%s: %s\n", path, llvm_error_to_str(*err).data());
+            return 1;
+      }
+      print_value(result);
       return 0;
 }
+#endif
+
+// Compiles one file and runs its top-level statements, printing the value of the last one: as bytecode, or as
+// native code (or object files) with the LLVM backend.
+static int run(const char* path, const RunOptions& options) {
+      Stats::File* const file = stats_enabled && options.stats ? options.stats->file(path) : nullptr;
+      SourceBuffer source;
+      {
+            const PhaseTimer timer(options.stats, Phase::read, file);
+            if (const std::optional<SourceError> err = source.load(path)) {
+                  std::fprintf(stderr, "%s: %s\n", path, source_error_to_str(*err).data());
+                  return 1;
+            }
+      }
+
+      Lexer lexer(source.view());
+      Diagnostics diagnostics;
+      {
+            const PhaseTimer timer(options.stats, Phase::lex, file);
+            lexer.tokenize(diagnostics);
+      }
+      Context ctx;
+      std::vector<ASTNode*> ast;
+      {
+            const PhaseTimer timer(options.stats, Phase::parse, file);
+            Parser parser(lexer.tokens, ctx, diagnostics);
+            parser.fold_constants = true;
+            ast = parser.parse();
+      }
+      const size_t before = diagnostics.size();
+      {
+            const PhaseTimer timer(options.stats, Phase::sema, file);
+            std::optional<ThreadPool> pool;
+            if (options.jobs > 1)
+                  pool.emplace(options.jobs);
+            TypeChecker(lexer.tokens, diagnostics, pool ? &*pool : nullptr).check(ast);
+      }
+      if (diagnostics.size() == before) {
+            const PhaseTimer timer(options.stats, Phase::comptime, file);
+            Interpreter(ctx, &diagnostics).run(ast);
+      }
+      if (file) {
+            file->tokens = lexer.tokens.size();
+            file->nodes = Flattener().flatten(ast).nodes.size();
+            file->names = lexer.tokens.names.size();
+            file->name_slots = lexer.tokens.names.slots();
+            options.stats->arena(0, ctx.arena.bytes_used(), ctx.arena.bytes_reserved());
+      }
+      if (!diagnostics.empty()) {
+            diagnostics.sort();
+            for (const Diagnostic& d : diagnostics.list())
+                  std::fprintf(stderr, "%s\n", format_diagnostic(path, d, lexer.tokens).c_str());
+            return 1;
+      }
+
+      if (options.jit || options.object) {
+#if NANO_ENABLE_LLVM
+            return run_native(path, ast, options, file);
+#else
+            std::fprintf(stderr, "%s: this Nano was built without the LLVM backend (NANO_ENABLE_LLVM)\n", path);
+            return 1;
+#endif
+      }
+
+      Program program;
+      {
+            const PhaseTimer timer(options.stats, Phase::ir, file);
+            BytecodeCompiler compiler(program);
+            if (const std::optional<CompileError> err = compiler.compile(ast)) {
+                  std::fprintf(stderr, "%s: in %.*s: %s\n", path, static_cast<int>(compiler.error_function.size()),
+                               compiler.error_function.data(), compile_error_to_str(*err).data());
+                  return 1;
+            }
+      }
+      Value result;
+      {
+            const PhaseTimer timer(options.stats, Phase::run, file);
+            if (const std::optional<RuntimeError> err = VM(program).run(result)) {
+                  std::fprintf(stderr, "%s: %s\n", path, runtime_error_to_str(*err).data());
+                  return 1;
+            }
+      }
+      print_value(result);
+      return 0;
+}
+
+// Lexes and parses every file (and whatever they import) on `jobs` threads.
+static int compile(const std::vector<const char*>& paths, const size_t jobs, const char* cache, const char* remote,
+                   Stats* stats) {
+      Driver driver(jobs);
+      if (cache)
+            driver.use_cache(cache);
+      if (remote) {
+            std::optional<RemoteCache> client = RemoteCache::connect(remote);
+            if (!client || !cache) {
+                  std::fprintf(stderr, "%s: --remote-cache needs an http:// URL and --cache DIR\n", remote);
+                  return 1;
+            }
+            driver.use_remote_cache(std::move(*client));
+      }
+      if (stats)
+            driver.collect_stats(*stats);
+      for (const char* path : paths)
+            driver.add(path);
+      driver.wait();
+
+      std::vector<const Module*> modules;
+      for (const auto& [path, module] : driver.modules())
+            modules.push_back(module.get());
+      std::ranges::sort(modules, {}, &Module::path);
+
+      int status = 0;
+      for (const Module* module : modules) {
+            const char* path = module->path.c_str();
+            if (module->source_error) {
+                  std::fprintf(stderr, "%s: %s\n", path, source_error_to_str(*module->source_error).data());
+                  status = 1;
+            } else if (!module->diagnostics.empty()) {
+                  for (const Diagnostic& d : module->diagnostics.list())
+                        std::fprintf(stderr, "%s\n", format_diagnostic(path, d, module->lexer->tokens).c_str());
+                  status = 1;
+            } else {
+                  std::printf("%s: %zu tokens, %zu top-level nodes, %zu imports\n", path, module->token_count(),
+                              module->item_count(), module->imports.size());
+            }
+      }
+      return status;
+}
+
+// Serves check requests on `socket` until one asks it to stop.
+static int serve(const char* socket) {
+#if NANO_HAS_SERVER
+      CompileServer server;
+      if (const std::optional<ServerError> err = server.listen(socket)) {
+            std::fprintf(stderr, "%s: %s\n", socket, server_error_to_str(*err).data());
+            return 1;
+      }
+      server.run();
+      return 0;
+#else
+      std::fprintf(stderr, "%s: --server needs epoll and inotify, which this platform doesn't have\n", socket);
+      return 1;
+#endif
+}
+
+// Has the server on `socket` check every file, and prints what it reports the way compile() does.
+static int ask(const char* socket, const std::vector<const char*>& paths) {
+#if NANO_HAS_SERVER
+      int status = 0;
+      for (const char* path : paths) {
+            std::string reply;
+            int checked = 0;
+            if (const std::optional<ServerError> err =
+                    ask_server(socket, "check " + Driver::normalize(path), reply, checked)) {
+                  std::fprintf(stderr, "%s: %s\n", socket, server_error_to_str(*err).data());
+                  return 1;
+            }
+            std::fputs(reply.c_str(), stderr);
+            status |= checked;
+      }
+      return status;
+#else
+      std::fprintf(stderr, "%s: --connect needs epoll and inotify, which this platform doesn't have\n", socket);
+      return 1;
+#endif
+}
+
+int main(int argc, char** argv) {
+      if (argc < 2) {
+            std::puts("usage: Nano [--stream | --split | --run [--jit | --emit-obj FILE] [-O0..-O3]] [--jobs N] "
+                      "[--cache DIR [--remote-cache URL]] [--time-report | --stats] [--trace FILE.json] "
+                      "<file or directory>...\n"
+                      "       Nano --server SOCKET\n"
+                      "       Nano --connect SOCKET <file>...");
+            return 0;
+      }
+
+      bool stream = false;
+      bool split = false;
+      bool execute = false;
+      RunOptions run_options;
+      size_t jobs = std::thread::hardware_concurrency();
+      const char* cache = nullptr;
+      const char* remote = nullptr;
+      bool report = false;
+      const char* trace = nullptr;
+      const char* server = nullptr;
+      const char* connect = nullptr;
+      std::vector<const char*> paths;
+      for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (arg == "--stream") {
+                  stream = true;
+            } else if (arg == "--split") {
+                  split = true;
+            } else if (arg == "--run") {
+                  execute = true;
+            } else if (arg == "--jit") {
+                  run_options.jit = true;
+            } else if (arg == "--emit-obj" && i + 1 < argc) {
+                  run_options.object = argv[++i];
+            } else if (arg.size() == 3 && arg.starts_with("-O") && arg[2] >= '0' && arg[2] <= '3') {
+                  run_options.opt_level = static_cast<unsigned>(arg[2] - '0');
+            } else if (arg == "--jobs" && i + 1 < argc) {
+                  jobs = std::strtoul(argv[++i], nullptr, 10);
+            } else if (arg == "--cache" && i + 1 < argc) {
+                  cache = argv[++i];
+            } else if (arg == "--remote-cache" && i + 1 < argc) {
+                  remote = argv[++i];
+            } else if (arg == "--time-report" || arg == "--stats") {
+                  report = true;
+            } else if (arg == "--trace" && i + 1 < argc) {
+                  trace = argv[++i];
+            } else if (arg == "--server" && i + 1 < argc) {
+                  server = argv[++i];
+            } else if (arg == "--connect" && i + 1 < argc) {
+                  connect = argv[++i];
+            } else {
+                  paths.push_back(argv[i]);
+            }
+      }
+
+      if (server)
+            return serve(server);
+      if (connect)
+            return ask(connect, paths);
+      // streaming only lexes, one file at a time, it's for inputs too large to hold in memory
+      if (stream) {
+            int status = 0;
+            for (const char* path : paths)
+                  status |= lex_stream(path);
+            return status;
+      }
+      // so does splitting, which spends every thread on one file instead of one file per thread
+      if (split) {
+            ThreadPool pool(jobs);
+            int status = 0;
+            for (const char* path : paths)
+                  status |= lex_split(path, pool);
+            return status;
+      }
+      Stats stats;
+      if (report || trace) {
+            if (!stats_enabled) {
+                  std::fprintf(stderr, "this Nano was built without --time-report (NANO_ENABLE_STATS)\n");
+                  return 1;
+            }
+            run_options.stats = &stats;
+      }
+      int status = 0;
+      if (execute) {
+            run_options.jobs = jobs;
+            for (const char* path : paths)
+                  status |= run(path, run_options);
+      } else {
+            status = compile(paths, jobs, cache, remote, run_options.stats);
+      }
+      if (report)
+            stats.print_report(stderr);
+      if (trace && !stats.write_trace(trace)) {
+            std::fprintf(stderr, "%s: %s\n", trace, source_error_to_str(SourceError::cannot_open).data());
+            status = 1;
+      }
+      return status;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <latch>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "./lexer.hpp"
+#include "./scan.hpp"
+#include "./thread_pool.hpp"
+
+namespace split {
+      // characters that can change whether a newline is safe to split at
+      constexpr std::array<bool, 256> interesting = [] {
+            std::array<bool, 256> t{};
+            for (const char c : std::string_view("\"'/\n"))
+                  t[static_cast<unsigned char>(c)] = true;
+            return t;
+      }();
+}
+
+// Where to cut `src` into about `parts` pieces that can be lexed independently: offsets right after a newline that
+// isn't inside a string literal or a block comment, so no token crosses them. The first is always 0. This walks the
+// source once, but only looks at quotes, slashes and newlines, mirroring just enough of lex_token() to know where
+// literals and comments end; everything else is skipped without being classified.
+inline std::vector<size_t> find_split_points(const std::string_view src, const size_t parts) {
+      std::vector<size_t> starts{0};
+      if (parts <= 1 || src.empty())
+            return starts;
+
+      const char* const data = src.data();
+      const char* const end = data + src.size();
+      size_t target = src.size() / parts;
+      const char* p = data;
+      while (p < end && starts.size() < parts) {
+            while (p < end && !split::interesting[static_cast<unsigned char>(*p)])
+                  ++p;
+            if (p == end)
+                  break;
+
+            switch (*p) {
+                  case '\n':
+                        ++p;
+                        if (static_cast<size_t>(p - data) >= target && p < end) {
+                              starts.push_back(static_cast<size_t>(p - data));
+                              target = src.size() / parts * starts.size();
+                        }
+                        break;
+                  case '"':
+                        ++p;
+                        while ((p = scan::find_quote_or_escape(p, end)) != end && *p == '\\')
+                              p = end - p > 2 ? p + 2 : end;
+                        if (p < end)
+                              ++p;
+                        break;
+                  case '\'':
+                        ++p;
+                        if (p < end)
+                              p += *p == '\\' && end - p >= 2 ? 2 : 1;
+                        if (p < end && *p == '\'')
+                              ++p;
+                        break;
+                  default:
+                        ++p;
+                        if (p < end && *p == '/') {
+                              p = scan::find_newline(p, end);
+                        } else if (p < end && *p == '*') {
+                              p = scan::find_comment_close(p + 1, end);
+                              p = end - p >= 2 ? p + 2 : end;
+                        }
+                        break;
+            }
+      }
+      return starts;
+}
+
+// Opt-in parallel tokenize() for one large source: it is cut at find_split_points(), every piece is lexed by its own
+// Lexer on the pool, and the pieces' tokens are stitched back together in order. Offsets and line starts are recorded
+// against the whole source to begin with, so locations need no fixing up; only the per-piece name ids are remapped.
+// The result, errors included, is the same as a sequential tokenize().
+class ParallelLexer {
+  public:
+      // Pieces are at least `min_piece` bytes, so small inputs stay sequential. Must not be called from a pool task.
+      static std::optional<LexerError> tokenize(Lexer& lexer, ThreadPool& pool, const size_t min_piece = 1 << 20) {
+            const std::string_view src = lexer.m_source;
+            if (src.size() > max_source_size)
+                  return LexerError::source_too_large;
+            size_t parts = src.size() / (min_piece == 0 ? 1 : min_piece);
+            if (parts > pool.size())
+                  parts = pool.size();
+            if (parts <= 1 || lexer.m_index != 0 || !lexer.tokens.empty())
+                  return lexer.tokenize();
+
+            const std::vector<size_t> starts = find_split_points(src, parts);
+            std::vector<std::unique_ptr<Lexer>> pieces(starts.size());
+            std::vector<std::optional<LexerError>> errors(starts.size());
+            std::latch done(static_cast<std::ptrdiff_t>(starts.size()));
+            for (size_t i = 0; i < starts.size(); i++) {
+                  const size_t start = starts[i];
+                  const size_t stop = i + 1 < starts.size() ? starts[i + 1] : src.size();
+                  pool.submit([&, i, start, stop](size_t) {
+                        pieces[i] = std::make_unique<Lexer>(src.substr(start, stop - start));
+                        pieces[i]->m_base = start;
+                        pieces[i]->tokens.base = static_cast<uint32_t>(start);
+                        errors[i] = pieces[i]->lex_window();
+                        done.count_down();
+                  });
+            }
+            done.wait();
+
+            lexer.tokens.source = src;
+            lexer.tokens.base = 0;
+            const auto rehome = [&lexer](const std::string_view val) -> std::string_view {
+                  return *lexer.m_decoded.emplace(val).first;
+            };
+            for (size_t i = 0; i < pieces.size(); i++) {
+                  lexer.tokens.append(pieces[i]->tokens, rehome);
+                  if (errors[i]) {
+                        lexer.m_index = pieces[i]->m_base + pieces[i]->m_index;
+                        return errors[i];
+                  }
+            }
+            lexer.m_index = src.size();
+            lexer.push(TypeOfToken::T_EOF, lexer.m_index);
+            return std::nullopt;
+      }
+};
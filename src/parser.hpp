@@ -1,43 +1,90 @@
 #pragma once
 
-#include <memory>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <span>
 #include <string_view>
-#include <unordered_map>
+#include <type_traits>
+#include <vector>
+#include "./context.hpp"
+#include "./diagnostics.hpp"
 #include "./lexer.hpp"
+#include "./scan.hpp"
+#include "./types.hpp"
+
+// One per concrete ASTNode class, so passes can switch on a node instead of going through virtual calls.
+enum class NodeKind : uint8_t {
+      null,
+      number,
+      boolean,
+      string,
+      binary,
+      unary,
+      variable,
+      variable_call,
+      prototype,
+      function,
+      call,
+      comptime,
+      error,
+};
 
-enum class Type { INT, FLOAT, STRING, BOOL, NULL_T, UNKNOWN };
-
-constexpr std::string_view type_to_str(Type t) {
-      switch (t) {
-            case Type::INT:
-                  return "int";
-            case Type::FLOAT:
-                  return "float";
-            case Type::STRING:
-                  return "string";
-            case Type::BOOL:
-                  return "bool";
-            case Type::NULL_T:
+constexpr std::string_view node_kind_to_str(NodeKind k) {
+      switch (k) {
+            case NodeKind::null:
                   return "null";
-            case Type::UNKNOWN:
-                  return "unknown_type";
+            case NodeKind::number:
+                  return "number";
+            case NodeKind::boolean:
+                  return "boolean";
+            case NodeKind::string:
+                  return "string";
+            case NodeKind::binary:
+                  return "binary";
+            case NodeKind::unary:
+                  return "unary";
+            case NodeKind::variable:
+                  return "variable";
+            case NodeKind::variable_call:
+                  return "variable_call";
+            case NodeKind::prototype:
+                  return "prototype";
+            case NodeKind::function:
+                  return "function";
+            case NodeKind::call:
+                  return "call";
+            case NodeKind::comptime:
+                  return "comptime";
+            case NodeKind::error:
+                  return "error";
       }
+      return "unknown_node";
 }
 
+// Nodes live in the Context's arena and are never deleted one by one, so they hold nothing that needs destroying.
+// Children are plain pointers into the same arena and child lists are spans allocated from it. Printing goes through
+// AstPrinter (ast_printer.hpp).
 class ASTNode {
   public:
-      virtual ~ASTNode() = default;
-      [[nodiscard]] constexpr virtual std::string_view display() const = 0;
+      const NodeKind kind;
       Type type = Type::UNKNOWN;
+
+  protected:
+      explicit ASTNode(const NodeKind k) : kind(k) {}
+      ~ASTNode() = default;
 };
 
 class NullNode : public ASTNode {
   public:
       Token token;
 
-      explicit NullNode(Token token) : token(std::move(token)) { type = Type::NULL_T; }
-
-      [[nodiscard]] constexpr std::string_view display() const override { return "null"; }
+      explicit NullNode(const Token& token) : ASTNode(NodeKind::null), token(token) { type = Type::NULL_T; }
 };
 
 class NumberNode : public ASTNode {
@@ -45,12 +92,39 @@ class NumberNode : public ASTNode {
       Token token;
       bool isNeg;
       std::string_view val;
+      // the value, read from `val` once: `integer` for an INT, `real` for a FLOAT, isNeg already applied
+      int64_t integer = 0;
+      double real = 0;
+
+      explicit NumberNode(Token& token, bool isNeg) :
+          ASTNode(NodeKind::number), token(token), isNeg(isNeg), val(token.val) {
+            const char* const first = val.data();
+            const char* const last = first + val.size();
+            if (val.find('.') == std::string_view::npos) {
+                  type = Type::INT;
+                  // out of range: the TypeChecker reports an UNKNOWN number as number_out_of_range
+                  if (std::from_chars(first, last, integer).ec != std::errc{})
+                        type = Type::UNKNOWN;
+                  if (isNeg)
+                        integer = static_cast<int64_t>(0 - static_cast<uint64_t>(integer));
+            } else {
+                  type = Type::FLOAT;
+                  std::from_chars(first, last, real);
+                  if (isNeg)
+                        real = -real;
+            }
+      }
 
-      explicit NumberNode(Token& token, bool isNeg) : token(token), isNeg(isNeg), val(token.val) {
-            type = token.val.find('.') == std::string_view::npos ? Type::INT : Type::FLOAT;
+      // A computed number; `text` is how it prints and has to live as long as the node.
+      NumberNode(const Token& at, const std::string_view text, const int64_t value) :
+          ASTNode(NodeKind::number), token(at), isNeg(false), val(text), integer(value) {
+            type = Type::INT;
       }
 
-      [[nodiscard]] constexpr std::string_view display() const override { return val; }
+      NumberNode(const Token& at, const std::string_view text, const double value) :
+          ASTNode(NodeKind::number), token(at), isNeg(false), val(text), real(value) {
+            type = Type::FLOAT;
+      }
 };
 
 class BoolNode : public ASTNode {
@@ -58,9 +132,9 @@ class BoolNode : public ASTNode {
       Token token;
       bool val;
 
-      explicit BoolNode(Token& token, bool val) : token(token), val(val) { type = Type::BOOL; }
-
-      [[nodiscard]] constexpr std::string_view display() const override { return val ? "true" : "false"; }
+      explicit BoolNode(Token& token, bool val) : ASTNode(NodeKind::boolean), token(token), val(val) {
+            type = Type::BOOL;
+      }
 };
 
 class StringNode : public ASTNode {
@@ -68,438 +142,871 @@ class StringNode : public ASTNode {
       Token token;
       std::string_view val;
 
-      explicit StringNode(const Token& token) : token(token), val(token.val) { type = Type::STRING; }
-
-      [[nodiscard]] constexpr std::string_view display() const override { return val; }
+      explicit StringNode(const Token& token) : ASTNode(NodeKind::string), token(token), val(token.val) {
+            type = Type::STRING;
+      }
 };
 
 class BinaryOperation : public ASTNode {
   public:
-      std::unique_ptr<ASTNode> left;
-      std::unique_ptr<ASTNode> right;
+      ASTNode* left;
+      ASTNode* right;
       Token op;
 
-  private:
-      mutable std::string buffer;
-
-  public:
-      explicit BinaryOperation(std::unique_ptr<ASTNode> left, std::unique_ptr<ASTNode> right, Token op) :
-          left(std::move(left)), right(std::move(right)), op(std::move(op)) {}
-
-      [[nodiscard]] std::string_view display() const override {
-            buffer = "(" + std::string(left->display()) + " " + std::string(op.val) + " " +
-                     std::string(right->display()) + ")";
-            return buffer;
-      }
+      explicit BinaryOperation(ASTNode* left, ASTNode* right, const Token& op) :
+          ASTNode(NodeKind::binary), left(left), right(right), op(op) {}
 };
 
 class UnaryOperation : public ASTNode {
   public:
-      std::unique_ptr<ASTNode> node;
+      ASTNode* node;
       Token op;
 
-  private:
-      mutable std::string buffer;
-
-  public:
-      explicit UnaryOperation(std::unique_ptr<ASTNode> n, Token o) : node(std::move(n)), op(std::move(o)) {
-            if (node->type != Type::INT && node->type != Type::FLOAT) {
-                  // TODO: error handling: Expected a number
-            }
-      }
-
-      [[nodiscard]] std::string_view display() const override {
-            buffer = std::string(op.val) + std::string(node->display());
-            return buffer;
-      }
+      // operand types are checked by the TypeChecker (sema.hpp)
+      explicit UnaryOperation(ASTNode* n, const Token& o) : ASTNode(NodeKind::unary), node(n), op(o) {}
 };
 
 class VariableNode : public ASTNode {
   public:
       const std::string_view name;
-      std::unique_ptr<ASTNode> val;
+      ASTNode* val;
       const Type type;
 
-  private:
-      mutable std::string buffer;
-
-  public:
-      explicit VariableNode(const std::string_view n, std::unique_ptr<ASTNode> v = nullptr,
-                            const Type t = Type::UNKNOWN) : name(n), val(std::move(v)), type(t) {}
-
-      [[nodiscard]] std::string_view display() const override {
-            if (val) {
-                  buffer = std::string(type_to_str(type)) + std::string(name) + " = " + std::string(val->display());
-            } else {
-                  buffer = std::string(type_to_str(type)) + std::string(name);
-            }
-            return buffer;
-      }
+      explicit VariableNode(const std::string_view n, ASTNode* v = nullptr, const Type t = Type::UNKNOWN) :
+          ASTNode(NodeKind::variable), name(n), val(v), type(t) {}
 };
 
 class VariableCallNode : public ASTNode {
   public:
       std::string_view name;
 
-  private:
-      mutable std::string buffer;
-
-  public:
-      explicit VariableCallNode(const std::string_view n) : name(n) {}
-
-      [[nodiscard]] constexpr std::string_view display() const override {
-            buffer = std::string(name);
-            return buffer;
-      }
+      explicit VariableCallNode(const std::string_view n) : ASTNode(NodeKind::variable_call), name(n) {}
 };
 
 class PrototypeNode : public ASTNode {
   public:
       const std::string_view name;
-      std::vector<VariableNode> args;
+      std::span<VariableNode*> args;
       const Type type;
 
-  private:
-      mutable std::string buffer;
-
-  public:
-      explicit PrototypeNode(const std::string_view name, std::vector<VariableNode>&& a, const Type t) :
-          name(name), args(std::move(a)), type(t) {}
-
-      [[nodiscard]] std::string_view display() const override {
-            buffer = std::string(type_to_str(type)) + " function " + std::string(name) + "(";
-            for (size_t i = 0; i < args.size(); i++) {
-                  buffer += args[i].display();
-                  if (i + 1 < args.size()) {
-                        buffer += ", ";
-                  }
-            }
-            buffer += ")";
-            return buffer;
-      }
+      explicit PrototypeNode(const std::string_view name, const std::span<VariableNode*> a, const Type t) :
+          ASTNode(NodeKind::prototype), name(name), args(a), type(t) {}
 };
 
 class FunctionNode : public ASTNode {
+      friend class Parser;
+
   public:
-      std::unique_ptr<PrototypeNode> Proto;
-      std::vector<std::unique_ptr<ASTNode>> Body;
+      PrototypeNode* Proto;
       Type type;
+      // tokens [body_first, body_last) between the braces while the body isn't parsed yet (Parser::lazy_bodies),
+      // both 0 once it is
+      uint32_t body_first = 0;
+      uint32_t body_last = 0;
+
+      [[nodiscard]] bool pending() const { return body_last != 0; }
+
+      // The statements of the body. Nothing parses a pending() one on the way: whoever made the tree with
+      // lazy_bodies has to Parser::parse_body() it before handing it on.
+      [[nodiscard]] std::span<ASTNode*> body() const {
+            assert(!pending());
+            return m_body;
+      }
+
+      explicit FunctionNode(PrototypeNode* Proto, const std::span<ASTNode*> Body) :
+          ASTNode(NodeKind::function), Proto(Proto), type(Proto->type), m_body(Body) {}
 
   private:
-      mutable std::string buffer;
+      std::span<ASTNode*> m_body;
+};
 
+class CallNode : public ASTNode {
   public:
-      explicit FunctionNode(std::unique_ptr<PrototypeNode> Proto, std::vector<std::unique_ptr<ASTNode>> Body) :
-          Proto(std::move(Proto)), Body(std::move(Body)) {
-            type = Proto->type;
-      };
+      std::string_view callee;
+      std::span<ASTNode*> args;
 
-      [[nodiscard]] std::string_view display() const override {
-            buffer = std::string(Proto->display()) + " :\n";
-            for (size_t i = 0; i < Body.size(); i++) {
-                  buffer += "\t" + std::string(Body[i]->display());
-                  if (i + 1 < Body.size()) {
-                        buffer += "\n";
-                  }
-            }
-            return buffer;
-      }
+      explicit CallNode(const std::string_view callee, const std::span<ASTNode*> args) :
+          ASTNode(NodeKind::call), callee(callee), args(args) {}
 };
 
-class CallNode : public ASTNode {
+// `comptime <expression>` or `comptime { ... }`, evaluated by the Interpreter (comptime.hpp) to the value of its last
+// expression. `value` is the literal node it evaluated to, nullptr until it has been.
+class ComptimeNode : public ASTNode {
   public:
-      std::string_view callee;
-      std::vector<std::unique_ptr<ASTNode>> args;
+      Token token;
+      std::span<ASTNode*> body;
+      ASTNode* value = nullptr;
 
-  private:
-      mutable std::string buffer;
+      explicit ComptimeNode(const Token& token, const std::span<ASTNode*> body) :
+          ASTNode(NodeKind::comptime), token(token), body(body) {}
+};
 
+// Stands in for what couldn't be parsed, so one pass can go on past an error. `token` is where it was noticed.
+class ErrorNode : public ASTNode {
   public:
-      explicit CallNode(const std::string_view callee, std::vector<std::unique_ptr<ASTNode>> args) :
-          callee(callee), args(std::move(args)) {}
-
-      [[nodiscard]] std::string_view display() const override {
-            buffer = std::string(callee) + "(";
-            for (size_t i = 0; i < args.size(); i++) {
-                  buffer += std::string(args[i]->display());
-                  if (i + 1 < args.size()) {
-                        buffer += ", ";
-                  }
-            }
-            return buffer;
-      }
+      Token token;
+
+      explicit ErrorNode(const Token& token) : ASTNode(NodeKind::error), token(token) {}
 };
 
+// the arena skips the finalizer queue for these, so releasing a whole tree costs nothing per node
+static_assert(std::is_trivially_destructible_v<BinaryOperation> && std::is_trivially_destructible_v<FunctionNode> &&
+              std::is_trivially_destructible_v<CallNode> && std::is_trivially_destructible_v<VariableNode>);
+
 struct Symbol {
       Type type;
-      std::unique_ptr<ASTNode> val;
+      ASTNode* val;
       bool is_const;
       std::string_view name;
 
-      explicit Symbol(const Type& type = Type::UNKNOWN, std::unique_ptr<ASTNode> val = nullptr, bool is_const = false,
-                      std::string_view name = "") : type(type), val(std::move(val)), is_const(is_const), name(name) {}
+      explicit Symbol(const Type& type = Type::UNKNOWN, ASTNode* val = nullptr, bool is_const = false,
+                      std::string_view name = "") : type(type), val(val), is_const(is_const), name(name) {}
 };
 
-class Scope {
-  public:
-      struct Symbols {
-            std::unordered_map<std::string_view, Symbol> vars;
-            std::unordered_map<std::string_view, Symbol> functions;
+// Every name's innermost visible declaration, as a flat array indexed by SymbolId, so resolving a name is one load
+// whatever the nesting depth. Declarations are kept on a stack that doubles as the undo log: each one remembers the
+// declaration it shadows, and leaving a scope pops the scope's declarations and puts those back.
+class SymbolTable {
+      static constexpr uint32_t none = UINT32_MAX;
+
+      enum class Space : uint8_t { var, function };
+
+      struct Declaration {
+            Symbol symbol;
+            SymbolId id;
+            uint32_t shadowed;
+            uint32_t depth;
+            Space space;
       };
 
-      Symbols symbols;
-      Scope* parent;
+      std::vector<Declaration> m_declarations;
+      // index into m_declarations per SymbolId, or none
+      std::vector<uint32_t> m_vars;
+      std::vector<uint32_t> m_functions;
+      // where each open scope's declarations start
+      std::vector<uint32_t> m_scopes;
 
-      explicit Scope(Scope* parent = nullptr) : parent(parent) {}
+  public:
+      void push_scope() { m_scopes.push_back(static_cast<uint32_t>(m_declarations.size())); }
+
+      void pop_scope() {
+            const uint32_t start = m_scopes.back();
+            m_scopes.pop_back();
+            for (size_t i = m_declarations.size(); i > start; i--) {
+                  const Declaration& d = m_declarations[i - 1];
+                  visible(d.space)[d.id] = d.shadowed;
+            }
+            m_declarations.resize(start);
+      }
 
-      void declare_var(std::string_view name, Symbol sym) {
-            if (symbols.vars.contains(name)) {
+      // 0 at global scope
+      [[nodiscard]] size_t depth() const { return m_scopes.size(); }
+
+      void declare_var(const SymbolId id, Symbol sym) {
+            if (!declare(Space::var, id, std::move(sym))) {
                   // TODO: error handling: Already declared variable
-                  return;
             }
-            symbols.vars[name] = std::move(sym);
       }
 
-      Symbol* get_var(std::string_view name) {
-            if (auto it = symbols.vars.find(name); it != symbols.vars.end())
-                  return &it->second;
-
-            if (parent)
-                  return parent->get_var(name);
+      void declare_function(const SymbolId id, Symbol sym) {
+            if (!declare(Space::function, id, std::move(sym))) {
+                  // TODO: error handling: Already defined function
+            }
+      }
 
+      // The returned pointer is only valid until the next declaration.
+      Symbol* get_var(const SymbolId id) {
             // TODO: error handling: Unknown variable
-            return nullptr;
+            return lookup(m_vars, id);
       }
 
-      void declare_function(std::string_view name, Symbol sym) {
-            if (symbols.functions.contains(name)) {
-                  // TODO: error handling: Already defined function
-                  return;
+      Symbol* get_function(const SymbolId id) {
+            // TODO: error handling: Unknown function
+            return lookup(m_functions, id);
+      }
+
+  private:
+      std::vector<uint32_t>& visible(const Space space) { return space == Space::var ? m_vars : m_functions; }
+
+      // false if the name is already declared in the current scope
+      bool declare(const Space space, const SymbolId id, Symbol&& sym) {
+            if (id == no_symbol)
+                  return true;
+            std::vector<uint32_t>& table = visible(space);
+            if (id >= table.size())
+                  table.resize(static_cast<size_t>(id) + 1, none);
+            const uint32_t shadowed = table[id];
+            if (shadowed != none && m_declarations[shadowed].depth == depth())
+                  return false;
+            table[id] = static_cast<uint32_t>(m_declarations.size());
+            m_declarations.push_back({std::move(sym), id, shadowed, static_cast<uint32_t>(depth()), space});
+            return true;
+      }
+
+      Symbol* lookup(const std::vector<uint32_t>& table, const SymbolId id) {
+            if (id >= table.size() || table[id] == none)
+                  return nullptr;
+            return &m_declarations[table[id]].symbol;
+      }
+};
+
+// How tightly each infix operator binds, indexed by TypeOfToken; 0 for tokens that can't continue an expression.
+struct InfixOperator {
+      uint8_t precedence = 0;
+      bool right_assoc = false;
+};
+
+constexpr std::array<InfixOperator, static_cast<size_t>(TypeOfToken::T_EOF) + 1> infix_operators = [] {
+      std::array<InfixOperator, static_cast<size_t>(TypeOfToken::T_EOF) + 1> t{};
+      const auto set = [&t](const std::initializer_list<TypeOfToken> ops, const uint8_t precedence,
+                            const bool right_assoc = false) {
+            for (const TypeOfToken op : ops)
+                  t[static_cast<size_t>(op)] = {precedence, right_assoc};
+      };
+      using enum TypeOfToken;
+      set({OP_EQUALS, OP_PLUSEQUALS, OP_MINUSEQUALS, OP_TIMESEQUALS, OP_DIVEQUALS}, 1, true);
+      set({OP_DOUBLEPIPE}, 2);
+      set({OP_DOUBLEAMPERSAND}, 3);
+      set({OP_PIPE}, 4);
+      set({OP_AMPERSAND}, 5);
+      set({OP_EQUALSEQUALS, OP_EXCL_EQUALS}, 6);
+      set({LTHAN, LTHAN_EQUALS, GTHAN, GTHAN_EQUALS}, 7);
+      set({OP_PLUS, OP_MINUS}, 8);
+      set({OP_TIMES, OP_DIV}, 9);
+      return t;
+}();
+
+// binds tighter than every infix operator
+constexpr uint8_t prefix_precedence = 10;
+
+constexpr bool is_prefix_operator(const TypeOfToken t) {
+      return t == TypeOfToken::OP_MINUS || t == TypeOfToken::OP_EXCL_MARK || t == TypeOfToken::OP_INC ||
+             t == TypeOfToken::OP_DEC;
+}
+
+// Constant folding: an operator applied to literals is replaced by its result as soon as the parser builds it. Only
+// operands of the same type are combined, an INT and a FLOAT are left for whatever later decides how they mix, and so
+// is anything with no defined result (division by zero, INT64_MIN / -1, a FLOAT that overflows). INT arithmetic wraps.
+namespace fold {
+      inline NumberNode* integer(Arena& arena, const Token& at, const int64_t value) {
+            char buf[24];
+            const char* const end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+            const std::span<char> text = arena.copy(std::span<const char>(buf, end));
+            return arena.make<NumberNode>(at, std::string_view(text.data(), text.size()), value);
+      }
+
+      inline NumberNode* real(Arena& arena, const Token& at, const double value) {
+            if (!std::isfinite(value))
+                  return nullptr;
+            char buf[40];
+            char* end = std::to_chars(buf, buf + sizeof(buf) - 2, value).ptr;
+            // so it still reads as a FLOAT
+            if (std::string_view(buf, end).find_first_of(".e") == std::string_view::npos) {
+                  *end++ = '.';
+                  *end++ = '0';
             }
-            symbols.functions[name] = std::move(sym);
+            const std::span<char> text = arena.copy(std::span<const char>(buf, end));
+            return arena.make<NumberNode>(at, std::string_view(text.data(), text.size()), value);
       }
 
-      Symbol* get_function(std::string_view name) {
-            if (auto it = symbols.functions.find(name); it != symbols.functions.end())
-                  return &it->second;
+      inline BoolNode* boolean(Arena& arena, const Token& at, const bool value) {
+            Token token = at;
+            return arena.make<BoolNode>(token, value);
+      }
 
-            if (parent)
-                  return parent->get_function(name);
+      template<typename T>
+      std::optional<bool> compare(const TypeOfToken op, const T a, const T b) {
+            switch (op) {
+                  case TypeOfToken::OP_EQUALSEQUALS:
+                        return a == b;
+                  case TypeOfToken::OP_EXCL_EQUALS:
+                        return a != b;
+                  case TypeOfToken::LTHAN:
+                        return a < b;
+                  case TypeOfToken::LTHAN_EQUALS:
+                        return a <= b;
+                  case TypeOfToken::GTHAN:
+                        return a > b;
+                  case TypeOfToken::GTHAN_EQUALS:
+                        return a >= b;
+                  default:
+                        return std::nullopt;
+            }
+      }
 
-            // TODO: error handling: Unknown function
+      // `op` applied to `operand`, or nullptr if that isn't a constant
+      inline ASTNode* unary(Arena& arena, const Token& op, const ASTNode* operand) {
+            if (!operand)
+                  return nullptr;
+            if (operand->kind == NodeKind::number && op.type == TypeOfToken::OP_MINUS) {
+                  const auto* n = static_cast<const NumberNode*>(operand);
+                  if (n->type == Type::INT)
+                        return integer(arena, op, static_cast<int64_t>(0 - static_cast<uint64_t>(n->integer)));
+                  if (n->type == Type::FLOAT)
+                        return real(arena, op, -n->real);
+            }
+            if (operand->kind == NodeKind::boolean && op.type == TypeOfToken::OP_EXCL_MARK)
+                  return boolean(arena, op, !static_cast<const BoolNode*>(operand)->val);
             return nullptr;
       }
-};
 
+      inline ASTNode* binary(Arena& arena, const Token& op, const ASTNode* lhs, const ASTNode* rhs) {
+            if (!lhs || !rhs || lhs->kind != rhs->kind || lhs->type != rhs->type)
+                  return nullptr;
+
+            if (lhs->kind == NodeKind::boolean) {
+                  const bool a = static_cast<const BoolNode*>(lhs)->val;
+                  const bool b = static_cast<const BoolNode*>(rhs)->val;
+                  switch (op.type) {
+                        case TypeOfToken::OP_DOUBLEAMPERSAND:
+                              return boolean(arena, op, a && b);
+                        case TypeOfToken::OP_DOUBLEPIPE:
+                              return boolean(arena, op, a || b);
+                        case TypeOfToken::OP_EQUALSEQUALS:
+                              return boolean(arena, op, a == b);
+                        case TypeOfToken::OP_EXCL_EQUALS:
+                              return boolean(arena, op, a != b);
+                        default:
+                              return nullptr;
+                  }
+            }
+            if (lhs->kind != NodeKind::number)
+                  return nullptr;
+
+            const auto* l = static_cast<const NumberNode*>(lhs);
+            const auto* r = static_cast<const NumberNode*>(rhs);
+            if (l->type == Type::INT) {
+                  const int64_t a = l->integer;
+                  const int64_t b = r->integer;
+                  const auto ua = static_cast<uint64_t>(a);
+                  const auto ub = static_cast<uint64_t>(b);
+                  switch (op.type) {
+                        case TypeOfToken::OP_PLUS:
+                              return integer(arena, op, static_cast<int64_t>(ua + ub));
+                        case TypeOfToken::OP_MINUS:
+                              return integer(arena, op, static_cast<int64_t>(ua - ub));
+                        case TypeOfToken::OP_TIMES:
+                              return integer(arena, op, static_cast<int64_t>(ua * ub));
+                        case TypeOfToken::OP_DIV:
+                              if (b == 0 || (a == INT64_MIN && b == -1))
+                                    return nullptr;
+                              return integer(arena, op, a / b);
+                        case TypeOfToken::OP_AMPERSAND:
+                              return integer(arena, op, a & b);
+                        case TypeOfToken::OP_PIPE:
+                              return integer(arena, op, a | b);
+                        default:
+                              break;
+                  }
+                  const std::optional<bool> result = compare(op.type, a, b);
+                  return result ? boolean(arena, op, *result) : nullptr;
+            }
+            if (l->type == Type::FLOAT) {
+                  const double a = l->real;
+                  const double b = r->real;
+                  switch (op.type) {
+                        case TypeOfToken::OP_PLUS:
+                              return real(arena, op, a + b);
+                        case TypeOfToken::OP_MINUS:
+                              return real(arena, op, a - b);
+                        case TypeOfToken::OP_TIMES:
+                              return real(arena, op, a * b);
+                        case TypeOfToken::OP_DIV:
+                              return b == 0 ? nullptr : real(arena, op, a / b);
+                        default:
+                              break;
+                  }
+                  const std::optional<bool> result = compare(op.type, a, b);
+                  return result ? boolean(arena, op, *result) : nullptr;
+            }
+            return nullptr;
+      }
+}
+
+// Walks the token stream by index; positions come from tokens.location() when they're needed.
 class Parser {
   public:
-      std::vector<Token> tokens;
+      // borrowed, it (and the source it views) has to outlive the parser and the nodes it returns
+      const TokenStream& tokens;
+      // nodes and child lists are allocated from ctx.arena and live as long as it does
+      Context& ctx;
       size_t index;
-      size_t column;
-      size_t line;
-      Scope* global_scope = new Scope();
-      Scope* current_scope = global_scope;
+      // keyed by the ids tokens.names hands out
+      SymbolTable symbols;
+      // replace operators on literals by their value while parsing, see fold::
+      bool fold_constants = false;
+      // A node with more than this many levels below it becomes an error instead, so that everything that walks the
+      // tree recursively afterwards (printing, evaluation, code generation) has a bound on its stack depth.
+      uint32_t max_depth = 512;
+      // Only find where each top-level function body ends and leave it unparsed until parse_body(), for when
+      // mostly signatures are needed. The brace matching is all a skipped body costs, nothing of it is allocated.
+      // Bodies see the top-level names declared by the time they're parsed, not only the earlier ones, which only
+      // changes the types the parser guesses for the TypeChecker to check anyway. A body with an error in it always
+      // ends at its closing brace, where an eager parse may have taken that brace for an operand. Nothing in the
+      // Driver or Workspace turns it on, since both check every body; BM_ParseSignatures measures it.
+      bool lazy_bodies = false;
+
+  private:
+      struct PendingOperator {
+            Token token;
+            uint8_t precedence;
+            enum Form : uint8_t { prefix, infix, paren } form;
+      };
+
+      // shared by nested parse_expr() calls, each one only touches the entries above where it started
+      std::vector<ASTNode*> operand_stack;
+      // the depth of the tree under each operand
+      std::vector<uint32_t> depth_stack;
+      std::vector<PendingOperator> operator_stack;
+      // depth of the node parse_expr() or parse_primary() returned last
+      uint32_t last_depth = 0;
+      // parse_expr() calls in progress
+      uint32_t nesting = 0;
+
+      // the closing brace of the body parse_body() is parsing, which reads as the end of the stream
+      size_t stop = SIZE_MAX;
+
+      // where errors go, if anywhere; parsing recovers from them the same way either way
+      Diagnostics* diagnostics = nullptr;
+      // set from an error until the parser resynchronizes, errors in between are only consequences of the first
+      bool panicking = false;
 
-      explicit Parser(std::vector<Token> tokns) : tokens(std::move(tokns)), index(0), column(1), line(1) {}
+  public:
+      explicit Parser(const TokenStream& tokns, Context& context) : tokens(tokns), ctx(context), index(0) {}
+
+      Parser(const TokenStream& tokns, Context& context, Diagnostics& diags) : Parser(tokns, context) {
+            diagnostics = &diags;
+      }
 
   private:
-      Token next_token() {
-            if (index < tokens.size()) {
-                  Token token = tokens[index];
+      // Comments are skipped here, so they never reach the grammar and `index` is always at a token that means
+      // something once a token has been peeked at.
+      void skip_comments() {
+            while (index < tokens.size() && index < stop && tokens.kind(index) == TypeOfToken::COMMENT)
                   index++;
-                  if (token.type == TypeOfToken::NEWLINE) {
-                        column = 1;
-                        line++;
-                  } else {
-                        column += token.val.length();
+      }
+
+      Token next_token() {
+            skip_comments();
+            if (index < tokens.size() && index < stop)
+                  return tokens[index++];
+            if (index < tokens.size())
+                  return Token{TypeOfToken::T_EOF, Keyword::none, tokens.offset(index), 0, no_symbol, {}};
+            return Token{};
+      }
+
+      [[nodiscard]] TypeOfToken peek_next() {
+            skip_comments();
+            if (index >= tokens.size() || index >= stop)
+                  return TypeOfToken::T_EOF;
+            return tokens.kind(index);
+      }
+
+      void error(const ParseError e, const Token& at) {
+            if (panicking)
+                  return;
+            panicking = true;
+            if (diagnostics)
+                  diagnostics->report(e, at.offset, at.length);
+      }
+
+      // The next token if it is a `kind`. Otherwise it is left alone, for whatever comes after the missing one.
+      bool expect(const TypeOfToken kind, const ParseError e, Token& out) {
+            if (peek_next() == kind) {
+                  out = next_token();
+                  return true;
+            }
+            error(e, index < tokens.size() ? tokens[index] : Token{});
+            return false;
+      }
+
+      [[nodiscard]] size_t line_of(const uint32_t offset) const {
+            return tokens.location_of(offset).line;
+      }
+
+      // After an error, skips to where the next statement starts: past a ';', or before a '}', a keyword that starts an
+      // item, or the first token on a later line than the one the parser stopped at.
+      void synchronize() {
+            if (!panicking)
+                  return;
+            panicking = false;
+            const size_t line = index > 0 && index - 1 < tokens.size() ? line_of(tokens.offset(index - 1)) : 0;
+            while (index < tokens.size()) {
+                  const TypeOfToken kind = tokens.kind(index);
+                  if (kind == TypeOfToken::T_EOF || kind == TypeOfToken::RBRACE || line_of(tokens.offset(index)) > line)
+                        return;
+                  if (kind == TypeOfToken::KEYWORD) {
+                        const Keyword kw = tokens.keyword(index);
+                        if (kw == Keyword::kw_var || kw == Keyword::kw_fn || kw == Keyword::kw_import)
+                              return;
                   }
-                  return token;
+                  index++;
+                  if (kind == TypeOfToken::SEMICOLON)
+                        return;
             }
-            return Token{TypeOfToken::T_EOF, "\0", column, line};
       }
 
-      Token peek_next() {
-            if (index >= tokens.size())
-                  return Token{TypeOfToken::T_EOF, "", column, line};
-            return tokens[index];
+      // A built-in by its name alone; anything else is one lookup in the compilation's type table, an identifier's
+      // by the hash the lexer made of it when it interned the name.
+      [[nodiscard]] Type parse_type(const Token& token) const {
+            if (token.symbol != no_symbol)
+                  return ctx.types.named(tokens.names, token.symbol);
+            return ctx.types.named(token.val);
       }
 
+      // Precedence climbing without recursion: operands and pending operators live on two explicit stacks, so long
+      // operator chains and deeply nested parentheses cost stack entries rather than native call frames. Only primaries
+      // that contain whole expressions of their own (var initializers, function bodies) recurse.
       ASTNode* parse_expr() {
-            ASTNode* node = parse_term();
-            while (peek_next().type == TypeOfToken::OP_PLUS || peek_next().type == TypeOfToken::OP_MINUS) {
-                  Token token = next_token();
-                  node = new BinaryOperation(std::unique_ptr<ASTNode>(node), std::unique_ptr<ASTNode>(parse_term()),
-                                             token);
+            // one token is always consumed, so whatever loop called this keeps making progress
+            if (nesting >= max_depth)
+                  return too_deep(next_token());
+            nesting++;
+            const size_t operand_base = operand_stack.size();
+            const size_t operator_base = operator_stack.size();
+
+            while (true) {
+                  // prefix position: unary operators and opening parentheses, then one primary
+                  while (is_prefix_operator(peek_next()) || peek_next() == TypeOfToken::LPAREN) {
+                        const Token token = next_token();
+                        if (token.type == TypeOfToken::LPAREN)
+                              operator_stack.push_back({token, 0, PendingOperator::paren});
+                        else
+                              operator_stack.push_back({token, prefix_precedence, PendingOperator::prefix});
+                  }
+                  operand_stack.push_back(parse_primary());
+                  depth_stack.push_back(last_depth);
+
+                  // closing parentheses end the innermost one that is still open in this expression
+                  while (peek_next() == TypeOfToken::RPAREN && open_paren(operator_base)) {
+                        next_token();
+                        while (operator_stack.back().form != PendingOperator::paren)
+                              reduce();
+                        operator_stack.pop_back();
+                  }
+
+                  const InfixOperator info = infix_operators[static_cast<size_t>(peek_next())];
+                  if (info.precedence == 0)
+                        break;
+                  while (operator_stack.size() > operator_base) {
+                        const PendingOperator& top = operator_stack.back();
+                        if (top.form == PendingOperator::paren || top.precedence < info.precedence ||
+                            (top.precedence == info.precedence && info.right_assoc))
+                              break;
+                        reduce();
+                  }
+                  operator_stack.push_back({next_token(), info.precedence, PendingOperator::infix});
             }
+
+            while (operator_stack.size() > operator_base) {
+                  if (operator_stack.back().form == PendingOperator::paren) {
+                        error(ParseError::expected_rparen, operator_stack.back().token);
+                        operator_stack.pop_back();
+                        continue;
+                  }
+                  reduce();
+            }
+            ASTNode* node = operand_stack.back();
+            last_depth = depth_stack.back();
+            operand_stack.resize(operand_base);
+            depth_stack.resize(operand_base);
+            nesting--;
             return node;
       }
 
-      ASTNode* parse_term() {
-            ASTNode* node = parse_factor();
-            while (peek_next().type == TypeOfToken::OP_TIMES || peek_next().type == TypeOfToken::OP_DIV) {
-                  Token token = next_token();
-                  node = new BinaryOperation(std::unique_ptr<ASTNode>(node), std::unique_ptr<ASTNode>(parse_factor()),
-                                             token);
-            }
+      ASTNode* too_deep(const Token& at) {
+            error(ParseError::nested_too_deeply, at);
+            last_depth = 1;
+            return ctx.arena.make<ErrorNode>(at);
+      }
+
+      // `node`, `depth` levels deep, or an error in its place past max_depth; sets last_depth either way
+      ASTNode* limit_depth(ASTNode* node, const uint32_t depth, const Token& at) {
+            if (depth > max_depth)
+                  return too_deep(at);
+            last_depth = depth;
             return node;
       }
 
-      ASTNode* parse_factor() {
+      [[nodiscard]] bool open_paren(const size_t operator_base) const {
+            for (size_t i = operator_stack.size(); i > operator_base; i--) {
+                  if (operator_stack[i - 1].form == PendingOperator::paren)
+                        return true;
+            }
+            return false;
+      }
+
+      // Applies the topmost pending operator to the operands on top of the stack.
+      void reduce() {
+            const PendingOperator op = operator_stack.back();
+            operator_stack.pop_back();
+            ASTNode* rhs = operand_stack.back();
+            const uint32_t rhs_depth = depth_stack.back();
+            if (op.form == PendingOperator::prefix) {
+                  ASTNode* folded = fold_constants ? fold::unary(ctx.arena, op.token, rhs) : nullptr;
+                  if (folded) {
+                        operand_stack.back() = folded;
+                        depth_stack.back() = 1;
+                  } else if (rhs) {
+                        operand_stack.back() =
+                                limit_depth(ctx.arena.make<UnaryOperation>(rhs, op.token), rhs_depth + 1, op.token);
+                        depth_stack.back() = last_depth;
+                  }
+                  return;
+            }
+            operand_stack.pop_back();
+            depth_stack.pop_back();
+            ASTNode* lhs = operand_stack.back();
+            ASTNode* folded = fold_constants ? fold::binary(ctx.arena, op.token, lhs, rhs) : nullptr;
+            if (folded) {
+                  operand_stack.back() = folded;
+                  depth_stack.back() = 1;
+                  return;
+            }
+            operand_stack.back() = limit_depth(ctx.arena.make<BinaryOperation>(lhs, rhs, op.token),
+                                               std::max(depth_stack.back(), rhs_depth) + 1, op.token);
+            depth_stack.back() = last_depth;
+      }
+
+      ASTNode* parse_primary() {
             Token token = next_token();
+            last_depth = 1;
             switch (token.type) {
                   case TypeOfToken::NUMBER:
-                        return new NumberNode(token, false);
+                        return ctx.arena.make<NumberNode>(token, false);
                   case TypeOfToken::STRING:
-                        return new StringNode(token);
+                        return ctx.arena.make<StringNode>(token);
                   case TypeOfToken::IDENTIFIER: {
-                        Symbol* sym = current_scope->get_var(token.val);
-                        auto var = new VariableCallNode(token.val);
-                        var->type = sym->type;
+                        if (peek_next() == TypeOfToken::LPAREN)
+                              return parse_call(token);
+                        const Symbol* sym = symbols.get_var(token.symbol);
+                        auto var = ctx.arena.make<VariableCallNode>(token.val);
+                        var->type = sym ? sym->type : Type::UNKNOWN;
                         return var;
                   }
-                  case TypeOfToken::OP_MINUS:
-                        return new UnaryOperation(std::unique_ptr<ASTNode>(parse_factor()), token);
-                  case TypeOfToken::LPAREN: {
-                        ASTNode* node = parse_expr();
-                        Token close = next_token();
-                        if (close.type != TypeOfToken::RPAREN)
-                              // TODO: error handling: Expected ')'/Unclosed parent
-                              return node;
-                  }
                   case TypeOfToken::KEYWORD: {
-                        std::string_view keyword = token.val;
-                        if (keyword == "var") {
-                              Token name = next_token();
-                              Token eq = next_token();
-                              if (eq.type != TypeOfToken::OP_EQUALS) {
-                                    // TODO: error handling: Expected '='
-                              }
-                              auto val_node = std::unique_ptr<ASTNode>(parse_expr());
-                              Symbol sym(val_node->type, std::move(val_node));
-                              current_scope->declare_var(name.val, std::move(sym));
-                              return new VariableNode(name.val, std::move(val_node));
-                        } else if (keyword == "null") {
-                              return new NullNode(token);
-                        } else if (keyword == "fn") {
-                              Token name = next_token();
-                              if (name.type != TypeOfToken::IDENTIFIER) {
-                                    // TODO: error handling: Expected function name
-                              }
-
-                              Token lparen = next_token();
-                              if (lparen.type != TypeOfToken::LPAREN) {
-                                    // TODO: error handling: Expected '(' after function name
+                        const Keyword keyword = token.keyword;
+                        if (keyword == Keyword::kw_var) {
+                              Token name, eq;
+                              expect(TypeOfToken::IDENTIFIER, ParseError::expected_variable_name, name);
+                              expect(TypeOfToken::OP_EQUALS, ParseError::expected_equals, eq);
+                              ASTNode* val_node = parse_expr();
+                              Symbol sym(val_node ? val_node->type : Type::UNKNOWN, val_node);
+                              symbols.declare_var(name.symbol, std::move(sym));
+                              return limit_depth(ctx.arena.make<VariableNode>(name.val, val_node), last_depth + 1,
+                                                 token);
+                        } else if (keyword == Keyword::kw_null) {
+                              return ctx.arena.make<NullNode>(token);
+                        } else if (keyword == Keyword::kw_true || keyword == Keyword::kw_false) {
+                              return ctx.arena.make<BoolNode>(token, keyword == Keyword::kw_true);
+                        } else if (keyword == Keyword::kw_comptime) {
+                              std::span<ASTNode*> body;
+                              uint32_t depth = 0;
+                              if (peek_next() == TypeOfToken::LBRACE) {
+                                    next_token();
+                                    body = parse_statements(depth);
+                              } else {
+                                    ASTNode* expr = parse_expr();
+                                    body = ctx.arena.copy(std::span<ASTNode* const>(&expr, 1));
+                                    depth = last_depth;
                               }
-
-                              std::vector<VariableNode> params;
-
-                              while (peek_next().type != TypeOfToken::RPAREN &&
-                                     peek_next().type != TypeOfToken::T_EOF) {
-                                    Token param_name = next_token();
-                                    if (param_name.type != TypeOfToken::IDENTIFIER) {
-                                          // TODO: error handling: Expected parameter name
+                              auto node = ctx.arena.make<ComptimeNode>(token, body);
+                              node->type = body.empty() || !body.back() ? Type::NULL_T : body.back()->type;
+                              return limit_depth(node, depth + 1, token);
+                        } else if (keyword == Keyword::kw_fn) {
+                              Token name, lparen;
+                              expect(TypeOfToken::IDENTIFIER, ParseError::expected_function_name, name);
+                              expect(TypeOfToken::LPAREN, ParseError::expected_lparen, lparen);
+
+                              std::vector<VariableNode*> params;
+
+                              while (peek_next() != TypeOfToken::RPAREN &&
+                                     peek_next() != TypeOfToken::T_EOF) {
+                                    Token param_name, colon, type_token;
+                                    if (!expect(TypeOfToken::IDENTIFIER, ParseError::expected_parameter_name,
+                                                param_name) ||
+                                        !expect(TypeOfToken::COLON, ParseError::expected_colon, colon) ||
+                                        !expect(TypeOfToken::IDENTIFIER, ParseError::expected_type, type_token)) {
+                                          // the rest of the list is lost, but not the body after it
+                                          while (peek_next() != TypeOfToken::RPAREN &&
+                                                 peek_next() != TypeOfToken::LBRACE &&
+                                                 peek_next() != TypeOfToken::SEMICOLON &&
+                                                 peek_next() != TypeOfToken::T_EOF)
+                                                next_token();
+                                          break;
                                     }
 
-                                    Token colon = next_token();
-                                    if (colon.type != TypeOfToken::COLON) {
-                                          // TODO: error handling: Expected colon
-                                    }
-
-                                    Token type_token = next_token();
-                                    if (type_token.type != TypeOfToken::IDENTIFIER) {
-                                          // TODO: error handling: Expected parameter type
-                                    }
+                                    params.push_back(ctx.arena.make<VariableNode>(param_name.val, nullptr,
+                                                                                  parse_type(type_token)));
 
-                                    Type param_type;
-                                    if (type_token.val == "int")
-                                          param_type = Type::INT;
-                                    else if (type_token.val == "float")
-                                          param_type = Type::FLOAT;
-                                    else if (type_token.val == "bool")
-                                          param_type = Type::BOOL;
-                                    else if (type_token.val == "string")
-                                          param_type = Type::STRING;
-                                    else if (type_token.val == "null")
-                                          param_type = Type::NULL_T;
-                                    else
-                                          param_type = Type::UNKNOWN;
-
-                                    params.emplace_back(param_name.val, nullptr, param_type);
-
-                                    if (peek_next().type == TypeOfToken::COMMA)
+                                    if (peek_next() == TypeOfToken::COMMA)
                                           next_token();
                               }
 
-                              Token rparen = next_token();
-                              if (rparen.type != TypeOfToken::RPAREN) {
-                                    // TODO: error handling: Expected ')'
-                              }
-
-                              Token colon = next_token();
-                              if (colon.type != TypeOfToken::COLON) {
-                                    // TODO: error handling: Expected colon
-                              }
+                              Token rparen, colon, ret_type_token;
+                              if (expect(TypeOfToken::RPAREN, ParseError::expected_rparen, rparen) &&
+                                  expect(TypeOfToken::COLON, ParseError::expected_colon, colon))
+                                    expect(TypeOfToken::IDENTIFIER, ParseError::expected_type, ret_type_token);
+                              const Type ret_type = parse_type(ret_type_token);
 
-                              Token ret_type_token = next_token();
-                              if (ret_type_token.type != TypeOfToken::IDENTIFIER) {
-                                    // TODO: error handling: Expected function return type
-                              }
+                              auto proto = ctx.arena.make<PrototypeNode>(name.val, ctx.arena.copy(params), ret_type);
+                              symbols.declare_function(name.symbol, Symbol(ret_type, nullptr));
 
-                              Type ret_type;
-                              if (ret_type_token.val == "int")
-                                    ret_type = Type::INT;
-                              else if (ret_type_token.val == "float")
-                                    ret_type = Type::FLOAT;
-                              else if (ret_type_token.val == "bool")
-                                    ret_type = Type::BOOL;
-                              else if (ret_type_token.val == "string")
-                                    ret_type = Type::STRING;
-                              else if (ret_type_token.val == "null")
-                                    ret_type = Type::NULL_T;
-                              else
-                                    ret_type = Type::UNKNOWN;
-
-                              auto proto = std::make_unique<PrototypeNode>(name.val, std::move(params), ret_type);
-
-                              if (peek_next().type == TypeOfToken::SEMICOLON) {
+                              if (peek_next() == TypeOfToken::SEMICOLON) {
                                     next_token();
-                                    Symbol sym(ret_type, nullptr);
-                                    current_scope->declare_function(name.val, std::move(sym));
-                                    return proto.release();
-                              } else if (peek_next().type == TypeOfToken::LBRACE) {
+                                    return proto;
+                              } else if (peek_next() == TypeOfToken::LBRACE) {
                                     next_token();
-                                    std::vector<std::unique_ptr<ASTNode>> body;
-                                    Symbol sym(ret_type, nullptr);
-                                    current_scope->declare_function(name.val, std::move(sym));
-                                    current_scope = new Scope(current_scope);
-                                    while (peek_next().type != TypeOfToken::RBRACE &&
-                                           peek_next().type != TypeOfToken::T_EOF) {
-                                          body.emplace_back(std::unique_ptr<ASTNode>(parse_expr()));
+                                    // a brace is as good a place to pick up again as any
+                                    panicking = false;
+                                    if (lazy_bodies && nesting == 1) {
+                                          auto fn = ctx.arena.make<FunctionNode>(proto, std::span<ASTNode*>{});
+                                          fn->body_first = static_cast<uint32_t>(index);
+                                          index = matching_brace(index);
+                                          fn->body_last = static_cast<uint32_t>(index);
+                                          Token rbrace;
+                                          expect(TypeOfToken::RBRACE, ParseError::expected_rbrace, rbrace);
+                                          return fn;
                                     }
-                                    Token rbrace = next_token();
-                                    current_scope = current_scope->parent;
-                                    return new FunctionNode(std::move(proto), std::move(body));
+                                    uint32_t depth = 0;
+                                    const std::span<ASTNode*> body = parse_statements(depth);
+                                    return limit_depth(ctx.arena.make<FunctionNode>(proto, body), depth + 2, token);
                               }
+                              error(ParseError::expected_body, index < tokens.size() ? tokens[index] : Token{});
+                              return proto;
                         }
                         break;
                   }
-                  case TypeOfToken::COMMENT:
-                        next_token();
+                  case TypeOfToken::ERROR:
+                        // the lexer has reported it already
+                        panicking = true;
+                        return ctx.arena.make<ErrorNode>(token);
                   default:
-                        // TODO: error handling: Unexpected <token>
+                        break;
             }
+            error(ParseError::expected_expression, token);
+            return ctx.arena.make<ErrorNode>(token);
       }
 
-  public:
-      std::vector<std::unique_ptr<ASTNode>> parse() {
-            std::vector<std::unique_ptr<ASTNode>> nodes;
+      // Statements up to the '}' closing the block, and that brace, in a scope of their own; `depth` is the deepest.
+      std::span<ASTNode*> parse_statements(uint32_t& depth) {
+            std::vector<ASTNode*> body;
+            symbols.push_scope();
+            while (peek_next() != TypeOfToken::RBRACE && peek_next() != TypeOfToken::T_EOF) {
+                  body.push_back(parse_expr());
+                  depth = std::max(depth, last_depth);
+                  synchronize();
+            }
+            Token rbrace;
+            expect(TypeOfToken::RBRACE, ParseError::expected_rbrace, rbrace);
+            symbols.pop_scope();
+            return ctx.arena.copy(body);
+      }
 
-            while (peek_next().type != TypeOfToken::T_EOF) {
-                  auto node = std::unique_ptr<ASTNode>(parse_expr());
-                  nodes.push_back(std::move(node));
+      // The '}' that closes the block whose '{' is just before `from`, or the T_EOF ending the stream. Only the kinds
+      // are looked at, a byte each, so the scan goes from brace to brace a vector at a time.
+      [[nodiscard]] size_t matching_brace(const size_t from) const {
+            const auto* kinds = reinterpret_cast<const char*>(tokens.kinds().data());
+            const char* end = kinds + tokens.size();
+            const auto lbrace = static_cast<char>(TypeOfToken::LBRACE);
+            const auto rbrace = static_cast<char>(TypeOfToken::RBRACE);
+            size_t depth = 1;
+            for (const char* p = kinds + from; (p = scan::find_either(p, end, lbrace, rbrace)) < end; ++p) {
+                  if (*p == lbrace)
+                        depth++;
+                  else if (--depth == 0)
+                        return static_cast<size_t>(p - kinds);
+            }
+            // where an eager parse would have stopped too
+            return tokens.empty() || tokens.kind(tokens.size() - 1) != TypeOfToken::T_EOF ? tokens.size()
+                                                                                          : tokens.size() - 1;
+      }
 
-                  if (peek_next().type == TypeOfToken::NEWLINE)
+      // `callee(arg, ...)`, the callee already consumed
+      ASTNode* parse_call(const Token& callee) {
+            next_token();
+            std::vector<ASTNode*> args;
+            uint32_t depth = 0;
+            while (peek_next() != TypeOfToken::RPAREN && peek_next() != TypeOfToken::T_EOF) {
+                  args.push_back(parse_expr());
+                  depth = std::max(depth, last_depth);
+                  if (peek_next() != TypeOfToken::COMMA)
+                        break;
+                  next_token();
+            }
+            Token rparen;
+            expect(TypeOfToken::RPAREN, ParseError::expected_rparen, rparen);
+
+            auto call = ctx.arena.make<CallNode>(callee.val, ctx.arena.copy(args));
+            const Symbol* sym = symbols.get_function(callee.symbol);
+            call->type = sym ? sym->type : Type::UNKNOWN;
+            return limit_depth(call, depth + 1, callee);
+      }
+
+  public:
+      // The top-level item at `index`, leaving `index` just past it. nullopt for an import, which has no node:
+      // `import <module>` is resolved, and an `import` without a module reported, by the Driver straight from the
+      // tokens.
+      std::optional<ASTNode*> parse_item() {
+            if (peek_next() == TypeOfToken::KEYWORD && tokens.keyword(index) == Keyword::kw_import) {
+                  next_token();
+                  if (peek_next() == TypeOfToken::STRING || peek_next() == TypeOfToken::IDENTIFIER)
                         next_token();
+                  return std::nullopt;
+            }
+
+            ASTNode* node = parse_expr();
+            synchronize();
+            if (peek_next() == TypeOfToken::NEWLINE)
+                  next_token();
+            return node;
+      }
+
+      // Parses the body of `fn` if it's still pending, with the parser where it was left afterwards.
+      void parse_body(FunctionNode& fn) {
+            if (!fn.pending())
+                  return;
+            const size_t resume = index;
+            const bool was_panicking = panicking;
+            index = fn.body_first;
+            stop = fn.body_last;
+            panicking = false;
+            nesting++;
+            std::vector<ASTNode*> body;
+            uint32_t depth = 0;
+            symbols.push_scope();
+            while (peek_next() != TypeOfToken::T_EOF) {
+                  body.push_back(parse_expr());
+                  depth = std::max(depth, last_depth);
+                  synchronize();
+            }
+            symbols.pop_scope();
+            fn.m_body = ctx.arena.copy(body);
+            nesting--;
+            stop = SIZE_MAX;
+            if (depth + 2 > max_depth) {
+                  error(ParseError::nested_too_deeply, tokens[fn.body_first]);
+                  fn.m_body = {};
+            }
+            fn.body_first = fn.body_last = 0;
+            index = resume;
+            panicking = was_panicking;
+      }
+
+      // every pending body in `items`
+      void parse_bodies(const std::span<ASTNode* const> items) {
+            for (ASTNode* item : items) {
+                  if (item && item->kind == NodeKind::function)
+                        parse_body(*static_cast<FunctionNode*>(item));
+            }
+      }
+
+      std::vector<ASTNode*> parse() {
+            std::vector<ASTNode*> nodes;
+
+            while (peek_next() != TypeOfToken::T_EOF) {
+                  if (const std::optional<ASTNode*> node = parse_item())
+                        nodes.push_back(*node);
             }
 
             return nodes;
@@ -0,0 +1,312 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "./hash.hpp"
+#include "./ir.hpp"
+#include "./thread_pool.hpp"
+
+namespace ir {
+      // Points every use of a value at what `replace` maps it to, following chains.
+      inline void substitute(Function& fn, std::unordered_map<ValueId, ValueId>& replace) {
+            const auto resolve = [&replace](ValueId v) {
+                  while (true) {
+                        const auto it = replace.find(v);
+                        if (it == replace.end() || it->second == v)
+                              return v;
+                        v = it->second;
+                  }
+            };
+            for (Block& block : fn.blocks) {
+                  for (const ValueId id : block.insts) {
+                        for (ValueId& operand : fn.values[id].operands)
+                              operand = resolve(operand);
+                  }
+            }
+      }
+
+      inline void remove_if(Function& fn, const std::function<bool(ValueId)>& dead) {
+            for (Block& block : fn.blocks)
+                  std::erase_if(block.insts, dead);
+      }
+
+      // Forwards copies, and phis whose operands are all the same value, to that value.
+      inline bool propagate_copies(Function& fn) {
+            std::unordered_map<ValueId, ValueId> replace;
+            for (const Block& block : fn.blocks) {
+                  for (const ValueId id : block.insts) {
+                        const Inst& inst = fn.values[id];
+                        if (inst.op == Opcode::copy) {
+                              replace[id] = inst.operands[0];
+                        } else if (inst.op == Opcode::phi && !inst.operands.empty() &&
+                                   std::ranges::all_of(inst.operands, [&](const ValueId v) {
+                                         return v == inst.operands[0] || v == id;
+                                   })) {
+                              replace[id] = inst.operands[0];
+                        }
+                  }
+            }
+            if (replace.empty())
+                  return false;
+            substitute(fn, replace);
+            remove_if(fn, [&replace](const ValueId id) { return replace.contains(id); });
+            return true;
+      }
+
+      // Removes every instruction nothing needs. Only pure ones can go, and a division by a value that may be zero
+      // stays: it may be what stops the program.
+      inline bool eliminate_dead_code(Function& fn) {
+            const auto needed = [&fn](const Inst& inst) {
+                  if (!is_pure(inst.op) && inst.op != Opcode::phi && inst.op != Opcode::get_global &&
+                      inst.op != Opcode::param)
+                        return true;
+                  if (inst.op != Opcode::div || inst.type != Type::INT)
+                        return false;
+                  const Inst& divisor = fn.values[inst.operands[1]];
+                  return divisor.op != Opcode::constant || divisor.integer == 0;
+            };
+
+            std::vector<uint8_t> live(fn.values.size(), 0);
+            std::vector<ValueId> work;
+            for (const Block& block : fn.blocks) {
+                  for (const ValueId id : block.insts) {
+                        if (needed(fn.values[id])) {
+                              live[id] = 1;
+                              work.push_back(id);
+                        }
+                  }
+            }
+            while (!work.empty()) {
+                  const ValueId id = work.back();
+                  work.pop_back();
+                  for (const ValueId operand : fn.values[id].operands) {
+                        if (!live[operand]) {
+                              live[operand] = 1;
+                              work.push_back(operand);
+                        }
+                  }
+            }
+
+            bool changed = false;
+            remove_if(fn, [&](const ValueId id) {
+                  // parameters stay so param i is still the i-th argument
+                  if (live[id] || fn.values[id].op == Opcode::param)
+                        return false;
+                  changed = true;
+                  return true;
+            });
+            return changed;
+      }
+
+      // Global value numbering over the dominator tree: a pure instruction computing what one in a dominating
+      // position already did (same operation, type, constant and operands, in either order for commutative ones)
+      // is replaced by it.
+      inline bool number_values(Function& fn) {
+            struct Key {
+                  Opcode op;
+                  Type type;
+                  int64_t integer;
+                  uint64_t real;
+                  ValueId a, b;
+
+                  bool operator==(const Key&) const = default;
+            };
+            struct KeyHash {
+                  size_t operator()(const Key& k) const {
+                        const uint64_t words[] = {static_cast<uint64_t>(k.op) << 16 | static_cast<uint64_t>(k.type),
+                                                  static_cast<uint64_t>(k.integer), k.real,
+                                                  uint64_t{k.a} << 32 | k.b};
+                        return static_cast<size_t>(xxh64::hash(words, sizeof(words), 0));
+                  }
+            };
+
+            const std::vector<BlockId> idom = dominators(fn);
+            std::vector<std::vector<BlockId>> children(fn.blocks.size());
+            for (BlockId b = 1; b < fn.blocks.size(); b++) {
+                  if (idom[b] != UINT32_MAX)
+                        children[idom[b]].push_back(b);
+            }
+
+            std::unordered_map<ValueId, ValueId> replace;
+            const auto resolve = [&replace](const ValueId v) {
+                  const auto it = replace.find(v);
+                  return it == replace.end() ? v : it->second;
+            };
+            // what the blocks from the root to the current one computed
+            std::unordered_map<Key, ValueId, KeyHash> table;
+            const auto visit = [&](const BlockId block, std::vector<Key>& added) {
+                  for (const ValueId id : fn.blocks[block].insts) {
+                        const Inst& inst = fn.values[id];
+                        if (!is_pure(inst.op) || inst.operands.size() > 2)
+                              continue;
+                        Key key{inst.op, inst.type, inst.integer, std::bit_cast<uint64_t>(inst.real),
+                                inst.operands.empty() ? UINT32_MAX : resolve(inst.operands[0]),
+                                inst.operands.size() < 2 ? UINT32_MAX : resolve(inst.operands[1])};
+                        const bool commutative = inst.op == Opcode::add || inst.op == Opcode::mul ||
+                                                 inst.op == Opcode::bit_and || inst.op == Opcode::bit_or ||
+                                                 inst.op == Opcode::eq || inst.op == Opcode::ne;
+                        if (commutative && key.b < key.a)
+                              std::swap(key.a, key.b);
+                        const auto [it, inserted] = table.try_emplace(key, id);
+                        if (inserted)
+                              added.push_back(key);
+                        else
+                              replace[id] = it->second;
+                  }
+            };
+
+            // depth first, each block's entries taken out of the table again once its subtree is done
+            std::vector<std::pair<BlockId, std::vector<Key>>> stack;
+            std::vector<size_t> next(fn.blocks.size(), 0);
+            stack.push_back({0, {}});
+            visit(0, stack.back().second);
+            while (!stack.empty()) {
+                  const BlockId block = stack.back().first;
+                  if (next[block] < children[block].size()) {
+                        const BlockId child = children[block][next[block]++];
+                        stack.push_back({child, {}});
+                        visit(child, stack.back().second);
+                        continue;
+                  }
+                  for (const Key& key : stack.back().second)
+                        table.erase(key);
+                  stack.pop_back();
+            }
+
+            if (replace.empty())
+                  return false;
+            substitute(fn, replace);
+            remove_if(fn, [&replace](const ValueId id) { return replace.contains(id); });
+            return true;
+      }
+
+      // Inlines calls to functions of one block and at most `max_insts` instructions, other than to themselves: the
+      // callee's instructions are copied in front of the call, which becomes a copy of the callee's result for
+      // propagate_copies to remove. A module pass, it reads other functions while changing one.
+      inline bool inline_small_functions(Module& module, const size_t max_insts = 24) {
+            const auto inlinable = [&](const uint32_t callee, const uint32_t caller) {
+                  const Function& fn = module.functions[callee];
+                  return callee != caller && fn.blocks.size() == 1 && fn.blocks[0].insts.size() <= max_insts &&
+                         std::ranges::none_of(fn.blocks[0].insts, [&](const ValueId id) {
+                               return fn.values[id].op == Opcode::call &&
+                                      fn.values[id].integer == static_cast<int64_t>(callee);
+                         });
+            };
+
+            bool changed = false;
+            for (uint32_t f = 0; f < module.functions.size(); f++) {
+                  Function& fn = module.functions[f];
+                  for (BlockId b = 0; b < fn.blocks.size(); b++) {
+                        std::vector<ValueId> insts;
+                        for (const ValueId id : fn.blocks[b].insts) {
+                              Inst& call = fn.values[id];
+                              const auto callee = static_cast<uint32_t>(call.integer);
+                              if (call.op != Opcode::call || !inlinable(callee, f)) {
+                                    insts.push_back(id);
+                                    continue;
+                              }
+                              const Function& source = module.functions[callee];
+                              std::unordered_map<ValueId, ValueId> map;
+                              ValueId result = 0;
+                              const std::vector<ValueId> args = call.operands;
+                              for (const ValueId sid : source.blocks[0].insts) {
+                                    const Inst& inst = source.values[sid];
+                                    if (inst.op == Opcode::param) {
+                                          map[sid] = args[static_cast<size_t>(inst.integer)];
+                                          continue;
+                                    }
+                                    if (inst.op == Opcode::ret) {
+                                          result = map.at(inst.operands[0]);
+                                          continue;
+                                    }
+                                    Inst copy = inst;
+                                    copy.block = b;
+                                    for (ValueId& operand : copy.operands)
+                                          operand = map.at(operand);
+                                    fn.values.push_back(std::move(copy));
+                                    map[sid] = static_cast<ValueId>(fn.values.size() - 1);
+                                    insts.push_back(map[sid]);
+                              }
+                              // `call` may have moved with the push_backs
+                              Inst& done = fn.values[id];
+                              done.op = Opcode::copy;
+                              done.operands = {result};
+                              done.integer = 0;
+                              insts.push_back(id);
+                              changed = true;
+                        }
+                        fn.blocks[b].insts = std::move(insts);
+                  }
+            }
+            return changed;
+      }
+
+      // Runs passes over a module in order. A function pass changes one function at a time and runs on every
+      // function at once when there's a thread pool; a module pass may look at all of them and runs alone.
+      class PassManager {
+            struct Pass {
+                  std::string_view name;
+                  std::function<bool(Function&)> function;
+                  std::function<bool(Module&)> module;
+            };
+
+            std::vector<Pass> m_passes;
+            ThreadPool* m_pool;
+
+        public:
+            // how often each pass changed something, in the order they were added
+            std::vector<std::pair<std::string_view, size_t>> changes;
+
+            explicit PassManager(ThreadPool* pool = nullptr) : m_pool(pool) {}
+
+            PassManager& add(const std::string_view name, std::function<bool(Function&)> pass) {
+                  m_passes.push_back({name, std::move(pass), {}});
+                  return *this;
+            }
+
+            PassManager& add_module_pass(const std::string_view name, std::function<bool(Module&)> pass) {
+                  m_passes.push_back({name, {}, std::move(pass)});
+                  return *this;
+            }
+
+            // inlining, then cleaning up after it
+            static PassManager standard(ThreadPool* pool = nullptr) {
+                  PassManager pm(pool);
+                  pm.add_module_pass("inline", [](Module& m) { return inline_small_functions(m); });
+                  pm.add("copy-propagation", propagate_copies);
+                  pm.add("gvn", number_values);
+                  pm.add("copy-propagation", propagate_copies);
+                  pm.add("dce", eliminate_dead_code);
+                  return pm;
+            }
+
+            void run(Module& module) {
+                  changes.clear();
+                  for (const Pass& pass : m_passes) {
+                        size_t changed = 0;
+                        if (pass.module) {
+                              changed = pass.module(module);
+                        } else if (m_pool && module.functions.size() > 1) {
+                              std::vector<uint8_t> results(module.functions.size(), 0);
+                              for (size_t i = 0; i < module.functions.size(); i++) {
+                                    m_pool->submit([&pass, &module, &results, i](size_t) {
+                                          results[i] = pass.function(module.functions[i]);
+                                    });
+                              }
+                              m_pool->wait();
+                              changed = static_cast<size_t>(std::ranges::count(results, 1));
+                        } else {
+                              for (Function& fn : module.functions)
+                                    changed += pass.function(fn);
+                        }
+                        changes.emplace_back(pass.name, changed);
+                  }
+            }
+      };
+} // namespace ir
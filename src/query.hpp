@@ -0,0 +1,502 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "./diagnostics.hpp"
+#include "./incremental.hpp"
+#include "./sema.hpp"
+
+// Memoized queries with dependency tracking, as rustc and Salsa do them. Inputs are set from outside, every change to
+// one starts a new revision. A query's value is kept with the queries and inputs it read while computing it; asked
+// for again in a later revision, it's computed again only if one of those changed since, and if it then comes out
+// the same as before, the queries that read it don't have to be (the "early cutoff"). Not thread-safe.
+class QueryEngine {
+      struct Slot {
+            // computes the value again and says whether it came out different; null for an input
+            std::function<bool()> execute;
+            std::vector<uint32_t> deps;
+            // the revision it was last known current in, and the one its value last changed in
+            uint64_t verified = 0;
+            uint64_t changed = 0;
+            bool active = false;
+      };
+
+      // a deque, so a Slot stays put while the queries it reads add theirs
+      std::deque<Slot> m_slots;
+      uint64_t m_revision = 1;
+      // where the query being computed records what it reads
+      std::vector<uint32_t>* m_reads = nullptr;
+      size_t m_executed = 0;
+
+  public:
+      QueryEngine() = default;
+      QueryEngine(const QueryEngine&) = delete;
+      QueryEngine& operator=(const QueryEngine&) = delete;
+
+      uint32_t add(std::function<bool()> execute) {
+            Slot slot;
+            slot.execute = std::move(execute);
+            m_slots.push_back(std::move(slot));
+            return static_cast<uint32_t>(m_slots.size() - 1);
+      }
+
+      // An input got a new value.
+      void changed(const uint32_t input) {
+            m_revision++;
+            m_slots[input].changed = m_revision;
+            m_slots[input].verified = m_revision;
+      }
+
+      // Brings `id` up to date and records that the query being computed, if any, read it.
+      void read(const uint32_t id) {
+            refresh(id);
+            if (m_reads)
+                  m_reads->push_back(id);
+      }
+
+      [[nodiscard]] uint64_t revision() const { return m_revision; }
+      // how many times any query was computed
+      [[nodiscard]] size_t executed() const { return m_executed; }
+
+  private:
+      // The revision the value of `id` last changed in, once it's current.
+      uint64_t refresh(const uint32_t id) {
+            Slot& slot = m_slots[id];
+            // a query that reads itself sees what it had before
+            if (!slot.execute || slot.verified == m_revision || slot.active)
+                  return slot.changed;
+            slot.active = true;
+            if (slot.verified != 0) {
+                  const bool stale = std::ranges::any_of(slot.deps, [&](const uint32_t dep) {
+                        return refresh(dep) > slot.verified;
+                  });
+                  if (!stale) {
+                        slot.active = false;
+                        slot.verified = m_revision;
+                        return slot.changed;
+                  }
+            }
+
+            std::vector<uint32_t> reads;
+            std::vector<uint32_t>* outer = std::exchange(m_reads, &reads);
+            const bool different = slot.execute();
+            m_reads = outer;
+            m_executed++;
+            slot.deps = std::move(reads);
+            slot.active = false;
+            slot.verified = m_revision;
+            if (different)
+                  slot.changed = m_revision;
+            return slot.changed;
+      }
+};
+
+// A value per key that queries can read, set from outside.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class QueryInput {
+      struct Entry {
+            uint32_t slot;
+            Value value;
+      };
+
+      QueryEngine& m_engine;
+      std::unordered_map<Key, Entry, Hash> m_entries;
+
+  public:
+      explicit QueryInput(QueryEngine& engine) : m_engine(engine) {}
+
+      void set(const Key& key, Value value) {
+            auto it = m_entries.find(key);
+            if (it == m_entries.end())
+                  it = m_entries.emplace(key, Entry{m_engine.add(nullptr), std::move(value)}).first;
+            else if (it->second.value == value)
+                  return;
+            else
+                  it->second.value = std::move(value);
+            m_engine.changed(it->second.slot);
+      }
+
+      // `key` must have been set.
+      const Value& get(const Key& key) {
+            const Entry& entry = m_entries.at(key);
+            m_engine.read(entry.slot);
+            return entry.value;
+      }
+};
+
+// A value per key computed by `compute`, which reads other queries and inputs through their get(). What get()
+// returns stays valid until the next revision.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class Query {
+      struct Entry {
+            uint32_t slot;
+            std::optional<Value> value;
+      };
+
+      QueryEngine& m_engine;
+      std::function<Value(const Key&)> m_compute;
+      // unordered_map doesn't move its elements, so the slots can point at theirs
+      std::unordered_map<Key, Entry, Hash> m_entries;
+      size_t m_executions = 0;
+
+  public:
+      Query(QueryEngine& engine, std::function<Value(const Key&)> compute) :
+          m_engine(engine), m_compute(std::move(compute)) {}
+
+      const Value& get(const Key& key) {
+            auto it = m_entries.find(key);
+            if (it == m_entries.end()) {
+                  it = m_entries.try_emplace(key).first;
+                  auto* entry = &*it;
+                  entry->second.slot = m_engine.add([this, entry] {
+                        Value value = m_compute(entry->first);
+                        m_executions++;
+                        const bool different = !entry->second.value || !(*entry->second.value == value);
+                        // kept even when equal: it may hold what changed in ways equality doesn't look at
+                        entry->second.value = std::move(value);
+                        return different;
+                  });
+            }
+            m_engine.read(it->second.slot);
+            // read through a cycle while it's first computed: like a query that reads itself, it sees what it had
+            // before, which is nothing yet
+            if (!it->second.value) {
+                  static const Value none{};
+                  return none;
+            }
+            return *it->second.value;
+      }
+
+      // how many times this query was computed, for any key
+      [[nodiscard]] size_t executions() const { return m_executions; }
+};
+
+// The front-end as queries over open Documents, for an editor: what an edit costs is re-lexing and re-parsing around
+// it (incremental.hpp), checking the top-level statements and prototypes of its file again, and checking again only
+// the bodies that were re-parsed or that call a function whose signature, or read a global whose type, changed.
+// Editing only a body therefore re-checks that body alone. A function's diagnostics are kept relative to its first
+// token, so moving it doesn't make them stale. Functions are looked up per file, a second definition of one isn't
+// checked beyond its prototype, and types are only on the nodes of bodies checked since they were parsed. Names a
+// file doesn't declare are looked up in the open files it imports, as set_imports() says which those are.
+class Workspace {
+      // a name in a file
+      using Name = std::pair<std::string, std::string>;
+
+      struct NameHash {
+            size_t operator()(const Name& n) const {
+                  const std::hash<std::string> h;
+                  return h(n.first) * 31 + h(n.second);
+            }
+      };
+
+      struct Declared {
+            std::unordered_map<std::string, FunctionTable::Entry> functions;
+            std::vector<Diagnostic> diagnostics;
+            bool operator==(const Declared&) const = default;
+      };
+
+      struct Globals {
+            std::unordered_map<std::string, Type> types;
+            std::vector<Diagnostic> diagnostics;
+            bool operator==(const Globals&) const = default;
+      };
+
+      // The item that defines a function. Only which parse made it matters: a reused item is the same function
+      // wherever it moved to, so `index` isn't compared.
+      struct Definition {
+            uint64_t document = 0;
+            uint64_t serial = UINT64_MAX;
+            size_t index = 0;
+            bool operator==(const Definition& o) const { return document == o.document && serial == o.serial; }
+      };
+
+      struct Open {
+            std::unique_ptr<Document> document;
+            // which open() made it, since serials start over in every Document
+            uint64_t generation;
+      };
+
+      // How bodies see the functions and globals of their file: through the queries, so what they look up is what
+      // they depend on.
+      class Resolver final : public Declarations {
+            Workspace& m_workspace;
+            const std::string& m_path;
+            // for the top-level statements, which declare the globals rather than look them up
+            bool m_top_level;
+
+        public:
+            Resolver(Workspace& workspace, const std::string& path, const bool top_level = false) :
+                m_workspace(workspace), m_path(path), m_top_level(top_level) {}
+
+            [[nodiscard]] const FunctionType* function(const std::string_view name) const override {
+                  const std::string key(name);
+                  if (const std::optional<FunctionType>& fn = m_workspace.m_signature.get({m_path, key}))
+                        return &*fn;
+                  for (const std::string& import : m_workspace.m_imports.get(m_path)) {
+                        if (const std::optional<FunctionType>& fn = m_workspace.m_signature.get({import, key}))
+                              return &*fn;
+                  }
+                  return nullptr;
+            }
+
+            [[nodiscard]] std::optional<Type> global(const std::string_view name) const override {
+                  const std::string key(name);
+                  if (!m_top_level) {
+                        if (const std::optional<Type>& type = m_workspace.m_global.get({m_path, key}))
+                              return type;
+                  }
+                  for (const std::string& import : m_workspace.m_imports.get(m_path)) {
+                        if (const std::optional<Type>& type = m_workspace.m_global.get({import, key}))
+                              return type;
+                  }
+                  return std::nullopt;
+            }
+      };
+
+      QueryEngine m_engine;
+      // every open file's, so types mean the same in all of them
+      std::shared_ptr<TypeTable> m_types = std::make_shared<TypeTable>();
+      std::unordered_map<std::string, Open> m_open;
+      uint64_t m_generations = 0;
+
+      // bumped on every change to a document
+      QueryInput<std::string, uint64_t> m_version{m_engine};
+      // the open files each file imports, in import order
+      QueryInput<std::string, std::vector<std::string>> m_imports{m_engine};
+      // the prototypes of a file, and what's wrong with them
+      Query<std::string, Declared> m_declared{m_engine, [this](const std::string& path) { return declare(path); }};
+      Query<Name, std::optional<FunctionType>, NameHash> m_signature{m_engine, [this](const Name& n) {
+            const Declared& declared = m_declared.get(n.first);
+            const auto it = declared.functions.find(n.second);
+            return it == declared.functions.end() ? std::nullopt : std::optional(it->second.type);
+      }};
+      // the top-level statements of a file, checked in order, and the globals they declare
+      Query<std::string, Globals> m_globals{m_engine, [this](const std::string& path) { return check_globals(path); }};
+      Query<Name, std::optional<Type>, NameHash> m_global{m_engine, [this](const Name& n) {
+            const Globals& globals = m_globals.get(n.first);
+            const auto it = globals.types.find(n.second);
+            return it == globals.types.end() ? std::nullopt : std::optional(it->second);
+      }};
+      Query<Name, Definition, NameHash> m_definition{m_engine, [this](const Name& n) { return define(n); }};
+      // a body's diagnostics, relative to its item's first token as it was parsed
+      Query<Name, std::vector<Diagnostic>, NameHash> m_checked{m_engine, [this](const Name& n) { return check(n); }};
+      Query<std::string, std::vector<Diagnostic>> m_diagnostics{m_engine,
+                                                                [this](const std::string& p) { return collect(p); }};
+
+  public:
+      // Opens `path` with `text`, or starts it over if it's open.
+      void open(const std::string& path, std::string text) {
+            const bool reopened = m_open.contains(path);
+            m_open[path] = {std::make_unique<Document>(std::move(text), m_types), ++m_generations};
+            m_version.set(path, m_generations);
+            if (!reopened)
+                  m_imports.set(path, {});
+      }
+
+      // What `path`, which must be open, imports: open files, which may import it in turn.
+      void set_imports(const std::string& path, std::vector<std::string> imports) {
+            m_imports.set(path, std::move(imports));
+      }
+
+      // `path` must be open.
+      std::optional<LexerError> edit(const std::string& path, const TextEdit& e) {
+            Open& open = m_open.at(path);
+            const std::optional<LexerError> err = open.document->edit(e);
+            m_version.set(path, ++m_generations);
+            return err;
+      }
+
+      [[nodiscard]] const Document* document(const std::string& path) const {
+            const auto it = m_open.find(path);
+            return it == m_open.end() ? nullptr : it->second.document.get();
+      }
+
+      // What type checking `path` reports, in source order.
+      const std::vector<Diagnostic>& diagnostics(const std::string& path) { return m_diagnostics.get(path); }
+
+      std::optional<FunctionType> signature(const std::string& path, const std::string& function) {
+            return m_signature.get({path, function});
+      }
+
+      // The type of the innermost expression at `offset`, once what it's in is checked.
+      std::optional<Type> type_at(const std::string& path, const size_t offset) {
+            const Document& doc = read(path);
+            for (const Document::Item& item : doc.items()) {
+                  const uint32_t start = doc.tokens().offset(item.first);
+                  const uint32_t end = item.last < doc.tokens().size() ? doc.tokens().offset(item.last) : UINT32_MAX;
+                  if (!item.node || offset < start || offset >= end)
+                        continue;
+                  if (item.node->kind == NodeKind::function)
+                        m_checked.get({path, std::string(static_cast<const FunctionNode*>(item.node)->Proto->name)});
+                  else
+                        m_globals.get(path);
+                  const ASTNode* node = innermost(Document::text_of(item), offset - start + item.parsed_at, item.node);
+                  if (!node)
+                        return std::nullopt;
+                  if (node->kind == NodeKind::function)
+                        return static_cast<const FunctionNode*>(node)->Proto->type;
+                  if (node->kind == NodeKind::prototype)
+                        return static_cast<const PrototypeNode*>(node)->type;
+                  return node->type;
+            }
+            return std::nullopt;
+      }
+
+      // how many times a function body was type checked, to see what an edit cost
+      [[nodiscard]] size_t bodies_checked() const { return m_checked.executions(); }
+      [[nodiscard]] const QueryEngine& engine() const { return m_engine; }
+
+  private:
+      const Document& read(const std::string& path) {
+            m_version.get(path);
+            return *m_open.at(path).document;
+      }
+
+      // Diagnostics an item's nodes report, moved from where it was parsed to where it is now.
+      static void rebase(const Document& doc, const Document::Item& item, const std::vector<Diagnostic>& found,
+                         const int64_t from, std::vector<Diagnostic>& out) {
+            const int64_t delta = static_cast<int64_t>(doc.tokens().offset(item.first)) - from;
+            for (const Diagnostic& d : found)
+                  out.push_back({d.error, static_cast<uint32_t>(d.offset + delta), d.length});
+      }
+
+      Declared declare(const std::string& path) {
+            const Document& doc = read(path);
+            FunctionTable table;
+            Declared declared;
+            for (const Document::Item& item : doc.items()) {
+                  const NodeKind kind = item.node ? item.node->kind : NodeKind::null;
+                  if (kind != NodeKind::function && kind != NodeKind::prototype)
+                        continue;
+                  const PrototypeNode& proto = kind == NodeKind::function
+                                                       ? *static_cast<const FunctionNode*>(item.node)->Proto
+                                                       : *static_cast<const PrototypeNode*>(item.node);
+                  Diagnostics found;
+                  table.declare(proto, kind == NodeKind::function, [&](const SemaError e, const ASTNode* at) {
+                        const auto [offset, length] = node_location(Document::text_of(item), 0, at);
+                        found.report(e, offset, length);
+                  });
+                  rebase(doc, item, found.list(), item.parsed_at, declared.diagnostics);
+            }
+            for (const auto& [name, entry] : table.entries())
+                  declared.functions.emplace(name, entry);
+            return declared;
+      }
+
+      Globals check_globals(const std::string& path) {
+            const Document& doc = read(path);
+            const Resolver resolver(*this, path, true);
+            std::unordered_map<std::string_view, Type> types;
+            Globals globals;
+            for (const Document::Item& item : doc.items()) {
+                  if (!item.node)
+                        continue;
+                  Diagnostics found;
+                  BodyChecker(Document::text_of(item), 0, resolver, found, &types).statement(item.node);
+                  rebase(doc, item, found.list(), item.parsed_at, globals.diagnostics);
+            }
+            for (const auto& [name, type] : types)
+                  globals.types.emplace(name, type);
+            return globals;
+      }
+
+      Definition define(const Name& n) {
+            const Document& doc = read(n.first);
+            const std::vector<Document::Item>& items = doc.items();
+            for (size_t i = 0; i < items.size(); i++) {
+                  if (items[i].node && items[i].node->kind == NodeKind::function &&
+                      static_cast<const FunctionNode*>(items[i].node)->Proto->name == n.second)
+                        return {m_open.at(n.first).generation, items[i].serial, i};
+            }
+            return {};
+      }
+
+      std::vector<Diagnostic> check(const Name& n) {
+            const Definition& def = m_definition.get(n);
+            if (def.serial == UINT64_MAX)
+                  return {};
+            const Document::Item& item = m_open.at(n.first).document->items()[def.index];
+            Diagnostics found;
+            BodyChecker(Document::text_of(item), 0, Resolver(*this, n.first), found)
+                    .function(*static_cast<FunctionNode*>(item.node));
+            std::vector<Diagnostic> relative;
+            for (const Diagnostic& d : found.list())
+                  relative.push_back({d.error, d.offset - item.parsed_at, d.length});
+            return relative;
+      }
+
+      std::vector<Diagnostic> collect(const std::string& path) {
+            const Document& doc = read(path);
+            std::vector<Diagnostic> out = m_declared.get(path).diagnostics;
+            const std::vector<Diagnostic>& top = m_globals.get(path).diagnostics;
+            out.insert(out.end(), top.begin(), top.end());
+            for (const Document::Item& item : doc.items()) {
+                  if (!item.node || item.node->kind != NodeKind::function)
+                        continue;
+                  const Name n{path, std::string(static_cast<const FunctionNode*>(item.node)->Proto->name)};
+                  if (m_definition.get(n).serial == item.serial)
+                        rebase(doc, item, m_checked.get(n), 0, out);
+            }
+            std::ranges::stable_sort(out, {}, &Diagnostic::offset);
+            return out;
+      }
+
+      // The smallest node under `node` whose location in `text` holds `offset`.
+      static const ASTNode* innermost(const std::string_view text, const size_t offset, const ASTNode* node) {
+            const ASTNode* best = nullptr;
+            size_t best_length = SIZE_MAX;
+            const std::function<void(const ASTNode*)> visit = [&](const ASTNode* n) {
+                  if (!n)
+                        return;
+                  const auto [at, length] = node_location(text, 0, n);
+                  if (offset >= at && offset < at + length && length <= best_length) {
+                        best = n;
+                        best_length = length;
+                  }
+                  switch (n->kind) {
+                        case NodeKind::binary:
+                              visit(static_cast<const BinaryOperation*>(n)->left);
+                              visit(static_cast<const BinaryOperation*>(n)->right);
+                              break;
+                        case NodeKind::unary:
+                              visit(static_cast<const UnaryOperation*>(n)->node);
+                              break;
+                        case NodeKind::variable:
+                              visit(static_cast<const VariableNode*>(n)->val);
+                              break;
+                        case NodeKind::call:
+                              for (const ASTNode* arg : static_cast<const CallNode*>(n)->args)
+                                    visit(arg);
+                              break;
+                        case NodeKind::comptime:
+                              for (const ASTNode* stmt : static_cast<const ComptimeNode*>(n)->body)
+                                    visit(stmt);
+                              break;
+                        case NodeKind::function: {
+                              const auto* fn = static_cast<const FunctionNode*>(n);
+                              visit(fn->Proto);
+                              for (const ASTNode* stmt : fn->body())
+                                    visit(stmt);
+                              break;
+                        }
+                        case NodeKind::prototype:
+                              for (const VariableNode* param : static_cast<const PrototypeNode*>(n)->args)
+                                    visit(param);
+                              break;
+                        default:
+                              break;
+                  }
+            };
+            visit(node);
+            return best;
+      }
+};
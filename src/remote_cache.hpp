@@ -0,0 +1,372 @@
+#pragma once
+#if defined(__unix__) || defined(__APPLE__)
+#define NANO_HAS_SOCKETS 1
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#else
+#define NANO_HAS_SOCKETS 0
+#endif
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "./hash.hpp"
+
+// A blob in a content-addressed store: the SHA-256 of its bytes, in hex, and how many there are.
+struct BlobDigest {
+      std::string hash;
+      uint64_t size = 0;
+
+      static BlobDigest of(const std::string_view bytes) { return {Sha256::hex(Sha256::hash(bytes)), bytes.size()}; }
+      bool operator==(const BlobDigest&) const = default;
+};
+
+// The outputs of one action, as the Bazel remote execution API's ActionResult message has them: each a path and
+// the digest of its contents. Only output_files (field 2) is written or read, which is all a cache needs of it.
+struct ActionOutputs {
+      struct File {
+            std::string path;
+            BlobDigest digest;
+            bool operator==(const File&) const = default;
+      };
+      std::vector<File> files;
+
+      [[nodiscard]] const BlobDigest* find(const std::string_view path) const {
+            for (const File& f : files) {
+                  if (f.path == path)
+                        return &f.digest;
+            }
+            return nullptr;
+      }
+
+      // protobuf wire format: ActionResult { repeated OutputFile output_files = 2; }, OutputFile { string path = 1;
+      // Digest digest = 2; }, Digest { string hash = 1; int64 size_bytes = 2; }
+      [[nodiscard]] std::string encode() const {
+            std::string out;
+            for (const File& f : files) {
+                  std::string digest;
+                  bytes_field(digest, 1, f.digest.hash);
+                  varint_field(digest, 2, f.digest.size);
+                  std::string file;
+                  bytes_field(file, 1, f.path);
+                  bytes_field(file, 2, digest);
+                  bytes_field(out, 2, file);
+            }
+            return out;
+      }
+
+      // nullopt for what isn't a well-formed message; fields it doesn't know are skipped
+      static std::optional<ActionOutputs> decode(const std::string_view in) {
+            const auto digest_of = [](const std::string_view message, BlobDigest& d) {
+                  return fields(message, [&](const uint32_t field, const uint64_t number, const std::string_view text) {
+                        if (field == 1)
+                              d.hash = text;
+                        else if (field == 2)
+                              d.size = number;
+                        return true;
+                  });
+            };
+            const auto file_of = [&](const std::string_view message, File& f) {
+                  return fields(message, [&](const uint32_t field, uint64_t, const std::string_view bytes) {
+                        if (field == 1)
+                              f.path = bytes;
+                        else if (field == 2)
+                              return digest_of(bytes, f.digest);
+                        return true;
+                  });
+            };
+            ActionOutputs result;
+            const bool ok = fields(in, [&](const uint32_t field, uint64_t, const std::string_view bytes) {
+                  if (field != 2)
+                        return true;
+                  result.files.emplace_back();
+                  return file_of(bytes, result.files.back());
+            });
+            return ok ? std::optional(std::move(result)) : std::nullopt;
+      }
+
+  private:
+      static void varint(std::string& out, uint64_t v) {
+            for (; v >= 0x80; v >>= 7)
+                  out += static_cast<char>((v & 0x7f) | 0x80);
+            out += static_cast<char>(v);
+      }
+
+      static void varint_field(std::string& out, const uint32_t field, const uint64_t v) {
+            varint(out, uint64_t{field} << 3);
+            varint(out, v);
+      }
+
+      static void bytes_field(std::string& out, const uint32_t field, const std::string_view bytes) {
+            varint(out, uint64_t{field} << 3 | 2);
+            varint(out, bytes.size());
+            out += bytes;
+      }
+
+      static bool read_varint(std::string_view& in, uint64_t& v) {
+            v = 0;
+            for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+                  const auto b = static_cast<unsigned char>(in.front());
+                  in.remove_prefix(1);
+                  v |= uint64_t{b & 0x7fu} << shift;
+                  if (!(b & 0x80))
+                        return true;
+            }
+            return false;
+      }
+
+      // Calls `each(field, number, bytes)` for every varint or length-delimited field of `in`, until it returns
+      // false. Fixed-size fields are skipped.
+      template<typename Each>
+      static bool fields(std::string_view in, Each&& each) {
+            while (!in.empty()) {
+                  uint64_t tag, v;
+                  if (!read_varint(in, tag))
+                        return false;
+                  const auto field = static_cast<uint32_t>(tag >> 3);
+                  switch (tag & 7) {
+                        case 0:
+                              if (!read_varint(in, v) || !each(field, v, {}))
+                                    return false;
+                              break;
+                        case 1:
+                        case 5: {
+                              const size_t size = (tag & 7) == 1 ? 8 : 4;
+                              if (in.size() < size)
+                                    return false;
+                              in.remove_prefix(size);
+                              break;
+                        }
+                        case 2:
+                              if (!read_varint(in, v) || v > in.size() || !each(field, 0, in.substr(0, v)))
+                                    return false;
+                              in.remove_prefix(v);
+                              break;
+                        default:
+                              return false;
+                  }
+            }
+            return true;
+      }
+};
+
+// A client of a cache speaking the Bazel remote cache's HTTP protocol (bazel-remote, nginx with WebDAV, and the
+// like): `GET` and `PUT` of `/ac/<sha256>` for the outputs of an action, serialized as an ActionResult, and of
+// `/cas/<sha256>` for blobs, under the URL's path. Only plain http://: a TLS or gRPC cache needs a proxy in front.
+// Every request is its own connection with a timeout, and anything that goes wrong is a miss: a cache that's down
+// costs a build no more than a cold cache. Without BSD sockets everything misses. Safe to use from many threads.
+class RemoteCache {
+      std::string m_host;
+      std::string m_port;
+      std::string m_prefix;
+      int m_timeout_ms;
+      mutable std::atomic<size_t> m_hits = 0;
+      mutable std::atomic<size_t> m_misses = 0;
+      mutable std::atomic<size_t> m_uploads = 0;
+
+  public:
+      // nullopt unless `url` is http://host[:port][/path]
+      static std::optional<RemoteCache> connect(const std::string_view url, const int timeout_ms = 10000) {
+            constexpr std::string_view scheme = "http://";
+            if (!url.starts_with(scheme))
+                  return std::nullopt;
+            std::string_view rest = url.substr(scheme.size());
+            const size_t slash = rest.find('/');
+            std::string_view authority = rest.substr(0, slash);
+            std::string prefix(slash == std::string_view::npos ? "" : rest.substr(slash));
+            while (prefix.ends_with('/'))
+                  prefix.pop_back();
+            const size_t colon = authority.rfind(':');
+            std::string port = "80";
+            if (colon != std::string_view::npos) {
+                  port = authority.substr(colon + 1);
+                  authority = authority.substr(0, colon);
+            }
+            if (authority.empty() || port.empty())
+                  return std::nullopt;
+            return RemoteCache(std::string(authority), std::move(port), std::move(prefix), timeout_ms);
+      }
+
+      RemoteCache(const RemoteCache& o) :
+          m_host(o.m_host), m_port(o.m_port), m_prefix(o.m_prefix), m_timeout_ms(o.m_timeout_ms) {}
+
+      [[nodiscard]] std::optional<ActionOutputs> get_action(const std::string& key) const {
+            std::optional<std::string> body = get("/ac/" + key);
+            std::optional<ActionOutputs> outputs = body ? ActionOutputs::decode(*body) : std::nullopt;
+            (outputs ? m_hits : m_misses)++;
+            return outputs;
+      }
+
+      // nullopt unless the blob is there and is what `digest` says
+      [[nodiscard]] std::optional<std::string> get_blob(const BlobDigest& digest) const {
+            std::optional<std::string> body = get("/cas/" + digest.hash);
+            if (!body || BlobDigest::of(*body) != digest)
+                  return std::nullopt;
+            return body;
+      }
+
+      // Uploads every blob, then the action that names them, so no reader sees an action without its outputs.
+      bool put_action(const std::string& key,
+                      const std::vector<std::pair<std::string, std::string_view>>& files) const {
+            ActionOutputs outputs;
+            for (const auto& [path, bytes] : files) {
+                  outputs.files.push_back({path, BlobDigest::of(bytes)});
+                  if (!put("/cas/" + outputs.files.back().digest.hash, bytes))
+                        return false;
+            }
+            if (!put("/ac/" + key, outputs.encode()))
+                  return false;
+            m_uploads++;
+            return true;
+      }
+
+      [[nodiscard]] size_t hits() const { return m_hits; }
+      [[nodiscard]] size_t misses() const { return m_misses; }
+      [[nodiscard]] size_t uploads() const { return m_uploads; }
+
+  private:
+      RemoteCache(std::string host, std::string port, std::string prefix, const int timeout_ms) :
+          m_host(std::move(host)), m_port(std::move(port)), m_prefix(std::move(prefix)), m_timeout_ms(timeout_ms) {}
+
+      [[nodiscard]] std::optional<std::string> get(const std::string& path) const {
+            int status = 0;
+            std::optional<std::string> body = request("GET", path, {}, status);
+            return status == 200 ? body : std::nullopt;
+      }
+
+      [[nodiscard]] bool put(const std::string& path, const std::string_view bytes) const {
+            int status = 0;
+            return request("PUT", path, bytes, status) && status >= 200 && status < 300;
+      }
+
+      // One HTTP/1.1 exchange on a fresh connection; the body of the response, or nullopt if there was none.
+      std::optional<std::string> request(const std::string_view method, const std::string& path,
+                                         const std::string_view body, int& status) const {
+#if NANO_HAS_SOCKETS
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* found = nullptr;
+            if (::getaddrinfo(m_host.c_str(), m_port.c_str(), &hints, &found) != 0)
+                  return std::nullopt;
+            int fd = -1;
+            for (const addrinfo* ai = found; ai && fd < 0; ai = ai->ai_next) {
+                  fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+                  if (fd < 0)
+                        continue;
+                  const timeval tv{m_timeout_ms / 1000, m_timeout_ms % 1000 * 1000};
+                  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                  ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+                  if (::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+                        ::close(fd);
+                        fd = -1;
+                  }
+            }
+            ::freeaddrinfo(found);
+            if (fd < 0)
+                  return std::nullopt;
+
+            std::string out(method);
+            out += " " + m_prefix + path + " HTTP/1.1\r\nHost: " + m_host + "\r\nConnection: close\r\n";
+            if (method == "PUT")
+                  out += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+            out += "\r\n";
+            out += body;
+            std::string in;
+            if (!send_all(fd, out) || !receive_all(fd, in)) {
+                  ::close(fd);
+                  return std::nullopt;
+            }
+            ::close(fd);
+            return parse_response(in, status);
+#else
+            // every request misses
+            return std::nullopt;
+#endif
+      }
+
+#if NANO_HAS_SOCKETS
+      static bool send_all(const int fd, const std::string_view bytes) {
+            for (size_t sent = 0; sent < bytes.size();) {
+                  const ssize_t n = ::send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+                  if (n < 0 && errno == EINTR)
+                        continue;
+                  if (n <= 0)
+                        return false;
+                  sent += static_cast<size_t>(n);
+            }
+            return true;
+      }
+
+      // until the server closes the connection, as `Connection: close` asks it to
+      static bool receive_all(const int fd, std::string& in) {
+            char buffer[16 * 1024];
+            for (;;) {
+                  const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+                  if (n < 0 && errno == EINTR)
+                        continue;
+                  if (n < 0)
+                        return false;
+                  if (n == 0)
+                        return true;
+                  in.append(buffer, static_cast<size_t>(n));
+            }
+      }
+
+#endif
+
+      static std::optional<std::string> parse_response(const std::string_view in, int& status) {
+            const size_t head_end = in.find("\r\n\r\n");
+            if (!in.starts_with("HTTP/1.") || head_end == std::string_view::npos || in.size() < 12)
+                  return std::nullopt;
+            status = std::atoi(std::string(in.substr(9, 3)).c_str());
+            std::string_view body = in.substr(head_end + 4);
+
+            bool chunked = false;
+            std::optional<size_t> length;
+            for (std::string_view head = in.substr(0, head_end); !head.empty();) {
+                  const size_t eol = head.find("\r\n");
+                  const std::string_view line = head.substr(0, eol);
+                  head = eol == std::string_view::npos ? std::string_view{} : head.substr(eol + 2);
+                  const size_t colon = line.find(':');
+                  if (colon == std::string_view::npos)
+                        continue;
+                  std::string name(line.substr(0, colon));
+                  for (char& c : name)
+                        c = static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+                  std::string_view value = line.substr(colon + 1);
+                  while (value.starts_with(' '))
+                        value.remove_prefix(1);
+                  if (name == "content-length")
+                        length = std::strtoull(std::string(value).c_str(), nullptr, 10);
+                  else if (name == "transfer-encoding" && value.find("chunked") != std::string_view::npos)
+                        chunked = true;
+            }
+            if (!chunked) {
+                  if (length && *length > body.size())
+                        return std::nullopt;
+                  return std::string(length ? body.substr(0, *length) : body);
+            }
+            std::string out;
+            for (;;) {
+                  const size_t eol = body.find("\r\n");
+                  if (eol == std::string_view::npos)
+                        return std::nullopt;
+                  const size_t size = std::strtoull(std::string(body.substr(0, eol)).c_str(), nullptr, 16);
+                  body.remove_prefix(eol + 2);
+                  if (size == 0)
+                        return out;
+                  if (body.size() < size + 2)
+                        return std::nullopt;
+                  out += body.substr(0, size);
+                  body.remove_prefix(size + 2);
+            }
+      }
+};
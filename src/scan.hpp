@@ -0,0 +1,200 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// Vectorized helpers for the lexer's hot loops: skipping whitespace, identifiers and digits, and finding the end of
+// strings and comments a whole vector at a time. Each build uses the widest instruction set the compiler targets
+// (AVX2, SSE2 or NEON), with a scalar loop for the tail and for everything else.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NANO_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NANO_SCAN_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define NANO_SCAN_NEON 1
+#endif
+
+namespace scan {
+      // the C locale's classes, without going through the locale
+      constexpr bool is_space(const char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+      constexpr bool is_digit(const char c) { return c >= '0' && c <= '9'; }
+      constexpr bool is_alpha(const char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+      constexpr bool is_ident(const char c) { return is_alpha(c) || is_digit(c) || c == '_'; }
+
+      namespace detail {
+#if defined(NANO_SCAN_AVX2)
+            using vec = __m256i;
+            constexpr ptrdiff_t width = 32;
+            constexpr int bits_per_byte = 1;
+            constexpr uint64_t all = 0xFFFFFFFFu;
+
+            inline vec load(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            inline vec splat(const char c) { return _mm256_set1_epi8(c); }
+            inline vec eq(const vec a, const char c) { return _mm256_cmpeq_epi8(a, splat(c)); }
+            inline vec either(const vec a, const vec b) { return _mm256_or_si256(a, b); }
+            // unsigned lo <= v <= hi
+            inline vec in_range(const vec v, const char lo, const char hi) {
+                  const vec d = _mm256_sub_epi8(v, splat(lo));
+                  return _mm256_cmpeq_epi8(_mm256_min_epu8(d, splat(static_cast<char>(hi - lo))), d);
+            }
+            inline uint64_t mask(const vec v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+#elif defined(NANO_SCAN_SSE2)
+            using vec = __m128i;
+            constexpr ptrdiff_t width = 16;
+            constexpr int bits_per_byte = 1;
+            constexpr uint64_t all = 0xFFFFu;
+
+            inline vec load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+            inline vec splat(const char c) { return _mm_set1_epi8(c); }
+            inline vec eq(const vec a, const char c) { return _mm_cmpeq_epi8(a, splat(c)); }
+            inline vec either(const vec a, const vec b) { return _mm_or_si128(a, b); }
+            inline vec in_range(const vec v, const char lo, const char hi) {
+                  const vec d = _mm_sub_epi8(v, splat(lo));
+                  return _mm_cmpeq_epi8(_mm_min_epu8(d, splat(static_cast<char>(hi - lo))), d);
+            }
+            inline uint64_t mask(const vec v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+#elif defined(NANO_SCAN_NEON)
+            using vec = uint8x16_t;
+            constexpr ptrdiff_t width = 16;
+            // NEON has no movemask, narrowing each byte to a nibble is the cheapest substitute
+            constexpr int bits_per_byte = 4;
+            constexpr uint64_t all = ~uint64_t{0};
+
+            inline vec load(const char* p) { return vld1q_u8(reinterpret_cast<const uint8_t*>(p)); }
+            inline vec splat(const char c) { return vdupq_n_u8(static_cast<uint8_t>(c)); }
+            inline vec eq(const vec a, const char c) { return vceqq_u8(a, splat(c)); }
+            inline vec either(const vec a, const vec b) { return vorrq_u8(a, b); }
+            inline vec in_range(const vec v, const char lo, const char hi) {
+                  return vcleq_u8(vsubq_u8(v, splat(lo)), splat(static_cast<char>(hi - lo)));
+            }
+            inline uint64_t mask(const vec v) {
+                  return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+            }
+#endif
+
+#if defined(NANO_SCAN_AVX2) || defined(NANO_SCAN_SSE2) || defined(NANO_SCAN_NEON)
+#define NANO_SCAN_SIMD 1
+            inline vec space(const vec v) { return either(eq(v, ' '), in_range(v, '\t', '\r')); }
+            inline vec ident(const vec v) {
+                  return either(either(in_range(v, 'a', 'z'), in_range(v, 'A', 'Z')),
+                                either(in_range(v, '0', '9'), eq(v, '_')));
+            }
+            inline vec digit(const vec v) { return in_range(v, '0', '9'); }
+
+            inline const char* first(const char* p, const uint64_t m) {
+                  return p + std::countr_zero(m) / bits_per_byte;
+            }
+#endif
+
+            // First position in [p, end) where the class holds (or doesn't, when `negate`), otherwise end.
+            template<bool negate, typename VecClass, typename Class>
+            const char* find(const char* p, const char* end, [[maybe_unused]] VecClass vec_class, Class cls) {
+#if defined(NANO_SCAN_SIMD)
+                  for (; end - p >= width; p += width) {
+                        uint64_t m = mask(vec_class(load(p)));
+                        if constexpr (negate)
+                              m = ~m & all;
+                        if (m)
+                              return first(p, m);
+                  }
+#endif
+                  while (p < end && cls(*p) == negate)
+                        ++p;
+                  return p;
+            }
+      }
+
+#if defined(NANO_SCAN_SIMD)
+#define NANO_SCAN_CLASS(expr) [](const detail::vec v) { return (expr); }
+#else
+#define NANO_SCAN_CLASS(expr) 0
+#endif
+
+      inline const char* skip_whitespace(const char* p, const char* end) {
+            return detail::find<true>(p, end, NANO_SCAN_CLASS(detail::space(v)), is_space);
+      }
+
+      inline const char* skip_ident(const char* p, const char* end) {
+            return detail::find<true>(p, end, NANO_SCAN_CLASS(detail::ident(v)), is_ident);
+      }
+
+      inline const char* skip_digits(const char* p, const char* end) {
+            return detail::find<true>(p, end, NANO_SCAN_CLASS(detail::digit(v)), is_digit);
+      }
+
+      inline const char* find_newline(const char* p, const char* end) {
+            return detail::find<false>(p, end, NANO_SCAN_CLASS(detail::eq(v, '\n')),
+                                       [](const char c) { return c == '\n'; });
+      }
+
+      // The closing quote of a string body, or the next backslash so the caller can skip the escaped character.
+      inline const char* find_quote_or_escape(const char* p, const char* end) {
+            return detail::find<false>(p, end, NANO_SCAN_CLASS(detail::either(detail::eq(v, '"'), detail::eq(v, '\\'))),
+                                       [](const char c) { return c == '"' || c == '\\'; });
+      }
+
+#undef NANO_SCAN_CLASS
+
+      // The "*/" closing a block comment, or end.
+      inline const char* find_comment_close(const char* p, const char* end) {
+#if defined(NANO_SCAN_SIMD)
+            // compare against '*' and, one byte further, '/', so a match needs both in the same lane
+            for (; end - p > detail::width; p += detail::width) {
+                  if (const uint64_t m = detail::mask(detail::eq(detail::load(p), '*')) &
+                                         detail::mask(detail::eq(detail::load(p + 1), '/')))
+                        return detail::first(p, m);
+            }
+#endif
+            for (; end - p >= 2; ++p) {
+                  if (p[0] == '*' && p[1] == '/')
+                        return p;
+            }
+            return end;
+      }
+
+      // The first byte in [p, end) that is `a` or `b`, or end. Any bytes will do, e.g. the kinds of a TokenStream.
+      inline const char* find_either(const char* p, const char* end, const char a, const char b) {
+#if defined(NANO_SCAN_SIMD)
+            for (; end - p >= detail::width; p += detail::width) {
+                  const detail::vec v = detail::load(p);
+                  if (const uint64_t m = detail::mask(detail::either(detail::eq(v, a), detail::eq(v, b))))
+                        return detail::first(p, m);
+            }
+#endif
+            while (p < end && *p != a && *p != b)
+                  ++p;
+            return p;
+      }
+
+      inline size_t count_newlines(const char* p, const char* end) {
+            size_t count = 0;
+#if defined(NANO_SCAN_SIMD)
+            for (; end - p >= detail::width; p += detail::width) {
+                  count += static_cast<size_t>(std::popcount(detail::mask(detail::eq(detail::load(p), '\n'))) /
+                                               detail::bits_per_byte);
+            }
+#endif
+            for (; p < end; ++p)
+                  count += *p == '\n';
+            return count;
+      }
+
+      // The last '\n' in [p, end), or nullptr.
+      inline const char* find_last_newline(const char* p, const char* end) {
+#if defined(NANO_SCAN_SIMD)
+            for (; end - p >= detail::width; end -= detail::width) {
+                  const char* block = end - detail::width;
+                  if (const uint64_t m = detail::mask(detail::eq(detail::load(block), '\n')))
+                        return block + (63 - std::countl_zero(m)) / detail::bits_per_byte;
+            }
+#endif
+            while (end > p) {
+                  if (*--end == '\n')
+                        return end;
+            }
+            return nullptr;
+      }
+}
@@ -0,0 +1,452 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "./diagnostics.hpp"
+#include "./lexer.hpp"
+#include "./parser.hpp"
+#include "./thread_pool.hpp"
+
+// The parameter and result types of a function, all a call needs to be checked.
+struct FunctionType {
+      std::vector<Type> params;
+      Type result = Type::UNKNOWN;
+
+      static FunctionType of(const PrototypeNode& proto) {
+            FunctionType type{{}, proto.type};
+            for (const VariableNode* param : proto.args)
+                  type.params.push_back(param->type);
+            return type;
+      }
+
+      bool operator==(const FunctionType&) const = default;
+};
+
+// The global names a body can refer to. A function is null and a global nullopt when there's none of that name.
+class Declarations {
+  public:
+      virtual ~Declarations() = default;
+      [[nodiscard]] virtual const FunctionType* function(std::string_view name) const = 0;
+      [[nodiscard]] virtual std::optional<Type> global(std::string_view name) const = 0;
+};
+
+// Where a node is in `source`, which starts at `base`: its token, or for a named node its name, which views the source.
+[[nodiscard]] inline std::pair<size_t, size_t> node_location(const std::string_view source, const size_t base,
+                                                             const ASTNode* node) {
+      const auto token = [](const Token& t) { return std::pair<size_t, size_t>{t.offset, t.length}; };
+      std::string_view name;
+      switch (node->kind) {
+            case NodeKind::null:
+                  return token(static_cast<const NullNode*>(node)->token);
+            case NodeKind::number:
+                  return token(static_cast<const NumberNode*>(node)->token);
+            case NodeKind::boolean:
+                  return token(static_cast<const BoolNode*>(node)->token);
+            case NodeKind::string:
+                  return token(static_cast<const StringNode*>(node)->token);
+            case NodeKind::binary:
+                  return token(static_cast<const BinaryOperation*>(node)->op);
+            case NodeKind::unary:
+                  return token(static_cast<const UnaryOperation*>(node)->op);
+            case NodeKind::comptime:
+                  return token(static_cast<const ComptimeNode*>(node)->token);
+            case NodeKind::error:
+                  return token(static_cast<const ErrorNode*>(node)->token);
+            case NodeKind::variable:
+                  name = static_cast<const VariableNode*>(node)->name;
+                  break;
+            case NodeKind::variable_call:
+                  name = static_cast<const VariableCallNode*>(node)->name;
+                  break;
+            case NodeKind::prototype:
+                  name = static_cast<const PrototypeNode*>(node)->name;
+                  break;
+            case NodeKind::function:
+                  name = static_cast<const FunctionNode*>(node)->Proto->name;
+                  break;
+            case NodeKind::call:
+                  name = static_cast<const CallNode*>(node)->callee;
+                  break;
+      }
+      if (name.data() < source.data() || name.data() + name.size() > source.data() + source.size())
+            return {0, 0};
+      return {base + static_cast<size_t>(name.data() - source.data()), name.size()};
+}
+
+// Checks one function body, or the top-level statements, against the functions and globals `declarations` knows.
+// Errors go to `diagnostics` at the node_location() in `source`, which is what the nodes were parsed from. Given
+// `globals`, a top-level `var` declares one there and lookups of globals look there first.
+class BodyChecker {
+      struct Local {
+            std::string_view name;
+            Type type;
+      };
+
+      std::string_view m_source;
+      size_t m_base;
+      const Declarations& m_declarations;
+      std::unordered_map<std::string_view, Type>* m_globals;
+      Diagnostics& m_diagnostics;
+      std::vector<Local> m_locals;
+      // where each open block's locals start
+      std::vector<size_t> m_blocks;
+
+  public:
+      BodyChecker(const std::string_view source, const size_t base, const Declarations& declarations,
+                  Diagnostics& diagnostics, std::unordered_map<std::string_view, Type>* globals = nullptr) :
+          m_source(source), m_base(base), m_declarations(declarations), m_globals(globals),
+          m_diagnostics(diagnostics) {}
+
+      void function(FunctionNode& fn) {
+            m_blocks.push_back(0);
+            for (const VariableNode* param : fn.Proto->args)
+                  m_locals.push_back({param->name, param->type});
+            const Type type = block(fn.body());
+            m_blocks.pop_back();
+            m_locals.clear();
+            if (type != Type::UNKNOWN && fn.Proto->type != Type::UNKNOWN && type != fn.Proto->type)
+                  report(SemaError::return_type, fn.Proto);
+      }
+
+      // A statement at global scope: a `var` there declares a global.
+      void statement(ASTNode* node) {
+            if (node->kind == NodeKind::function || node->kind == NodeKind::prototype)
+                  return;
+            const Type type = expr(node);
+            if (node->kind != NodeKind::variable)
+                  return;
+            const auto* var = static_cast<const VariableNode*>(node);
+            const auto [it, inserted] = m_globals->try_emplace(var->name, type);
+            if (inserted)
+                  return;
+            if (it->second != type && it->second != Type::UNKNOWN && type != Type::UNKNOWN)
+                  report(SemaError::global_type, node);
+            else if (it->second == Type::UNKNOWN)
+                  it->second = type;
+      }
+
+  private:
+      void report(const SemaError e, const ASTNode* at) {
+            const auto [offset, length] = node_location(m_source, m_base, at);
+            m_diagnostics.report(e, offset, length);
+      }
+
+      // The statements of a body in their own scope, and the type of the last one.
+      Type block(const std::span<ASTNode* const> stmts) {
+            m_blocks.push_back(m_locals.size());
+            Type type = Type::NULL_T;
+            for (ASTNode* stmt : stmts) {
+                  if (stmt)
+                        type = expr(stmt);
+            }
+            m_locals.resize(m_blocks.back());
+            m_blocks.pop_back();
+            return type;
+      }
+
+      [[nodiscard]] bool lookup(const std::string_view name, Type& type) const {
+            for (size_t i = m_locals.size(); i > 0; i--) {
+                  if (m_locals[i - 1].name == name) {
+                        type = m_locals[i - 1].type;
+                        return true;
+                  }
+            }
+            if (m_globals) {
+                  if (const auto it = m_globals->find(name); it != m_globals->end()) {
+                        type = it->second;
+                        return true;
+                  }
+            }
+            const std::optional<Type> global = m_declarations.global(name);
+            type = global.value_or(Type::UNKNOWN);
+            return global.has_value();
+      }
+
+      Type expr(ASTNode* node) {
+            if (!node)
+                  return Type::UNKNOWN;
+            node->type = infer(node);
+            return node->type;
+      }
+
+      Type infer(ASTNode* node) {
+            switch (node->kind) {
+                  case NodeKind::null:
+                        return Type::NULL_T;
+                  case NodeKind::number:
+                        // the parser leaves those it couldn't read UNKNOWN
+                        if (node->type == Type::UNKNOWN)
+                              report(SemaError::number_out_of_range, node);
+                        return node->type;
+                  case NodeKind::boolean:
+                        return Type::BOOL;
+                  case NodeKind::string:
+                        return Type::STRING;
+                  case NodeKind::variable_call: {
+                        Type type;
+                        if (lookup(static_cast<const VariableCallNode*>(node)->name, type))
+                              return type;
+                        report(SemaError::unknown_variable, node);
+                        return Type::UNKNOWN;
+                  }
+                  case NodeKind::variable: {
+                        auto* var = static_cast<VariableNode*>(node);
+                        const Type type = var->val ? expr(var->val) : Type::NULL_T;
+                        // at global scope statement() declares it
+                        if (!m_blocks.empty())
+                              m_locals.push_back({var->name, type});
+                        return type;
+                  }
+                  case NodeKind::binary:
+                        return binary(*static_cast<BinaryOperation*>(node));
+                  case NodeKind::unary:
+                        return unary(*static_cast<UnaryOperation*>(node));
+                  case NodeKind::call:
+                        return call(*static_cast<CallNode*>(node));
+                  case NodeKind::comptime: {
+                        auto* n = static_cast<ComptimeNode*>(node);
+                        const Type type = block(n->body);
+                        return n->value ? n->value->type : type;
+                  }
+                  case NodeKind::prototype:
+                  case NodeKind::function:
+                        report(SemaError::nested_function, node);
+                        return Type::UNKNOWN;
+                  case NodeKind::error:
+                        return Type::UNKNOWN;
+            }
+            return Type::UNKNOWN;
+      }
+
+      Type call(CallNode& node) {
+            std::vector<Type> args;
+            for (ASTNode* arg : node.args)
+                  args.push_back(expr(arg));
+            const FunctionType* fn = m_declarations.function(node.callee);
+            if (!fn) {
+                  report(SemaError::unknown_function, &node);
+                  return Type::UNKNOWN;
+            }
+            if (fn->params.size() != node.args.size()) {
+                  report(SemaError::argument_count, &node);
+                  return fn->result;
+            }
+            for (size_t i = 0; i < args.size(); i++) {
+                  const Type param = fn->params[i];
+                  if (args[i] != param && args[i] != Type::UNKNOWN && param != Type::UNKNOWN)
+                        report(SemaError::argument_type, node.args[i]);
+            }
+            return fn->result;
+      }
+
+      Type unary(UnaryOperation& node) {
+            const TypeOfToken op = node.op.type;
+            const bool step = op == TypeOfToken::OP_INC || op == TypeOfToken::OP_DEC;
+            if (step && (!node.node || node.node->kind != NodeKind::variable_call)) {
+                  expr(node.node);
+                  report(SemaError::not_assignable, &node);
+                  return Type::UNKNOWN;
+            }
+            const Type type = expr(node.node);
+            if (type == Type::UNKNOWN)
+                  return type;
+            const bool numeric = type == Type::INT || type == Type::FLOAT;
+            if (((step || op == TypeOfToken::OP_MINUS) && numeric) ||
+                (op == TypeOfToken::OP_EXCL_MARK && type == Type::BOOL))
+                  return type;
+            report(SemaError::invalid_operand, &node);
+            return Type::UNKNOWN;
+      }
+
+      Type binary(BinaryOperation& node) {
+            using enum TypeOfToken;
+            const TypeOfToken op = node.op.type;
+            const bool assignment = op == OP_EQUALS || op == OP_PLUSEQUALS || op == OP_MINUSEQUALS ||
+                                    op == OP_TIMESEQUALS || op == OP_DIVEQUALS;
+            if (assignment && (!node.left || node.left->kind != NodeKind::variable_call)) {
+                  expr(node.left);
+                  expr(node.right);
+                  report(SemaError::not_assignable, &node);
+                  return Type::UNKNOWN;
+            }
+
+            const Type left = expr(node.left);
+            const Type right = expr(node.right);
+            if (left == Type::UNKNOWN || right == Type::UNKNOWN)
+                  return Type::UNKNOWN;
+            if (left != right) {
+                  report(assignment ? SemaError::assignment_type : SemaError::operand_types, &node);
+                  return assignment ? left : Type::UNKNOWN;
+            }
+            if (op == OP_EQUALS)
+                  return left;
+
+            const bool numeric = left == Type::INT || left == Type::FLOAT;
+            switch (op) {
+                  case OP_PLUSEQUALS:
+                  case OP_MINUSEQUALS:
+                  case OP_TIMESEQUALS:
+                  case OP_DIVEQUALS:
+                  case OP_PLUS:
+                  case OP_MINUS:
+                  case OP_TIMES:
+                  case OP_DIV:
+                        if (numeric)
+                              return left;
+                        break;
+                  case OP_AMPERSAND:
+                  case OP_PIPE:
+                        if (left == Type::INT)
+                              return left;
+                        break;
+                  case LTHAN:
+                  case LTHAN_EQUALS:
+                  case GTHAN:
+                  case GTHAN_EQUALS:
+                        if (numeric)
+                              return Type::BOOL;
+                        break;
+                  case OP_EQUALSEQUALS:
+                  case OP_EXCL_EQUALS:
+                        return Type::BOOL;
+                  case OP_DOUBLEAMPERSAND:
+                  case OP_DOUBLEPIPE:
+                        if (left == Type::BOOL)
+                              return left;
+                        break;
+                  default:
+                        break;
+            }
+            report(SemaError::invalid_operand, &node);
+            return Type::UNKNOWN;
+      }
+};
+
+// The functions of one file by name, from their prototypes and definitions in order.
+class FunctionTable {
+  public:
+      struct Entry {
+            FunctionType type;
+            // whether a FunctionNode defines it, rather than only a prototype
+            bool defined;
+
+            bool operator==(const Entry&) const = default;
+      };
+
+  private:
+      std::unordered_map<std::string_view, Entry> m_entries;
+
+  public:
+      // Adds `proto`, and calls `report(SemaError, const ASTNode*)` for what's wrong with it.
+      template<typename Report>
+      void declare(const PrototypeNode& proto, const bool defined, Report&& report) {
+            for (const VariableNode* param : proto.args) {
+                  if (param->type == Type::UNKNOWN)
+                        report(SemaError::unknown_type, param);
+            }
+            if (proto.type == Type::UNKNOWN)
+                  report(SemaError::unknown_type, &proto);
+
+            const auto [it, inserted] = m_entries.try_emplace(proto.name, Entry{FunctionType::of(proto), defined});
+            if (inserted)
+                  return;
+            // a prototype and a definition of the same signature may both be there, in any order
+            Entry& existing = it->second;
+            if (existing.type != FunctionType::of(proto) || (existing.defined && defined)) {
+                  report(SemaError::redefined_function, &proto);
+                  return;
+            }
+            existing.defined = existing.defined || defined;
+      }
+
+      [[nodiscard]] const Entry* find(const std::string_view name) const {
+            const auto it = m_entries.find(name);
+            return it == m_entries.end() ? nullptr : &it->second;
+      }
+
+      [[nodiscard]] const std::unordered_map<std::string_view, Entry>& entries() const { return m_entries; }
+};
+
+// Type checking after parsing. Runs in two phases: the first, sequential one collects every function's signature and
+// checks the top-level statements in order, which decides the type of each global; the second checks the function
+// bodies, each on its own against the now read-only tables of the first, so they can all be checked at once. Every
+// expression node gets its type, UNKNOWN where it has none, and operations on an UNKNOWN operand aren't reported
+// again: the error that made it unknown already was. Names the file doesn't declare are looked up in `imports`.
+class TypeChecker final : public Declarations {
+      const TokenStream& m_tokens;
+      Diagnostics& m_diagnostics;
+      ThreadPool* m_pool;
+      const Declarations* m_imports;
+
+      FunctionTable m_functions;
+      std::unordered_map<std::string_view, Type> m_globals;
+
+      [[nodiscard]] auto reporter() {
+            return [this](const SemaError e, const ASTNode* at) {
+                  const auto [offset, length] = node_location(m_tokens.source, m_tokens.base, at);
+                  m_diagnostics.report(e, offset, length);
+            };
+      }
+
+  public:
+      // `tokens` is what the AST was parsed from, for where each error is. Function bodies are checked on `pool`
+      // when there is one, which mustn't be the pool running the caller: check() waits for it.
+      TypeChecker(const TokenStream& tokens, Diagnostics& diagnostics, ThreadPool* pool = nullptr,
+                  const Declarations* imports = nullptr) :
+          m_tokens(tokens), m_diagnostics(diagnostics), m_pool(pool), m_imports(imports) {}
+
+      void check(const std::span<ASTNode* const> items) {
+            std::vector<FunctionNode*> bodies;
+            for (ASTNode* item : items) {
+                  if (item && item->kind == NodeKind::function) {
+                        auto* fn = static_cast<FunctionNode*>(item);
+                        m_functions.declare(*fn->Proto, true, reporter());
+                        bodies.push_back(fn);
+                  } else if (item && item->kind == NodeKind::prototype) {
+                        m_functions.declare(*static_cast<PrototypeNode*>(item), false, reporter());
+                  }
+            }
+
+            BodyChecker top(m_tokens.source, m_tokens.base, *this, m_diagnostics, &m_globals);
+            for (ASTNode* item : items) {
+                  if (item)
+                        top.statement(item);
+            }
+
+            if (!m_pool || bodies.size() < 2) {
+                  for (FunctionNode* fn : bodies)
+                        BodyChecker(m_tokens.source, m_tokens.base, *this, m_diagnostics).function(*fn);
+                  return;
+            }
+            std::vector<Diagnostics> found(bodies.size());
+            for (size_t i = 0; i < bodies.size(); i++) {
+                  m_pool->submit([this, &bodies, &found, i](size_t) {
+                        BodyChecker(m_tokens.source, m_tokens.base, *this, found[i]).function(*bodies[i]);
+                  });
+            }
+            m_pool->wait();
+            for (const Diagnostics& d : found)
+                  m_diagnostics.append(d);
+      }
+
+      // The type of each global once check() is done, and the file's functions; not what it imports.
+      [[nodiscard]] const std::unordered_map<std::string_view, Type>& globals() const { return m_globals; }
+      [[nodiscard]] const FunctionTable& functions() const { return m_functions; }
+
+      [[nodiscard]] const FunctionType* function(const std::string_view name) const override {
+            if (const FunctionTable::Entry* fn = m_functions.find(name))
+                  return &fn->type;
+            return m_imports ? m_imports->function(name) : nullptr;
+      }
+
+      [[nodiscard]] std::optional<Type> global(const std::string_view name) const override {
+            if (const auto it = m_globals.find(name); it != m_globals.end())
+                  return it->second;
+            return m_imports ? m_imports->global(name) : std::nullopt;
+      }
+};
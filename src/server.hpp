@@ -0,0 +1,421 @@
+#pragma once
+#if defined(__linux__)
+#define NANO_HAS_SERVER 1
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "./driver.hpp"
+#include "./query.hpp"
+#include "./source.hpp"
+
+enum class ServerError {
+      cannot_create_socket,
+      cannot_bind,
+      cannot_listen,
+      cannot_connect,
+      disconnected,
+};
+
+constexpr std::string_view server_error_to_str(ServerError e) {
+      switch (e) {
+            case ServerError::cannot_create_socket:
+                  return "cannot create socket";
+            case ServerError::cannot_bind:
+                  return "cannot bind socket";
+            case ServerError::cannot_listen:
+                  return "cannot listen on socket";
+            case ServerError::cannot_connect:
+                  return "cannot connect to server";
+            case ServerError::disconnected:
+                  return "server closed the connection";
+      }
+      return "unknown server error";
+}
+
+inline std::optional<sockaddr_un> socket_address(const std::string& path) {
+      sockaddr_un addr{};
+      addr.sun_family = AF_UNIX;
+      if (path.size() >= sizeof(addr.sun_path))
+            return std::nullopt;
+      std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+      return addr;
+}
+
+// A long-lived front-end for build tools, behind `Nano --server SOCKET`. Every file it's asked about stays open in
+// one Workspace, so interned names, parsed items and every query result stay warm from one request to the next, and
+// a file that changed on disk costs what the Workspace makes of an edit to it. Changes come from inotify, watching
+// the directory of every open file (editors often save by renaming over it); a file whose directory can't be watched
+// is read again on every request instead.
+//
+// Requests are lines over a Unix socket, replies are lines closed by `end STATUS`:
+//   check PATH      the diagnostics of PATH, checked against the files it imports; status 1 if there are any
+//   stats           counters, one `name value` per line
+//   shutdown        stops the server once it has replied
+// One thread serves every client through epoll, on non-blocking sockets; the Workspace isn't thread-safe, and a
+// warm request is short enough that clients don't wait on each other for long.
+class CompileServer {
+      struct Client {
+            std::string in;
+            std::string out;
+      };
+
+      std::string m_path;
+      int m_listener = -1;
+      int m_epoll = -1;
+      int m_inotify = -1;
+
+      Workspace m_workspace;
+      // every open file, and whether it may differ from what the Workspace has of it
+      std::unordered_map<std::string, bool> m_stale;
+      // watch descriptor to directory, and the directories watched
+      std::unordered_map<int, std::string> m_watches;
+      std::unordered_set<std::string> m_watched;
+      std::unordered_map<int, Client> m_clients;
+      bool m_stopping = false;
+
+      size_t m_requests = 0;
+      size_t m_reads = 0;
+      size_t m_invalidations = 0;
+
+  public:
+      CompileServer() = default;
+      CompileServer(const CompileServer&) = delete;
+      CompileServer& operator=(const CompileServer&) = delete;
+
+      ~CompileServer() {
+            for (const auto& [fd, client] : m_clients)
+                  ::close(fd);
+            for (const int fd : {m_listener, m_epoll, m_inotify}) {
+                  if (fd >= 0)
+                        ::close(fd);
+            }
+            if (m_listener >= 0)
+                  ::unlink(m_path.c_str());
+      }
+
+      // Binds `path`, replacing a socket left there by a server that didn't shut down. Anything else at `path`, or a
+      // socket a live server still answers on, is left alone and makes this cannot_bind. Call before run().
+      std::optional<ServerError> listen(std::string path) {
+            m_path = std::move(path);
+            const std::optional<sockaddr_un> addr = socket_address(m_path);
+            if (!addr)
+                  return ServerError::cannot_bind;
+            m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+            m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            const int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (m_epoll < 0 || listener < 0) {
+                  if (listener >= 0)
+                        ::close(listener);
+                  return ServerError::cannot_create_socket;
+            }
+            if (!clear_stale_socket(*addr)) {
+                  ::close(listener);
+                  return ServerError::cannot_bind;
+            }
+            if (::bind(listener, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr)) != 0) {
+                  ::close(listener);
+                  return ServerError::cannot_bind;
+            }
+            m_listener = listener;
+            if (::listen(m_listener, SOMAXCONN) != 0)
+                  return ServerError::cannot_listen;
+            watch_fd(m_listener, EPOLLIN);
+            if (m_inotify >= 0)
+                  watch_fd(m_inotify, EPOLLIN);
+            return std::nullopt;
+      }
+
+      // Serves clients until one asks for a shutdown.
+      void run() {
+            epoll_event events[64];
+            while (!m_stopping) {
+                  const int n = ::epoll_wait(m_epoll, events, static_cast<int>(std::size(events)), -1);
+                  if (n < 0 && errno != EINTR)
+                        return;
+                  for (int i = 0; i < n; i++) {
+                        const int fd = events[i].data.fd;
+                        if (fd == m_listener)
+                              accept_all();
+                        else if (fd == m_inotify)
+                              read_changes();
+                        else
+                              serve(fd, events[i].events);
+                  }
+            }
+      }
+
+      // The reply to one request line, closing `end` line included. Public so it can be asked without a socket.
+      std::string handle(const std::string_view request) {
+            m_requests++;
+            std::string reply;
+            int status = 0;
+            if (request.starts_with("check ")) {
+                  status = check(std::string(request.substr(6)), reply);
+            } else if (request == "stats") {
+                  reply += "files " + std::to_string(m_stale.size()) + "\n";
+                  reply += "requests " + std::to_string(m_requests) + "\n";
+                  reply += "reads " + std::to_string(m_reads) + "\n";
+                  reply += "invalidations " + std::to_string(m_invalidations) + "\n";
+                  reply += "bodies_checked " + std::to_string(m_workspace.bodies_checked()) + "\n";
+            } else if (request == "shutdown") {
+                  m_stopping = true;
+            } else {
+                  reply += "unknown request\n";
+                  status = 2;
+            }
+            return reply + "end " + std::to_string(status) + "\n";
+      }
+
+  private:
+      // Whether `addr` is free to bind: nothing is there, or a socket nobody answers on, which is then removed.
+      [[nodiscard]] bool clear_stale_socket(const sockaddr_un& addr) const {
+            struct stat st{};
+            if (::lstat(m_path.c_str(), &st) != 0)
+                  return errno == ENOENT;
+            if (!S_ISSOCK(st.st_mode))
+                  return false;
+            const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (probe < 0)
+                  return false;
+            const bool live = ::connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+            ::close(probe);
+            return !live && ::unlink(m_path.c_str()) == 0;
+      }
+
+      void watch_fd(const int fd, const uint32_t events) const {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = fd;
+            if (::epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &ev) != 0)
+                  ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev);
+      }
+
+      void accept_all() {
+            for (;;) {
+                  const int fd = ::accept4(m_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                  if (fd < 0)
+                        return;
+                  m_clients[fd];
+                  watch_fd(fd, EPOLLIN | EPOLLRDHUP);
+            }
+      }
+
+      void serve(const int fd, const uint32_t events) {
+            const auto it = m_clients.find(fd);
+            if (it == m_clients.end())
+                  return;
+            Client& client = it->second;
+            bool closed = (events & (EPOLLERR | EPOLLHUP)) != 0;
+            if (events & (EPOLLIN | EPOLLRDHUP)) {
+                  char buffer[4096];
+                  for (;;) {
+                        const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+                        if (n > 0) {
+                              client.in.append(buffer, static_cast<size_t>(n));
+                        } else if (n < 0 && errno == EINTR) {
+                              continue;
+                        } else {
+                              // drained, or gone
+                              closed |= n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+                              break;
+                        }
+                  }
+                  for (size_t end; (end = client.in.find('\n')) != std::string::npos;) {
+                        client.out += handle(std::string_view(client.in).substr(0, end));
+                        client.in.erase(0, end + 1);
+                  }
+            }
+            while (!client.out.empty()) {
+                  const ssize_t n = ::send(fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+                  if (n < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                              closed = true;
+                        if (errno != EINTR)
+                              break;
+                        continue;
+                  }
+                  client.out.erase(0, static_cast<size_t>(n));
+            }
+            // a client that hung up after its last request still gets the reply, if the socket takes it
+            if (closed) {
+                  ::close(fd);
+                  m_clients.erase(it);
+                  return;
+            }
+            watch_fd(fd, client.out.empty() ? EPOLLIN | EPOLLRDHUP : EPOLLIN | EPOLLRDHUP | EPOLLOUT);
+      }
+
+      void read_changes() {
+            alignas(inotify_event) char buffer[16 * 1024];
+            for (;;) {
+                  const ssize_t n = ::read(m_inotify, buffer, sizeof(buffer));
+                  if (n <= 0)
+                        return;
+                  for (ssize_t at = 0; at < n;) {
+                        const auto* event = reinterpret_cast<const inotify_event*>(buffer + at);
+                        at += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                        if (event->mask & IN_Q_OVERFLOW) {
+                              for (auto& [path, stale] : m_stale)
+                                    stale = true;
+                              m_invalidations++;
+                              continue;
+                        }
+                        const auto dir = m_watches.find(event->wd);
+                        if (dir == m_watches.end() || event->len == 0)
+                              continue;
+                        const auto file = m_stale.find((std::filesystem::path(dir->second) / event->name).string());
+                        if (file != m_stale.end() && !file->second) {
+                              file->second = true;
+                              m_invalidations++;
+                        }
+                  }
+            }
+      }
+
+      int check(const std::string& path, std::string& reply) {
+            const std::string key = Driver::normalize(path);
+            std::unordered_set<std::string> seen;
+            if (const std::optional<SourceError> err = refresh(key, seen)) {
+                  reply += key + ": " + std::string(source_error_to_str(*err)) + "\n";
+                  return 1;
+            }
+            const Document& doc = *m_workspace.document(key);
+            int status = 0;
+            if (const std::optional<LexerError> err = doc.error()) {
+                  reply += key + ": " + std::string(lexer_error_to_str(*err)) + "\n";
+                  status = 1;
+            }
+            for (const Diagnostic& d : m_workspace.diagnostics(key)) {
+                  reply += format_diagnostic(key, d, doc.tokens()) + "\n";
+                  status = 1;
+            }
+            return status;
+      }
+
+      // Brings `path` and everything it imports up to date with the disk. A file that can't be read any more keeps
+      // what was last read of it.
+      std::optional<SourceError> refresh(const std::string& path, std::unordered_set<std::string>& seen) {
+            if (!seen.insert(path).second)
+                  return std::nullopt;
+            const auto it = m_stale.find(path);
+            if (it == m_stale.end() || it->second) {
+                  // watched before it's read, so a change while it is isn't missed
+                  const bool watched = watch(std::filesystem::path(path).parent_path().string());
+                  SourceBuffer source;
+                  if (const std::optional<SourceError> err = source.load(path))
+                        return it == m_stale.end() ? err : std::nullopt;
+                  m_reads++;
+                  if (it == m_stale.end())
+                        m_workspace.open(path, std::string(source.view()));
+                  else
+                        edit(path, source.view());
+                  m_stale[path] = !watched;
+            }
+
+            std::vector<std::string> imports;
+            for (const std::string_view name : find_imports(m_workspace.document(path)->tokens())) {
+                  std::string import = Driver::normalize(Driver::resolve_import(path, name));
+                  if (!refresh(import, seen) && m_workspace.document(import))
+                        imports.push_back(std::move(import));
+            }
+            m_workspace.set_imports(path, std::move(imports));
+            return std::nullopt;
+      }
+
+      // What changed between what the Workspace has and `text`, as one edit of the range between their common
+      // prefix and suffix, which is all of a typical save.
+      void edit(const std::string& path, const std::string_view text) {
+            const std::string_view old = m_workspace.document(path)->text();
+            if (old == text)
+                  return;
+            const size_t prefix = static_cast<size_t>(std::ranges::mismatch(old, text).in1 - old.begin());
+            const size_t limit = std::min(old.size(), text.size()) - prefix;
+            size_t suffix = 0;
+            while (suffix < limit && old[old.size() - 1 - suffix] == text[text.size() - 1 - suffix])
+                  suffix++;
+            const size_t length = old.size() - prefix - suffix;
+            m_workspace.edit(path, {prefix, length, text.substr(prefix, text.size() - prefix - suffix)});
+      }
+
+      // false if `dir` can't be watched
+      bool watch(const std::string& dir) {
+            if (m_watched.contains(dir))
+                  return true;
+            if (m_inotify < 0)
+                  return false;
+            const int wd = ::inotify_add_watch(m_inotify, dir.c_str(),
+                                               IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+            if (wd < 0)
+                  return false;
+            m_watches[wd] = dir;
+            m_watched.insert(dir);
+            return true;
+      }
+};
+
+// Sends `request` to the server at `socket` and appends its reply, up to its `end` line, to `reply`.
+inline std::optional<ServerError> ask_server(const std::string& socket, const std::string_view request,
+                                             std::string& reply, int& status) {
+      const std::optional<sockaddr_un> addr = socket_address(socket);
+      if (!addr)
+            return ServerError::cannot_connect;
+      const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (fd < 0)
+            return ServerError::cannot_create_socket;
+      if (::connect(fd, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr)) != 0) {
+            ::close(fd);
+            return ServerError::cannot_connect;
+      }
+      const std::string line = std::string(request) + "\n";
+      for (size_t sent = 0; sent < line.size();) {
+            const ssize_t n = ::send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                  continue;
+            if (n <= 0) {
+                  ::close(fd);
+                  return ServerError::disconnected;
+            }
+            sent += static_cast<size_t>(n);
+      }
+
+      std::string in;
+      char buffer[4096];
+      for (;;) {
+            if (!in.empty() && in.back() == '\n') {
+                  const size_t last = in.find_last_of('\n', in.size() - 2);
+                  const size_t start = last == std::string::npos ? 0 : last + 1;
+                  if (std::string_view(in).substr(start).starts_with("end ")) {
+                        reply += in.substr(0, start);
+                        status = std::atoi(in.c_str() + start + 4);
+                        ::close(fd);
+                        return std::nullopt;
+                  }
+            }
+            const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && errno == EINTR)
+                  continue;
+            if (n <= 0) {
+                  ::close(fd);
+                  return ServerError::disconnected;
+            }
+            in.append(buffer, static_cast<size_t>(n));
+      }
+}
+#else
+#define NANO_HAS_SERVER 0
+#endif
@@ -0,0 +1,218 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NANO_HAS_MMAP 1
+#else
+#define NANO_HAS_MMAP 0
+#endif
+
+// The largest source the front-end takes: token offsets are uint32 and a token's length keeps its top bit as a flag.
+constexpr size_t max_source_size = INT32_MAX;
+
+enum class SourceError {
+      cannot_open,
+      cannot_read,
+      too_large,
+};
+
+constexpr std::string_view source_error_to_str(SourceError e) {
+      switch (e) {
+            case SourceError::cannot_open:
+                  return "cannot open file";
+            case SourceError::cannot_read:
+                  return "cannot read file";
+            case SourceError::too_large:
+                  return "file too large";
+      }
+      return "unknown source error";
+}
+
+// The contents of a source file. Files are memory-mapped where the platform allows it, so handing the view to a Lexer
+// never copies the file; otherwise (or when mapping fails, e.g. for pipes) they are read into a heap buffer once.
+class SourceBuffer {
+      std::string m_path;
+      const char* m_data = nullptr;
+      size_t m_size = 0;
+      bool m_mapped = false;
+      // a unique_ptr rather than a std::string: moving the buffer must not move the bytes lexer tokens point at
+      std::unique_ptr<char[]> m_fallback;
+
+  public:
+      SourceBuffer() = default;
+
+      SourceBuffer(SourceBuffer&& other) noexcept { *this = std::move(other); }
+
+      SourceBuffer& operator=(SourceBuffer&& other) noexcept {
+            if (this != &other) {
+                  release();
+                  m_path = std::move(other.m_path);
+                  m_data = std::exchange(other.m_data, nullptr);
+                  m_size = std::exchange(other.m_size, 0);
+                  m_mapped = std::exchange(other.m_mapped, false);
+                  m_fallback = std::move(other.m_fallback);
+            }
+            return *this;
+      }
+
+      SourceBuffer(const SourceBuffer&) = delete;
+      SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+      ~SourceBuffer() { release(); }
+
+      std::optional<SourceError> load(std::string path) {
+            release();
+            m_path = std::move(path);
+#if NANO_HAS_MMAP
+            const int fd = ::open(m_path.c_str(), O_RDONLY);
+            if (fd < 0)
+                  return SourceError::cannot_open;
+
+            struct stat st {};
+            if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+                  if (static_cast<uint64_t>(st.st_size) > max_source_size) {
+                        ::close(fd);
+                        return SourceError::too_large;
+                  }
+                  m_size = static_cast<size_t>(st.st_size);
+                  if (m_size == 0) {
+                        ::close(fd);
+                        return std::nullopt;
+                  }
+
+                  void* map = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                  if (map != MAP_FAILED) {
+                        // the lexer walks the file front to back exactly once
+                        ::madvise(map, m_size, MADV_SEQUENTIAL);
+                        ::close(fd);
+                        m_data = static_cast<const char*>(map);
+                        m_mapped = true;
+                        return std::nullopt;
+                  }
+            }
+            ::close(fd);
+            m_size = 0;
+#endif
+            return read_fallback();
+      }
+
+      // Takes ownership of an in-memory source, e.g. one that came from an editor rather than the disk.
+      std::optional<SourceError> assign(std::string path, const std::string_view text) {
+            release();
+            m_path = std::move(path);
+            if (text.size() > max_source_size)
+                  return SourceError::too_large;
+            m_fallback = std::make_unique<char[]>(text.size());
+            std::char_traits<char>::copy(m_fallback.get(), text.data(), text.size());
+            m_data = m_fallback.get();
+            m_size = text.size();
+            return std::nullopt;
+      }
+
+      [[nodiscard]] std::string_view view() const { return {m_data, m_size}; }
+      [[nodiscard]] const std::string& path() const { return m_path; }
+      [[nodiscard]] size_t size() const { return m_size; }
+      [[nodiscard]] bool mapped() const { return m_mapped; }
+
+  private:
+      // Reads the file into m_fallback itself: a regular one into a buffer of its size, anything else (a pipe) into
+      // one that doubles as it fills. Either way the buffer read into is the one kept, nothing is copied afterwards.
+      std::optional<SourceError> read_fallback() {
+            std::FILE* file = std::fopen(m_path.c_str(), "rb");
+            if (!file)
+                  return SourceError::cannot_open;
+
+            size_t capacity = 64 * 1024;
+#if NANO_HAS_MMAP
+            struct stat st {};
+            if (::fstat(::fileno(file), &st) == 0 && S_ISREG(st.st_mode)) {
+                  if (static_cast<uint64_t>(st.st_size) > max_source_size) {
+                        std::fclose(file);
+                        return SourceError::too_large;
+                  }
+                  // one more byte, so the end of the file is seen without growing the buffer
+                  capacity = static_cast<size_t>(st.st_size) + 1;
+            }
+#endif
+            std::unique_ptr<char[]> buffer = std::make_unique_for_overwrite<char[]>(capacity);
+            size_t size = 0;
+            std::optional<SourceError> err;
+            while (!err) {
+                  if (size == capacity) {
+                        if (capacity > max_source_size) {
+                              err = SourceError::too_large;
+                              break;
+                        }
+                        auto grown = std::make_unique_for_overwrite<char[]>(capacity * 2);
+                        std::char_traits<char>::copy(grown.get(), buffer.get(), size);
+                        buffer = std::move(grown);
+                        capacity *= 2;
+                  }
+                  const size_t n = std::fread(buffer.get() + size, 1, capacity - size, file);
+                  if (n == 0)
+                        break;
+                  size += n;
+            }
+            if (!err && std::ferror(file) != 0)
+                  err = SourceError::cannot_read;
+            else if (!err && size > max_source_size)
+                  err = SourceError::too_large;
+            std::fclose(file);
+            if (err)
+                  return err;
+
+            m_fallback = std::move(buffer);
+            m_data = m_fallback.get();
+            m_size = size;
+            return std::nullopt;
+      }
+
+      void release() {
+#if NANO_HAS_MMAP
+            if (m_mapped)
+                  ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+            m_fallback.reset();
+            m_data = nullptr;
+            m_size = 0;
+            m_mapped = false;
+      }
+};
+
+// Reads a file (or stdin) sequentially for StreamLexer, which never needs more of it in memory than a few chunks.
+class FileReader {
+      std::FILE* m_file = nullptr;
+      bool m_owned = false;
+
+  public:
+      explicit FileReader(std::FILE* file) : m_file(file) {}
+
+      explicit FileReader(const std::string& path) : m_file(std::fopen(path.c_str(), "rb")), m_owned(true) {}
+
+      FileReader(const FileReader&) = delete;
+      FileReader& operator=(const FileReader&) = delete;
+
+      ~FileReader() {
+            if (m_owned && m_file)
+                  std::fclose(m_file);
+      }
+
+      [[nodiscard]] bool is_open() const { return m_file != nullptr; }
+
+      size_t operator()(char* buf, const size_t capacity) {
+            if (!m_file)
+                  return 0;
+            return std::fread(buf, 1, capacity, m_file);
+      }
+};
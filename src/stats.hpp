@@ -0,0 +1,276 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Phase timers and counters are compiled in unless NANO_STATS is 0 (the NANO_ENABLE_STATS CMake option), in which
+// case PhaseTimer is an empty object and nothing is ever recorded.
+#ifndef NANO_STATS
+#define NANO_STATS 1
+#endif
+
+constexpr bool stats_enabled = NANO_STATS;
+
+enum class Phase : uint8_t {
+      read,
+      lex,
+      parse,
+      sema,
+      comptime,
+      ir,
+      codegen,
+      run,
+};
+
+constexpr size_t phase_count = 8;
+
+constexpr std::string_view phase_to_str(Phase p) {
+      switch (p) {
+            case Phase::read:
+                  return "read";
+            case Phase::lex:
+                  return "lex";
+            case Phase::parse:
+                  return "parse";
+            case Phase::sema:
+                  return "sema";
+            case Phase::comptime:
+                  return "comptime";
+            case Phase::ir:
+                  return "ir";
+            case Phase::codegen:
+                  return "codegen";
+            case Phase::run:
+                  return "run";
+      }
+      return "unknown phase";
+}
+
+// CPU time of the calling thread, 0 where there's no per-thread clock.
+inline int64_t thread_cpu_ns() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+      timespec ts{};
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+      return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+#else
+      return 0;
+#endif
+}
+
+// What --time-report collects: one event per phase a file went through, with wall and CPU time and the thread it ran
+// on, plus per-file counts and how big the arenas got. Threads only take the lock to add a file or an event; a file's
+// counters belong to whichever thread compiles it and are read once everything is done.
+class Stats {
+  public:
+      using Clock = std::chrono::steady_clock;
+
+      struct File {
+            std::string path;
+            uint32_t index;
+            size_t tokens = 0;
+            size_t nodes = 0;
+            // the lexer's name interner: distinct names and open-addressed slots
+            size_t names = 0;
+            size_t name_slots = 0;
+      };
+
+      struct Event {
+            Phase phase;
+            // index of the File, or UINT32_MAX for work that isn't about one file
+            uint32_t file;
+            uint32_t thread;
+            int64_t start_ns;
+            int64_t wall_ns;
+            int64_t cpu_ns;
+      };
+
+      struct ArenaUsage {
+            size_t used = 0;
+            size_t reserved = 0;
+      };
+
+  private:
+      const Clock::time_point m_epoch = Clock::now();
+      mutable std::mutex m_mutex;
+      // a deque, so a File stays put while other threads add theirs
+      std::deque<File> m_files;
+      std::vector<Event> m_events;
+      std::unordered_map<std::thread::id, uint32_t> m_threads;
+      std::vector<ArenaUsage> m_arenas;
+
+  public:
+      File* file(std::string_view path) {
+            std::lock_guard lock(m_mutex);
+            m_files.push_back({std::string(path), static_cast<uint32_t>(m_files.size())});
+            return &m_files.back();
+      }
+
+      // nanoseconds since the Stats was made
+      [[nodiscard]] int64_t now() const {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_epoch).count();
+      }
+
+      void record(const Phase phase, const File* file, const int64_t start_ns, const int64_t wall_ns,
+                  const int64_t cpu_ns) {
+            std::lock_guard lock(m_mutex);
+            const auto [it, inserted] =
+                    m_threads.try_emplace(std::this_thread::get_id(), static_cast<uint32_t>(m_threads.size()));
+            m_events.push_back({phase, file ? file->index : UINT32_MAX, it->second, start_ns, wall_ns, cpu_ns});
+      }
+
+      // The size of arena `index` now; arenas only grow, so the last report is the peak.
+      void arena(const size_t index, const size_t used, const size_t reserved) {
+            std::lock_guard lock(m_mutex);
+            if (index >= m_arenas.size())
+                  m_arenas.resize(index + 1);
+            m_arenas[index] = {std::max(m_arenas[index].used, used), std::max(m_arenas[index].reserved, reserved)};
+      }
+
+      // Everything below reads without locking: call it once nothing records anymore.
+      [[nodiscard]] const std::deque<File>& files() const { return m_files; }
+      [[nodiscard]] const std::vector<Event>& events() const { return m_events; }
+      [[nodiscard]] const std::vector<ArenaUsage>& arenas() const { return m_arenas; }
+
+      // Per phase, then per file, then counters, like -ftime-report.
+      void print_report(std::FILE* out) const {
+            std::array<int64_t, phase_count> wall{}, cpu{};
+            std::vector<int64_t> file_wall(m_files.size(), 0);
+            int64_t total_wall = 0, total_cpu = 0;
+            for (const Event& e : m_events) {
+                  wall[static_cast<size_t>(e.phase)] += e.wall_ns;
+                  cpu[static_cast<size_t>(e.phase)] += e.cpu_ns;
+                  total_wall += e.wall_ns;
+                  total_cpu += e.cpu_ns;
+                  if (e.file != UINT32_MAX)
+                        file_wall[e.file] += e.wall_ns;
+            }
+            const auto ms = [](const int64_t ns) { return static_cast<double>(ns) / 1e6; };
+            const auto percent = [total_wall](const int64_t ns) {
+                  return total_wall ? 100.0 * static_cast<double>(ns) / static_cast<double>(total_wall) : 0.0;
+            };
+
+            // summed over threads, so with --jobs N wall time can add up to more than the run took
+            std::fprintf(out, "%-10s %12s %12s %8s\n", "phase", "wall ms", "cpu ms", "wall %");
+            for (size_t p = 0; p < phase_count; p++) {
+                  if (wall[p] == 0 && cpu[p] == 0)
+                        continue;
+                  std::fprintf(out, "%-10s %12.3f %12.3f %7.1f%%\n", phase_to_str(static_cast<Phase>(p)).data(),
+                               ms(wall[p]), ms(cpu[p]), percent(wall[p]));
+            }
+            std::fprintf(out, "%-10s %12.3f %12.3f\n\n", "total", ms(total_wall), ms(total_cpu));
+
+            size_t tokens = 0, nodes = 0;
+            double max_load = 0;
+            if (!m_files.empty()) {
+                  std::fprintf(out, "%12s %10s %10s %8s  %s\n", "wall ms", "tokens", "nodes", "names", "file");
+                  for (const File& f : m_files) {
+                        std::fprintf(out, "%12.3f %10zu %10zu %8zu  %s\n", ms(file_wall[f.index]), f.tokens, f.nodes,
+                                     f.names, f.path.c_str());
+                        tokens += f.tokens;
+                        nodes += f.nodes;
+                        if (f.name_slots)
+                              max_load = std::max(max_load,
+                                                  static_cast<double>(f.names) / static_cast<double>(f.name_slots));
+                  }
+                  std::fprintf(out, "\n");
+            }
+
+            size_t peak = 0, reserved = 0;
+            for (const ArenaUsage& a : m_arenas) {
+                  peak = std::max(peak, a.used);
+                  reserved += a.reserved;
+            }
+            std::fprintf(out, "files: %zu, tokens: %zu, nodes: %zu\n", m_files.size(), tokens, nodes);
+            std::fprintf(out, "arenas: %zu, peak %zu bytes used in one, %zu bytes reserved in all\n",
+                         m_arenas.size(), peak, reserved);
+            std::fprintf(out, "name interner: highest load factor %.2f\n", max_load);
+      }
+
+      // Chrome trace-event JSON, as Perfetto and chrome://tracing open it: one complete event per phase per file,
+      // on the thread that ran it.
+      bool write_trace(const char* path) const {
+            std::FILE* out = std::fopen(path, "w");
+            if (!out)
+                  return false;
+            std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+            bool first = true;
+            for (uint32_t t = 0; t < m_threads.size(); t++) {
+                  std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                                    "\"args\":{\"name\":\"thread %u\"}}",
+                               first ? "" : ",\n", t, t);
+                  first = false;
+            }
+            for (const Event& e : m_events) {
+                  std::fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"nano\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cpu_us\":%.3f",
+                               first ? "" : ",\n", phase_to_str(e.phase).data(), e.thread,
+                               static_cast<double>(e.start_ns) / 1e3, static_cast<double>(e.wall_ns) / 1e3,
+                               static_cast<double>(e.cpu_ns) / 1e3);
+                  first = false;
+                  if (e.file != UINT32_MAX) {
+                        std::fputs(",\"file\":\"", out);
+                        write_escaped(out, m_files[e.file].path);
+                        std::fputc('"', out);
+                  }
+                  std::fputs("}}", out);
+            }
+            std::fprintf(out, "\n]}\n");
+            return std::fclose(out) == 0;
+      }
+
+  private:
+      static void write_escaped(std::FILE* out, const std::string_view s) {
+            for (const char c : s) {
+                  if (c == '"' || c == '\\')
+                        std::fprintf(out, "\\%c", c);
+                  else if (static_cast<unsigned char>(c) < 0x20)
+                        std::fprintf(out, "\\u%04x", static_cast<unsigned>(c));
+                  else
+                        std::fputc(c, out);
+            }
+      }
+};
+
+// Times everything until the end of its scope as one `phase` event, when `stats` isn't null. Built without
+// NANO_STATS it holds nothing and does nothing.
+class PhaseTimer {
+#if NANO_STATS
+      Stats* m_stats;
+      const Stats::File* m_file;
+      Phase m_phase;
+      int64_t m_start = 0;
+      int64_t m_cpu = 0;
+#endif
+
+  public:
+#if NANO_STATS
+      PhaseTimer(Stats* stats, const Phase phase, const Stats::File* file = nullptr) :
+          m_stats(stats), m_file(file), m_phase(phase) {
+            if (m_stats) {
+                  m_start = m_stats->now();
+                  m_cpu = thread_cpu_ns();
+            }
+      }
+
+      ~PhaseTimer() {
+            if (m_stats)
+                  m_stats->record(m_phase, m_file, m_start, m_stats->now() - m_start, thread_cpu_ns() - m_cpu);
+      }
+#else
+      PhaseTimer(Stats*, Phase, const Stats::File* = nullptr) {}
+#endif
+
+      PhaseTimer(const PhaseTimer&) = delete;
+      PhaseTimer& operator=(const PhaseTimer&) = delete;
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of workers, each with its own task deque. A worker runs its own tasks newest first (what it just
+// spawned is still hot in its cache) and, once it runs dry, steals the oldest task from another worker, so a task
+// that fans out into many more (a file and all its imports) spreads over every core without a shared queue.
+// Tasks get the index of the worker running them, for per-worker state like arenas.
+class ThreadPool {
+  public:
+      using Task = std::function<void(size_t worker)>;
+
+  private:
+      struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+      };
+
+      std::vector<std::unique_ptr<Queue>> m_queues;
+      std::vector<std::thread> m_threads;
+
+      std::mutex m_mutex;
+      std::condition_variable m_wake;
+      std::condition_variable m_idle;
+      // tasks sitting in some queue; only incremented with m_mutex held, so sleeping workers can't miss one
+      std::atomic<size_t> m_queued{0};
+      // tasks submitted and not finished yet
+      std::atomic<size_t> m_pending{0};
+      bool m_stop = false;
+      size_t m_next = 0;
+
+      // which worker of which pool the current thread is
+      static inline thread_local const ThreadPool* t_pool = nullptr;
+      static inline thread_local size_t t_worker = 0;
+
+  public:
+      explicit ThreadPool(size_t threads = std::thread::hardware_concurrency()) {
+            if (threads == 0)
+                  threads = 1;
+            for (size_t i = 0; i < threads; i++)
+                  m_queues.push_back(std::make_unique<Queue>());
+            for (size_t i = 0; i < threads; i++)
+                  m_threads.emplace_back([this, i] { run(i); });
+      }
+
+      ThreadPool(const ThreadPool&) = delete;
+      ThreadPool& operator=(const ThreadPool&) = delete;
+
+      ~ThreadPool() {
+            {
+                  std::lock_guard lock(m_mutex);
+                  m_stop = true;
+            }
+            m_wake.notify_all();
+            for (std::thread& t : m_threads)
+                  t.join();
+      }
+
+      [[nodiscard]] size_t size() const { return m_threads.size(); }
+
+      // From inside a task the new task goes to the current worker's own queue, otherwise they are dealt out in turn.
+      void submit(Task task) {
+            m_pending.fetch_add(1);
+            size_t target;
+            if (t_pool == this) {
+                  target = t_worker;
+            } else {
+                  std::lock_guard lock(m_mutex);
+                  target = m_next++ % m_queues.size();
+            }
+            {
+                  std::lock_guard lock(m_queues[target]->mutex);
+                  m_queues[target]->tasks.push_back(std::move(task));
+            }
+            {
+                  std::lock_guard lock(m_mutex);
+                  m_queued.fetch_add(1);
+            }
+            m_wake.notify_one();
+      }
+
+      // Blocks until every task, including the ones submitted by other tasks, has finished. Not for use from a task.
+      void wait() {
+            std::unique_lock lock(m_mutex);
+            m_idle.wait(lock, [this] { return m_pending.load() == 0; });
+      }
+
+  private:
+      bool pop(const size_t worker, Task& task) {
+            {
+                  Queue& own = *m_queues[worker];
+                  std::lock_guard lock(own.mutex);
+                  if (!own.tasks.empty()) {
+                        task = std::move(own.tasks.back());
+                        own.tasks.pop_back();
+                        return true;
+                  }
+            }
+            for (size_t i = 1; i < m_queues.size(); i++) {
+                  Queue& victim = *m_queues[(worker + i) % m_queues.size()];
+                  std::lock_guard lock(victim.mutex);
+                  if (!victim.tasks.empty()) {
+                        task = std::move(victim.tasks.front());
+                        victim.tasks.pop_front();
+                        return true;
+                  }
+            }
+            return false;
+      }
+
+      void run(const size_t worker) {
+            t_pool = this;
+            t_worker = worker;
+            Task task;
+            while (true) {
+                  if (pop(worker, task)) {
+                        m_queued.fetch_sub(1);
+                        task(worker);
+                        task = nullptr;
+                        if (m_pending.fetch_sub(1) == 1) {
+                              std::lock_guard lock(m_mutex);
+                              m_idle.notify_all();
+                        }
+                        continue;
+                  }
+                  std::unique_lock lock(m_mutex);
+                  m_wake.wait(lock, [this] { return m_stop || m_queued.load() > 0; });
+                  if (m_stop && m_queued.load() == 0)
+                        return;
+            }
+      }
+};
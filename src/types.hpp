@@ -0,0 +1,327 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "./interner.hpp"
+
+// A type is a 16-bit id into a TypeTable. The built-ins are the first ids of every table, so they can be named as
+// enumerators; every other id is a type some table interned. Tables hash-cons what they intern, so two types are the
+// same type exactly when their ids are equal.
+enum class Type : uint16_t { INT, FLOAT, STRING, BOOL, NULL_T, UNKNOWN };
+
+constexpr size_t builtin_types = static_cast<size_t>(Type::UNKNOWN) + 1;
+// how many types a table holds before intern() refuses more, so no id is ever truncated into another
+constexpr size_t max_types = UINT16_MAX;
+
+// the name of a built-in; TypeTable::str() also knows the types it interned
+constexpr std::string_view type_to_str(Type t) {
+      switch (t) {
+            case Type::INT:
+                  return "int";
+            case Type::FLOAT:
+                  return "float";
+            case Type::STRING:
+                  return "string";
+            case Type::BOOL:
+                  return "bool";
+            case Type::NULL_T:
+                  return "null";
+            case Type::UNKNOWN:
+                  return "unknown_type";
+      }
+      return "unknown_type";
+}
+
+// The built-in a type name stands for, UNKNOWN if it names none. Every TypeTable declares the built-ins alike and
+// never lets their names mean anything else, so this answers for all of them without touching one.
+constexpr Type builtin_named(const std::string_view name) {
+      for (size_t i = 0; i + 1 < builtin_types; i++) {
+            if (type_to_str(static_cast<Type>(i)) == name)
+                  return static_cast<Type>(i);
+      }
+      return Type::UNKNOWN;
+}
+
+static_assert(builtin_named("float") == Type::FLOAT && builtin_named("null") == Type::NULL_T &&
+              builtin_named("unknown_type") == Type::UNKNOWN && builtin_named("Point") == Type::UNKNOWN);
+
+// What a type is made of. `struct`, `enum` and `class` types are nominal: two of them are the same only with the same
+// name, whatever their members. A `dyn` type is structural, its members are the types it can hold.
+enum class TypeKind : uint8_t { builtin, struct_type, enum_type, class_type, dyn };
+
+// A type as a file stores it, outside of any TypeTable. Built-ins are the same in every table, so they're stored as
+// their ids; every other type as builtin_types plus its index in the file's list of these. Each one's members come
+// before it in the list.
+struct StoredType {
+      TypeKind kind;
+      uint8_t padding[3];
+      // into the file's type names, length 0 for an unnamed type
+      uint32_t name_offset;
+      uint32_t name_length;
+      // a range of the file's stored member ids
+      uint32_t first_member;
+      uint32_t members;
+};
+
+// Interns types and maps type names to them. Lookups by structure and by name are both one hash and a probe of an
+// open-addressed table, like StringInterner. One table serves a whole compilation, shared by every thread of it:
+// ids from different tables only agree on the built-ins, which is why files store types as StoredTypes instead.
+class TypeTable {
+      struct Info {
+            TypeKind kind;
+            // into m_names, no_symbol for an unnamed type
+            SymbolId name;
+            // a range of m_members
+            uint32_t first_member;
+            uint32_t members;
+            uint32_t hash;
+      };
+
+      // held shared by lookups, exclusively by intern() and declare()
+      mutable std::shared_mutex m_mutex;
+      std::vector<Info> m_types;
+      std::vector<Type> m_members;
+      // id + 1 per slot, 0 marks an empty one; the size is a power of two kept at most half full
+      std::vector<uint32_t> m_slots;
+
+      StringInterner m_names;
+      // what each of m_names is the name of, UNKNOWN for a name that isn't a type's
+      std::vector<Type> m_named;
+
+  public:
+      TypeTable() {
+            for (size_t i = 0; i < builtin_types; i++) {
+                  const auto t = static_cast<Type>(i);
+                  const Type interned = *intern(TypeKind::builtin, t == Type::UNKNOWN ? "" : type_to_str(t), {});
+                  if (t != Type::UNKNOWN)
+                        declare(type_to_str(t), interned);
+            }
+      }
+
+      TypeTable(const TypeTable&) = delete;
+      TypeTable& operator=(const TypeTable&) = delete;
+
+      // The type of `kind` named `name` made of `members`: the one there already is, or a new one. Named types of
+      // the same kind are told apart by name alone, so a `struct` re-interned with other members is still the first.
+      // nullopt for a new type once the table holds max_types.
+      std::optional<Type> intern(const TypeKind kind, const std::string_view name,
+                                 const std::span<const Type> members) {
+            const std::unique_lock lock(m_mutex);
+            const SymbolId sym = name.empty() ? no_symbol : m_names.intern(name);
+            const bool nominal = kind != TypeKind::dyn && sym != no_symbol;
+            const std::span<const Type> key = nominal ? std::span<const Type>{} : members;
+            const uint32_t h = hash(kind, sym, key);
+            if ((m_types.size() + 1) * 2 > m_slots.size())
+                  rehash(m_slots.empty() ? 64 : m_slots.size() * 2);
+
+            size_t slot = h & (m_slots.size() - 1);
+            for (; m_slots[slot] != 0; slot = (slot + 1) & (m_slots.size() - 1)) {
+                  const uint32_t id = m_slots[slot] - 1;
+                  const Info& info = m_types[id];
+                  if (info.hash == h && info.kind == kind && info.name == sym &&
+                      (nominal || std::ranges::equal(members_of(static_cast<Type>(id)), key)))
+                        return static_cast<Type>(id);
+            }
+
+            if (m_types.size() >= max_types)
+                  return std::nullopt;
+            const auto id = static_cast<uint32_t>(m_types.size());
+            m_types.push_back(
+                    {kind, sym, static_cast<uint32_t>(m_members.size()), static_cast<uint32_t>(members.size()), h});
+            m_members.insert(m_members.end(), members.begin(), members.end());
+            m_slots[slot] = id + 1;
+            return static_cast<Type>(id);
+      }
+
+      // Makes `name` mean `type` when it's used as a type name. false if it already meant another.
+      bool declare(const std::string_view name, const Type type) {
+            const std::unique_lock lock(m_mutex);
+            const SymbolId sym = m_names.intern(name);
+            if (sym >= m_named.size())
+                  m_named.resize(sym + 1, Type::UNKNOWN);
+            if (m_named[sym] != Type::UNKNOWN && m_named[sym] != type)
+                  return false;
+            m_named[sym] = type;
+            return true;
+      }
+
+      // What a type name in the source stands for, UNKNOWN if nothing. Only names declared besides the built-ins
+      // take the lock every thread of the compilation shares.
+      [[nodiscard]] Type named(const std::string_view name) const {
+            if (const Type builtin = builtin_named(name); builtin != Type::UNKNOWN)
+                  return builtin;
+            const std::shared_lock lock(m_mutex);
+            return named_by(m_names.find(name));
+      }
+
+      // The same for the identifier `symbol` of `names`, a lexer's, whose hash of the name is reused.
+      [[nodiscard]] Type named(const StringInterner& names, const SymbolId symbol) const {
+            const std::string_view name = names.str(symbol);
+            if (const Type builtin = builtin_named(name); builtin != Type::UNKNOWN)
+                  return builtin;
+            const std::shared_lock lock(m_mutex);
+            return named_by(m_names.find(name, names.hash_of(symbol)));
+      }
+
+      [[nodiscard]] TypeKind kind(const Type t) const {
+            const std::shared_lock lock(m_mutex);
+            return m_types[static_cast<size_t>(t)].kind;
+      }
+      // a copy, since another thread may intern more while it's used
+      [[nodiscard]] std::vector<Type> members(const Type t) const {
+            const std::shared_lock lock(m_mutex);
+            const std::span<const Type> members = members_of(t);
+            return {members.begin(), members.end()};
+      }
+      [[nodiscard]] size_t size() const {
+            const std::shared_lock lock(m_mutex);
+            return m_types.size();
+      }
+
+      // the name a diagnostic shows for `t`; an unnamed `dyn` spells out its members
+      [[nodiscard]] std::string str(const Type t) const {
+            const std::shared_lock lock(m_mutex);
+            return str_of(t);
+      }
+
+      // Stores types for a file: export_type() gives each type the id the file stores it as, and collects what the
+      // ones that aren't built-ins are made of into `types`, `members` and `names`, for the file to write out.
+      class Export {
+            const TypeTable& m_table;
+            std::vector<Type> m_stored;
+
+        public:
+            std::vector<StoredType> types;
+            std::vector<Type> members;
+            std::string names;
+
+            explicit Export(const TypeTable& table) : m_table(table) {}
+
+            Type export_type(const Type t) {
+                  if (static_cast<size_t>(t) < builtin_types)
+                        return t;
+                  const size_t id = static_cast<size_t>(t) - builtin_types;
+                  if (id < m_stored.size() && m_stored[id] != Type::UNKNOWN)
+                        return m_stored[id];
+                  TypeKind kind;
+                  std::string name;
+                  std::vector<Type> of;
+                  {
+                        const std::shared_lock lock(m_table.m_mutex);
+                        const Info& info = m_table.m_types[static_cast<size_t>(t)];
+                        kind = info.kind;
+                        if (info.name != no_symbol)
+                              name = m_table.m_names.str(info.name);
+                        const std::span<const Type> m = m_table.members_of(t);
+                        of.assign(m.begin(), m.end());
+                  }
+                  for (Type& m : of)
+                        m = export_type(m);
+                  const StoredType stored{kind,
+                                          {},
+                                          static_cast<uint32_t>(names.size()),
+                                          static_cast<uint32_t>(name.size()),
+                                          static_cast<uint32_t>(members.size()),
+                                          static_cast<uint32_t>(of.size())};
+                  names += name;
+                  members.insert(members.end(), of.begin(), of.end());
+                  types.push_back(stored);
+                  if (id >= m_stored.size())
+                        m_stored.resize(id + 1, Type::UNKNOWN);
+                  return m_stored[id] = static_cast<Type>(builtin_types + types.size() - 1);
+            }
+      };
+
+      // Whether stored types are well-formed: names and member ranges in bounds, every member stored before the
+      // type made of it.
+      static bool valid(const std::span<const StoredType> types, const std::span<const Type> members,
+                        const std::string_view names) {
+            for (size_t i = 0; i < types.size(); i++) {
+                  const StoredType& t = types[i];
+                  if (t.kind == TypeKind::builtin || t.kind > TypeKind::dyn || t.name_offset > names.size() ||
+                      t.name_length > names.size() - t.name_offset || t.first_member > members.size() ||
+                      t.members > members.size() - t.first_member)
+                        return false;
+                  for (const Type m : members.subspan(t.first_member, t.members)) {
+                        if (static_cast<size_t>(m) >= builtin_types + i)
+                              return false;
+                  }
+            }
+            return true;
+      }
+
+      // What each stored id of a file's types is in this table, interning what isn't here yet; nullopt if they
+      // aren't valid() or don't fit in the table. Indexed by stored id, so a file's ids are translated by one load.
+      std::optional<std::vector<Type>> import(const std::span<const StoredType> types,
+                                              const std::span<const Type> members, const std::string_view names) {
+            if (!valid(types, members, names))
+                  return std::nullopt;
+            std::vector<Type> ids(builtin_types);
+            for (size_t i = 0; i < builtin_types; i++)
+                  ids[i] = static_cast<Type>(i);
+            std::vector<Type> of;
+            for (const StoredType& t : types) {
+                  of.clear();
+                  for (const Type m : members.subspan(t.first_member, t.members))
+                        of.push_back(ids[static_cast<size_t>(m)]);
+                  const std::optional<Type> id = intern(t.kind, names.substr(t.name_offset, t.name_length), of);
+                  if (!id)
+                        return std::nullopt;
+                  ids.push_back(*id);
+            }
+            return ids;
+      }
+
+  private:
+      [[nodiscard]] Type named_by(const SymbolId sym) const {
+            return sym < m_named.size() ? m_named[sym] : Type::UNKNOWN;
+      }
+
+      [[nodiscard]] std::span<const Type> members_of(const Type t) const {
+            const Info& info = m_types[static_cast<size_t>(t)];
+            return std::span<const Type>(m_members).subspan(info.first_member, info.members);
+      }
+
+      [[nodiscard]] std::string str_of(const Type t) const {
+            if (static_cast<size_t>(t) < builtin_types)
+                  return std::string(type_to_str(t));
+            const Info& info = m_types[static_cast<size_t>(t)];
+            if (info.name != no_symbol)
+                  return std::string(m_names.str(info.name));
+            std::string out = "dyn(";
+            for (const Type m : members_of(t))
+                  out += (out.size() > 4 ? ", " : "") + str_of(m);
+            return out + ")";
+      }
+
+      static uint32_t hash(const TypeKind kind, const SymbolId name, const std::span<const Type> members) {
+            // FNV-1a over the 16-bit ids, as StringInterner does over bytes
+            uint32_t h = 2166136261u;
+            const auto mix = [&h](const uint32_t v) {
+                  h ^= v;
+                  h *= 16777619u;
+            };
+            mix(static_cast<uint32_t>(kind));
+            mix(name);
+            for (const Type m : members)
+                  mix(static_cast<uint32_t>(m));
+            return h;
+      }
+
+      void rehash(const size_t slots) {
+            m_slots.assign(slots, 0);
+            for (uint32_t id = 0; id < m_types.size(); id++) {
+                  size_t slot = m_types[id].hash & (slots - 1);
+                  while (m_slots[slot] != 0)
+                        slot = (slot + 1) & (slots - 1);
+                  m_slots[slot] = id + 1;
+            }
+      }
+};
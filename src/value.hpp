@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include "./parser.hpp"
+
+// A value as the interpreters see it, at compile time (comptime.hpp) or at run time (vm.hpp). `type` says which field
+// holds it.
+struct Value {
+      Type type = Type::NULL_T;
+      int64_t integer = 0;
+      double real = 0;
+      bool boolean = false;
+      std::string_view string;
+
+      static Value of(const int64_t v) { return {Type::INT, v, 0, false, {}}; }
+      static Value of(const double v) { return {Type::FLOAT, 0, v, false, {}}; }
+      static Value of(const bool v) { return {Type::BOOL, 0, 0, v, {}}; }
+      static Value of(const std::string_view v) { return {Type::STRING, 0, 0, false, v}; }
+
+      bool operator==(const Value&) const = default;
+};
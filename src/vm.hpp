@@ -0,0 +1,332 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "./bytecode.hpp"
+#include "./value.hpp"
+
+// Threaded dispatch jumps straight from one instruction's handler to the next one's through a table of label
+// addresses, a GNU extension; elsewhere the same handlers sit in a switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define NANO_THREADED_DISPATCH 1
+#else
+#define NANO_THREADED_DISPATCH 0
+#endif
+
+enum class RuntimeError {
+      division_by_zero,
+      stack_overflow,
+      unknown_function,
+      argument_count,
+      type_mismatch,
+};
+
+constexpr std::string_view runtime_error_to_str(RuntimeError e) {
+      switch (e) {
+            case RuntimeError::division_by_zero:
+                  return "division by zero";
+            case RuntimeError::stack_overflow:
+                  return "calls nested too deeply";
+            case RuntimeError::unknown_function:
+                  return "no such function";
+            case RuntimeError::argument_count:
+                  return "wrong number of arguments";
+            case RuntimeError::type_mismatch:
+                  return "argument of the wrong type";
+      }
+      return "unknown runtime error";
+}
+
+// Runs a Program. All frames share one register file: a call's arguments are already in the caller's registers
+// where the callee's first ones go, so calling is moving the frame base up, not copying.
+class VM {
+      struct Frame {
+            const Function* fn;
+            const Instr* ip;
+            size_t base;
+            // where in the caller the result goes
+            uint16_t dst;
+      };
+
+      const Program& m_program;
+      std::vector<Reg> m_registers;
+      std::vector<Frame> m_frames;
+      std::vector<Reg> m_globals;
+      // the program's strings, then those passed in to call()
+      std::vector<std::string_view> m_strings;
+      bool m_initialized = false;
+
+  public:
+      size_t max_depth = 10'000;
+
+      explicit VM(const Program& program) :
+          m_program(program), m_globals(program.globals.size()), m_strings(program.strings) {}
+
+      // Runs the top-level statements, which also sets the globals up for call().
+      std::optional<RuntimeError> run(Value& out) {
+            const Function& entry = m_program.functions[m_program.entry];
+            Reg result;
+            if (const std::optional<RuntimeError> err = execute(entry, {}, result))
+                  return err;
+            m_initialized = true;
+            out = value(entry.result, result);
+            return std::nullopt;
+      }
+
+      std::optional<RuntimeError> call(const std::string_view name, const std::span<const Value> args, Value& out) {
+            const auto it = m_program.by_name.find(name);
+            if (it == m_program.by_name.end())
+                  return RuntimeError::unknown_function;
+            if (!m_initialized) {
+                  Value ignored;
+                  if (const std::optional<RuntimeError> err = run(ignored))
+                        return err;
+            }
+            const Function& fn = m_program.functions[it->second];
+            if (args.size() != fn.params.size())
+                  return RuntimeError::argument_count;
+            std::vector<Reg> regs(args.size());
+            for (size_t i = 0; i < args.size(); i++) {
+                  if (args[i].type != fn.params[i])
+                        return RuntimeError::type_mismatch;
+                  regs[i] = reg(args[i]);
+            }
+            Reg result;
+            if (const std::optional<RuntimeError> err = execute(fn, regs, result))
+                  return err;
+            out = value(fn.result, result);
+            return std::nullopt;
+      }
+
+  private:
+      [[nodiscard]] Value value(const Type type, const Reg r) const {
+            switch (type) {
+                  case Type::INT:
+                        return Value::of(r.i);
+                  case Type::FLOAT:
+                        return Value::of(r.f);
+                  case Type::BOOL:
+                        return Value::of(r.i != 0);
+                  case Type::STRING:
+                        return Value::of(m_strings[static_cast<size_t>(r.i)]);
+                  default:
+                        return {};
+            }
+      }
+
+      Reg reg(const Value& v) {
+            Reg r;
+            r.i = 0;
+            switch (v.type) {
+                  case Type::INT:
+                        r.i = v.integer;
+                        break;
+                  case Type::FLOAT:
+                        r.f = v.real;
+                        break;
+                  case Type::BOOL:
+                        r.i = v.boolean;
+                        break;
+                  case Type::STRING:
+                        r.i = static_cast<int64_t>(m_strings.size());
+                        m_strings.push_back(v.string);
+                        break;
+                  default:
+                        break;
+            }
+            return r;
+      }
+
+      std::optional<RuntimeError> execute(const Function& entry, const std::span<const Reg> args, Reg& result) {
+            m_frames.clear();
+            m_registers.assign(entry.registers + size_t{1}, Reg{});
+            for (size_t i = 0; i < args.size(); i++)
+                  m_registers[i] = args[i];
+            m_frames.push_back({&entry, entry.code.data(), 0, 0});
+
+            const Reg* const constants = m_program.constants.data();
+            const Function* const functions = m_program.functions.data();
+            const Instr* ip = entry.code.data();
+            Reg* r = m_registers.data();
+            Instr in;
+
+#if NANO_THREADED_DISPATCH
+            static const void* const labels[] = {
+#define NANO_OPCODE_LABEL(name) &&op_##name,
+                    NANO_OPCODES(NANO_OPCODE_LABEL)
+#undef NANO_OPCODE_LABEL
+            };
+#define NANO_CASE(name) op_##name:
+#define NANO_NEXT()                                                                                                    \
+      in = *ip++;                                                                                                      \
+      goto* labels[static_cast<size_t>(in.op)]
+            NANO_NEXT();
+#else
+#define NANO_CASE(name) case Op::name:
+#define NANO_NEXT() continue
+            for (;;) {
+                  in = *ip++;
+                  switch (in.op) {
+#endif
+
+            NANO_CASE(load) {
+                  r[in.a] = constants[in.k()];
+                  NANO_NEXT();
+            }
+            NANO_CASE(mov) {
+                  r[in.a] = r[in.b];
+                  NANO_NEXT();
+            }
+            NANO_CASE(get_global) {
+                  r[in.a] = m_globals[in.k()];
+                  NANO_NEXT();
+            }
+            NANO_CASE(set_global) {
+                  m_globals[in.k()] = r[in.a];
+                  NANO_NEXT();
+            }
+
+#define NANO_INT_OP(name, expr)                                                                                        \
+      NANO_CASE(name) {                                                                                                \
+            const uint64_t x = static_cast<uint64_t>(r[in.b].i), y = static_cast<uint64_t>(r[in.c].i);                 \
+            r[in.a].i = static_cast<int64_t>(expr);                                                                    \
+            NANO_NEXT();                                                                                               \
+      }
+            // wrapping, like the comptime interpreter's arithmetic
+            NANO_INT_OP(add_i, x + y)
+            NANO_INT_OP(sub_i, x - y)
+            NANO_INT_OP(mul_i, x * y)
+            NANO_INT_OP(and_i, x & y)
+            NANO_INT_OP(or_i, x | y)
+#undef NANO_INT_OP
+            NANO_CASE(div_i) {
+                  const int64_t y = r[in.c].i;
+                  if (y == 0)
+                        return RuntimeError::division_by_zero;
+                  // INT64_MIN / -1 overflows
+                  r[in.a].i = y == -1 ? static_cast<int64_t>(0 - static_cast<uint64_t>(r[in.b].i)) : r[in.b].i / y;
+                  NANO_NEXT();
+            }
+            NANO_CASE(neg_i) {
+                  r[in.a].i = static_cast<int64_t>(0 - static_cast<uint64_t>(r[in.b].i));
+                  NANO_NEXT();
+            }
+            NANO_CASE(inc_i) {
+                  r[in.a].i = static_cast<int64_t>(static_cast<uint64_t>(r[in.a].i) + 1);
+                  NANO_NEXT();
+            }
+            NANO_CASE(dec_i) {
+                  r[in.a].i = static_cast<int64_t>(static_cast<uint64_t>(r[in.a].i) - 1);
+                  NANO_NEXT();
+            }
+
+#define NANO_COMPARE(name, field, op)                                                                                  \
+      NANO_CASE(name) {                                                                                                \
+            r[in.a].i = r[in.b].field op r[in.c].field;                                                                \
+            NANO_NEXT();                                                                                               \
+      }
+            NANO_COMPARE(lt_i, i, <)
+            NANO_COMPARE(le_i, i, <=)
+            NANO_COMPARE(gt_i, i, >)
+            NANO_COMPARE(ge_i, i, >=)
+            NANO_COMPARE(eq_i, i, ==)
+            NANO_COMPARE(ne_i, i, !=)
+            NANO_COMPARE(lt_f, f, <)
+            NANO_COMPARE(le_f, f, <=)
+            NANO_COMPARE(gt_f, f, >)
+            NANO_COMPARE(ge_f, f, >=)
+            NANO_COMPARE(eq_f, f, ==)
+            NANO_COMPARE(ne_f, f, !=)
+#undef NANO_COMPARE
+
+#define NANO_FLOAT_OP(name, op)                                                                                        \
+      NANO_CASE(name) {                                                                                                \
+            r[in.a].f = r[in.b].f op r[in.c].f;                                                                        \
+            NANO_NEXT();                                                                                               \
+      }
+            NANO_FLOAT_OP(add_f, +)
+            NANO_FLOAT_OP(sub_f, -)
+            NANO_FLOAT_OP(mul_f, *)
+            NANO_FLOAT_OP(div_f, /)
+#undef NANO_FLOAT_OP
+            NANO_CASE(neg_f) {
+                  r[in.a].f = -r[in.b].f;
+                  NANO_NEXT();
+            }
+            NANO_CASE(inc_f) {
+                  r[in.a].f += 1;
+                  NANO_NEXT();
+            }
+            NANO_CASE(dec_f) {
+                  r[in.a].f -= 1;
+                  NANO_NEXT();
+            }
+
+            NANO_CASE(not_b) {
+                  r[in.a].i = r[in.b].i == 0;
+                  NANO_NEXT();
+            }
+            NANO_CASE(eq_s) {
+                  r[in.a].i = m_strings[static_cast<size_t>(r[in.b].i)] == m_strings[static_cast<size_t>(r[in.c].i)];
+                  NANO_NEXT();
+            }
+            NANO_CASE(ne_s) {
+                  r[in.a].i = m_strings[static_cast<size_t>(r[in.b].i)] != m_strings[static_cast<size_t>(r[in.c].i)];
+                  NANO_NEXT();
+            }
+
+            NANO_CASE(jump) {
+                  ip = m_frames.back().fn->code.data() + in.k();
+                  NANO_NEXT();
+            }
+            NANO_CASE(jump_if) {
+                  if (r[in.a].i != 0)
+                        ip = m_frames.back().fn->code.data() + in.k();
+                  NANO_NEXT();
+            }
+            NANO_CASE(jump_unless) {
+                  if (r[in.a].i == 0)
+                        ip = m_frames.back().fn->code.data() + in.k();
+                  NANO_NEXT();
+            }
+
+            NANO_CASE(call) {
+                  if (m_frames.size() >= max_depth)
+                        return RuntimeError::stack_overflow;
+                  const Function& callee = functions[in.b];
+                  m_frames.back().ip = ip;
+                  const size_t base = static_cast<size_t>(r - m_registers.data()) + in.c;
+                  // grown geometrically, and `r` moves with the storage
+                  if (base + callee.registers + 1 > m_registers.size())
+                        m_registers.resize((base + callee.registers + 1) * 2);
+                  m_frames.push_back({&callee, nullptr, base, in.a});
+                  r = m_registers.data() + base;
+                  ip = callee.code.data();
+                  NANO_NEXT();
+            }
+            NANO_CASE(ret) {
+                  const Reg value = r[in.a];
+                  const Frame done = m_frames.back();
+                  m_frames.pop_back();
+                  if (m_frames.empty()) {
+                        result = value;
+                        return std::nullopt;
+                  }
+                  const Frame& caller = m_frames.back();
+                  r = m_registers.data() + caller.base;
+                  r[done.dst] = value;
+                  ip = caller.ip;
+                  NANO_NEXT();
+            }
+
+#if !NANO_THREADED_DISPATCH
+                  }
+            }
+#endif
+#undef NANO_CASE
+#undef NANO_NEXT
+      }
+};
@@ -0,0 +1,75 @@
+#pragma once
+// only built with -DNANO_ENABLE_LLVM=ON
+#if NANO_ENABLE_LLVM
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "../../src/llvm_backend.hpp"
+#include "../../src/passes.hpp"
+
+inline void build_native(const std::string_view in, Context& ctx, ir::Module& module) {
+      Lexer lexer(in);
+      EXPECT_FALSE(lexer.tokenize());
+      Diagnostics diagnostics;
+      Parser parser(lexer.tokens, ctx, diagnostics);
+      const std::vector<ASTNode*> nodes = parser.parse();
+      EXPECT_TRUE(diagnostics.empty());
+      EXPECT_FALSE(ir::Builder(module).build(nodes));
+      ir::PassManager::standard().run(module);
+}
+
+TEST(LlvmBackend, JitRunsAtEveryLevel) {
+      Context ctx;
+      ir::Module module;
+      build_native("fn fib(n: int) : int { var r = n\nn > 1 && (r = fib(n - 1) + fib(n - 2)) > 0\nr }\n"
+                   "fn half(x: float) : float { x / 2.0 }\n"
+                   "var base = 20\nbase += 5\nfib(base) + fib(2) / 1\n",
+                   ctx, module);
+      const LlvmBackend backend;
+      for (unsigned level = 0; level <= 3; level++) {
+            Value out;
+            ASSERT_EQ(backend.run(module, level, out), std::nullopt) << level;
+            EXPECT_EQ(out, Value::of(int64_t{75026})) << level;
+      }
+
+      Context ctx2;
+      ir::Module strings;
+      build_native("fn same(a: string, b: string) : bool { a == b }\nsame(\"x\", \"x\") && !same(\"x\", \"y\")\n", ctx2,
+                   strings);
+      Value out;
+      ASSERT_EQ(backend.run(strings, 2, out), std::nullopt);
+      EXPECT_EQ(out, Value::of(true));
+}
+
+TEST(LlvmBackend, JitReportsDivisionByZero) {
+      Context ctx;
+      ir::Module module;
+      build_native("fn f(a: int, b: int) : int { a / b }\nvar z = 0\nf(1, z)\n", ctx, module);
+      Value out;
+      EXPECT_EQ(LlvmBackend().run(module, 0, out), LlvmError::division_by_zero);
+}
+
+TEST(LlvmBackend, EmitsObjectFilesInParallel) {
+      Context ctx;
+      ir::Module module;
+      build_native("fn a(x: int) : int { x + 1 }\nfn b(x: int) : int { a(x) * 2 }\nfn c(x: int) : int { b(x) - 3 }\n"
+                   "c(4)\n",
+                   ctx, module);
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_llvm_test";
+      std::filesystem::create_directories(dir);
+      std::vector<std::string> written;
+      ASSERT_EQ(LlvmBackend().emit_objects(module, (dir / "out.o").string(), 2, 3, written), std::nullopt);
+      ASSERT_EQ(written.size(), 3u);
+      for (const std::string& path : written) {
+            // an ELF or Mach-O or COFF header, not empty
+            EXPECT_GT(std::filesystem::file_size(path), 64u) << path;
+      }
+      std::filesystem::remove_all(dir);
+
+      std::string text;
+      ASSERT_EQ(LlvmBackend().ir_text(module, 2, text), std::nullopt);
+      EXPECT_NE(text.find("define i64 @nano.main()"), std::string::npos) << text;
+}
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+
+// Synthetic sources for the benchmarks, each stressing one part of the front-end. Deterministic for a seed, and
+// valid Nano, so lexing and parsing them never takes an error path.
+enum class CorpusShape {
+      // long statements of nested parentheses and operators
+      deep_expressions,
+      // few tokens, each a 100+ character name
+      long_identifiers,
+      // mostly line and block comments around a little code
+      comments,
+      // thousands of one-line `fn`s
+      small_functions,
+};
+
+constexpr std::string_view corpus_shape_to_str(CorpusShape s) {
+      switch (s) {
+            case CorpusShape::deep_expressions:
+                  return "deep_expressions";
+            case CorpusShape::long_identifiers:
+                  return "long_identifiers";
+            case CorpusShape::comments:
+                  return "comments";
+            case CorpusShape::small_functions:
+                  return "small_functions";
+      }
+      return "unknown";
+}
+
+// About `bytes` of source in the given shape.
+inline std::string generate_corpus(const CorpusShape shape, const size_t bytes, const uint32_t seed = 1) {
+      std::mt19937 rng(seed);
+      const auto pick = [&rng](const size_t n) { return static_cast<size_t>(rng() % n); };
+      constexpr std::string_view ops[] = {" + ", " - ", " * ", " / ", " < ", " == "};
+      std::string out = "var a = 1\nvar b = 2.5\n";
+
+      while (out.size() < bytes) {
+            switch (shape) {
+                  case CorpusShape::deep_expressions: {
+                        const size_t depth = 16 + pick(48);
+                        out += "var e = ";
+                        for (size_t i = 0; i < depth; i++)
+                              out += '(';
+                        out += "a";
+                        for (size_t i = 0; i < depth; i++) {
+                              out += ops[pick(4)];
+                              out += pick(2) ? "a" : std::to_string(pick(1000));
+                              out += ')';
+                        }
+                        out += '\n';
+                        break;
+                  }
+                  case CorpusShape::long_identifiers: {
+                        std::string name = "identifier_";
+                        const size_t length = 100 + pick(400);
+                        while (name.size() < length)
+                              name += static_cast<char>('a' + pick(26));
+                        out += "var " + name + " = a\n" + name + " += " + name + "\n";
+                        break;
+                  }
+                  case CorpusShape::comments:
+                        out += "// a line comment, long enough to be most of what the lexer sees on this line\n";
+                        out += "/* a block comment\n   spanning lines, with symbols + - * / { } ( ) \" ' */\n";
+                        out += "a = a + " + std::to_string(pick(100)) + " // trailing\n";
+                        break;
+                  case CorpusShape::small_functions: {
+                        const std::string n = std::to_string(out.size());
+                        out += "fn f" + n + "(x: int, y: int) : int { x * " + std::to_string(pick(10)) + " + y }\n";
+                        break;
+                  }
+            }
+      }
+      return out;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "../../src/ast_flat.hpp"
+#include "../../src/parser.hpp"
+#include "corpus.h"
+
+// operator new calls so far, counted by bench_main.cpp
+inline std::atomic<size_t> g_allocations{0};
+
+inline constexpr size_t corpus_bytes = 1 << 20;
+
+inline const std::string& corpus(const CorpusShape shape) {
+      static const std::string corpora[] = {
+              generate_corpus(CorpusShape::deep_expressions, corpus_bytes),
+              generate_corpus(CorpusShape::long_identifiers, corpus_bytes),
+              generate_corpus(CorpusShape::comments, corpus_bytes),
+              generate_corpus(CorpusShape::small_functions, corpus_bytes),
+      };
+      return corpora[static_cast<size_t>(shape)];
+}
+
+// bytes/s as MB/s, the rest per second or per token
+inline void report(benchmark::State& state, const size_t bytes, const size_t tokens, const size_t nodes,
+                   const size_t allocations) {
+      const auto iterations = static_cast<double>(state.iterations());
+      state.SetBytesProcessed(static_cast<int64_t>(bytes) * state.iterations());
+      state.counters["tokens"] = benchmark::Counter(static_cast<double>(tokens) * iterations,
+                                                    benchmark::Counter::kIsRate);
+      if (nodes)
+            state.counters["nodes"] = benchmark::Counter(static_cast<double>(nodes) * iterations,
+                                                         benchmark::Counter::kIsRate);
+      state.counters["allocs/token"] =
+              static_cast<double>(allocations) / (static_cast<double>(tokens) * iterations);
+}
+
+inline void BM_Tokenize(benchmark::State& state, const CorpusShape shape) {
+      const std::string& source = corpus(shape);
+      size_t tokens = 0;
+      const size_t before = g_allocations.load();
+      for (auto _ : state) {
+            Lexer lexer(source);
+            if (lexer.tokenize()) {
+                  state.SkipWithError("corpus doesn't lex");
+                  return;
+            }
+            tokens = lexer.tokens.size();
+            benchmark::DoNotOptimize(lexer.tokens.kinds().data());
+      }
+      report(state, source.size(), tokens, 0, g_allocations.load() - before);
+}
+
+// Parsing only: the tokens are made once, outside the timed loop.
+inline void BM_Parse(benchmark::State& state, const CorpusShape shape) {
+      const std::string& source = corpus(shape);
+      Lexer lexer(source);
+      if (lexer.tokenize()) {
+            state.SkipWithError("corpus doesn't lex");
+            return;
+      }
+      size_t nodes = 0;
+      {
+            Context ctx;
+            Diagnostics diagnostics;
+            Parser parser(lexer.tokens, ctx, diagnostics);
+            nodes = Flattener().flatten(parser.parse()).nodes.size();
+            if (!diagnostics.empty()) {
+                  state.SkipWithError("corpus doesn't parse");
+                  return;
+            }
+      }
+
+      const size_t before = g_allocations.load();
+      for (auto _ : state) {
+            Context ctx;
+            Parser parser(lexer.tokens, ctx);
+            const std::vector<ASTNode*> ast = parser.parse();
+            benchmark::DoNotOptimize(ast.data());
+      }
+      report(state, source.size(), lexer.tokens.size(), nodes, g_allocations.load() - before);
+}
+
+// What an import that only needs signatures costs: bodies are brace-matched and skipped (Parser::lazy_bodies).
+inline void BM_ParseSignatures(benchmark::State& state, const bool lazy) {
+      const std::string& source = corpus(CorpusShape::small_functions);
+      Lexer lexer(source);
+      if (lexer.tokenize()) {
+            state.SkipWithError("corpus doesn't lex");
+            return;
+      }
+      size_t arena = 0;
+      const size_t before = g_allocations.load();
+      for (auto _ : state) {
+            Context ctx;
+            Parser parser(lexer.tokens, ctx);
+            parser.lazy_bodies = lazy;
+            const std::vector<ASTNode*> ast = parser.parse();
+            benchmark::DoNotOptimize(ast.data());
+            arena = ctx.arena.bytes_used();
+      }
+      report(state, source.size(), lexer.tokens.size(), 0, g_allocations.load() - before);
+      state.counters["arena bytes"] = static_cast<double>(arena);
+}
+
+#define NANO_FRONTEND_BENCHMARKS(shape)                                                                                \
+      BENCHMARK_CAPTURE(BM_Tokenize, shape, CorpusShape::shape)->Unit(benchmark::kMillisecond);                        \
+      BENCHMARK_CAPTURE(BM_Parse, shape, CorpusShape::shape)->Unit(benchmark::kMillisecond)
+
+NANO_FRONTEND_BENCHMARKS(deep_expressions);
+NANO_FRONTEND_BENCHMARKS(long_identifiers);
+NANO_FRONTEND_BENCHMARKS(comments);
+NANO_FRONTEND_BENCHMARKS(small_functions);
+BENCHMARK_CAPTURE(BM_ParseSignatures, eager, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_ParseSignatures, lazy, true)->Unit(benchmark::kMillisecond);
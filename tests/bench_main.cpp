@@ -0,0 +1,18 @@
+#include <cstdlib>
+#include <new>
+#include <benchmark/benchmark.h>
+
+#include "bench/frontend.h"
+
+// Every allocation goes through here, for the allocs/token counters.
+void* operator new(const std::size_t size) {
+      g_allocations.fetch_add(1, std::memory_order_relaxed);
+      if (void* p = std::malloc(size ? size : 1))
+            return p;
+      throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+BENCHMARK_MAIN();
@@ -0,0 +1,84 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../../src/ast_printer.hpp"
+#include "../../src/comptime.hpp"
+
+struct ComptimeRun {
+      std::string ast;
+      std::vector<EvalError> errors;
+      size_t memo_hits = 0;
+};
+
+inline ComptimeRun run_comptime(const std::string_view in, const EvalBudget budget = {}) {
+      Lexer lexer(in);
+      EXPECT_FALSE(lexer.tokenize());
+      Context ctx;
+      Diagnostics diagnostics;
+      Parser parser(lexer.tokens, ctx, diagnostics);
+      const std::vector<ASTNode*> nodes = parser.parse();
+      EXPECT_TRUE(diagnostics.empty());
+
+      Interpreter interpreter(ctx, &diagnostics, budget);
+      interpreter.run(nodes);
+      ComptimeRun result;
+      StringSink sink{result.ast};
+      AstPrinter(sink).print(nodes);
+      for (const Diagnostic& d : diagnostics.list())
+            result.errors.push_back(std::get<EvalError>(d.error));
+      result.memo_hits = interpreter.memo_hits();
+      return result;
+}
+
+TEST(ComptimeInterpreter, EvaluatesCallsAndBlocks) {
+      const ComptimeRun r = run_comptime("fn sq(x: int) : int { x * x }\n"
+                                         "fn sum3(a: int, b: int, c: int) : int { var t = a + b\nt += c\nt }\n"
+                                         "var base = 10\n"
+                                         "var a = comptime sq(base + 2)\n"
+                                         "var b = comptime { var x = 1.5\nx * 2.0 }\n"
+                                         "var c = comptime sum3(1, 2, 3) == 6 && \"n\" != \"m\"\n");
+      EXPECT_NE(r.ast.find("unknown_type a = 144\n"), std::string::npos) << r.ast;
+      EXPECT_NE(r.ast.find("unknown_type b = 3.0\n"), std::string::npos) << r.ast;
+      EXPECT_NE(r.ast.find("unknown_type c = true\n"), std::string::npos) << r.ast;
+      EXPECT_TRUE(r.errors.empty());
+}
+
+TEST(ComptimeInterpreter, MemoizesCallsOnTheirArguments) {
+      // fib(n) without memoization would take 2^30 calls
+      const ComptimeRun r = run_comptime(
+              "fn fib(n: int) : int { var r = n\nn > 1 && (r = fib(n - 1) + fib(n - 2)) > 0\nr }\n"
+              "var f = comptime fib(90)\nvar g = comptime fib(90)\n");
+      EXPECT_NE(r.ast.find("unknown_type f = 2880067194370816120\n"), std::string::npos) << r.ast;
+      EXPECT_TRUE(r.errors.empty());
+      EXPECT_GE(r.memo_hits, 89u);
+}
+
+TEST(ComptimeInterpreter, BudgetsStopRunawayEvaluation) {
+      const ComptimeRun r = run_comptime("fn loop(n: int) : int { loop(n + 1) }\nvar a = comptime loop(0)\n"
+                                         "var b = comptime 1 / 0\nvar c = comptime missing\nvar d = comptime 7\n",
+                                         EvalBudget{.steps = 100000, .depth = 64});
+      const std::vector<EvalError> expected = {EvalError::depth_limit, EvalError::division_by_zero,
+                                               EvalError::unknown_name};
+      EXPECT_EQ(r.errors, expected);
+      EXPECT_NE(r.ast.find("unknown_type d = 7\n"), std::string::npos) << r.ast;
+      EXPECT_NE(r.ast.find("comptime loop(0)"), std::string::npos) << "A failed evaluation leaves the expression.";
+}
+
+TEST(ComptimeInterpreter, MemoryIsBudgetedPerExpression) {
+      std::string in = "fn sq(x: int) : int { x * x }\n"
+                       "fn fib(n: int) : int { var r = n\nn > 1 && (r = fib(n - 1) + fib(n - 2)) > 0\nr }\n";
+      for (int i = 0; i < 64; i++)
+            in += "var a" + std::to_string(i) + " = comptime sq(" + std::to_string(i) + ")\n";
+      in += "var big = comptime fib(80)\nvar last = comptime sq(100)\n";
+      const ComptimeRun r = run_comptime(in, EvalBudget{.memory = 2048});
+      EXPECT_EQ(r.errors, std::vector<EvalError>{EvalError::memory_limit}) << "Only fib(80) memoizes too much at once.";
+      EXPECT_NE(r.ast.find("unknown_type a63 = 3969\n"), std::string::npos) << r.ast;
+      EXPECT_NE(r.ast.find("unknown_type last = 10000\n"), std::string::npos) << r.ast;
+}
+
+TEST(ComptimeInterpreter, DivisionOverflowWrapsLikeTheVm) {
+      const ComptimeRun r = run_comptime("var m = comptime (-9223372036854775807 - 1) / -1\n");
+      EXPECT_TRUE(r.errors.empty());
+      EXPECT_NE(r.ast.find("unknown_type m = -9223372036854775808\n"), std::string::npos) << r.ast;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include "../../src/cache.hpp"
+#include "../../src/context.hpp"
+#include "../../src/driver.hpp"
+
+TEST(CacheHash, MatchesReferenceXXH64) {
+      EXPECT_EQ(xxh64::hash(""), 0xef46db3751d8e999ull);
+      EXPECT_EQ(xxh64::hash("a"), 0xd24ec4f1a98c6e5bull);
+      EXPECT_EQ(xxh64::hash("abc"), 0x44bc2cf5ad770999ull);
+      EXPECT_EQ(xxh64::hash("Nobody inspects the spammish repetition"), 0xfbcea83c8a378bf1ull);
+}
+
+TEST(CacheEntries, RoundTripTokensAndAst) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_cache_test";
+      std::filesystem::remove_all(dir);
+      const std::string source = "import lib\nvar s = \"a\\tb\"\nfn f(int a) : int { a + 1 }\nvar x = f(2) * 3\n";
+
+      Lexer lexer(source);
+      ASSERT_FALSE(lexer.tokenize());
+      Context ctx;
+      Parser parser(lexer.tokens, ctx);
+      const std::vector<ASTNode*> ast = parser.parse();
+      const FlatAst flat = Flattener().flatten(ast);
+      const std::vector<std::string_view> imports = find_imports(lexer.tokens);
+
+      const CompilationCache cache(dir);
+      EXPECT_FALSE(cache.load(source));
+      ASSERT_FALSE(cache.store(source, lexer.tokens, flat, ctx.types, imports));
+
+      const std::optional<CacheEntry> entry = cache.load(source);
+      ASSERT_TRUE(entry);
+      ASSERT_EQ(entry->token_count(), lexer.tokens.size());
+      for (size_t i = 0; i < lexer.tokens.size(); i++) {
+            EXPECT_EQ(entry->kinds()[i], lexer.tokens.kind(i));
+            EXPECT_EQ(entry->keywords()[i], lexer.tokens.keyword(i));
+            EXPECT_EQ(entry->offsets()[i], lexer.tokens.offset(i));
+            EXPECT_EQ(entry->lengths()[i], lexer.tokens.length(i));
+            EXPECT_EQ(entry->symbols()[i], lexer.tokens.symbol(i));
+      }
+      EXPECT_TRUE(std::ranges::equal(entry->line_starts(), lexer.tokens.line_starts));
+      ASSERT_EQ(entry->decoded().size(), 1u);
+      EXPECT_EQ(entry->decoded()[0].second, "a\tb");
+      ASSERT_EQ(entry->name_count(), lexer.tokens.names.size());
+      for (SymbolId id = 0; id < lexer.tokens.names.size(); id++)
+            EXPECT_EQ(entry->name(id), lexer.tokens.names.str(id));
+      ASSERT_EQ(entry->imports().size(), 1u);
+      EXPECT_EQ(entry->imports()[0], "lib");
+
+      const FlatAstView view = entry->ast();
+      ASSERT_EQ(view.nodes.size(), flat.nodes.size());
+      ASSERT_EQ(view.roots.size(), flat.roots.size());
+      for (size_t i = 0; i < flat.nodes.size(); i++) {
+            EXPECT_EQ(view.nodes[i].kind, flat.nodes[i].kind);
+            EXPECT_EQ(view.nodes[i].data, flat.nodes[i].data);
+            EXPECT_EQ(view.nodes[i].lhs, flat.nodes[i].lhs);
+            EXPECT_EQ(view.nodes[i].rhs, flat.nodes[i].rhs);
+      }
+      EXPECT_TRUE(std::ranges::equal(view.extra, flat.extra));
+      for (size_t i = 0; i < flat.strings.size(); i++)
+            EXPECT_EQ(view.str(i), flat.str(i));
+
+      EXPECT_FALSE(cache.load(source + " ")) << "An edited source must not hit the old entry.";
+      std::filesystem::remove_all(dir);
+}
+
+TEST(CacheEntries, DamagedEntriesMiss) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_cache_damage_test";
+      std::filesystem::remove_all(dir);
+      const std::string source = "import lib\nfn f(a: int) : int { a + 1 }\nvar x = f(2)\n";
+
+      Lexer lexer(source);
+      ASSERT_FALSE(lexer.tokenize());
+      Context ctx;
+      Parser parser(lexer.tokens, ctx);
+      const std::string bytes = CompilationCache::entry(source, lexer.tokens, Flattener().flatten(parser.parse()),
+                                                        ctx.types, find_imports(lexer.tokens));
+      const CompilationCache cache(dir);
+      const auto load = [&](const std::string& entry) {
+            EXPECT_FALSE(cache.store_entry(source, entry));
+            return cache.load(source);
+      };
+      ASSERT_TRUE(load(bytes));
+
+      EXPECT_FALSE(load(bytes.substr(0, bytes.size() - 1)));
+      EXPECT_FALSE(load(bytes.substr(0, sizeof(CacheHeader) - 1)));
+      std::string flipped = bytes;
+      flipped.back() ^= 1;
+      EXPECT_FALSE(load(flipped));
+
+      // damage that the checksum was made over, as a writer with a bug would leave it: every reference is checked
+      const auto rehashed = [&bytes](const CacheSection s, const size_t at, const uint32_t value) {
+            std::string damaged = bytes;
+            CacheHeader header;
+            std::memcpy(&header, damaged.data(), sizeof(header));
+            std::memcpy(damaged.data() + header.section[static_cast<size_t>(s)].offset + at, &value, sizeof(value));
+            header.hash = xxh64::hash(damaged.data() + sizeof(header), damaged.size() - sizeof(header));
+            std::memcpy(damaged.data(), &header, sizeof(header));
+            return damaged;
+      };
+      EXPECT_TRUE(load(rehashed(CacheSection::offsets, 0, 0)));
+      EXPECT_FALSE(load(rehashed(CacheSection::offsets, 0, static_cast<uint32_t>(source.size()) + 1)));
+      EXPECT_FALSE(load(rehashed(CacheSection::symbols, 0, 1000)));
+      EXPECT_FALSE(load(rehashed(CacheSection::imports, offsetof(FlatString, length), 1000)))
+          << "An import name past the characters must not be read.";
+      EXPECT_FALSE(load(rehashed(CacheSection::ast_roots, 0, 1000)));
+      EXPECT_FALSE(load(rehashed(CacheSection::ast_nodes, offsetof(FlatNode, lhs), 5)))
+          << "A child after its parent could make a cycle.";
+      std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include "../../src/driver.hpp"
+
+TEST(DriverPool, WaitsForTasksSpawnedByTasks) {
+      ThreadPool pool(4);
+      std::atomic<int> ran{0};
+      for (int i = 0; i < 8; i++) {
+            pool.submit([&](size_t) {
+                  ran++;
+                  for (int j = 0; j < 16; j++)
+                        pool.submit([&](const size_t worker) {
+                              EXPECT_LT(worker, pool.size());
+                              ran++;
+                        });
+            });
+      }
+      pool.wait();
+      EXPECT_EQ(ran.load(), 8 + 8 * 16);
+}
+
+TEST(DriverModules, ImportsAreFollowedOnce) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_driver_test";
+      std::filesystem::create_directories(dir / "sub");
+      std::ofstream(dir / "main.nano") << "import \"sub/b.nano\"\nimport c\nvar x = 1\n";
+      std::ofstream(dir / "sub" / "b.nano") << "import \"../c.nano\"\nvar y = 2\n";
+      std::ofstream(dir / "c.nano") << "var z = 3\nvar w = \"unterminated\n";
+
+      Driver driver(2);
+      driver.add(dir / "main.nano");
+      driver.wait();
+      std::filesystem::remove_all(dir);
+
+      ASSERT_EQ(driver.modules().size(), 3u);
+      size_t failed = 0;
+      for (const auto& [path, module] : driver.modules()) {
+            if (module->failed()) {
+                  failed++;
+                  EXPECT_EQ(module->lexer_error, LexerError::unterminated_string);
+                  continue;
+            }
+            EXPECT_EQ(module->ast.size(), 1u) << path << ": import statements shouldn't end up in the AST.";
+      }
+      EXPECT_EQ(failed, 1u);
+}
+
+TEST(DriverModules, ImportWithoutModuleIsReported) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_driver_import_test";
+      std::filesystem::create_directories(dir);
+      std::ofstream(dir / "main.nano") << "import 5\nvar x = 1\n";
+
+      Driver driver(2);
+      driver.add(dir / "main.nano");
+      driver.wait();
+      std::filesystem::remove_all(dir);
+
+      ASSERT_EQ(driver.modules().size(), 1u);
+      const Module& main = *driver.modules().begin()->second;
+      ASSERT_EQ(main.diagnostics.size(), 1u);
+      EXPECT_EQ(std::get<ParseError>(main.diagnostics.list()[0].error), ParseError::expected_module);
+      EXPECT_EQ(main.diagnostics.list()[0].offset, 7u);
+      EXPECT_EQ(main.item_count(), 2u) << "Only `import` is skipped, `5` and the `var` after it are still parsed.";
+}
+
+TEST(DriverModules, ImportCyclesBreakTheSameWayEveryRun) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_driver_cycle_test";
+      std::filesystem::create_directories(dir);
+      std::ofstream(dir / "a.nano") << "import b\nfn f() : int { 1 }\nvar x = g()\n";
+      std::ofstream(dir / "b.nano") << "import a\nfn g() : int { 2 }\nvar y = f()\n";
+
+      for (int run = 0; run < 8; run++) {
+            Driver driver(4);
+            driver.add(dir / "b.nano");
+            driver.add(dir / "a.nano");
+            driver.wait();
+            ASSERT_EQ(driver.modules().size(), 2u);
+            // a comes first by path, so it's the one checked without the other's interface
+            for (const auto& [path, module] : driver.modules()) {
+                  if (std::filesystem::path(path).filename() == "a.nano") {
+                        ASSERT_EQ(module->diagnostics.size(), 1u);
+                        EXPECT_EQ(std::get<SemaError>(module->diagnostics.list()[0].error),
+                                  SemaError::unknown_function);
+                  } else {
+                        EXPECT_TRUE(module->diagnostics.empty());
+                  }
+            }
+      }
+      std::filesystem::remove_all(dir);
+}
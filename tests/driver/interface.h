@@ -0,0 +1,160 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include "../../src/cache.hpp"
+#include "../../src/driver.hpp"
+#include "../../src/interface.hpp"
+
+// the interface ModuleInterface::build() makes of `source` once it's checked
+inline std::string interface_of(const std::string_view source) {
+      Lexer lexer(source);
+      Diagnostics diagnostics;
+      lexer.tokenize(diagnostics);
+      Context ctx;
+      Parser parser(lexer.tokens, ctx, diagnostics);
+      const std::vector<ASTNode*> ast = parser.parse();
+      TypeChecker checker(lexer.tokens, diagnostics);
+      checker.check(ast);
+      EXPECT_TRUE(diagnostics.empty());
+      return ModuleInterface::build(CompilationCache::key(source), ctx.types, checker.functions(), checker.globals());
+}
+
+TEST(ModuleInterfaces, RoundTripSignaturesAndGlobals) {
+      const std::string source = "fn add(a: int, b: float) : float { b }\nfn later(s: string) : bool;\n"
+                                 "var g = 1.5\nvar n = add(1, g) > 2.0\n";
+      const uint64_t key = CompilationCache::key(source);
+      const std::string bytes = interface_of(source);
+      TypeTable types;
+
+      const std::optional<ModuleInterface> m = ModuleInterface::from(bytes, key, types);
+      ASSERT_TRUE(m);
+      EXPECT_EQ(m->function_count(), 2u);
+      EXPECT_EQ(m->global_count(), 2u);
+      const FunctionType* add = m->function("add");
+      ASSERT_TRUE(add);
+      EXPECT_EQ(add->params, (std::vector<Type>{Type::INT, Type::FLOAT}));
+      EXPECT_EQ(add->result, Type::FLOAT);
+      ASSERT_TRUE(m->function("later"));
+      EXPECT_EQ(m->function("later")->params, std::vector<Type>{Type::STRING});
+      EXPECT_FALSE(m->function("g"));
+      EXPECT_EQ(m->global("g"), Type::FLOAT);
+      EXPECT_EQ(m->global("n"), Type::BOOL);
+      EXPECT_FALSE(m->global("add"));
+
+      EXPECT_EQ(ModuleInterface::from(interface_of(source), key, types)->hash(), m->hash())
+          << "The same source must make the same interface.";
+}
+
+TEST(ModuleInterfaces, RejectDamagedOrForeignFiles) {
+      const std::string source = "fn f(x: int) : int { x }\nvar g = f(1)\n";
+      const uint64_t key = CompilationCache::key(source);
+      const std::string bytes = interface_of(source);
+      TypeTable types;
+      ASSERT_TRUE(ModuleInterface::from(bytes, key, types));
+
+      EXPECT_FALSE(ModuleInterface::from(bytes, key + 1, types)) << "An interface of another source must not be used.";
+      EXPECT_FALSE(ModuleInterface::from(bytes.substr(0, bytes.size() - 1), key, types));
+      EXPECT_FALSE(ModuleInterface::from(bytes.substr(0, sizeof(InterfaceHeader) - 1), key, types));
+      std::string damaged = bytes;
+      damaged.back() ^= 1;
+      EXPECT_FALSE(ModuleInterface::from(damaged, key, types));
+}
+
+TEST(ModuleInterfaces, TypesAreStoredByStructure) {
+      const std::string source = "fn f(p: Point) : int;\n";
+      Lexer lexer(source);
+      ASSERT_FALSE(lexer.tokenize());
+      Context ctx;
+      ctx.types.intern(TypeKind::enum_type, "Unused", {});
+      ASSERT_TRUE(ctx.types.declare("Point", *ctx.types.intern(TypeKind::struct_type, "Point", {})));
+      Diagnostics diagnostics;
+      Parser parser(lexer.tokens, ctx, diagnostics);
+      TypeChecker checker(lexer.tokens, diagnostics);
+      checker.check(parser.parse());
+      ASSERT_TRUE(diagnostics.empty());
+      const uint64_t key = CompilationCache::key(source);
+      const std::string bytes = ModuleInterface::build(key, ctx.types, checker.functions(), checker.globals());
+
+      // another compilation, whose table handed out the ids in another order
+      TypeTable types;
+      types.intern(TypeKind::struct_type, "Size", {});
+      const std::optional<ModuleInterface> m = ModuleInterface::from(bytes, key, types);
+      ASSERT_TRUE(m);
+      ASSERT_TRUE(m->function("f"));
+      EXPECT_EQ(m->function("f")->params, std::vector<Type>{*types.intern(TypeKind::struct_type, "Point", {})});
+      EXPECT_EQ(types.size(), builtin_types + 2);
+}
+
+TEST(ModuleInterfaces, ImportersAreCheckedAgainstThem) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_interface_test";
+      std::filesystem::remove_all(dir);
+      std::filesystem::create_directories(dir);
+      std::ofstream(dir / "main.nano") << "import lib\nvar x = twice(limit) + 1\nvar y = twice(\"no\")\n";
+      std::ofstream(dir / "lib.nano") << "import base\nfn twice(n: int) : int { n * base_k }\nvar limit = 4\n";
+      std::ofstream(dir / "base.nano") << "var base_k = 2\n";
+
+      const auto run = [&dir] {
+            auto driver = std::make_unique<Driver>(2);
+            driver->use_cache(dir / "cache");
+            driver->add(dir / "main.nano");
+            driver->wait();
+            return driver;
+      };
+      const auto module = [](const Driver& driver, const char* name) -> const Module& {
+            for (const auto& [path, m] : driver.modules()) {
+                  if (std::filesystem::path(path).filename() == name)
+                        return *m;
+            }
+            throw std::out_of_range(name);
+      };
+
+      const std::unique_ptr<Driver> cold = run();
+      ASSERT_EQ(cold->modules().size(), 3u);
+      EXPECT_TRUE(module(*cold, "base.nano").diagnostics.empty());
+      EXPECT_TRUE(module(*cold, "lib.nano").diagnostics.empty()) << "`base_k` comes from base's interface.";
+      const Module& main = module(*cold, "main.nano");
+      ASSERT_EQ(main.diagnostics.size(), 1u) << "Only the string argument to twice() is wrong.";
+      EXPECT_EQ(std::get<SemaError>(main.diagnostics.list()[0].error), SemaError::argument_type);
+
+      // lib and base are clean and only imported: main is checked against lib's cached interface, and lib's is
+      // only checked against base's, so neither is lexed
+      const std::unique_ptr<Driver> warm = run();
+      std::filesystem::remove_all(dir);
+      ASSERT_EQ(warm->modules().size(), 3u);
+      for (const char* name : {"lib.nano", "base.nano"}) {
+            const Module& m = module(*warm, name);
+            EXPECT_TRUE(m.interface) << name;
+            EXPECT_FALSE(m.lexer) << name;
+            EXPECT_FALSE(m.cached) << name;
+      }
+      ASSERT_EQ(module(*warm, "main.nano").diagnostics.size(), 1u);
+}
+
+TEST(ModuleInterfaces, CachedFilesAreCheckedAgainstEditedImports) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_interface_edit_test";
+      std::filesystem::remove_all(dir);
+      std::filesystem::create_directories(dir);
+      std::ofstream(dir / "a.nano") << "import b\nvar x = f()\n";
+      // a after a run with `b` as b.nano
+      const auto run = [&dir](const std::string_view b) {
+            std::ofstream(dir / "b.nano", std::ios::trunc) << b;
+            Driver driver(2);
+            driver.use_cache(dir / "cache");
+            driver.add(dir / "a.nano");
+            driver.wait();
+            const Module& a = *driver.modules().at(Driver::normalize(dir / "a.nano"));
+            return std::pair(a.cached.has_value(), a.diagnostics.list());
+      };
+
+      EXPECT_EQ(run("fn f() : int { 1 }\n"), std::pair(false, std::vector<Diagnostic>{}));
+      EXPECT_EQ(run("fn f() : int { 2 }\n"), std::pair(true, std::vector<Diagnostic>{}))
+          << "Only b's body changed, not its interface.";
+      const auto [cached, diagnostics] = run("fn g() : int { 2 }\n");
+      EXPECT_FALSE(cached) << "b no longer declares what a was checked against.";
+      ASSERT_EQ(diagnostics.size(), 1u);
+      EXPECT_EQ(std::get<SemaError>(diagnostics[0].error), SemaError::unknown_function);
+      std::filesystem::remove_all(dir);
+}
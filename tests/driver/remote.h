@@ -0,0 +1,171 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "../../src/driver.hpp"
+#include "../../src/remote_cache.hpp"
+
+#if NANO_HAS_SOCKETS
+#include <netinet/in.h>
+
+// A Bazel-style HTTP cache in memory: GET and PUT of any path, one request per connection.
+class FakeHttpCache {
+      int m_fd = -1;
+      int m_port = 0;
+      std::atomic<bool> m_stop = false;
+      std::thread m_thread;
+      std::mutex m_mutex;
+      std::map<std::string, std::string> m_blobs;
+
+  public:
+      FakeHttpCache() {
+            m_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            ::bind(m_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+            socklen_t size = sizeof(addr);
+            ::getsockname(m_fd, reinterpret_cast<sockaddr*>(&addr), &size);
+            m_port = ntohs(addr.sin_port);
+            ::listen(m_fd, 16);
+            m_thread = std::thread([this] { serve(); });
+      }
+
+      ~FakeHttpCache() {
+            m_stop = true;
+            ::shutdown(m_fd, SHUT_RDWR);
+            ::close(m_fd);
+            m_thread.join();
+      }
+
+      [[nodiscard]] std::string url() const { return "http://127.0.0.1:" + std::to_string(m_port) + "/nano"; }
+
+      size_t count(const std::string& prefix) {
+            std::lock_guard lock(m_mutex);
+            return static_cast<size_t>(std::ranges::count_if(m_blobs, [&](const auto& kv) {
+                  return kv.first.starts_with(prefix);
+            }));
+      }
+
+  private:
+      void serve() {
+            while (!m_stop) {
+                  const int client = ::accept(m_fd, nullptr, nullptr);
+                  if (client < 0)
+                        continue;
+                  std::string in;
+                  char buffer[4096];
+                  size_t head_end = std::string::npos;
+                  size_t length = 0;
+                  for (;;) {
+                        if (head_end == std::string::npos && (head_end = in.find("\r\n\r\n")) != std::string::npos) {
+                              const size_t at = in.find("Content-Length: ");
+                              length = at < head_end ? std::stoul(in.substr(at + 16)) : 0;
+                        }
+                        if (head_end != std::string::npos && in.size() >= head_end + 4 + length)
+                              break;
+                        const ssize_t n = ::recv(client, buffer, sizeof(buffer), 0);
+                        if (n <= 0)
+                              break;
+                        in.append(buffer, static_cast<size_t>(n));
+                  }
+                  const std::string method = in.substr(0, in.find(' '));
+                  const size_t path_at = method.size() + 1;
+                  const std::string path = in.substr(path_at, in.find(' ', path_at) - path_at);
+                  std::string reply = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+                  {
+                        std::lock_guard lock(m_mutex);
+                        if (method == "PUT") {
+                              m_blobs[path] = in.substr(head_end + 4, length);
+                              reply = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+                        } else if (const auto it = m_blobs.find(path); it != m_blobs.end()) {
+                              reply = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(it->second.size()) +
+                                      "\r\n\r\n" + it->second;
+                        }
+                  }
+                  ::send(client, reply.data(), reply.size(), MSG_NOSIGNAL);
+                  ::close(client);
+            }
+      }
+};
+
+TEST(RemoteCache, Sha256MatchesReference) {
+      EXPECT_EQ(Sha256::hex(Sha256::hash("")), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+      EXPECT_EQ(Sha256::hex(Sha256::hash("abc")), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+      const std::string million(1000000, 'a');
+      Sha256 pieces;
+      for (size_t i = 0; i < million.size(); i += 777)
+            pieces.update(std::string_view(million).substr(i, 777));
+      EXPECT_EQ(Sha256::hex(pieces.finish()), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST(RemoteCache, ActionResultsRoundTrip) {
+      const ActionOutputs outputs{
+              {{"entry", BlobDigest::of("abc")}, {"interface", BlobDigest::of(std::string(300, 'x'))}}};
+      const std::optional<ActionOutputs> decoded = ActionOutputs::decode(outputs.encode());
+      ASSERT_TRUE(decoded);
+      EXPECT_EQ(decoded->files, outputs.files);
+      EXPECT_FALSE(ActionOutputs::decode(outputs.encode().substr(0, 10)));
+      EXPECT_FALSE(RemoteCache::connect("https://cache.example"));
+      EXPECT_TRUE(RemoteCache::connect("http://cache.example:8080/prefix/"));
+}
+
+TEST(RemoteCache, SharesModulesBetweenMachines) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_remote_test";
+      std::filesystem::remove_all(dir);
+      std::filesystem::create_directories(dir / "src");
+      std::ofstream(dir / "src" / "main.nano") << "import lib\nvar x = twice(limit)\n";
+      std::ofstream(dir / "src" / "lib.nano") << "fn twice(n: int) : int { n * 2 }\nvar limit = 4\n";
+      FakeHttpCache server;
+
+      // every run is a machine of its own: a local cache of its own, the remote one shared
+      const auto run = [&](const std::string& machine) {
+            auto driver = std::make_unique<Driver>(2);
+            driver->use_cache(dir / machine);
+            driver->use_remote_cache(*RemoteCache::connect(server.url()));
+            driver->add(dir / "src" / "main.nano");
+            driver->wait();
+            return driver;
+      };
+      const auto all = [](const Driver& driver, auto&& pred) {
+            return std::ranges::all_of(driver.modules(), [&](const auto& kv) { return pred(*kv.second); });
+      };
+
+      const std::unique_ptr<Driver> first = run("a");
+      EXPECT_TRUE(all(*first, [](const Module& m) { return m.diagnostics.empty() && !m.cached; }));
+      EXPECT_EQ(server.count("/nano/ac/"), 2u);
+      EXPECT_EQ(server.count("/nano/cas/"), 4u);
+
+      const std::unique_ptr<Driver> second = run("b");
+      ASSERT_EQ(second->modules().size(), 2u);
+      EXPECT_TRUE(all(*second, [](const Module& m) { return m.cached && m.interface && !m.lexer; }))
+          << "Nothing should have been parsed on the second machine.";
+
+      const auto module = [](const Driver& driver, const char* name) -> const Module& {
+            for (const auto& [path, m] : driver.modules()) {
+                  if (std::filesystem::path(path).filename() == name)
+                        return *m;
+            }
+            throw std::out_of_range(name);
+      };
+
+      // a new body is a new lib, but the same interface: main is still what it was
+      std::ofstream(dir / "src" / "lib.nano") << "fn twice(n: int) : int { n + n }\nvar limit = 4\n";
+      const std::unique_ptr<Driver> third = run("c");
+      EXPECT_FALSE(module(*third, "lib.nano").cached);
+      EXPECT_TRUE(module(*third, "main.nano").cached);
+
+      // main's source is the same, but what it's checked against isn't: it must miss
+      std::ofstream(dir / "src" / "lib.nano") << "fn twice(n: int) : float { 2.0 }\nvar limit = 4\n";
+      const std::unique_ptr<Driver> fourth = run("d");
+      EXPECT_TRUE(all(*fourth, [](const Module& m) { return !m.cached && m.diagnostics.empty(); }));
+      EXPECT_EQ(server.count("/nano/ac/"), 5u);
+      std::filesystem::remove_all(dir);
+}
+#endif
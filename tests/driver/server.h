@@ -0,0 +1,83 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include "../../src/server.hpp"
+
+#if NANO_HAS_SERVER
+TEST(CompileServer, KeepsFilesWarmAndFollowsChanges) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_server_test";
+      std::filesystem::remove_all(dir);
+      std::filesystem::create_directories(dir);
+      std::ofstream(dir / "main.nano") << "import lib\nfn f() : int { twice(limit) }\nfn g() : int { twice(\"no\") }\n";
+      std::ofstream(dir / "lib.nano") << "fn twice(n: int) : int { n * 2 }\nvar limit = 4\n";
+      const std::string socket = (dir / "s.sock").string();
+      const std::string main = Driver::normalize(dir / "main.nano");
+
+      CompileServer server;
+      ASSERT_FALSE(server.listen(socket));
+      std::thread thread([&server] { server.run(); });
+      const auto ask = [&socket](const std::string& request, int& status) {
+            std::string reply;
+            EXPECT_FALSE(ask_server(socket, request, reply, status));
+            return reply;
+      };
+      const auto stat = [&ask](const std::string& name) {
+            int status = 0;
+            const std::string reply = ask("stats", status);
+            const size_t at = reply.find(name + " ");
+            return at == std::string::npos ? SIZE_MAX : std::stoul(reply.substr(at + name.size() + 1));
+      };
+
+      int status = 0;
+      EXPECT_EQ(ask("check " + main, status), main + ":3:22: argument of the wrong type\n");
+      EXPECT_EQ(status, 1);
+      EXPECT_EQ(stat("files"), 2u);
+      EXPECT_EQ(stat("bodies_checked"), 2u);
+
+      // nothing changed: nothing is read or checked again
+      ask("check " + main, status);
+      EXPECT_EQ(stat("reads"), 2u);
+      EXPECT_EQ(stat("bodies_checked"), 2u);
+
+      std::ofstream(dir / "lib.nano") << "fn twice(n: string) : int { 2 }\nvar limit = 4\n";
+      for (int i = 0; i < 200 && stat("invalidations") == 0; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      ASSERT_EQ(stat("invalidations"), 1u) << "The change to lib.nano was never noticed.";
+      EXPECT_EQ(ask("check " + main, status), main + ":2:22: argument of the wrong type\n");
+      EXPECT_EQ(stat("reads"), 3u);
+
+      EXPECT_EQ(ask("check " + (dir / "missing.nano").string(), status), Driver::normalize(dir / "missing.nano") +
+                                                                               ": cannot open file\n");
+      EXPECT_EQ(status, 1);
+      ask("shutdown", status);
+      thread.join();
+      std::filesystem::remove_all(dir);
+}
+TEST(CompileServer, BindsOnlyOverStaleSockets) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_server_bind_test";
+      std::filesystem::remove_all(dir);
+      std::filesystem::create_directories(dir);
+      std::ofstream(dir / "keep.nano") << "var x = 1\n";
+      EXPECT_EQ(CompileServer().listen((dir / "keep.nano").string()), ServerError::cannot_bind);
+      EXPECT_TRUE(std::filesystem::is_regular_file(dir / "keep.nano")) << "A file that isn't a socket was replaced.";
+
+      const std::string socket = (dir / "s.sock").string();
+      {
+            CompileServer live;
+            ASSERT_FALSE(live.listen(socket));
+            EXPECT_EQ(CompileServer().listen(socket), ServerError::cannot_bind) << "A live server was taken over.";
+      }
+
+      // a socket left by a server that didn't shut down: bound, but nobody accepts on it
+      const int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      const std::optional<sockaddr_un> addr = socket_address(socket);
+      ASSERT_EQ(::bind(stale, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr)), 0);
+      ::close(stale);
+      EXPECT_FALSE(CompileServer().listen(socket));
+      std::filesystem::remove_all(dir);
+}
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+#include "../../src/driver.hpp"
+#include "../../src/stats.hpp"
+
+TEST(DriverStats, TimesEveryPhaseOfEveryFile) {
+      const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nano_stats_test";
+      std::filesystem::create_directories(dir);
+      std::ofstream(dir / "main.nano") << "import lib\nvar x = 1 + 2\n";
+      std::ofstream(dir / "lib.nano") << "fn f(int a) : int { a * 2 }\nvar y = f(3)\n";
+
+      Stats stats;
+      Driver driver(2);
+      driver.collect_stats(stats);
+      driver.add(dir / "main.nano");
+      driver.wait();
+
+      ASSERT_EQ(stats.files().size(), 2u);
+      for (const Stats::File& file : stats.files()) {
+            EXPECT_GT(file.tokens, 0u) << file.path;
+            EXPECT_GT(file.nodes, 0u) << file.path;
+            EXPECT_GT(file.name_slots, file.names) << file.path;
+            for (const Phase phase : {Phase::read, Phase::lex, Phase::parse, Phase::sema}) {
+                  EXPECT_EQ(std::ranges::count_if(stats.events(),
+                                                  [&](const Stats::Event& e) {
+                                                        return e.file == file.index && e.phase == phase;
+                                                  }),
+                            1)
+                          << file.path << ": " << phase_to_str(phase);
+            }
+      }
+      ASSERT_EQ(stats.arenas().size(), 2u);
+      EXPECT_GT(stats.arenas()[0].used + stats.arenas()[1].used, 0u);
+
+      const std::filesystem::path trace = dir / "trace.json";
+      ASSERT_TRUE(stats.write_trace(trace.string().c_str()));
+      std::ifstream in(trace);
+      const std::string json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+      std::filesystem::remove_all(dir);
+
+      EXPECT_TRUE(json.starts_with("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+      EXPECT_NE(json.find("\"name\":\"parse\",\"cat\":\"nano\",\"ph\":\"X\""), std::string::npos);
+      EXPECT_NE(json.find("lib.nano\""), std::string::npos);
+}
+
+TEST(DriverStats, RecordsNothingWithoutStats) {
+      Stats stats;
+      {
+            const PhaseTimer timer(nullptr, Phase::lex);
+      }
+      {
+            const PhaseTimer timer(&stats, Phase::codegen);
+      }
+      ASSERT_EQ(stats.events().size(), 1u);
+      EXPECT_EQ(stats.events()[0].phase, Phase::codegen);
+      EXPECT_EQ(stats.events()[0].file, UINT32_MAX);
+      EXPECT_GE(stats.events()[0].wall_ns, 0);
+}
@@ -0,0 +1,38 @@
+// libFuzzer target for the lexer: any input tokenizes into a stream that ends in T_EOF, whose tokens are in order,
+// don't overlap and all lie within the input, whatever errors were reported on the way.
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include "../../src/diagnostics.hpp"
+#include "../../src/lexer.hpp"
+
+// every byte of every value is read into this, so reading one past the end is caught by ASan
+static volatile unsigned char g_sink;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, const size_t size) {
+      const std::string_view source(reinterpret_cast<const char*>(data), size);
+      Lexer lexer(source);
+      Diagnostics diagnostics;
+      lexer.tokenize(diagnostics);
+
+      const TokenStream& tokens = lexer.tokens;
+      if (tokens.empty() || tokens.kind(tokens.size() - 1) != TypeOfToken::T_EOF)
+            std::abort();
+      size_t end = 0;
+      for (size_t i = 0; i < tokens.size(); i++) {
+            if (tokens.offset(i) < end || tokens.offset(i) + size_t{tokens.length(i)} > size)
+                  std::abort();
+            end = tokens.offset(i) + size_t{tokens.length(i)};
+            // decoded values live in a side table, everything else views the input
+            const std::string_view value = tokens.value(i);
+            for (const char c : value)
+                  g_sink = g_sink + static_cast<unsigned char>(c);
+            (void)tokens.location(i);
+      }
+      for (const Diagnostic& d : diagnostics.list()) {
+            if (d.offset + size_t{d.length} > size)
+                  std::abort();
+      }
+      return 0;
+}
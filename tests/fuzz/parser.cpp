@@ -0,0 +1,59 @@
+// libFuzzer target for everything after the lexer in the front-end: parsing with recovery and folding, type
+// checking, comptime evaluation on a small budget, and the passes that walk the tree afterwards (printing and
+// flattening). Nothing may crash, hang or recurse past the parser's depth limit, however broken the input, and on input
+// without errors parsing bodies lazily must give the same tree.
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../../src/ast_flat.hpp"
+#include "../../src/ast_printer.hpp"
+#include "../../src/comptime.hpp"
+#include "../../src/context.hpp"
+#include "../../src/diagnostics.hpp"
+#include "../../src/lexer.hpp"
+#include "../../src/parser.hpp"
+#include "../../src/sema.hpp"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, const size_t size) {
+      const std::string_view source(reinterpret_cast<const char*>(data), size);
+      Lexer lexer(source);
+      Diagnostics diagnostics;
+      lexer.tokenize(diagnostics);
+
+      Context ctx;
+      Parser parser(lexer.tokens, ctx, diagnostics);
+      parser.fold_constants = true;
+      const std::vector<ASTNode*> ast = parser.parse();
+
+      std::string out;
+      StringSink sink{out};
+      if (diagnostics.empty()) {
+            Context lazy_ctx;
+            Parser lazy(lexer.tokens, lazy_ctx);
+            lazy.fold_constants = true;
+            lazy.lazy_bodies = true;
+            const std::vector<ASTNode*> lazy_ast = lazy.parse();
+            lazy.parse_bodies(lazy_ast);
+            std::string lazy_out;
+            StringSink lazy_sink{lazy_out};
+            AstPrinter(sink).print(ast);
+            AstPrinter(lazy_sink).print(lazy_ast);
+            if (out != lazy_out)
+                  std::abort();
+            out.clear();
+      }
+
+      TypeChecker(lexer.tokens, diagnostics).check(ast);
+      Interpreter(ctx, &diagnostics, EvalBudget{.steps = 100'000, .depth = 64, .memory = 1 << 20}).run(ast);
+      diagnostics.sort();
+      for (const Diagnostic& d : diagnostics.list())
+            (void)format_diagnostic("fuzz", d, lexer.tokens);
+
+      AstPrinter(sink).print(ast);
+      AstPrinter(sink, PrintStyle::json).print(ast);
+      (void)Flattener().flatten(ast);
+      return 0;
+}
@@ -0,0 +1,97 @@
+// Stands in for libFuzzer's main() where there is no libFuzzer (GCC, MSVC): runs a fuzz target over files and
+// directories of inputs, such as the corpus and crash artifacts, so they stay regression tests everywhere.
+//
+// With -linear it checks the other way the front-end can take a build worker down: by taking too long. Each input is
+// repeated up to about 64 KiB and to 8 times that, and processing the larger one has to take less than `slack` times
+// 8 as long. The repetition keeps the input's shape, nested parentheses stay nested ("((" repeated is deeper), so
+// anything quadratic in nesting, length or count of something shows up.
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static void run_one(const std::string& input) {
+      LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+}
+
+static std::string repeat(const std::string& input, const size_t bytes) {
+      std::string out;
+      out.reserve(bytes + input.size());
+      while (out.size() < bytes)
+            out += input;
+      return out;
+}
+
+// the fastest of a few runs, the least disturbed by whatever else the machine is doing
+static double seconds(const std::string& input) {
+      double best = 1e30;
+      for (int i = 0; i < 3; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            run_one(input);
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+      }
+      return best;
+}
+
+int main(int argc, char** argv) {
+      constexpr size_t base_bytes = 64 * 1024;
+      constexpr size_t factor = 8;
+      constexpr double slack = 3;
+
+      bool linear = false;
+      std::vector<std::filesystem::path> inputs;
+      for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (arg == "-linear") {
+                  linear = true;
+                  continue;
+            }
+            // libFuzzer's own flags, so a command line works with either main()
+            if (arg.starts_with("-"))
+                  continue;
+            std::error_code ec;
+            if (std::filesystem::is_directory(arg, ec)) {
+                  for (const auto& entry : std::filesystem::directory_iterator(arg, ec)) {
+                        if (entry.is_regular_file(ec))
+                              inputs.push_back(entry.path());
+                  }
+            } else {
+                  inputs.emplace_back(arg);
+            }
+      }
+      std::ranges::sort(inputs);
+
+      int status = 0;
+      for (const std::filesystem::path& path : inputs) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                  std::fprintf(stderr, "%s: cannot open file\n", path.string().c_str());
+                  status = 1;
+                  continue;
+            }
+            const std::string input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            run_one(input);
+            if (!linear || input.empty())
+                  continue;
+
+            const double small = seconds(repeat(input, base_bytes));
+            const double large = seconds(repeat(input, base_bytes * factor));
+            // below a millisecond it's all noise
+            if (large > 1e-3 && large > small * factor * slack) {
+                  std::fprintf(stderr, "%s: %zux the input took %.1fx as long (%.3f ms, then %.3f ms)\n",
+                               path.string().c_str(), factor, large / small, small * 1e3, large * 1e3);
+                  status = 1;
+            }
+      }
+      std::printf("%zu inputs\n", inputs.size());
+      return status;
+}
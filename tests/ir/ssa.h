@@ -0,0 +1,83 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../../src/ir.hpp"
+#include "../../src/passes.hpp"
+
+struct IrBuild {
+      Context ctx;
+      ir::Module module;
+      std::optional<CompileError> error;
+
+      [[nodiscard]] const ir::Function& function(const std::string_view name) const {
+            return module.functions[module.by_name.at(name)];
+      }
+};
+
+inline void build_ir(const std::string_view in, IrBuild& build) {
+      Lexer lexer(in);
+      EXPECT_FALSE(lexer.tokenize());
+      Diagnostics diagnostics;
+      Parser parser(lexer.tokens, build.ctx, diagnostics);
+      const std::vector<ASTNode*> nodes = parser.parse();
+      EXPECT_TRUE(diagnostics.empty());
+      build.error = ir::Builder(build.module).build(nodes);
+}
+
+inline size_t count_ops(const ir::Function& fn, const ir::Opcode op) {
+      size_t n = 0;
+      for (const ir::Block& block : fn.blocks)
+            n += std::ranges::count_if(block.insts, [&](const ir::ValueId id) { return fn.values[id].op == op; });
+      return n;
+}
+
+TEST(Ir, ShortCircuitsJoinInPhis) {
+      IrBuild build;
+      build_ir("fn fib(n: int) : int { var r = n\nn > 1 && (r = fib(n - 1) + fib(n - 2)) > 0\nr }\n", build);
+      ASSERT_FALSE(build.error);
+      const ir::Function& fib = build.function("fib");
+      EXPECT_EQ(ir::verify(fib), std::nullopt) << ir::to_string(fib);
+      ASSERT_EQ(fib.blocks.size(), 3u);
+      EXPECT_EQ(fib.blocks[2].preds, (std::vector<ir::BlockId>{0, 1}));
+      // one for the && and one for r, which only the right side assigns
+      EXPECT_EQ(count_ops(fib, ir::Opcode::phi), 2u) << ir::to_string(fib);
+      const ir::Inst& ret = fib.values[fib.blocks[2].insts.back()];
+      ASSERT_EQ(ret.op, ir::Opcode::ret);
+      EXPECT_EQ(fib.values[ret.operands[0]].op, ir::Opcode::phi);
+}
+
+TEST(Ir, PassesInlineAndCleanUp) {
+      IrBuild build;
+      build_ir("fn sq(x: int) : int { x * x }\n"
+               "fn f(a: int, b: int) : int { var unused = a / 2\nvar c = a\nsq(a + b) + sq(b + a) + c }\n",
+               build);
+      ASSERT_FALSE(build.error);
+      ThreadPool pool(2);
+      ir::PassManager pm = ir::PassManager::standard(&pool);
+      pm.run(build.module);
+
+      const ir::Function& f = build.function("f");
+      EXPECT_EQ(ir::verify(f), std::nullopt) << ir::to_string(f);
+      EXPECT_EQ(count_ops(f, ir::Opcode::call), 0u) << ir::to_string(f);
+      // a + b and b + a are one value, so both squares are
+      EXPECT_EQ(count_ops(f, ir::Opcode::mul), 1u) << ir::to_string(f);
+      EXPECT_EQ(count_ops(f, ir::Opcode::div), 0u) << ir::to_string(f);
+      EXPECT_EQ(count_ops(f, ir::Opcode::copy), 0u) << ir::to_string(f);
+      EXPECT_EQ(count_ops(f, ir::Opcode::add), 3u) << ir::to_string(f);
+      for (const auto& [name, changed] : pm.changes) {
+            if (name == "inline") {
+                  EXPECT_EQ(changed, 1u);
+            }
+      }
+}
+
+TEST(Ir, DivisionThatMayTrapIsKept) {
+      IrBuild build;
+      build_ir("fn f(a: int, b: int) : int { var q = a / b\nvar h = a / 2\na }\n", build);
+      ASSERT_FALSE(build.error);
+      ir::PassManager::standard().run(build.module);
+      EXPECT_EQ(count_ops(build.function("f"), ir::Opcode::div), 1u) << ir::to_string(build.function("f"));
+}
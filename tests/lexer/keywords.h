@@ -0,0 +1,40 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "../../src/lexer.hpp"
+
+TEST(LexerKeywords, EveryKeywordIsRecognized) {
+      for (size_t i = 0; i < keywords.size(); i++) {
+            auto lexer = Lexer(std::string(keywords[i]));
+            ASSERT_EQ(lexer.tokenize(), std::nullopt);
+            EXPECT_EQ(lexer.tokens.at(0).type, TypeOfToken::KEYWORD) << keywords[i];
+            EXPECT_EQ(lexer.tokens.at(0).keyword, static_cast<Keyword>(i)) << keywords[i];
+      }
+
+      auto lexer = Lexer("fns retur elseiff comptimes _if");
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+      for (size_t i = 0; i + 1 < lexer.tokens.size(); i++) {
+            EXPECT_EQ(lexer.tokens.at(i).type, TypeOfToken::IDENTIFIER) << lexer.tokens.at(i).val;
+            EXPECT_EQ(lexer.tokens.at(i).keyword, Keyword::none) << lexer.tokens.at(i).val;
+      }
+}
+
+TEST(LexerKeywords, OperatorsTakeTheLongestMatch) {
+      auto lexer = Lexer("+ += ++ -= -- *= /= == != && || :: >= <= = ! & | : ; , . ( ) [ ] { } +++");
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+      const std::vector<TypeOfToken> expected = {
+              TypeOfToken::OP_PLUS,        TypeOfToken::OP_PLUSEQUALS,   TypeOfToken::OP_INC,
+              TypeOfToken::OP_MINUSEQUALS, TypeOfToken::OP_DEC,          TypeOfToken::OP_TIMESEQUALS,
+              TypeOfToken::OP_DIVEQUALS,   TypeOfToken::OP_EQUALSEQUALS, TypeOfToken::OP_EXCL_EQUALS,
+              TypeOfToken::OP_DOUBLEAMPERSAND, TypeOfToken::OP_DOUBLEPIPE, TypeOfToken::DOUBLECOLON,
+              TypeOfToken::GTHAN_EQUALS,   TypeOfToken::LTHAN_EQUALS,    TypeOfToken::OP_EQUALS,
+              TypeOfToken::OP_EXCL_MARK,   TypeOfToken::OP_AMPERSAND,    TypeOfToken::OP_PIPE,
+              TypeOfToken::COLON,          TypeOfToken::SEMICOLON,       TypeOfToken::COMMA,
+              TypeOfToken::PERIOD,         TypeOfToken::LPAREN,          TypeOfToken::RPAREN,
+              TypeOfToken::LBRACKET,       TypeOfToken::RBRACKET,        TypeOfToken::LBRACE,
+              TypeOfToken::RBRACE,         TypeOfToken::OP_INC,          TypeOfToken::OP_PLUS,
+              TypeOfToken::T_EOF,
+      };
+      ASSERT_EQ(lexer.tokens.size(), expected.size());
+      for (size_t i = 0; i < expected.size(); i++)
+            EXPECT_EQ(lexer.tokens.at(i).type, expected[i]) << "token " << i << ": " << lexer.tokens.at(i).val;
+}
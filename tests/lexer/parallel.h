@@ -0,0 +1,37 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "../../src/parallel_lexer.hpp"
+
+TEST(LexerParallel, SplitsMatchSequentialLexing) {
+      std::string in;
+      for (int i = 0; i < 200; i++) {
+            in += "var a" + std::to_string(i % 7) + " = \"multi\nline \\\" \n\" + '\"' + '\\n'\n";
+            in += "/* a comment \n with \" quotes ' and\n newlines */ b // trailing \" quote\n";
+      }
+      const std::vector<size_t> starts = find_split_points(in, 16);
+      ASSERT_GT(starts.size(), 8u);
+      for (const size_t start : starts)
+            EXPECT_TRUE(start == 0 || in.substr(start).starts_with("var") || in.substr(start).starts_with("/*"));
+
+      Lexer sequential(in);
+      ASSERT_EQ(sequential.tokenize(), std::nullopt);
+      Lexer parallel(in);
+      ThreadPool pool(4);
+      ASSERT_EQ(ParallelLexer::tokenize(parallel, pool, 256), std::nullopt);
+
+      ASSERT_EQ(parallel.tokens.size(), sequential.tokens.size());
+      EXPECT_EQ(parallel.tokens.line_starts, sequential.tokens.line_starts);
+      EXPECT_EQ(parallel.tokens.names.size(), sequential.tokens.names.size());
+      for (size_t i = 0; i < sequential.tokens.size(); i++) {
+            const Token a = sequential.tokens[i];
+            const Token b = parallel.tokens[i];
+            ASSERT_EQ(a.type, b.type) << i;
+            ASSERT_EQ(a.offset, b.offset) << i;
+            ASSERT_EQ(a.val, b.val) << i;
+            ASSERT_EQ(a.symbol, b.symbol) << i;
+            ASSERT_EQ(sequential.tokens.location(i).line, parallel.tokens.location(i).line) << i;
+      }
+
+      Lexer broken(in + "\"unterminated");
+      EXPECT_EQ(ParallelLexer::tokenize(broken, pool, 256), LexerError::unterminated_string);
+}
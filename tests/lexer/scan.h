@@ -0,0 +1,33 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "../../src/scan.hpp"
+
+// Runs every helper from every starting offset of inputs longer than a vector, against a plain loop.
+TEST(LexerScan, MatchesScalarLoops) {
+      const std::string in = "  \t\r\n  identifier_with_digits_0123456789   \"string \\\" body with \n newline\" "
+                             "/* comment * / still comment ** */ 1234567890123456789012345678901234567890.5 \n\n";
+      const char* end = in.data() + in.size();
+      for (size_t i = 0; i < in.size(); i++) {
+            const char* p = in.data() + i;
+            auto scalar = [&](auto stop) {
+                  const char* q = p;
+                  while (q < end && !stop(q))
+                        ++q;
+                  return q;
+            };
+            EXPECT_EQ(scan::skip_whitespace(p, end), scalar([](const char* q) { return !scan::is_space(*q); }));
+            EXPECT_EQ(scan::skip_ident(p, end), scalar([](const char* q) { return !scan::is_ident(*q); }));
+            EXPECT_EQ(scan::skip_digits(p, end), scalar([](const char* q) { return !scan::is_digit(*q); }));
+            EXPECT_EQ(scan::find_newline(p, end), scalar([](const char* q) { return *q == '\n'; }));
+            EXPECT_EQ(scan::find_quote_or_escape(p, end),
+                      scalar([](const char* q) { return *q == '"' || *q == '\\'; }));
+            EXPECT_EQ(scan::find_comment_close(p, end),
+                      scalar([&](const char* q) { return q + 1 < end && q[0] == '*' && q[1] == '/'; }));
+            EXPECT_EQ(scan::count_newlines(p, end), static_cast<size_t>(std::count(p, end, '\n')));
+            const char* last = nullptr;
+            for (const char* q = p; q < end; q++)
+                  if (*q == '\n')
+                        last = q;
+            EXPECT_EQ(scan::find_last_newline(p, end), last);
+      }
+}
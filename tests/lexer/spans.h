@@ -0,0 +1,42 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "../../src/lexer.hpp"
+
+TEST(LexerSpans, ValuesOutliveTokenize) {
+      std::string in = "fn add(a: int) a + 12.5 // done";
+      auto lexer = Lexer(in);
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+      ASSERT_EQ(lexer.tokens.size(), 12u);
+      EXPECT_EQ(lexer.tokens.at(0).val, "fn");
+      EXPECT_EQ(lexer.tokens.at(1).val, "add");
+      EXPECT_EQ(lexer.tokens.at(8).val, "+");
+      EXPECT_EQ(lexer.tokens.at(9).val, "12.5");
+      EXPECT_EQ(lexer.tokens.at(10).val, " done");
+      EXPECT_EQ(lexer.tokens.location(1).column, 4u) << "Tokens should record where they start.";
+}
+
+TEST(LexerSpans, EscapedLiteralsAreDecoded) {
+      std::string in = "\"a\\tb\\\"c\" \"plain\" '\\n' 'x'";
+      auto lexer = Lexer(in);
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+      ASSERT_EQ(lexer.tokens.size(), 5u);
+      EXPECT_EQ(lexer.tokens.at(0).val, "a\tb\"c");
+      EXPECT_EQ(lexer.tokens.at(1).val, "plain");
+      EXPECT_EQ(lexer.tokens.at(2).val, "\n");
+      EXPECT_EQ(lexer.tokens.at(3).val, "x");
+}
+
+TEST(LexerSpans, LocationsFromLineTable) {
+      std::string in = "a\n  bb /* x\ny */ c\n\n\"s\ntr\" d";
+      auto lexer = Lexer(in);
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+      ASSERT_EQ(lexer.tokens.size(), 7u);
+      const std::vector<std::pair<size_t, size_t>> expected = {{1, 1}, {2, 3}, {2, 6}, {3, 6}, {5, 1}, {6, 5}, {6, 6}};
+      for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_EQ(lexer.tokens.location(i).line, expected[i].first) << "token " << i;
+            EXPECT_EQ(lexer.tokens.location(i).column, expected[i].second) << "token " << i;
+      }
+      EXPECT_EQ(lexer.tokens.at(2).val, " x\ny ");
+      EXPECT_EQ(lexer.tokens.at(4).val, "s\ntr");
+      EXPECT_EQ(lexer.tokens.text(4), "\"s\ntr\"");
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include "../../src/lexer.hpp"
+
+// Feeds the lexer a few bytes at a time, so nearly every token ends up crossing a chunk boundary.
+TEST(LexerStream, TokensCrossingChunks) {
+      const std::string in = "fn add(a: int) {\n  a += 12.5 /* a long\ncomment */ \"str\\ting\" 'c' // tail\n}";
+      auto whole = Lexer(in);
+      ASSERT_EQ(whole.tokenize(), std::nullopt);
+
+      for (const size_t chunk : {1u, 3u, 7u, 64u}) {
+            size_t pos = 0;
+            auto read = [&](char* buf, const size_t cap) {
+                  const size_t n = std::min(cap, in.size() - pos);
+                  std::memcpy(buf, in.data() + pos, n);
+                  pos += n;
+                  return n;
+            };
+            std::vector<std::string> vals;
+            std::vector<std::pair<size_t, size_t>> locs;
+            std::optional<LexerError> err = StreamLexer(chunk).tokenize(read, [&](const TokenStream& tokens) {
+                  for (size_t i = 0; i < tokens.size(); i++) {
+                        vals.emplace_back(tokens[i].val);
+                        const SourceLocation loc = tokens.location(i);
+                        locs.emplace_back(loc.line, loc.column);
+                  }
+            });
+            ASSERT_EQ(err, std::nullopt) << "chunk size " << chunk;
+            ASSERT_EQ(vals.size(), whole.tokens.size()) << "chunk size " << chunk;
+            for (size_t i = 0; i < vals.size(); i++) {
+                  EXPECT_EQ(vals[i], whole.tokens[i].val) << "chunk size " << chunk << ", token " << i;
+                  EXPECT_EQ(locs[i].first, whole.tokens.location(i).line) << "chunk size " << chunk << ", token " << i;
+                  EXPECT_EQ(locs[i].second, whole.tokens.location(i).column)
+                          << "chunk size " << chunk << ", token " << i;
+            }
+      }
+}
+
+TEST(LexerStream, InputsPastTheLimitAreRefused) {
+      const std::string in(100, ' ');
+      const auto lex = [&in](const size_t size, const size_t max_size) {
+            size_t pos = 0;
+            auto read = [&](char* buf, const size_t cap) {
+                  const size_t n = std::min(cap, size - pos);
+                  std::memcpy(buf, in.data(), n);
+                  pos += n;
+                  return n;
+            };
+            return StreamLexer(7, max_size).tokenize(read, [](const TokenStream&) {});
+      };
+      EXPECT_EQ(lex(100, 100), std::nullopt);
+      EXPECT_EQ(lex(100, 99), LexerError::source_too_large);
+      EXPECT_EQ(lex(100, 0), LexerError::source_too_large);
+}
+
+#if NANO_HAS_MMAP
+TEST(LexerSources, FilesPastTheLimitAreRefused) {
+      const std::filesystem::path path = std::filesystem::temp_directory_path() / "nano_too_large.nano";
+      std::ofstream(path).close();
+      // sparse, so nothing near that size is written
+      std::filesystem::resize_file(path, max_source_size + 1);
+      SourceBuffer source;
+      EXPECT_EQ(source.load(path.string()), SourceError::too_large);
+      EXPECT_EQ(source.size(), 0u);
+      std::filesystem::resize_file(path, 3);
+      EXPECT_EQ(source.load(path.string()), std::nullopt);
+      EXPECT_EQ(source.size(), 3u);
+      std::filesystem::remove(path);
+}
+
+TEST(LexerSources, PipesAreReadWhole) {
+      const std::filesystem::path path = std::filesystem::temp_directory_path() / "nano_source_pipe";
+      std::filesystem::remove(path);
+      ASSERT_EQ(::mkfifo(path.c_str(), 0600), 0);
+      std::string text;
+      for (int i = 0; i < 20000; i++)
+            text += "var x" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+      std::thread writer([&] { std::ofstream(path) << text; });
+      SourceBuffer source;
+      EXPECT_EQ(source.load(path.string()), std::nullopt);
+      writer.join();
+      EXPECT_FALSE(source.mapped());
+      EXPECT_EQ(source.view(), text) << "A pipe is read past the first buffer it's given.";
+      std::filesystem::remove(path);
+}
+#endif
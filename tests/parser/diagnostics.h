@@ -0,0 +1,70 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../../src/ast_printer.hpp"
+#include "../../src/diagnostics.hpp"
+
+inline std::vector<std::string> diagnose(const std::string_view in, std::string* ast = nullptr) {
+      Lexer lexer(in);
+      Diagnostics diagnostics;
+      lexer.tokenize(diagnostics);
+      Context ctx;
+      Parser parser(lexer.tokens, ctx, diagnostics);
+      const std::vector<ASTNode*> nodes = parser.parse();
+      diagnostics.sort();
+      if (ast) {
+            StringSink sink{*ast};
+            AstPrinter(sink).print(nodes);
+      }
+
+      std::vector<std::string> out;
+      for (const Diagnostic& d : diagnostics.list())
+            out.push_back(format_diagnostic("f", d, lexer.tokens) + " [" + std::string(in.substr(d.offset, d.length)) +
+                          "]");
+      return out;
+}
+
+TEST(ParserDiagnostics, LexerKeepsGoingPastErrors) {
+      Lexer lexer("var a = @ 1\nvar b = \"x\\q\"\nvar c = \"open\nvar d = 2");
+      Diagnostics diagnostics;
+      EXPECT_EQ(lexer.tokenize(diagnostics), LexerError::unknown_character);
+      ASSERT_EQ(diagnostics.size(), 3u);
+      EXPECT_EQ(diagnostics.list()[1].error, decltype(Diagnostic::error){LexerError::unknown_escape_sequence});
+      EXPECT_EQ(diagnostics.list()[2].error, decltype(Diagnostic::error){LexerError::unterminated_string});
+      EXPECT_EQ(lexer.tokens.kind(lexer.tokens.size() - 1), TypeOfToken::T_EOF);
+      EXPECT_EQ(lexer.tokens.kind(lexer.tokens.size() - 2), TypeOfToken::NUMBER)
+              << "An unterminated string should only swallow the rest of its line.";
+      EXPECT_EQ(lexer.tokens.location(lexer.tokens.size() - 2).line, 4u);
+}
+
+TEST(ParserDiagnostics, ReportsEveryErrorInOnePass) {
+      std::string ast;
+      const std::vector<std::string> errors =
+              diagnose("var x = 1 + )\nvar = 2\nfn f(a int, b: int) : int { a + )\n  b }\nvar y = @ 3\n"
+                       "fn g(a: int) : int { a }\nvar z = (1 + 2\n",
+                       &ast);
+      const std::vector<std::string> expected = {
+              "f:1:13: expected an expression [)]", "f:2:5: expected a variable name [=]",
+              "f:3:8: expected ':' [int]",          "f:3:33: expected an expression [)]",
+              "f:5:9: unknown character [@]",       "f:7:9: expected ')' [(]",
+      };
+      EXPECT_EQ(errors, expected);
+      EXPECT_NE(ast.find("int function g(int a) :"), std::string::npos) << "Items after errors should still parse: "
+                                                                          << ast;
+      EXPECT_NE(ast.find("<error>"), std::string::npos);
+}
+
+TEST(ParserDiagnostics, CleanInputHasNone) {
+      std::string ast;
+      EXPECT_TRUE(diagnose("fn f(a: int) : int { a + 1 }\nvar x = f\n", &ast).empty());
+      EXPECT_EQ(ast.find("<error>"), std::string::npos);
+}
+
+TEST(ParserDiagnostics, CommentsAreNotOperands) {
+      std::string ast;
+      EXPECT_TRUE(diagnose("var a = 1\n// note\nvar b = 2\nvar c = a + // note\n b\n", &ast).empty());
+      EXPECT_EQ(ast.find("<error>"), std::string::npos);
+      EXPECT_EQ(diagnose("var a = // note\n"), std::vector<std::string>{"f:2:1: expected an expression []"})
+              << "A comment where an operand should be is no operand.";
+}
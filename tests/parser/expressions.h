@@ -0,0 +1,69 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "../../src/ast_printer.hpp"
+
+inline std::string parse_to_text(const std::string_view in) {
+      auto lexer = Lexer(in);
+      if (lexer.tokenize())
+            return "<lexer error>";
+      Context ctx;
+      Parser parser(lexer.tokens, ctx);
+      std::string out;
+      StringSink sink{out};
+      AstPrinter(sink).print(parser.parse());
+      return out;
+}
+
+TEST(ParserExpressions, PrecedenceAndAssociativity) {
+      EXPECT_EQ(parse_to_text("1 - 2 - 3 * 4"), "((1 - 2) - (3 * 4))\n");
+      EXPECT_EQ(parse_to_text("1 < 2 == 3 >= 4 && 5 || 6"), "((((1 < 2) == (3 >= 4)) && 5) || 6)\n");
+      EXPECT_EQ(parse_to_text("1 | 2 & 3 != 4"), "(1 | (2 & (3 != 4)))\n");
+      EXPECT_EQ(parse_to_text("var a = 1\na = a += 2"), "unknown_type a = 1\n(a = (a += 2))\n");
+      EXPECT_EQ(parse_to_text("-(1 + 2) * !3"), "(-(1 + 2) * !3)\n");
+}
+
+TEST(ParserExpressions, CommentsAreSkipped) {
+      EXPECT_EQ(parse_to_text("var a = 1\n// note\nvar b = 2\nb"), "unknown_type a = 1\nunknown_type b = 2\nb\n");
+      EXPECT_EQ(parse_to_text("1 + // note\n 2"), "(1 + 2)\n");
+      EXPECT_EQ(parse_to_text("fn f(a: int) : int { // note\n a }"), "int function f(int a) :\n\ta\n");
+}
+
+TEST(ParserExpressions, DeepNestingDoesNotRecurse) {
+      const std::string in = std::string(100000, '(') + "1" + std::string(100000, ')') + " + 2";
+      auto lexer = Lexer(in);
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+      Context ctx;
+      Parser parser(lexer.tokens, ctx);
+      const auto nodes = parser.parse();
+      ASSERT_EQ(nodes.size(), 1u);
+      ASSERT_EQ(nodes[0]->kind, NodeKind::binary);
+      EXPECT_EQ(static_cast<const BinaryOperation*>(nodes[0])->left->kind, NodeKind::number);
+}
+
+TEST(ParserExpressions, TreesDeeperThanTheLimitBecomeErrors) {
+      const auto deepest = [](const std::string& in) {
+            auto lexer = Lexer(in);
+            Diagnostics diagnostics;
+            lexer.tokenize(diagnostics);
+            Context ctx;
+            Parser parser(lexer.tokens, ctx, diagnostics);
+            parser.max_depth = 64;
+            const std::vector<ASTNode*> nodes = parser.parse();
+            // printing recurses once per level, so it gets through at any depth the parser lets past
+            std::string out;
+            StringSink sink{out};
+            AstPrinter(sink).print(nodes);
+            return diagnostics.list().empty() ? "" : diagnostics.list()[0].message();
+      };
+      std::string chain = "x", calls, vars;
+      for (int i = 0; i < 10000; i++) {
+            chain += " + x";
+            calls += "f(";
+            vars += "var v = ";
+      }
+      EXPECT_EQ(deepest(chain), "nested too deeply");
+      EXPECT_EQ(deepest(calls + "1"), "nested too deeply");
+      EXPECT_EQ(deepest(vars + "1"), "nested too deeply");
+      EXPECT_EQ(deepest(std::string(10000, '-') + "x"), "nested too deeply");
+      EXPECT_EQ(deepest("fn g(a: int) : int { f(f(f(a + a + a))) }\nvar y = -(-(g(1)))\n"), "");
+}
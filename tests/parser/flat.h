@@ -0,0 +1,32 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "../../src/ast_flat.hpp"
+
+TEST(ParserFlat, ChildrenComeBeforeParents) {
+      auto lexer = Lexer("var x = 1 + 2 * 3\nfn g(a: int, b: float): int;");
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+      Context ctx;
+      Parser parser(lexer.tokens, ctx);
+      const FlatAst ast = Flattener().flatten(parser.parse());
+
+      ASSERT_EQ(ast.roots.size(), 2u);
+      const FlatNode& var = ast.nodes[ast.roots[0]];
+      ASSERT_EQ(var.kind, NodeKind::variable);
+      EXPECT_EQ(ast.str(var.data), "x");
+
+      const FlatNode& sum = ast.nodes[var.lhs];
+      ASSERT_EQ(sum.kind, NodeKind::binary);
+      EXPECT_EQ(static_cast<TypeOfToken>(sum.aux), TypeOfToken::OP_PLUS);
+      EXPECT_LT(sum.lhs, var.lhs);
+      EXPECT_LT(sum.rhs, var.lhs);
+      EXPECT_EQ(ast.str(ast.nodes[sum.lhs].data), "1");
+      EXPECT_EQ(ast.nodes[sum.rhs].kind, NodeKind::binary);
+
+      const FlatNode& proto = ast.nodes[ast.roots[1]];
+      ASSERT_EQ(proto.kind, NodeKind::prototype);
+      EXPECT_EQ(proto.type, Type::INT);
+      const auto params = ast.list(proto);
+      ASSERT_EQ(params.size(), 2u);
+      EXPECT_EQ(ast.str(ast.nodes[params[0]].data), "a");
+      EXPECT_EQ(ast.nodes[params[1]].type, Type::FLOAT);
+}
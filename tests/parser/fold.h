@@ -0,0 +1,58 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <string>
+#include "../../src/ast_printer.hpp"
+
+inline std::string fold_to_text(const std::string_view in) {
+      Lexer lexer(in);
+      if (lexer.tokenize())
+            return "<lexer error>";
+      Context ctx;
+      Parser parser(lexer.tokens, ctx);
+      parser.fold_constants = true;
+      std::string out;
+      StringSink sink{out};
+      AstPrinter(sink).print(parser.parse());
+      return out;
+}
+
+TEST(ParserFold, NumbersCarryTheirValue) {
+      Lexer lexer("42 2.5 99999999999999999999");
+      ASSERT_FALSE(lexer.tokenize());
+      Context ctx;
+      Parser parser(lexer.tokens, ctx);
+      const std::vector<ASTNode*> nodes = parser.parse();
+      ASSERT_EQ(nodes.size(), 3u);
+      const auto* i = static_cast<const NumberNode*>(nodes[0]);
+      const auto* f = static_cast<const NumberNode*>(nodes[1]);
+      EXPECT_EQ(i->type, Type::INT);
+      EXPECT_EQ(i->integer, 42);
+      EXPECT_EQ(f->type, Type::FLOAT);
+      EXPECT_DOUBLE_EQ(f->real, 2.5);
+      EXPECT_EQ(nodes[2]->type, Type::UNKNOWN) << "An out of range literal has no value to fold.";
+}
+
+TEST(ParserFold, CollapsesConstantSubtrees) {
+      EXPECT_EQ(fold_to_text("1 + 2 * 3"), "7\n");
+      EXPECT_EQ(fold_to_text("-(10 - 4) / 4"), "-1\n");
+      EXPECT_EQ(fold_to_text("1.5 * 2.0"), "3.0\n");
+      EXPECT_EQ(fold_to_text("1 < 2 && 3 == 3"), "true\n");
+      EXPECT_EQ(fold_to_text("var a = 2 * 3\nvar b = a + 1 * 2"), "unknown_type a = 6\nunknown_type b = (a + 2)\n");
+}
+
+TEST(ParserFold, NamesGetTheFoldedType) {
+      Lexer lexer("var a = 2 * 3\na");
+      ASSERT_FALSE(lexer.tokenize());
+      Context ctx;
+      Parser parser(lexer.tokens, ctx);
+      parser.fold_constants = true;
+      const std::vector<ASTNode*> nodes = parser.parse();
+      ASSERT_EQ(nodes.size(), 2u);
+      EXPECT_EQ(nodes[1]->type, Type::INT) << "An unfolded 2 * 3 has no type to give `a`.";
+}
+
+TEST(ParserFold, LeavesWhatHasNoConstantValue) {
+      EXPECT_EQ(fold_to_text("1 + 2.0"), "(1 + 2.0)\n") << "INT and FLOAT operands aren't mixed.";
+      EXPECT_EQ(fold_to_text("1 / 0"), "(1 / 0)\n");
+      EXPECT_EQ(fold_to_text("9223372036854775807 + 1"), "-9223372036854775808\n") << "INT arithmetic wraps.";
+}
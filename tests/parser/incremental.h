@@ -0,0 +1,58 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "../../src/ast_printer.hpp"
+#include "../../src/incremental.hpp"
+
+TEST(ParserIncremental, EditsMatchAFullRelex) {
+      std::string in = "fn f(a: int): int { var x = 1 }\nfn g(): int;\n"
+                       "var s = \"a\\tb\"\nfn h(): float { var y = 2 }\n";
+      Document doc(in);
+      ASSERT_EQ(doc.error(), std::nullopt);
+      ASSERT_EQ(doc.ast().size(), 4u);
+      const ASTNode* f = doc.ast()[0];
+      const ASTNode* h = doc.ast()[3];
+
+      const size_t at = in.find("var s");
+      ASSERT_EQ(doc.edit({at + 4, 1, "longer"}), std::nullopt);
+      in.replace(at + 4, 1, "longer");
+      EXPECT_EQ(doc.text(), in);
+      EXPECT_EQ(doc.reused(), 3u);
+      EXPECT_EQ(doc.ast()[0], f) << "Untouched functions should be reused as they are.";
+      EXPECT_EQ(doc.ast()[3], h);
+
+      Lexer full(in);
+      ASSERT_EQ(full.tokenize(), std::nullopt);
+      ASSERT_EQ(doc.tokens().size(), full.tokens.size());
+      for (size_t i = 0; i < full.tokens.size(); i++) {
+            EXPECT_EQ(doc.tokens()[i].offset, full.tokens[i].offset) << i;
+            EXPECT_EQ(doc.tokens()[i].val, full.tokens[i].val) << i;
+      }
+      EXPECT_EQ(doc.tokens().line_starts, full.tokens.line_starts);
+      EXPECT_EQ(to_string(doc.ast()[2]), "unknown_type longer = a\tb");
+
+      // opening a comment swallows everything after it, closing it brings the functions back
+      ASSERT_EQ(doc.edit({0, 0, "/*"}), LexerError::unclosed_comment);
+      ASSERT_EQ(doc.edit({0, 2, ""}), std::nullopt);
+      EXPECT_EQ(doc.text(), in);
+      EXPECT_EQ(doc.ast().size(), 4u);
+      EXPECT_EQ(to_string(doc.ast()[1]), "int function g()");
+}
+
+TEST(ParserIncremental, ReusedFunctionsNamedAfterAComment) {
+      std::string in = "fn /* c */ foo() : int { 1 }\nvar a = 1\nvar b = foo()\n";
+      Document doc(in);
+      ASSERT_EQ(doc.error(), std::nullopt);
+      ASSERT_EQ(doc.ast().size(), 3u);
+      const auto call_type = [](const ASTNode* var) { return static_cast<const VariableNode*>(var)->val->type; };
+      EXPECT_EQ(call_type(doc.ast()[2]), Type::INT);
+
+      const size_t at = in.find("= 1");
+      ASSERT_EQ(doc.edit({at + 2, 1, "22"}), std::nullopt);
+      in.replace(at + 2, 1, "22");
+      EXPECT_EQ(doc.reused(), 1u);
+      const Document fresh(in);
+      ASSERT_EQ(doc.ast().size(), fresh.ast().size());
+      EXPECT_EQ(call_type(doc.ast()[2]), Type::INT) << "`foo` must still be declared when its item is reused.";
+      for (size_t i = 0; i < doc.ast().size(); i++)
+            EXPECT_EQ(to_string(doc.ast()[i]), to_string(fresh.ast()[i])) << i;
+}
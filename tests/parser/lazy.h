@@ -0,0 +1,78 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../../src/ast_printer.hpp"
+
+// every item of `in` printed, and every diagnostic's offset, parsing bodies eagerly or lazily
+inline std::pair<std::vector<std::string>, std::vector<uint32_t>> parse_bodies(const std::string_view in,
+                                                                                const bool lazy) {
+      Lexer lexer(in);
+      EXPECT_EQ(lexer.tokenize(), std::nullopt);
+      Context ctx;
+      Diagnostics diagnostics;
+      Parser parser(lexer.tokens, ctx, diagnostics);
+      parser.lazy_bodies = lazy;
+      const std::vector<ASTNode*> ast = parser.parse();
+      if (lazy) {
+            for (const ASTNode* item : ast) {
+                  if (item && item->kind == NodeKind::function) {
+                        EXPECT_TRUE(static_cast<const FunctionNode*>(item)->pending());
+                  }
+            }
+      }
+      parser.parse_bodies(ast);
+      diagnostics.sort();
+
+      std::pair<std::vector<std::string>, std::vector<uint32_t>> out;
+      for (const ASTNode* item : ast)
+            out.first.push_back(to_string(item));
+      for (const Diagnostic& d : diagnostics.list())
+            out.second.push_back(d.offset);
+      return out;
+}
+
+TEST(ParserLazy, BodiesParseTheSameWhenNeeded) {
+      std::string in = "var g = 1\n"
+                       "fn f(a: int) : int { var x = comptime { var k = 2\nk * 3 }\nx + a }\n"
+                       "fn p(s: string) : bool;\n"
+                       "fn nested() : int { fn inner() : int { 1 }\n2 }\n"
+                       "var h = f(g)\n";
+      // a body longer than a vector of token kinds, with braces in every position
+      in += "fn long() : int {";
+      for (int i = 0; i < 40; i++)
+            in += " comptime { " + std::to_string(i) + " }";
+      in += " }\n";
+      EXPECT_EQ(parse_bodies(in, true), parse_bodies(in, false));
+
+      // the eager parse takes the '}' for the missing operand and the next line into the body, braces don't lie
+      const std::string broken = "fn broken() : int { 1 + }\nvar after = 2\n";
+      EXPECT_EQ(parse_bodies(broken, false).first.size(), 1u);
+      EXPECT_EQ(parse_bodies(broken, true).first,
+                (std::vector<std::string>{"int function broken() :\n\t(1 + <error>)", "unknown_type after = 2"}));
+}
+
+TEST(ParserLazy, SkippedBodiesCostNothing) {
+      std::string in;
+      for (int i = 0; i < 100; i++)
+            in += "fn f" + std::to_string(i) + "(x: int) : int { var y = x * 2 + 1\ny * y - x }\n";
+      Lexer lexer(in);
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+
+      Context eager_ctx, lazy_ctx;
+      Parser eager(lexer.tokens, eager_ctx);
+      Parser lazy(lexer.tokens, lazy_ctx);
+      lazy.lazy_bodies = true;
+      eager.parse();
+      const std::vector<ASTNode*> ast = lazy.parse();
+      ASSERT_EQ(ast.size(), 100u);
+      EXPECT_LT(lazy_ctx.arena.bytes_used() * 2, eager_ctx.arena.bytes_used());
+      auto* fn = static_cast<FunctionNode*>(ast[7]);
+      EXPECT_TRUE(fn->pending());
+      EXPECT_EQ(to_string(fn->Proto), "int function f7(int x)");
+
+      lazy.parse_body(*fn);
+      EXPECT_FALSE(fn->pending());
+      EXPECT_EQ(to_string(fn), "int function f7(int x) :\n\tunknown_type y = ((x * 2) + 1)\n\t((y * y) - x)");
+      EXPECT_EQ(lazy.index, lexer.tokens.size() - 1) << "Parsing a body leaves the parser where it was.";
+}
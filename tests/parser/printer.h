@@ -0,0 +1,40 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "../../src/ast_printer.hpp"
+
+TEST(ParserPrinter, TextAndJson) {
+      auto lexer = Lexer("var x = 1 + 2 * 3\nfn g(a: int): int { var s = \"a\\\"b\" }");
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+      Context ctx;
+      Parser parser(lexer.tokens, ctx);
+      const auto nodes = parser.parse();
+
+      std::string out;
+      StringSink sink{out};
+      AstPrinter(sink).print(nodes);
+      EXPECT_EQ(out, "unknown_type x = (1 + (2 * 3))\nint function g(int a) :\n\tunknown_type s = a\"b\n");
+
+      out.clear();
+      AstPrinter(sink, PrintStyle::json).print(nodes[1]);
+      EXPECT_EQ(out, R"({"kind":"function","prototype":{"kind":"prototype","name":"g","type":"int","params":[)"
+                     R"({"kind":"variable","name":"a","type":"int"}]},"body":[{"kind":"variable","name":"s",)"
+                     R"("type":"unknown_type","value":{"kind":"string","value":"a\"b"}}]})");
+}
+
+TEST(ParserPrinter, InternedTypesByName) {
+      auto lexer = Lexer("fn f(p: Point, n: int) : Point;");
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+      Context ctx;
+      const Type point = *ctx.types.intern(TypeKind::struct_type, "Point", std::vector<Type>{Type::FLOAT});
+      ASSERT_TRUE(ctx.types.declare("Point", point));
+      Parser parser(lexer.tokens, ctx);
+      const auto nodes = parser.parse();
+      ASSERT_EQ(nodes.size(), 1u);
+
+      EXPECT_EQ(to_string(nodes[0], PrintStyle::text, &ctx.types), "Point function f(Point p, int n)");
+      EXPECT_EQ(to_string(nodes[0], PrintStyle::json, &ctx.types),
+                R"({"kind":"prototype","name":"f","type":"Point","params":[{"kind":"variable","name":"p",)"
+                R"("type":"Point"},{"kind":"variable","name":"n","type":"int"}]})");
+      EXPECT_EQ(to_string(nodes[0]), "unknown_type function f(unknown_type p, int n)")
+              << "Without the table only the built-ins have names.";
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <gtest/gtest.h>
+#include "../../src/parser.hpp"
+
+TEST(ParserSymbols, IdentifiersAreInternedWhileLexing) {
+      auto lexer = Lexer("abc + de * abc - fn");
+      ASSERT_EQ(lexer.tokenize(), std::nullopt);
+      const TokenStream& tokens = lexer.tokens;
+      EXPECT_EQ(tokens.symbol(0), tokens.symbol(4));
+      EXPECT_NE(tokens.symbol(0), tokens.symbol(2));
+      EXPECT_EQ(tokens.symbol(1), no_symbol);
+      EXPECT_EQ(tokens.symbol(6), no_symbol) << "Keywords aren't names.";
+      EXPECT_EQ(tokens.names.size(), 2u);
+      EXPECT_EQ(tokens.names.str(tokens[2].symbol), "de");
+      EXPECT_EQ(tokens.names.find("abc"), tokens.symbol(0));
+      EXPECT_EQ(tokens.names.find("fn"), no_symbol);
+}
+
+TEST(ParserSymbols, ScopesShadowAndRestore) {
+      StringInterner names;
+      const SymbolId x = names.intern("x");
+      const SymbolId y = names.intern("y");
+      SymbolTable table;
+      table.declare_var(x, Symbol(Type::INT));
+      table.push_scope();
+      table.declare_var(x, Symbol(Type::STRING));
+      table.declare_var(y, Symbol(Type::BOOL));
+      table.declare_var(y, Symbol(Type::FLOAT));
+      ASSERT_NE(table.get_var(x), nullptr);
+      EXPECT_EQ(table.get_var(x)->type, Type::STRING);
+      EXPECT_EQ(table.get_var(y)->type, Type::BOOL) << "Redeclaring in the same scope should keep the first.";
+      EXPECT_EQ(table.get_function(x), nullptr);
+      table.pop_scope();
+      EXPECT_EQ(table.get_var(x)->type, Type::INT);
+      EXPECT_EQ(table.get_var(y), nullptr);
+}
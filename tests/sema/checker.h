@@ -0,0 +1,104 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../../src/sema.hpp"
+
+// every diagnostic of `in` as "line:column: message"
+inline std::vector<std::string> check_types(const std::string_view in, ThreadPool* pool = nullptr) {
+      Lexer lexer(in);
+      Diagnostics diagnostics;
+      lexer.tokenize(diagnostics);
+      Context ctx;
+      Parser parser(lexer.tokens, ctx, diagnostics);
+      const std::vector<ASTNode*> ast = parser.parse();
+      TypeChecker(lexer.tokens, diagnostics, pool).check(ast);
+      diagnostics.sort();
+      std::vector<std::string> out;
+      for (const Diagnostic& d : diagnostics.list())
+            out.push_back(format_diagnostic("", d, lexer.tokens).substr(1));
+      return out;
+}
+
+TEST(SemaTypes, WellTypedProgramsHaveNoErrors) {
+      EXPECT_EQ(check_types("fn sq(x: float) : float { x * x }\n"
+                            "fn pos(n: int) : bool { var z = 0\nn > z && !(n == z) }\n"
+                            "var g = sq(1.5)\n"
+                            "fn uses_global() : float { g += 1.0\ng }\n"
+                            "fn later(s: string) : bool { s == \"a\" }\n"
+                            "var c = comptime { var k = 2\nk * 3 }\n"
+                            "var b = later(\"b\") || pos(c)\n"),
+                std::vector<std::string>{});
+}
+
+TEST(SemaTypes, ExpressionsGetTheirTypes) {
+      Lexer lexer("fn f(x: int) : float { 1.5 }\nvar a = f(2) < 2.0\nvar s = -a\n");
+      ASSERT_FALSE(lexer.tokenize());
+      Context ctx;
+      Parser parser(lexer.tokens, ctx);
+      const std::vector<ASTNode*> ast = parser.parse();
+      Diagnostics diagnostics;
+      TypeChecker checker(lexer.tokens, diagnostics);
+      checker.check(ast);
+
+      const auto* a = static_cast<const VariableNode*>(ast[1]);
+      EXPECT_EQ(a->val->type, Type::BOOL);
+      EXPECT_EQ(static_cast<const BinaryOperation*>(a->val)->left->type, Type::FLOAT);
+      EXPECT_EQ(checker.globals().at("a"), Type::BOOL);
+      // `-` on a bool, and the global it initializes has no type
+      EXPECT_EQ(checker.globals().at("s"), Type::UNKNOWN);
+      ASSERT_EQ(diagnostics.size(), 1u);
+      EXPECT_EQ(diagnostics.list()[0].message(), "operator not defined for this type");
+}
+
+TEST(SemaTypes, ReportsEachErrorWhereItIs) {
+      EXPECT_EQ(check_types("nope\n"
+                            "1 + 2.0\n"
+                            "fn f(x: int) : int { x }\n"
+                            "f(1, 2)\n"
+                            "var w = f(\"s\")\n"
+                            "1 = 2\n"
+                            "w = 2.0\n"
+                            "fn g() : bool { 1 }\n"
+                            "h()\n"
+                            "fn k(a: int, b: thing) : int { a }\n"
+                            "var n = 1 + !1\n"
+                            "var w = \"text\"\n"
+                            "fn outer() : int { fn inner() : int { 1 }\n1 }\n"
+                            "var big = 99999999999999999999\n"),
+                (std::vector<std::string>{
+                        "1:1: unknown variable",
+                        "2:3: operand types don't match",
+                        "4:1: wrong number of arguments",
+                        "5:11: argument of the wrong type",
+                        "6:3: only a variable can be assigned to",
+                        "7:3: assigned value has the wrong type",
+                        "8:4: body doesn't have the function's return type",
+                        "9:1: unknown function",
+                        "10:14: unknown type",
+                        "11:13: operator not defined for this type",
+                        "12:5: global declared again with another type",
+                        "13:23: functions can only be declared at the top level",
+                        "15:11: integer literal out of range",
+                }));
+}
+
+TEST(SemaTypes, RedefinitionsMustMatchTheirPrototype) {
+      EXPECT_EQ(check_types("fn f(x: int) : int;\nfn f(x: int) : int { x }\nf(1)\n"), std::vector<std::string>{});
+      EXPECT_EQ(check_types("fn f(x: int) : int { x }\nfn f(x: float) : int { 1 }\n"),
+                std::vector<std::string>{"2:4: function already defined differently"});
+}
+
+TEST(SemaTypes, ParallelBodiesReportTheSameAsSequential) {
+      std::string in = "var base = 10\n";
+      for (int i = 0; i < 200; i++) {
+            const std::string n = std::to_string(i);
+            in += "fn f" + n + "(x: int) : int { var y = x + base\n";
+            in += i % 7 == 0 ? "y + 1.5 }\n" : "y * " + n + " }\n";
+      }
+      ThreadPool pool(4);
+      const std::vector<std::string> parallel = check_types(in, &pool);
+      EXPECT_EQ(parallel.size(), 29u);
+      EXPECT_EQ(parallel, check_types(in));
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../../src/query.hpp"
+#include "checker.h"
+
+// what the workspace reports for `path`, formatted like check_types()
+inline std::vector<std::string> workspace_errors(Workspace& ws, const std::string& path) {
+      std::vector<std::string> out;
+      for (const Diagnostic& d : ws.diagnostics(path))
+            out.push_back(format_diagnostic("", d, ws.document(path)->tokens()).substr(1));
+      return out;
+}
+
+TEST(SemaQueries, BodyEditsRecheckOnlyThatBody) {
+      std::string in = "fn sq(x: int) : int { x * x }\n"
+                       "fn a() : int { sq(2) }\n"
+                       "var g = 1\n"
+                       "fn b() : int { sq(3) + g }\n";
+      Workspace ws;
+      ws.open("m.nano", in);
+      EXPECT_EQ(workspace_errors(ws, "m.nano"), std::vector<std::string>{});
+      EXPECT_EQ(ws.bodies_checked(), 3u);
+      EXPECT_EQ(workspace_errors(ws, "m.nano"), std::vector<std::string>{});
+      EXPECT_EQ(ws.bodies_checked(), 3u) << "Nothing changed, nothing should be checked again.";
+
+      const auto replace = [&](const std::string& from, const std::string& to) {
+            const size_t at = in.find(from);
+            ASSERT_NE(at, std::string::npos);
+            in.replace(at, from.size(), to);
+            ASSERT_EQ(ws.edit("m.nano", {at, from.size(), to}), std::nullopt);
+      };
+
+      replace("x * x", "x + x");
+      EXPECT_EQ(workspace_errors(ws, "m.nano"), std::vector<std::string>{});
+      EXPECT_EQ(ws.bodies_checked(), 4u) << "The callers only depend on the prototype of sq.";
+
+      // moving everything down keeps what was found, where it is now
+      replace("fn sq", "\n\nfn sq");
+      replace("x + x", "x + 1.5");
+      EXPECT_EQ(workspace_errors(ws, "m.nano"), check_types(in));
+      EXPECT_EQ(workspace_errors(ws, "m.nano").size(), 1u);
+      EXPECT_EQ(ws.bodies_checked(), 5u);
+
+      replace("g = 1", "g = 2.5");
+      EXPECT_EQ(workspace_errors(ws, "m.nano"), check_types(in));
+      EXPECT_EQ(ws.bodies_checked(), 6u) << "Only b reads g.";
+
+      replace("x: int) : int", "x: int) : float");
+      EXPECT_EQ(workspace_errors(ws, "m.nano"), check_types(in));
+      EXPECT_EQ(ws.bodies_checked(), 9u) << "A new signature is checked against every caller.";
+      EXPECT_EQ(ws.signature("m.nano", "sq"), (FunctionType{{Type::INT}, Type::FLOAT}));
+      EXPECT_EQ(ws.signature("m.nano", "nope"), std::nullopt);
+}
+
+TEST(SemaQueries, TypesOfExpressions) {
+      const std::string in = "fn half(x: float) : float { x / 2.0 }\nvar h = half(3.0) < 1.0\n";
+      Workspace ws;
+      ws.open("m.nano", in);
+      EXPECT_EQ(ws.type_at("m.nano", in.find('/')), Type::FLOAT);
+      EXPECT_EQ(ws.type_at("m.nano", in.find("half(3")), Type::FLOAT);
+      EXPECT_EQ(ws.type_at("m.nano", in.find('<')), Type::BOOL);
+      EXPECT_EQ(ws.bodies_checked(), 1u);
+
+      // reopening starts over, even where the new document's items line up with the old one's
+      ws.open("m.nano", "fn half(x: int) : float { x }\n");
+      EXPECT_EQ(workspace_errors(ws, "m.nano"),
+                std::vector<std::string>{"1:4: body doesn't have the function's return type"});
+      EXPECT_EQ(ws.type_at("m.nano", 26), Type::INT);
+}
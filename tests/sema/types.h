@@ -0,0 +1,115 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../../src/parser.hpp"
+#include "../../src/types.hpp"
+
+TEST(SemaTypeTable, BuiltinsAreTheirOwnIds) {
+      const TypeTable types;
+      EXPECT_EQ(types.size(), builtin_types);
+      EXPECT_EQ(types.named("int"), Type::INT);
+      EXPECT_EQ(types.named("float"), Type::FLOAT);
+      EXPECT_EQ(types.named("string"), Type::STRING);
+      EXPECT_EQ(types.named("bool"), Type::BOOL);
+      EXPECT_EQ(types.named("null"), Type::NULL_T);
+      EXPECT_EQ(types.named("unknown_type"), Type::UNKNOWN);
+      EXPECT_EQ(types.named("integer"), Type::UNKNOWN);
+      EXPECT_EQ(types.kind(Type::STRING), TypeKind::builtin);
+}
+
+TEST(SemaTypeTable, InternsStructurallyAndNominally) {
+      TypeTable types;
+      const std::vector<Type> int_or_string{Type::INT, Type::STRING};
+      const Type dyn = *types.intern(TypeKind::dyn, "", int_or_string);
+      EXPECT_EQ(types.intern(TypeKind::dyn, "", std::vector<Type>{Type::INT, Type::STRING}), dyn);
+      EXPECT_NE(types.intern(TypeKind::dyn, "", std::vector<Type>{Type::STRING, Type::INT}), dyn);
+      EXPECT_EQ(types.str(dyn), "dyn(int, string)");
+
+      const Type point = *types.intern(TypeKind::struct_type, "Point", std::vector<Type>{Type::FLOAT, Type::FLOAT});
+      EXPECT_EQ(types.intern(TypeKind::struct_type, "Point", {}), point) << "Structs are the same by name.";
+      EXPECT_NE(types.intern(TypeKind::struct_type, "Size", std::vector<Type>{Type::FLOAT, Type::FLOAT}), point);
+      EXPECT_NE(types.intern(TypeKind::class_type, "Point", {}), point);
+      EXPECT_EQ(types.members(point).size(), 2u);
+      EXPECT_EQ(types.str(point), "Point");
+
+      // enough to rehash a few times
+      for (int i = 0; i < 1000; i++)
+            types.intern(TypeKind::enum_type, "E" + std::to_string(i), {});
+      EXPECT_EQ(types.intern(TypeKind::dyn, "", int_or_string), dyn);
+      EXPECT_EQ(types.intern(TypeKind::enum_type, "E500", {}), types.intern(TypeKind::enum_type, "E500", {}));
+}
+
+TEST(SemaTypeTable, ParserLooksTypeNamesUp) {
+      Lexer lexer("fn f(p: Point, n: int) : Point;\nfn g(q: Nowhere) : bool;\n");
+      ASSERT_FALSE(lexer.tokenize());
+      Context ctx;
+      ASSERT_TRUE(ctx.types.declare("Point", *ctx.types.intern(TypeKind::struct_type, "Point", {})));
+      EXPECT_FALSE(ctx.types.declare("int", Type::FLOAT));
+      Parser parser(lexer.tokens, ctx);
+      const std::vector<ASTNode*> ast = parser.parse();
+      ASSERT_EQ(ast.size(), 2u);
+
+      const auto* f = static_cast<const PrototypeNode*>(ast[0]);
+      EXPECT_EQ(f->type, ctx.types.named("Point"));
+      EXPECT_EQ(f->args[0]->type, ctx.types.named("Point"));
+      EXPECT_EQ(f->args[1]->type, Type::INT);
+      EXPECT_EQ(static_cast<const PrototypeNode*>(ast[1])->args[0]->type, Type::UNKNOWN);
+}
+
+TEST(SemaTypeTable, ParserLooksNamesUpByTheLexersSymbol) {
+      Lexer lexer("fn f(p: Point) : int;\n");
+      ASSERT_FALSE(lexer.tokenize());
+      TypeTable types;
+      const Type point = *types.intern(TypeKind::struct_type, "Point", {});
+      ASSERT_TRUE(types.declare("Point", point));
+      const SymbolId symbol = lexer.tokens.names.find("Point");
+      ASSERT_NE(symbol, no_symbol);
+      EXPECT_EQ(types.named(lexer.tokens.names, symbol), point);
+      EXPECT_EQ(types.named(lexer.tokens.names, lexer.tokens.names.find("f")), Type::UNKNOWN);
+      EXPECT_EQ(types.named(lexer.tokens.names, lexer.tokens.names.find("int")), Type::INT);
+}
+
+TEST(SemaTypeTable, ExportedTypesAreRemappedOnImport) {
+      TypeTable from;
+      from.intern(TypeKind::enum_type, "Unused", {});
+      const Type point = *from.intern(TypeKind::struct_type, "Point", std::vector<Type>{Type::FLOAT, Type::FLOAT});
+      const Type dyn = *from.intern(TypeKind::dyn, "", std::vector<Type>{point, Type::INT});
+
+      TypeTable::Export out(from);
+      const Type stored = out.export_type(dyn);
+      EXPECT_EQ(out.export_type(dyn), stored);
+      EXPECT_EQ(out.export_type(Type::INT), Type::INT);
+      ASSERT_EQ(out.types.size(), 2u) << "Only what `dyn` is made of is stored, not every type of the table.";
+
+      TypeTable to;
+      const Type size = *to.intern(TypeKind::struct_type, "Size", {});
+      const std::optional<std::vector<Type>> ids = to.import(out.types, out.members, out.names);
+      ASSERT_TRUE(ids);
+      const Type imported = (*ids)[static_cast<size_t>(stored)];
+      EXPECT_NE(imported, size);
+      EXPECT_EQ(to.str(imported), "dyn(Point, int)");
+      EXPECT_EQ(to.members(imported)[0], *to.intern(TypeKind::struct_type, "Point", {}));
+      EXPECT_EQ(to.members(to.members(imported)[0]), (std::vector<Type>{Type::FLOAT, Type::FLOAT}));
+
+      std::vector<Type> forward = out.members;
+      forward[0] = static_cast<Type>(builtin_types + 1);
+      EXPECT_FALSE(to.import(out.types, forward, out.names)) << "A member must be stored before what it's in.";
+      std::vector<StoredType> past = out.types;
+      past[0].name_length = static_cast<uint32_t>(out.names.size() + 1);
+      EXPECT_FALSE(to.import(past, out.members, out.names));
+}
+
+TEST(SemaTypeTable, RefusesTypesPastTheLastId) {
+      TypeTable types;
+      while (types.size() < max_types)
+            ASSERT_TRUE(types.intern(TypeKind::enum_type, "E" + std::to_string(types.size()), {}));
+      EXPECT_FALSE(types.intern(TypeKind::enum_type, "Overflow", {})) << "A new type must not alias another's id.";
+      EXPECT_EQ(types.intern(TypeKind::enum_type, "E100", {}), static_cast<Type>(100))
+              << "Types already interned are still found.";
+
+      TypeTable from;
+      TypeTable::Export out(from);
+      out.export_type(*from.intern(TypeKind::struct_type, "Point", {}));
+      EXPECT_FALSE(types.import(out.types, out.members, out.names));
+}
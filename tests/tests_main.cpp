@@ -2,4 +2,30 @@
 #include <gtest/gtest.h>
 #include "../src/lexer.hpp"
 
-#include "lexer/string.h"
\ No newline at end of file
+#include "lexer/string.h"
+#include "lexer/spans.h"
+#include "lexer/stream.h"
+#include "lexer/scan.h"
+#include "lexer/keywords.h"
+#include "lexer/parallel.h"
+#include "parser/flat.h"
+#include "parser/printer.h"
+#include "parser/expressions.h"
+#include "parser/symbols.h"
+#include "parser/incremental.h"
+#include "parser/lazy.h"
+#include "parser/diagnostics.h"
+#include "parser/fold.h"
+#include "driver/driver.h"
+#include "driver/cache.h"
+#include "driver/stats.h"
+#include "driver/interface.h"
+#include "driver/server.h"
+#include "driver/remote.h"
+#include "comptime/interpreter.h"
+#include "sema/checker.h"
+#include "sema/queries.h"
+#include "sema/types.h"
+#include "vm/bytecode.h"
+#include "ir/ssa.h"
+#include "backend/llvm.h"
@@ -0,0 +1,83 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "../../src/bytecode.hpp"
+#include "../../src/vm.hpp"
+
+struct BytecodeRun {
+      Context ctx;
+      Program program;
+      std::optional<CompileError> error;
+};
+
+inline void compile_bytecode(const std::string_view in, BytecodeRun& run) {
+      Lexer lexer(in);
+      EXPECT_FALSE(lexer.tokenize());
+      Diagnostics diagnostics;
+      Parser parser(lexer.tokens, run.ctx, diagnostics);
+      const std::vector<ASTNode*> nodes = parser.parse();
+      EXPECT_TRUE(diagnostics.empty());
+      run.error = BytecodeCompiler(run.program).compile(nodes);
+}
+
+TEST(Bytecode, PicksInstructionsByOperandType) {
+      BytecodeRun run;
+      compile_bytecode("fn f(a: int, b: float) : bool { a * 2 < 7 && b + 1.0 > 2.5 }\n", run);
+      ASSERT_FALSE(run.error);
+      const std::string code = disassemble(run.program.functions[0]);
+      EXPECT_NE(code.find("mul_i r3, r0, r4"), std::string::npos) << code;
+      EXPECT_NE(code.find("lt_i"), std::string::npos) << code;
+      EXPECT_NE(code.find("jump_unless"), std::string::npos) << code;
+      EXPECT_NE(code.find("add_f r3, r1, r4"), std::string::npos) << code;
+      EXPECT_NE(code.find("gt_f"), std::string::npos) << code;
+}
+
+TEST(Bytecode, RunsFunctionsAndGlobals) {
+      BytecodeRun run;
+      compile_bytecode("fn fib(n: int) : int { var r = n\nn > 1 && (r = fib(n - 1) + fib(n - 2)) > 0\nr }\n"
+                       "fn half(x: float) : float { x / 2.0 }\n"
+                       "fn same(a: string, b: string) : bool { a == b }\n"
+                       "var base = 20\nbase += 5\nfib(base)\n",
+                       run);
+      ASSERT_FALSE(run.error);
+      VM vm(run.program);
+      Value out;
+      ASSERT_FALSE(vm.run(out));
+      EXPECT_EQ(out, Value::of(int64_t{75025}));
+
+      ASSERT_FALSE(vm.call("half", std::vector{Value::of(3.0)}, out));
+      EXPECT_EQ(out, Value::of(1.5));
+      const std::string_view x = "x";
+      ASSERT_FALSE(vm.call("same", std::vector{Value::of(x), Value::of(x)}, out));
+      EXPECT_EQ(out, Value::of(true));
+      EXPECT_EQ(vm.call("half", std::vector{Value::of(int64_t{3})}, out), RuntimeError::type_mismatch);
+}
+
+TEST(Bytecode, ReportsErrors) {
+      const std::pair<std::string_view, CompileError> cases[] = {
+              {"fn f(x: foo) : int { x }\n", CompileError::unknown_type},
+              {"fn f(x: int) : int { x + 1.0 }\n", CompileError::type_mismatch},
+              {"fn f(x: int) : int { g(x) }\n", CompileError::unknown_function},
+              {"fn f(x: int) : int { f(x, x) }\n", CompileError::argument_count},
+              {"var a = b\n", CompileError::unknown_name},
+              {"var a = 1\n1 = a\n", CompileError::not_assignable},
+      };
+      for (const auto& [source, error] : cases) {
+            BytecodeRun run;
+            compile_bytecode(source, run);
+            EXPECT_EQ(run.error, error) << source;
+      }
+
+      BytecodeRun run;
+      compile_bytecode("fn loop(n: int) : int { loop(n + 1) }\nvar z = 0\nloop(1 / z)\n", run);
+      ASSERT_FALSE(run.error);
+      Value out;
+      EXPECT_EQ(VM(run.program).run(out), RuntimeError::division_by_zero);
+      BytecodeRun deep;
+      compile_bytecode("fn loop(n: int) : int { loop(n + 1) }\nloop(0)\n", deep);
+      VM vm(deep.program);
+      vm.max_depth = 1000;
+      EXPECT_EQ(vm.run(out), RuntimeError::stack_overflow);
+}